@@ -21,8 +21,19 @@
 ########################################
 
 # initialize globals and create new log file....
+# (if the logging service is running it writes the log, and no file is reported back)
 LOG_NAMESPACE="inglenook.logging"
-LOG_FILE=$(ign_log_write start -n `basename $0` -p $$)
+LOG_FILE=$(ign_log_write start -S -n `basename $0` -p $$)
+if [ -z "$LOG_FILE" ]; then
+    LOG_TARGET="-S -n `basename $0` -p $$"
+else
+    LOG_TARGET="-f $LOG_FILE"
+fi
+
+# start one writer for the life of the script and feed it records, rather than starting a writer
+# for every message. (its console output goes to our standard out, but may lag behind our own.)
+exec {LOG_CONSOLE}>&1
+eval "coproc LOG_SERVER { exec ign_log_write serve -0 $LOG_TARGET >&$LOG_CONSOLE; }"
 
 ########################################
 # log()
@@ -40,8 +51,12 @@ function log()
         CATEGORY=$2;
     fi
 
-    # write the message to the log file.
-    eval "ign_log_write -a write -f $LOG_FILE -N $LOG_NAMESPACE -C $CATEGORY -m \"$1\""
+    # pass the message to the writer (or write it ourselves if the writer has gone).
+    if [ -n "$LOG_SERVER_PID" ]; then
+        printf '%s\t%s\t%s\0' "$CATEGORY" "$LOG_NAMESPACE" "$1" >&${LOG_SERVER[1]}
+    else
+        eval "ign_log_write -a write $LOG_TARGET -N $LOG_NAMESPACE -C $CATEGORY -m \"$1\""
+    fi
 }
 
 ########################################
@@ -109,8 +124,15 @@ function log_fatal()
 ########################################
 function close_log_file()
 {
-    # close the log file
-    eval ign_log_write close $LOG_FILE
+    # let the writer finish off what it has been given...
+    if [ -n "$LOG_SERVER_PID" ]; then
+        LOG_SERVER_WAIT=$LOG_SERVER_PID
+        eval "exec ${LOG_SERVER[1]}>&-"
+        wait $LOG_SERVER_WAIT
+    fi
+
+    # ... then close the log file
+    eval ign_log_write close $LOG_TARGET
 }
 
 # setup exit trapping
@@ -19,8 +19,13 @@
 // boost (http://boost.org) includes
 #include <boost/locale.hpp>
 
+// standard library includes
+#include <fstream>
+#include <iostream>
+
 // inglenook includes
 #include <ign_core/application.h>
+#include <ign_logging/log_socket.h>
 #include "log_write_actions.h"
 #include "log_write_exceptions.h"
 #include "program_options.h"
@@ -70,6 +75,14 @@ log_write_action parse_action(const std::string& action_string)
     {
         result = close_log;
     }
+    else if(action_string == serve_full_action_string)
+    {
+        result = serve_log;
+    }
+    else if(action_string == serve_short_action_string)
+    {
+        result = serve_log;
+    }
     
     // return the result
     return result;
@@ -127,8 +140,9 @@ const boost::filesystem::path create_log_file(const boost::program_options::vari
     boost::filesystem::path result = "";
 
     // based on the size of the arguments vector - choose how to process
-    // the create request
-    switch (arguments.size())
+    // the create request (the service switch doesn't count).
+    bool use_service = service_requested(arguments);
+    switch (arguments.size() - (use_service ? 1 : 0))
     {
         case 2: // expect create action and a file name.
         {
@@ -142,7 +156,12 @@ const boost::filesystem::path create_log_file(const boost::program_options::vari
             // extract the pid and name, then call the appropriate method...
             auto pid = require_parameter<pid_type>(arguments, PO_PID_FULL);
             auto name = require_parameter<std::string>(arguments, PO_NAME_FULL);
-            result = create_log_file(name, pid);
+
+            // if the logging service takes the session there is no file for us to report.
+            if(!use_service || !start_service_log(name, pid))
+            {
+                result = create_log_file(name, pid);
+            }
             break;
         }
         default: // improper number of arguments - tell user whats wrong.
@@ -242,14 +261,24 @@ const boost::filesystem::path create_log_file(const std::string& name, const pid
  */
 void write_log_entry(const boost::program_options::variables_map& arguments)
 {
-    // create defaults - we only actually require the log path and the message
-    std::string file_path       = require_parameter <std::string>(arguments, PO_FILENAME_FULL);
+    // create defaults - we only actually require the log path (or process) and the message
     std::string message         = require_parameter <std::string>(arguments, PO_MESSAGE_FULL);
     std::string log_namespace   = optional_parameter<std::string>(arguments, PO_NAMESPACE_FULL, log_write_default_namespace);
     unsigned int event_type     = optional_parameter<unsigned int>(arguments, PO_CATEGORY_FULL, category::information);
 
-    // write out the log entry
-    write_log_entry(file_path, message, log_namespace, convert_to_category(event_type) );
+    // pass the log entry to the logging service...
+    if(service_requested(arguments))
+    {
+        auto pid = require_parameter<pid_type>(arguments, PO_PID_FULL);
+        auto name = require_parameter<std::string>(arguments, PO_NAME_FULL);
+        write_service_entry(name, pid, message, log_namespace, convert_to_category(event_type) );
+    }
+    // ... or write out the log entry ourselves
+    else
+    {
+        std::string file_path = require_parameter <std::string>(arguments, PO_FILENAME_FULL);
+        write_log_entry(file_path, message, log_namespace, convert_to_category(event_type) );
+    }
 }
 
 /**
@@ -287,9 +316,19 @@ void write_log_entry(const boost::filesystem::path& path_to_log, const std::stri
  */
 void close_log_file(const boost::program_options::variables_map& arguments)
 {
-    // extract the log name and call close method...
-    auto log_file = require_parameter<std::string>(arguments, PO_FILENAME_FULL);
-    close_log_file(log_file);
+    // ask the logging service to close the log...
+    if(service_requested(arguments))
+    {
+        auto pid = require_parameter<pid_type>(arguments, PO_PID_FULL);
+        auto name = require_parameter<std::string>(arguments, PO_NAME_FULL);
+        close_service_log(name, pid);
+    }
+    // ... or extract the log name and call close method.
+    else
+    {
+        auto log_file = require_parameter<std::string>(arguments, PO_FILENAME_FULL);
+        close_log_file(log_file);
+    }
 }
 
 /**
@@ -320,6 +359,303 @@ void close_log_file(const boost::filesystem::path& path_to_log)
     _log_client.info() << ns(log_write_default_namespace) << translate("Terminated logging session.") << lf::end;
 }
 
+/**
+ * Writes records read from the input identified by the arguments, either to the log file given or through the
+ * logging service. Records are read from standard input unless an input (such as a FIFO) is given.
+ * @param arguments arguments to extract the log, input and delimiter from.
+ * @returns number of records written.
+ */
+std::size_t serve_log_file(const boost::program_options::variables_map& arguments)
+{
+    // records are separated by new lines, unless asked to use nulls (so messages can span lines).
+    char delimiter = arguments.count(PO_NULL_FULL) != 0 ? '\0' : '\n';
+
+    // read from the input given, or standard input.
+    std::ifstream input_file;
+    std::istream* input = &std::cin;
+    if(arguments.count(PO_INPUT_FULL) != 0)
+    {
+        input_file.open(arguments[PO_INPUT_FULL].as<std::string>());
+        if(!input_file)
+        {
+            BOOST_THROW_EXCEPTION( action_required_arguments_missing_exception()
+                    << expected_argument(PO_INPUT_FULL));
+        }
+        input = &input_file;
+    }
+
+    if(service_requested(arguments))
+    {
+        auto pid = require_parameter<pid_type>(arguments, PO_PID_FULL);
+        auto name = require_parameter<std::string>(arguments, PO_NAME_FULL);
+        return serve_service_log(name, pid, *input, delimiter);
+    }
+
+    auto log_file = require_parameter<std::string>(arguments, PO_FILENAME_FULL);
+    return serve_log_file(log_file, *input, delimiter);
+}
+
+/**
+ * Writes records read from an input to the specified log file, through one writer for the whole input.
+ * Each record is written as it is read; the file is left open for further writes (see parse_serve_record()).
+ * @param path_to_log log file to write out to.
+ * @param input input to read records from (until the end of the input).
+ * @param delimiter character separating records.
+ * @returns number of records written.
+ */
+std::size_t serve_log_file(const boost::filesystem::path& path_to_log, std::istream& input, const char& delimiter)
+{
+    // make things a little more readable
+    const bool create_file_if_not_exists = false;
+    const bool emmit_xml_header = false;
+    const bool emmit_xml_footer = false;
+
+    auto _log_writer = log_writer::create_from_file_path(path_to_log,
+        create_file_if_not_exists, emmit_xml_header, emmit_xml_footer);
+
+    std::size_t served = 0;
+    std::string record;
+    while(std::getline(input, record, delimiter))
+    {
+        auto entry = std::shared_ptr<log_entry>(new log_entry());
+        category event_type = category::information;
+        std::string log_namespace;
+        std::string message;
+        if(parse_serve_record(record, event_type, log_namespace, message))
+        {
+            entry->entry_type(event_type);
+            entry->log_namespace(log_namespace);
+            entry->message(message);
+            _log_writer->add_entry(entry);
+            served++;
+        }
+    }
+
+    return served;
+}
+
+/**
+ * Writes records read from an input through the logging service daemon, over one connection for the whole input.
+ * Entries are echoed to the console, as they would be if we were writing the log ourselves.
+ * @param name specific name to log for.
+ * @param pid specific pid to log for.
+ * @param input input to read records from (until the end of the input).
+ * @param delimiter character separating records.
+ * @throws service_unavailable_exception if the daemon is not available (or goes away).
+ * @returns number of records written.
+ */
+std::size_t serve_service_log(const std::string& name, const pid_type& pid, std::istream& input, const char& delimiter)
+{
+    std::shared_ptr<log_socket> connection;
+    try
+    {
+        connection = log_socket::connect(pid, name);
+    }
+    catch(boost::exception&)
+    {
+        BOOST_THROW_EXCEPTION( service_unavailable_exception()
+                << inglenook::core::exceptions::inglenook_error_number(log_write_exception_service_unavailable));
+    }
+
+    // echo to the console, as writing the log ourselves would (an off the record writer does just that).
+    auto console = log_writer::create_from_stream(nullptr, false, false);
+
+    std::size_t served = 0;
+    std::string record;
+    while(std::getline(input, record, delimiter))
+    {
+        auto entry = std::shared_ptr<log_entry>(new log_entry());
+        category event_type = category::information;
+        std::string log_namespace;
+        std::string message;
+        if(!parse_serve_record(record, event_type, log_namespace, message))
+        {
+            continue;
+        }
+        entry->entry_type(event_type);
+        entry->log_namespace(log_namespace);
+        entry->message(message);
+
+        // keep trying while the daemon is only slow (busy, or not reading fast enough for the send to go through
+        // within BUSY_TIMEOUT); give up only once it has gone.
+        while(!connection->send(*entry))
+        {
+            if(connection->disconnected())
+            {
+                BOOST_THROW_EXCEPTION( service_unavailable_exception()
+                        << inglenook::core::exceptions::inglenook_error_number(log_write_exception_service_unavailable));
+            }
+        }
+        console->add_entry(entry);
+        served++;
+    }
+
+    return served;
+}
+
+/**
+ * Parses a record read by the serve action. A record is the category (as a number, see convert_to_category()),
+ * namespace and message separated by tabs; the message may itself contain tabs. Records with no category or
+ * namespace are written as information in the default namespace, so a plain line of text is a valid record.
+ * @param record record to parse.
+ * @param event_type receives the category of the record.
+ * @param log_namespace receives the namespace of the record.
+ * @param message receives the message of the record.
+ * @returns false if there is no message in the record (so nothing to write).
+ */
+bool parse_serve_record(const std::string& record, category& event_type, std::string& log_namespace, std::string& message)
+{
+    event_type = category::information;
+    log_namespace = log_write_default_namespace;
+
+    // find the fields, if there are any.
+    auto first_separator = record.find(serve_field_separator);
+    auto second_separator = first_separator == std::string::npos ?
+            std::string::npos : record.find(serve_field_separator, first_separator + 1);
+    if(second_separator == std::string::npos)
+    {
+        message = record;
+        return !message.empty();
+    }
+
+    // an empty (or unreadable) category or namespace takes the default.
+    unsigned int category_value = 0;
+    for(std::size_t i = 0; i < first_separator; i++)
+    {
+        if(record[i] < '0' || record[i] > '9' || category_value > 0xff)
+        {
+            category_value = 0;
+            break;
+        }
+        category_value = category_value * 10 + (record[i] - '0');
+    }
+    event_type = convert_to_category(category_value);
+
+    if(second_separator > first_separator + 1)
+    {
+        log_namespace = record.substr(first_separator + 1, second_separator - first_separator - 1);
+    }
+
+    message = record.substr(second_separator + 1);
+    return !message.empty();
+}
+
+//--------------------------------------------------------//
+// Hide the implementation in the anonymous namespace.
+namespace
+{
+
+    /**
+     * Sends an entry to the logging service daemon on behalf of the specified process.
+     * @param name name of the process to log for.
+     * @param pid process id of the process to log for.
+     * @param entry entry to send.
+     * @param close_log if true, the daemon is also asked to close the log.
+     * @throws service_unavailable_exception if the entry could not be sent.
+     */
+    void send_to_service(const std::string& name, const pid_type& pid, log_entry& entry, const bool& close_log = false)
+    {
+        std::shared_ptr<log_socket> connection;
+        try
+        {
+            connection = log_socket::connect(pid, name);
+        }
+        catch(boost::exception&)
+        {
+            // (log_socket_exception - the daemon isn't running)
+            BOOST_THROW_EXCEPTION( service_unavailable_exception()
+                    << inglenook::core::exceptions::inglenook_error_number(log_write_exception_service_unavailable));
+        }
+
+        if(!connection->send(entry) || (close_log && !connection->close_log()))
+        {
+            BOOST_THROW_EXCEPTION( service_unavailable_exception()
+                    << inglenook::core::exceptions::inglenook_error_number(log_write_exception_service_unavailable));
+        }
+    }
+
+}
+//--------------------------------------------------------//
+
+/**
+ * Indicates if the arguments ask for entries to be passed to the logging service daemon (ign_logd).
+ * @param arguments arguments to check.
+ * @returns true if the service switch was given.
+ */
+bool service_requested(const boost::program_options::variables_map& arguments)
+{
+    return arguments.count(PO_SERVICE_FULL) != 0;
+}
+
+/**
+ * Starts a new logging session through the logging service daemon. The daemon creates the log file (at the
+ * default log path for the process) and keeps it open until close_service_log() is called or the process ends.
+ * @param name specific name to log for.
+ * @param pid specific pid to log for.
+ * @returns true if the daemon took the session, false if it is not available.
+ */
+bool start_service_log(const std::string& name, const pid_type& pid)
+{
+    using namespace boost::locale;
+
+    log_entry entry;
+    entry.entry_type(category::information);
+    entry.log_namespace(log_write_default_namespace);
+    entry.message(translate("Started new logging session."));
+
+    try
+    {
+        send_to_service(name, pid, entry);
+    }
+    catch(service_unavailable_exception&)
+    {
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * Writes a log message through the logging service daemon.
+ * @param name specific name to log for.
+ * @param pid specific pid to log for.
+ * @param message message to write out.
+ * @param log_namespace namespace to write the log out to
+ * @param event_type the type of event to write
+ * @throws service_unavailable_exception if the daemon is not available.
+ */
+void write_service_entry(const std::string& name, const pid_type& pid, const std::string& message,
+        const std::string& log_namespace, const category& event_type)
+{
+    log_entry entry;
+    entry.entry_type(event_type);
+    entry.log_namespace(log_namespace);
+    entry.message(message);
+    send_to_service(name, pid, entry);
+
+    // echo to the console, as writing the log ourselves would (an off the record writer does just that).
+    auto console = log_writer::create_from_stream(nullptr, false, false);
+    auto console_entry = std::shared_ptr<log_entry>(new log_entry(entry));
+    console->add_entry(console_entry);
+}
+
+/**
+ * Closes a logging session through the logging service daemon.
+ * @param name specific name to log for.
+ * @param pid specific pid to log for.
+ * @throws service_unavailable_exception if the daemon is not available.
+ */
+void close_service_log(const std::string& name, const pid_type& pid)
+{
+    using namespace boost::locale;
+
+    log_entry entry;
+    entry.entry_type(category::information);
+    entry.log_namespace(log_write_default_namespace);
+    entry.message(translate("Terminated logging session."));
+    send_to_service(name, pid, entry, true);
+}
+
 } // namespace logging
 
 } // namespace inglenook
@@ -52,6 +52,12 @@ const std::string close_full_action_string = "close";
 /// abbreviated action string (command) to close an existing log file
 const std::string close_short_action_string = "c";
 
+/// full action string (command) to write records read from an input to an existing log file
+const std::string serve_full_action_string = "serve";
+
+/// abbreviated action string (command) to write records read from an input to an existing log file
+const std::string serve_short_action_string = "v";
+
 /**
  * Log writer action
  * indicates what action should be performed by the log writer.
@@ -61,9 +67,13 @@ enum log_write_action : unsigned int
     no_action            = 0x00, /**< no action to be performed. */
     create_new_log       = 0x01, /**< create a new log file. */
     write_message_to_log = 0x02, /**< write a message to an existing log file. */
-    close_log            = 0x03  /**< close an open log file. */
+    close_log            = 0x03, /**< close an open log file. */
+    serve_log            = 0x04  /**< write records read from an input to an open log file. */
 };
 
+/// separates the fields of a record read by the serve action.
+const char serve_field_separator = '\t';
+
 /// default namespace to write entries in when using this binary.
 const std::string log_write_default_namespace = "inglenook.logging";
 
@@ -152,6 +162,36 @@ void close_log_file(const boost::program_options::variables_map& arguments);
 void close_log_file(const boost::filesystem::path& path_to_log);
 
 
+
+// writes records read from the input identified in the program arguments.
+std::size_t serve_log_file(const boost::program_options::variables_map& arguments);
+
+// writes records read from the specified input to the specified log file.
+std::size_t serve_log_file(const boost::filesystem::path& path_to_log, std::istream& input, const char& delimiter = '\n');
+
+// writes records read from the specified input through the logging service daemon.
+std::size_t serve_service_log(const std::string& name, const pid_type& pid, std::istream& input, const char& delimiter = '\n');
+
+// parses a record read by the serve action.
+bool parse_serve_record(const std::string& record, category& event_type, std::string& log_namespace, std::string& message);
+
+
+
+// indicates if the arguments ask for entries to be sent to the logging service daemon.
+bool service_requested(const boost::program_options::variables_map& arguments);
+
+// starts a new logging session through the logging service daemon.
+bool start_service_log(const std::string& name, const pid_type& pid);
+
+// writes a log entry through the logging service daemon.
+void write_service_entry(const std::string& name, const pid_type& pid, const std::string& message,
+        const std::string& log_namespace = log_write_default_namespace,
+        const category& event_type = category::information);
+
+// closes a logging session through the logging service daemon.
+void close_service_log(const std::string& name, const pid_type& pid);
+
+
 } // namespace logging
 
 } // namespace inglenook
@@ -39,6 +39,9 @@ const unsigned long module_error_base = 0xff10000;
 /// an action expected a parameter that wasn't provided.
 const unsigned long log_write_exception_missing_argument = module_error_base + 0x01;
 
+/// the logging service daemon was asked for, but could not be reached.
+const unsigned long log_write_exception_service_unavailable = module_error_base + 0x02;
+
 /// argument that was expected, but not provided.
 typedef boost::error_info<struct __expected_argument, std::string> expected_argument;
 
@@ -93,6 +96,18 @@ struct unrecognised_action_exception: virtual log_write_exception
 
 };
 
+/**
+ * Thrown when the logging service daemon (ign_logd) is asked for, but cannot be reached.
+ */
+struct service_unavailable_exception: virtual log_write_exception
+{
+	/// provides a boiler plate explaination of the exception.
+   const char* what() const throw() {
+	   return boost::locale::translate("The logging service is not available.").str().c_str();
+   }
+
+};
+
 
 } // namespace inglenook::logging
 
@@ -48,13 +48,15 @@ boost::program_options::options_description create_program_options()
     actions_description << translate("REQUIRED: Indicates the type of action to perform:\n\n")
             << start_short_action_string << ", [ "<< start_full_action_string << translate(" ] \tStarts a new log file.\n")
             << write_short_action_string << ", [ "<< write_full_action_string << translate(" ] \tWrite an entry to the specified log file.\n")
-            << close_short_action_string << ", [ "<< close_full_action_string << translate(" ] \tCloses the specific log file.");
+            << close_short_action_string << ", [ "<< close_full_action_string << translate(" ] \tCloses the specific log file.\n")
+            << serve_short_action_string << ", [ "<< serve_full_action_string << translate(" ] \tWrite records read from an input to the specified log file.");
 
     // create the actions group
     boost::program_options::options_description action_options( translate("Actions") );
     action_options.add_options()
         (boost::str(boost::format("%1%,%2%") % PO_ACTION_FULL % PO_ACTION_SHORT).c_str(),       boost::program_options::value<std::string>()->required(),   actions_description.str().c_str())
-        (boost::str(boost::format("%1%,%2%") % PO_FILENAME_FULL % PO_FILENAME_SHORT).c_str(),   boost::program_options::value<std::string>(),               translate("Path to log file.").str().c_str());
+        (boost::str(boost::format("%1%,%2%") % PO_FILENAME_FULL % PO_FILENAME_SHORT).c_str(),   boost::program_options::value<std::string>(),               translate("Path to log file.").str().c_str())
+        (boost::str(boost::format("%1%,%2%") % PO_SERVICE_FULL % PO_SERVICE_SHORT).c_str(),                                                                     translate("Pass entries to the logging service (ign_logd) for the process given by --pid and --name, instead of writing the log file.").str().c_str());
 
     // Create program options for log creation...
     boost::program_options::options_description creation_options(translate("Log creation specific options (s, start)"));
@@ -69,8 +71,14 @@ boost::program_options::options_description create_program_options()
         (boost::str(boost::format("%1%,%2%") % PO_NAMESPACE_FULL % PO_NAMESPACE_SHORT).c_str(), boost::program_options::value<std::string>(),               translate("Namespace to write message in.").str().c_str())
         (boost::str(boost::format("%1%,%2%") % PO_CATEGORY_FULL % PO_CATEGORY_SHORT).c_str(),   boost::program_options::value<unsigned int>(),              translate("Type of message to write.").str().c_str());
 
+    // Create program options for serving...
+    boost::program_options::options_description serving_options( translate("Log serving specific options (v, serve)") );
+    serving_options.add_options()
+        (boost::str(boost::format("%1%,%2%") % PO_INPUT_FULL % PO_INPUT_SHORT).c_str(),         boost::program_options::value<std::string>(),               translate("File or FIFO to read records from (defaults to standard input).").str().c_str())
+        (boost::str(boost::format("%1%,%2%") % PO_NULL_FULL % PO_NULL_SHORT).c_str(),                                                                           translate("Records are separated by null characters rather than new lines.").str().c_str());
+
     // add all the options
-    action_options.add(creation_options).add(writing_options);
+    action_options.add(creation_options).add(writing_options).add(serving_options);
 
     return action_options;
 }
@@ -129,8 +137,11 @@ int main(int arg_c, const char* arg_v[])
                     // create the new log file
                     auto new_log = create_log_file(vm);
 
-                    // notify callers where the log file was created.
-                    std::cout << boost::filesystem::system_complete(new_log) << std::endl;
+                    // notify callers where the log file was created (if the logging service took the log there is no file to report).
+                    if(!new_log.empty())
+                    {
+                        std::cout << boost::filesystem::system_complete(new_log) << std::endl;
+                    }
 
                     break;
                 }
@@ -142,6 +153,17 @@ int main(int arg_c, const char* arg_v[])
 
                     break;
                 }
+                // caller wants to stream records in to an open log.
+                case log_write_action::serve_log:
+                {
+                    // records are read in bulk, don't slow standard input down keeping it in step with stdio.
+                    std::ios::sync_with_stdio(false);
+
+                    // write records until the input ends.
+                    serve_log_file(vm);
+
+                    break;
+                }
                 // caller wants to close an open log file.
                 case log_write_action::close_log:
                 {
@@ -178,7 +200,7 @@ int main(int arg_c, const char* arg_v[])
         }
         
         // be helpful - tell the user valid options, and suggest where the user can get additional support using this tool
-        std::cerr << translate("Valid actions are start (s), write (w) and close (c).") << std::endl;
+        std::cerr << translate("Valid actions are start (s), write (w), close (c) and serve (v).") << std::endl;
         std::cerr << translate("For support with this binary check the manual documentation by typing \"man ") << inglenook::core::application::name() << "\"" << std::endl;
 
     }
@@ -198,6 +220,11 @@ int main(int arg_c, const char* arg_v[])
         std::cerr << translate("For support with this binary check the manual documentation by typing \"man ") << inglenook::core::application::name() << "\"" << std::endl;
 
     }
+    catch(inglenook::logging::service_unavailable_exception&)
+    {
+        // tell the user what went wrong...
+        std::cerr << translate("ERROR: The logging service (ign_logd) is not available.") << std::endl;
+    }
     catch(inglenook::core::exceptions::application_arguments_parser_exception&)
     {
         /* nothing to do - arguments passed to the program were incorrect */
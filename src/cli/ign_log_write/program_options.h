@@ -46,3 +46,15 @@ const std::string PO_NAMESPACE_SHORT = "N";
 // Program options: category
 const std::string PO_CATEGORY_FULL = "category";
 const std::string PO_CATEGORY_SHORT = "C";
+
+// Program options: input to serve records from
+const std::string PO_INPUT_FULL = "input";
+const std::string PO_INPUT_SHORT = "i";
+
+// Program options: records are null terminated
+const std::string PO_NULL_FULL = "null";
+const std::string PO_NULL_SHORT = "0";
+
+// Program options: send to the logging service
+const std::string PO_SERVICE_FULL = "service";
+const std::string PO_SERVICE_SHORT = "S";
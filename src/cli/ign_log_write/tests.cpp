@@ -27,6 +27,7 @@
  *      create_log_file()               | all prototypes.
  *      write_log_entry()               | all prototypes.
  *      close_log_file()                | all prototypes.
+ *      serve_log_file()                | all prototypes.
  *  main.cpp                          - little functional code tests could be written for (by design).
  */
 
@@ -73,6 +74,14 @@ BOOST_AUTO_TEST_CASE ( log_write_tests__argument_strings )
     BOOST_CHECK_MESSAGE(close_short_action_string == "c",
             "close log (short) action string has been changed from 'c' to '" <<
             close_short_action_string << "', please make sure all documentation is updated");
+
+    // check default values for serve log
+    BOOST_CHECK_MESSAGE(serve_full_action_string == "serve",
+            "serve log (full) action string has been changed from 'serve' to '" <<
+            serve_full_action_string << "', please make sure all documentation is updated");
+    BOOST_CHECK_MESSAGE(serve_short_action_string == "v",
+            "serve log (short) action string has been changed from 'v' to '" <<
+            serve_short_action_string << "', please make sure all documentation is updated");
 }
 
 
@@ -91,6 +100,8 @@ BOOST_AUTO_TEST_CASE ( log_write_tests__parsing_action )
     BOOST_CHECK(parse_action(write_full_action_string)   == log_write_action::write_message_to_log);
     BOOST_CHECK(parse_action(close_short_action_string)  == log_write_action::close_log);
     BOOST_CHECK(parse_action(close_full_action_string)   == log_write_action::close_log);
+    BOOST_CHECK(parse_action(serve_short_action_string)  == log_write_action::serve_log);
+    BOOST_CHECK(parse_action(serve_full_action_string)   == log_write_action::serve_log);
     BOOST_CHECK(parse_action(first_bad_action)           == log_write_action::no_action);
     BOOST_CHECK(parse_action(second_bad_action)          == log_write_action::no_action);
 }
@@ -199,6 +210,44 @@ BOOST_AUTO_TEST_CASE ( log_write_tests__convert_category_tests )
     }
 }
 
+//
+// log_write_tests__parse_serve_record
+// ensures records read by the serve action are split in to category, namespace and message.
+BOOST_AUTO_TEST_CASE ( log_write_tests__parse_serve_record )
+{
+    category entry_type;
+    std::string log_namespace;
+    std::string message;
+
+    // a complete record
+    BOOST_CHECK(parse_serve_record("4\tinglenook.tests\ta message", entry_type, log_namespace, message));
+    BOOST_CHECK(entry_type == category::warning);
+    BOOST_CHECK(log_namespace == "inglenook.tests");
+    BOOST_CHECK(message == "a message");
+
+    // the message may itself contain separators
+    BOOST_CHECK(parse_serve_record("5\tinglenook.tests\tcolumn\tcolumn", entry_type, log_namespace, message));
+    BOOST_CHECK(entry_type == category::error);
+    BOOST_CHECK(message == "column\tcolumn");
+
+    // empty or bad category and namespace fall back to the defaults
+    BOOST_CHECK(parse_serve_record("\t\ta message", entry_type, log_namespace, message));
+    BOOST_CHECK(entry_type == category::information);
+    BOOST_CHECK(log_namespace == log_write_default_namespace);
+    BOOST_CHECK(parse_serve_record("bad\tinglenook.tests\ta message", entry_type, log_namespace, message));
+    BOOST_CHECK(entry_type == category::information);
+
+    // a record with no separators is just a message
+    BOOST_CHECK(parse_serve_record("just a message", entry_type, log_namespace, message));
+    BOOST_CHECK(entry_type == category::information);
+    BOOST_CHECK(log_namespace == log_write_default_namespace);
+    BOOST_CHECK(message == "just a message");
+
+    // records with no message are skipped
+    BOOST_CHECK(!parse_serve_record("", entry_type, log_namespace, message));
+    BOOST_CHECK(!parse_serve_record("3\tinglenook.tests\t", entry_type, log_namespace, message));
+}
+
 } // namespace inglenook::logging
 
 } // namespace inglenook
@@ -29,5 +29,18 @@
 #include "log_entry_tests.h"
 #include "log_entry_buffered_tests.h"
 #include "log_entry_modifiers_tests.h"
+#include "log_field_tests.h"
+#include "log_attachment_tests.h"
+#include "log_source_tests.h"
+#include "log_context_tests.h"
+#include "log_span_tests.h"
+#include "log_format_tests.h"
+#include "log_formatter_tests.h"
 #include "log_writer_tests.h"
+#include "log_file_reader_tests.h"
+#include "log_limit_tests.h"
 #include "log_client_tests.h"
+#include "log_crash_handler_tests.h"
+#include "log_record_tests.h"
+#include "log_ring_tests.h"
+#include "log_socket_tests.h"
@@ -0,0 +1,547 @@
+/*
+ * bench.cpp: Measures log_writer throughput, latency and scaling with null, memory and file sinks.
+ * Copyright (C) 2012, Project Inglenook (http://www.project-inglenook.co.uk)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * usage: ign_logging_bench [entries per thread] [maximum threads]
+ * For each sink (null, memory, file, mapped, a memory mapped file, and uring, a file written through io_uring), each
+ * thread count (1, 2, 4 ... up to the maximum, which defaults to the number of hardware threads) and each API (stream:
+ * log_info() << ... << lf::end, format: log_info(FMT(...), ...) << lf::end, logging the same message), every thread
+ * logs its entries as fast as it can. Results are printed to standard out as JSON so runs from different builds can be compared:
+ *  entries_per_second      entries written per second, from the first call until the writer has written them all.
+ *  bytes_per_second        bytes written per second (as counted by the writer).
+ *  allocations_per_entry   heap allocations made by the whole process during the run, per entry.
+ *  call_latency_ns         percentiles of the time taken by each logging statement.
+ *  enqueue_to_disk_us      percentiles of the time from the start of a (sampled) statement until the writer has
+ *                          written and flushed it; an upper bound, as the writer is polled for its statistics.
+ *  dropped                 entries the writer failed to accept.
+ * Before the runs, the cost of individual log_client operations is timed on a single thread (operator_cost_ns,
+ * nanoseconds per call): finding the thread's entry (buffer), streaming a namespace (ns, which does little else),
+ * streaming an integer (int) and reading the default namespace (default_namespace). Each of the writer's formats
+ * (see log_formatter) is then timed formatting the same entry over and over (formatter_throughput, entries and bytes
+ * per second for xml, jsonl and logfmt).
+ * The main thread polls the writer while the logging threads run, so it occupies a hardware thread of its own.
+ */
+
+// inglenook includes
+#include "logging.h"
+
+// standard library includes
+#include <iostream>
+#include <sstream>
+#include <cstdlib>
+#include <cstdint>
+#include <new>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <atomic>
+
+// boost (http://boost.org) includes
+#include <boost/filesystem.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+//--------------------------------------------------------//
+// Hide the implementation in the anonymous namespace.
+namespace
+{
+
+    /// number of heap allocations made by the process.
+    std::atomic<std::uint64_t> allocations(0);
+
+    /// one in this many statements is sampled for enqueue to disk latency.
+    const int PROBE_INTERVAL = 64;
+
+    /**
+     * Stream buffer that discards everything written to it (the null sink).
+     */
+    class null_buffer : public std::streambuf
+    {
+        protected:
+
+            virtual std::streamsize xsputn(const char_type*, std::streamsize count) { return count; }
+
+            virtual int_type overflow(int_type character) { return traits_type::not_eof(character); }
+    };
+
+    /**
+     * Stream buffer that writes in to a fixed block of memory, wrapping when it is full (the memory sink).
+     */
+    class memory_buffer : public std::streambuf
+    {
+        public:
+
+            memory_buffer() : m_memory(MEMORY_SIZE) { setp(m_memory.data(), m_memory.data() + m_memory.size()); }
+
+        protected:
+
+            virtual int_type overflow(int_type character)
+            {
+                setp(m_memory.data(), m_memory.data() + m_memory.size());
+                if(!traits_type::eq_int_type(character, traits_type::eof()))
+                {
+                    sputc(traits_type::to_char_type(character));
+                }
+                return traits_type::not_eof(character);
+            }
+
+        private:
+
+            /// size of the block entries are written in to.
+            static const std::size_t MEMORY_SIZE = 4194304; // 4MiB
+
+            /// the block entries are written in to.
+            std::vector<char> m_memory;
+    };
+
+    /// a statement sampled for enqueue to disk latency.
+    struct probe
+    {
+        /// time the statement started (monotonic nanoseconds).
+        std::int64_t started;
+
+        /// number of entries the writer had accepted once the statement completed.
+        std::uint64_t position;
+
+        /// number of flushes the writer had made before the statement started.
+        std::uint64_t flushes;
+    };
+
+    /// results of a single run.
+    struct run_result
+    {
+        std::string sink;
+        std::string api;
+        int threads;
+        std::uint64_t entries;
+        double seconds;
+        std::uint64_t bytes;
+        std::uint64_t allocations;
+        std::uint64_t dropped;
+        std::vector<std::int64_t> call_latency;
+        std::vector<std::int64_t> disk_latency;
+    };
+
+    /**
+     * Totals a per category statistic.
+     * @param counters per category counters.
+     * @returns total across every category.
+     */
+    std::uint64_t total(const std::uint64_t (&counters)[inglenook::logging::LOG_STATISTICS_CATEGORIES])
+    {
+        std::uint64_t result = 0;
+        for(std::size_t i = 0; i < inglenook::logging::LOG_STATISTICS_CATEGORIES; i++)
+        {
+            result += counters[i];
+        }
+        return result;
+    }
+
+    /**
+     * Gets a percentile of a set of samples.
+     * @param samples samples (sorted).
+     * @param percentile percentile to get (0 - 100).
+     * @returns the sample at the percentile, or 0 if there are no samples.
+     */
+    std::int64_t percentile(const std::vector<std::int64_t>& samples, const double& percentile)
+    {
+        if(samples.empty())
+        {
+            return 0;
+        }
+        std::size_t index = static_cast<std::size_t>(samples.size() * percentile / 100.0);
+        return samples[std::min(index, samples.size() - 1)];
+    }
+
+    /**
+     * Logs entries as fast as possible, timing each statement.
+     * @param id number of this thread.
+     * @param format set to log with the format string API rather than the stream API.
+     * @param entries number of entries to log.
+     * @param call_latency [output] time taken by each statement (nanoseconds).
+     * @param probes [output] statements sampled for enqueue to disk latency (thread 0 only).
+     * @param probes_mutex mutex protecting probes.
+     */
+    void log_thread(const int& id, const bool& format, const int& entries, std::vector<std::int64_t>* call_latency,
+            std::vector<probe>* probes, boost::mutex* probes_mutex)
+    {
+        using namespace inglenook::logging;
+
+        auto writer = log_output;
+        call_latency->reserve(entries);
+        for(int i = 0; i < entries; i++)
+        {
+            bool sampled = id == 0 && i % PROBE_INTERVAL == 0;
+            std::uint64_t flushes = sampled ? writer->statistics().flushes : 0;
+
+            std::int64_t started = log_tracer::now();
+            if(format)
+            {
+                log_info(FMT("benchmark entry {} from thread {}"), i, id) << lf::end;
+            }
+            else
+            {
+                log_info() << "benchmark entry " << i << " from thread " << id << lf::end;
+            }
+            std::int64_t finished = log_tracer::now();
+            call_latency->push_back(finished - started);
+
+            if(sampled)
+            {
+                probe sample = { started, total(writer->statistics().enqueued), flushes };
+                boost::mutex::scoped_lock lock(*probes_mutex);
+                probes->push_back(sample);
+            }
+        }
+    }
+
+    /**
+     * Runs the benchmark against a writer.
+     * @param sink name of the sink the writer writes to.
+     * @param api name of the API to log with ("stream" or "format").
+     * @param writer writer to benchmark.
+     * @param threads number of threads to log from.
+     * @param entries number of entries each thread logs.
+     * @returns results of the run.
+     */
+    run_result run(const std::string& sink, const std::string& api, std::shared_ptr<inglenook::logging::log_writer> writer,
+            const int& threads, const int& entries)
+    {
+        using namespace inglenook::logging;
+
+        writer->console_threshold(category::no_log);
+        writer->xml_threshold(category::information);
+        writer->default_namespace("inglenook.logging.bench");
+        log_output = writer;
+        ilog = std::shared_ptr<log_client>(new log_client(writer));
+
+        run_result result;
+        result.sink = sink;
+        result.api = api;
+        result.threads = threads;
+        result.entries = static_cast<std::uint64_t>(threads) * entries;
+
+        std::vector<std::vector<std::int64_t>> call_latency(threads);
+        std::vector<probe> probes;
+        boost::mutex probes_mutex;
+        std::vector<std::shared_ptr<boost::thread>> logging_threads;
+
+        std::uint64_t allocations_before = allocations.load();
+        std::int64_t started = log_tracer::now();
+        for(int i = 0; i < threads; i++)
+        {
+            logging_threads.push_back(std::shared_ptr<boost::thread>(
+                    new boost::thread(log_thread, i, api == "format", entries, &call_latency[i], &probes, &probes_mutex)));
+        }
+
+        // watch the writer until it has written everything, resolving the sampled statements as we go.
+        std::size_t resolved = 0;
+        while(true)
+        {
+            auto statistics = writer->statistics();
+            std::int64_t now = log_tracer::now();
+            std::uint64_t written = total(statistics.written);
+            std::uint64_t dropped = total(statistics.dropped);
+            {
+                boost::mutex::scoped_lock lock(probes_mutex);
+                while(resolved < probes.size() && written >= probes[resolved].position &&
+                      statistics.flushes > probes[resolved].flushes)
+                {
+                    result.disk_latency.push_back((now - probes[resolved].started) / 1000);
+                    resolved++;
+                }
+            }
+            if(written + dropped >= result.entries && resolved == probes.size())
+            {
+                result.seconds = (now - started) / 1000000000.0;
+                result.bytes = statistics.bytes_written;
+                result.dropped = dropped;
+                break;
+            }
+            boost::this_thread::yield();
+        }
+        result.allocations = allocations.load() - allocations_before;
+
+        for(auto thread = logging_threads.begin(); thread != logging_threads.end(); thread++)
+        {
+            (*thread)->join();
+        }
+        for(auto latency = call_latency.begin(); latency != call_latency.end(); latency++)
+        {
+            result.call_latency.insert(result.call_latency.end(), latency->begin(), latency->end());
+        }
+        std::sort(result.call_latency.begin(), result.call_latency.end());
+        std::sort(result.disk_latency.begin(), result.disk_latency.end());
+
+        ilog.reset();
+        log_output.reset();
+        return result;
+    }
+
+    /**
+     * Times the log_client operations that don't write anything, on the calling thread.
+     * @param output stream to write the costs to (as JSON members).
+     */
+    void write_operator_costs(std::ostream& output)
+    {
+        using namespace inglenook::logging;
+
+        const int OPERATIONS = 2000000;
+        null_buffer null_sink;
+        auto writer = log_writer::create_from_stream(std::shared_ptr<std::ostream>(new std::ostream(&null_sink)), false, false);
+        log_client client(writer);
+        const ns log_namespace("inglenook.logging.bench");
+        std::uint64_t checksum = 0;
+
+        std::int64_t started = log_tracer::now();
+        for(int i = 0; i < OPERATIONS; i++)
+        {
+            checksum += client.buffer() != nullptr;
+        }
+        double buffer_cost = static_cast<double>(log_tracer::now() - started) / OPERATIONS;
+
+        started = log_tracer::now();
+        for(int i = 0; i < OPERATIONS; i++)
+        {
+            client << log_namespace;
+        }
+        double ns_cost = static_cast<double>(log_tracer::now() - started) / OPERATIONS;
+
+        started = log_tracer::now();
+        for(int i = 0; i < OPERATIONS; i++)
+        {
+            client << i;
+            if(i % 64 == 63)
+            {
+                client.buffer()->message(std::string());
+            }
+        }
+        double int_cost = static_cast<double>(log_tracer::now() - started) / OPERATIONS;
+
+        started = log_tracer::now();
+        for(int i = 0; i < OPERATIONS; i++)
+        {
+            checksum += client.default_namespace().length();
+        }
+        double default_namespace_cost = static_cast<double>(log_tracer::now() - started) / OPERATIONS;
+
+        output << "  \"operator_cost_ns\": {\"buffer\": " << buffer_cost << ", \"ns\": " << ns_cost
+               << ", \"int\": " << int_cost << ", \"default_namespace\": " << default_namespace_cost
+               << ", \"checksum\": " << checksum << "}," << std::endl;
+    }
+
+    /**
+     * Times each of the writer's formatters on the calling thread, formatting the same entry (with extended and typed
+     * data, and a source location) in to a reused string, as the writer does.
+     * @param output stream to write the throughput to (as JSON members).
+     */
+    void write_formatter_costs(std::ostream& output)
+    {
+        using namespace inglenook::logging;
+
+        const int OPERATIONS = 500000;
+        log_entry entry;
+        entry.entry_type(category::information);
+        entry.log_namespace("inglenook.logging.bench");
+        entry.message("bench entry 12345 with \"quoted\" <text>");
+        entry.extended_data("bench.host", "127.0.0.1");
+        entry.field("bench.rssi", -71);
+        entry.field("bench.snr", 3.5);
+        entry.source(&LOG_HERE);
+        entry.timestamp(boost::posix_time::microsec_clock::universal_time());
+
+        output << "  \"formatter_throughput\": {";
+        const char* names[] = { "xml", "jsonl", "logfmt" };
+        for(auto name = std::begin(names); name != std::end(names); name++)
+        {
+            auto formatter = log_formatter::create(*name);
+            std::string formatted;
+            std::uint64_t bytes = 0;
+
+            std::int64_t started = log_tracer::now();
+            for(int i = 0; i < OPERATIONS; i++)
+            {
+                formatted.clear();
+                formatter->format_entry(formatted, entry, 1024);
+                bytes += formatted.length();
+            }
+            double seconds = std::max(static_cast<double>(log_tracer::now() - started) / 1e9, 1e-9);
+
+            output << (name == std::begin(names) ? "" : ", ") << "\"" << *name << "\": {\"entries_per_second\": "
+                   << static_cast<std::uint64_t>(OPERATIONS / seconds) << ", \"bytes_per_second\": "
+                   << static_cast<std::uint64_t>(bytes / seconds) << "}";
+        }
+        output << "}," << std::endl;
+    }
+
+    /**
+     * Writes the results of a run as a JSON object.
+     * @param output stream to write to.
+     * @param result results to write.
+     */
+    void write_result(std::ostream& output, const run_result& result)
+    {
+        double seconds = result.seconds > 0 ? result.seconds : 1e-9;
+        output << "    {\"sink\": \"" << result.sink << "\", \"api\": \"" << result.api << "\", \"threads\": " << result.threads
+               << ", \"entries\": " << result.entries << ", \"seconds\": " << result.seconds
+               << ", \"entries_per_second\": " << static_cast<std::uint64_t>(result.entries / seconds)
+               << ", \"bytes_per_second\": " << static_cast<std::uint64_t>(result.bytes / seconds)
+               << ", \"allocations_per_entry\": " << static_cast<double>(result.allocations) / result.entries
+               << ", \"dropped\": " << result.dropped
+               << ", \"call_latency_ns\": {\"p50\": " << percentile(result.call_latency, 50)
+               << ", \"p99\": " << percentile(result.call_latency, 99)
+               << ", \"p99.9\": " << percentile(result.call_latency, 99.9) << "}"
+               << ", \"enqueue_to_disk_us\": {\"p50\": " << percentile(result.disk_latency, 50)
+               << ", \"p99\": " << percentile(result.disk_latency, 99)
+               << ", \"p99.9\": " << percentile(result.disk_latency, 99.9) << "}}";
+    }
+
+}
+//--------------------------------------------------------//
+
+/**
+ * Counts heap allocations made by the benchmark (see allocations_per_entry).
+ * @param size number of bytes to allocate.
+ * @returns allocated memory.
+ */
+void* operator new(std::size_t size)
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    void* memory = std::malloc(size == 0 ? 1 : size);
+    if(memory == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+    return memory;
+}
+
+/**
+ * Releases memory allocated by operator new.
+ * @param memory memory to release.
+ */
+void operator delete(void* memory) noexcept
+{
+    std::free(memory);
+}
+
+/**
+ * Releases memory allocated by operator new.
+ * @param memory memory to release.
+ */
+void operator delete(void* memory, std::size_t) noexcept
+{
+    std::free(memory);
+}
+
+/**
+ * This is the main entry point of the ign_logging benchmark.
+ * @param argc number of command line arguments
+ * @param argv list of command line arguments
+ * @returns EXIT_SUCCESS on success, EXIT_FAILURE if any entries were dropped.
+ */
+int main(int argc, const char* argv[])
+{
+    using namespace inglenook::logging;
+
+    const int entries = argc > 1 ? std::atoi(argv[1]) : 20000;
+    const int maximum_threads = argc > 2 ? std::atoi(argv[2]) : std::max(1u, boost::thread::hardware_concurrency());
+    if(entries <= 0 || maximum_threads <= 0)
+    {
+        std::cerr << "usage: ign_logging_bench [entries per thread] [maximum threads]" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    // 1, 2, 4 ... threads, finishing on the maximum.
+    std::vector<int> thread_counts;
+    for(int threads = 1; threads < maximum_threads; threads *= 2)
+    {
+        thread_counts.push_back(threads);
+    }
+    thread_counts.push_back(maximum_threads);
+
+    // the cost of the individual operations (before any threads have been started).
+    std::stringstream operator_costs;
+    write_operator_costs(operator_costs);
+    write_formatter_costs(operator_costs);
+
+    // keep the benchmark's log files out of the way.
+    auto scratch = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("ign-logging-bench-%%%%-%%%%");
+    boost::filesystem::create_directories(scratch);
+
+    std::vector<run_result> results;
+    const std::string sinks[] = { "null", "memory", "file", "mapped", "uring" };
+    const std::string apis[] = { "stream", "format" };
+    for(auto sink = std::begin(sinks); sink != std::end(sinks); sink++)
+    {
+        for(auto threads = thread_counts.begin(); threads != thread_counts.end(); threads++)
+        {
+            for(auto api = std::begin(apis); api != std::end(apis); api++)
+            {
+                null_buffer null_sink;
+                memory_buffer memory_sink;
+                std::shared_ptr<log_writer> writer;
+                if(*sink == "null")
+                {
+                    writer = log_writer::create_from_stream(std::shared_ptr<std::ostream>(new std::ostream(&null_sink)), false, false);
+                }
+                else if(*sink == "memory")
+                {
+                    writer = log_writer::create_from_stream(std::shared_ptr<std::ostream>(new std::ostream(&memory_sink)), false, false);
+                }
+                else if(*sink == "file")
+                {
+                    writer = log_writer::create_from_file_path(
+                            scratch / (*sink + "-" + std::to_string(*threads) + "-" + *api + ".xml"));
+                }
+                else if(*sink == "mapped")
+                {
+                    writer = log_writer::create_from_mapped_file_path(
+                            scratch / (*sink + "-" + std::to_string(*threads) + "-" + *api + ".xml"));
+                }
+                else
+                {
+                    writer = log_writer::create_from_async_file_path(
+                            scratch / (*sink + "-" + std::to_string(*threads) + "-" + *api + ".xml"));
+                }
+
+                results.push_back(run(*sink, *api, writer, *threads, entries));
+            }
+        }
+    }
+    boost::filesystem::remove_all(scratch);
+
+    // write out the results.
+    bool dropped = false;
+    std::cout << "{" << std::endl;
+    std::cout << "  \"benchmark\": \"ign_logging_bench\"," << std::endl;
+    std::cout << "  \"entries_per_thread\": " << entries << "," << std::endl;
+    std::cout << "  \"hardware_threads\": " << boost::thread::hardware_concurrency() << "," << std::endl;
+    std::cout << operator_costs.str();
+    std::cout << "  \"results\": [" << std::endl;
+    for(std::size_t i = 0; i < results.size(); i++)
+    {
+        write_result(std::cout, results[i]);
+        std::cout << (i + 1 < results.size() ? "," : "") << std::endl;
+        dropped = dropped || results[i].dropped > 0;
+    }
+    std::cout << "  ]" << std::endl;
+    std::cout << "}" << std::endl;
+
+    return dropped ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,312 @@
+/*
+ * log_attachment.cpp: Binary payloads attached to log entries.
+ * Copyright (C) 2012, Project Inglenook (http://www.project-inglenook.co.uk)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// inglenook includes
+#include "log_attachment.h"
+
+// standard library includes
+#include <algorithm>
+
+namespace inglenook
+{
+
+namespace logging
+{
+
+//--------------------------------------------------------//
+// Hide the implementation in the anonymous namespace.
+namespace
+{
+
+    /// names of the encodings (indexed by attachment_encoding).
+    const char* const ENCODING_NAMES[] = { "hex", "base64" };
+
+    /// digits used by the hex encoding.
+    const char* const HEX_DIGITS = "0123456789abcdef";
+
+    /// digits used by the base64 encoding.
+    const char* const BASE64_DIGITS = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+    /**
+     * Gets the value of a digit.
+     * @param digits the digits of the encoding.
+     * @param digit digit to look up.
+     * @returns value of the digit, or -1 if it isn't one.
+     */
+    int digit_value(const char* digits, const char& digit)
+    {
+        for(int value = 0; digits[value] != '\0'; value++)
+        {
+            if(digits[value] == digit)
+            {
+                return value;
+            }
+        }
+        return -1;
+    }
+
+}
+//--------------------------------------------------------//
+
+/**
+ * Creates an empty attachment.
+ */
+log_attachment::log_attachment() :
+    m_encoding(attachment_hex),
+    m_length(0),
+    m_size(0)
+{
+}
+
+/**
+ * Creates an attachment holding a copy of a payload. The payload is copied once, here; entries (and their copies)
+ * share it from then on.
+ * @param name name of the attachment.
+ * @param data the payload.
+ * @param length size of the payload in bytes.
+ * @param encoding how the attachment is written out.
+ */
+log_attachment::log_attachment(const std::string& name, const void* data, const std::size_t& length,
+        const attachment_encoding& encoding) :
+    m_name(name),
+    m_encoding(encoding),
+    m_data(data == nullptr ? nullptr : std::make_shared<const bytes>(static_cast<const unsigned char*>(data),
+            static_cast<const unsigned char*>(data) + length)),
+    m_length(data == nullptr ? 0 : length),
+    m_size(m_length)
+{
+}
+
+/**
+ * Creates an attachment sharing a payload, without copying it. The payload must not be changed once attached, as it
+ * is read by the writer thread whenever it gets to the entry.
+ * @param name name of the attachment.
+ * @param data the payload.
+ * @param encoding how the attachment is written out.
+ */
+log_attachment::log_attachment(const std::string& name, const std::shared_ptr<const bytes>& data,
+        const attachment_encoding& encoding) :
+    m_name(name),
+    m_encoding(encoding),
+    m_data(data),
+    m_length(data == nullptr ? 0 : data->size()),
+    m_size(m_length)
+{
+}
+
+/**
+ * Gets the name of the attachment.
+ * @returns name of the attachment.
+ */
+const std::string& log_attachment::name() const
+{
+    return m_name;
+}
+
+/**
+ * Gets how the attachment is written out.
+ * @returns the encoding.
+ */
+attachment_encoding log_attachment::encoding() const
+{
+    return m_encoding;
+}
+
+/**
+ * Gets the name of the encoding, as used by the encoding attribute of attachment elements.
+ * @returns name of the encoding ("hex" or "base64").
+ */
+const char* log_attachment::encoding_name() const
+{
+    return ENCODING_NAMES[m_encoding <= attachment_base64 ? m_encoding : attachment_hex];
+}
+
+/**
+ * Gets the bytes held.
+ * @returns the bytes held (nullptr if there are none).
+ */
+const unsigned char* log_attachment::data() const
+{
+    return m_data == nullptr || m_data->empty() ? nullptr : m_data->data();
+}
+
+/**
+ * Gets the number of bytes held.
+ * @returns number of bytes held.
+ */
+std::size_t log_attachment::length() const
+{
+    return m_length;
+}
+
+/**
+ * Gets the number of bytes attached.
+ * @returns number of bytes attached (more than length() if the attachment has been truncated).
+ */
+std::size_t log_attachment::size() const
+{
+    return m_size;
+}
+
+/**
+ * Sets the number of bytes attached, for attachments read back (from a log file or record) after being truncated.
+ * @param value number of bytes attached (no fewer than are held).
+ */
+void log_attachment::size(const std::size_t& value)
+{
+    m_size = std::max(value, m_length);
+}
+
+/**
+ * Indicates if fewer bytes are held than were attached.
+ * @returns true if the attachment has been truncated.
+ */
+bool log_attachment::truncated() const
+{
+    return m_length < m_size;
+}
+
+/**
+ * Holds no more than the specified number of bytes (the payload itself is left as it is, as it may be shared).
+ * @param length largest number of bytes to hold.
+ */
+void log_attachment::truncate(const std::size_t& length)
+{
+    m_length = std::min(m_length, length);
+}
+
+/**
+ * Appends the bytes held, encoded, stopping after the specified number of bytes.
+ * @param output text to append to.
+ * @param limit largest number of bytes to encode.
+ * @returns number of bytes encoded.
+ */
+std::size_t log_attachment::encode(std::string& output, const std::size_t& limit) const
+{
+    std::size_t length = std::min(m_length, limit);
+    const unsigned char* data = this->data();
+    if(length == 0 || data == nullptr)
+    {
+        return 0;
+    }
+
+    if(m_encoding == attachment_base64)
+    {
+        output.reserve(output.length() + (length + 2) / 3 * 4);
+        for(std::size_t i = 0; i < length; i += 3)
+        {
+            std::size_t remaining = length - i;
+            unsigned long group = static_cast<unsigned long>(data[i]) << 16;
+            group |= remaining > 1 ? static_cast<unsigned long>(data[i + 1]) << 8 : 0;
+            group |= remaining > 2 ? static_cast<unsigned long>(data[i + 2]) : 0;
+            output.push_back(BASE64_DIGITS[(group >> 18) & 0x3f]);
+            output.push_back(BASE64_DIGITS[(group >> 12) & 0x3f]);
+            output.push_back(remaining > 1 ? BASE64_DIGITS[(group >> 6) & 0x3f] : '=');
+            output.push_back(remaining > 2 ? BASE64_DIGITS[group & 0x3f] : '=');
+        }
+    }
+    else
+    {
+        output.reserve(output.length() + length * 2);
+        for(std::size_t i = 0; i < length; i++)
+        {
+            output.push_back(HEX_DIGITS[data[i] >> 4]);
+            output.push_back(HEX_DIGITS[data[i] & 0x0f]);
+        }
+    }
+    return length;
+}
+
+/**
+ * Creates an attachment from its encoded text, as written by log_writer (see encoding_name() and encode()).
+ * @param name name of the attachment.
+ * @param encoding_name name of the encoding.
+ * @param text the encoded bytes.
+ * @param attachment [output] the attachment.
+ * @returns true if the encoding is known and the text is valid.
+ */
+bool log_attachment::from_string(const std::string& name, const std::string& encoding_name, const std::string& text,
+        log_attachment& attachment)
+{
+    auto data = std::make_shared<bytes>();
+    attachment_encoding encoding;
+    if(encoding_name == ENCODING_NAMES[attachment_hex])
+    {
+        encoding = attachment_hex;
+        if(text.length() % 2 != 0)
+        {
+            return false;
+        }
+        data->reserve(text.length() / 2);
+        for(std::size_t i = 0; i < text.length(); i += 2)
+        {
+            int high = digit_value(HEX_DIGITS, text[i]);
+            int low = digit_value(HEX_DIGITS, text[i + 1]);
+            if(high < 0 || low < 0)
+            {
+                return false;
+            }
+            data->push_back(static_cast<unsigned char>((high << 4) | low));
+        }
+    }
+    else if(encoding_name == ENCODING_NAMES[attachment_base64])
+    {
+        encoding = attachment_base64;
+        if(text.length() % 4 != 0)
+        {
+            return false;
+        }
+        data->reserve(text.length() / 4 * 3);
+        for(std::size_t i = 0; i < text.length(); i += 4)
+        {
+            unsigned long group = 0;
+            int padding = 0;
+            for(std::size_t digit = 0; digit < 4; digit++)
+            {
+                int value = text[i + digit] == '=' && i + 4 == text.length() && digit >= 2 ? 0 :
+                        digit_value(BASE64_DIGITS, text[i + digit]);
+                if(value < 0 || (padding > 0 && text[i + digit] != '='))
+                {
+                    return false;
+                }
+                padding += text[i + digit] == '=' ? 1 : 0;
+                group = (group << 6) | static_cast<unsigned long>(value);
+            }
+            data->push_back(static_cast<unsigned char>(group >> 16));
+            if(padding < 2)
+            {
+                data->push_back(static_cast<unsigned char>(group >> 8));
+            }
+            if(padding < 1)
+            {
+                data->push_back(static_cast<unsigned char>(group));
+            }
+        }
+    }
+    else
+    {
+        return false;
+    }
+
+    attachment = log_attachment(name, std::shared_ptr<const bytes>(data), encoding);
+    return true;
+}
+
+} // namespace inglenook::logging
+
+} // namespace inglenook
@@ -0,0 +1,124 @@
+#pragma once
+/*
+ * log_attachment.h: Binary payloads attached to log entries.
+ * Copyright (C) 2012, Project Inglenook (http://www.project-inglenook.co.uk)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// standard library includes
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstddef>
+
+namespace inglenook
+{
+
+namespace logging
+{
+
+/**
+ * Attachment encodings
+ * How an attachment is written out as text. The values are used in binary records, so must not change.
+ */
+enum attachment_encoding : unsigned int
+{
+    attachment_hex    = 0x00,  /**< Two lower case hexadecimal digits per byte. */
+    attachment_base64 = 0x01   /**< Base64 (RFC 4648, padded). */
+};
+
+/**
+ * The log_attachment class holds a binary payload attached to a log entry (for example a raw device frame), streamed
+ * to log_client like any other modifier:
+ *
+ *     log_debug() << ns("zwave") << "frame received" << log_attachment("frame", data, length) << lf::end;
+ *
+ * The payload is either shared with the caller (no copy is made) or copied once, and is only encoded as text by
+ * whichever sink writes it out (see log_writer::attachment_limit()).
+ */
+class log_attachment
+{
+
+    public:
+
+        /// bytes of a payload.
+        typedef std::vector<unsigned char> bytes;
+
+        /// creates an empty attachment.
+        log_attachment();
+
+        // creates an attachment holding a copy of a payload.
+        log_attachment(const std::string& name, const void* data, const std::size_t& length,
+                const attachment_encoding& encoding = attachment_hex);
+
+        // creates an attachment sharing a payload (which must not change once attached).
+        log_attachment(const std::string& name, const std::shared_ptr<const bytes>& data,
+                const attachment_encoding& encoding = attachment_hex);
+
+        /// gets the name of the attachment.
+        const std::string& name() const;
+
+        /// gets how the attachment is written out.
+        attachment_encoding encoding() const;
+
+        /// gets the name of the encoding, as used by the encoding attribute of attachment elements.
+        const char* encoding_name() const;
+
+        /// gets the bytes held.
+        const unsigned char* data() const;
+
+        /// gets the number of bytes held.
+        std::size_t length() const;
+
+        /// gets the number of bytes attached (more than are held if the attachment has been truncated).
+        std::size_t size() const;
+
+        /// sets the number of bytes attached (for attachments read back after being truncated).
+        void size(const std::size_t& value);
+
+        /// indicates if fewer bytes are held than were attached.
+        bool truncated() const;
+
+        // holds no more than the specified number of bytes.
+        void truncate(const std::size_t& length);
+
+        // appends up to the specified number of bytes, encoded.
+        std::size_t encode(std::string& output, const std::size_t& limit) const;
+
+        // creates an attachment from its encoded text, as written by log_writer.
+        static bool from_string(const std::string& name, const std::string& encoding_name, const std::string& text,
+                log_attachment& attachment);
+
+    private:
+
+        /// name of the attachment.
+        std::string m_name;
+
+        /// how the attachment is written out.
+        attachment_encoding m_encoding;
+
+        /// the payload (shared, never changed).
+        std::shared_ptr<const bytes> m_data;
+
+        /// number of bytes held.
+        std::size_t m_length;
+
+        /// number of bytes attached.
+        std::size_t m_size;
+};
+
+} // namespace inglenook::logging
+
+} // namespace inglenook
@@ -0,0 +1,150 @@
+#pragma once
+/*
+* log_attachment_tests.h: Test routines for the log_attachment class (log_attachment.cpp/h)
+* Copyright (C) 2012, Project Inglenook (http://www.project-inglenook.co.uk)
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE LOG_TEST_NAME
+
+// standard includes
+#include <sstream>
+#include <vector>
+
+// boost (http://boost.org) includes
+#include <boost/test/unit_test.hpp>
+
+// inglenook includes
+#include "log_attachment.h"
+#include "log_record.h"
+#include "log_client.h"
+#include "log_file_reader.h"
+
+namespace inglenook
+{
+
+namespace logging
+{
+
+//
+// log_attachment_tests__encoding
+// checks payloads are encoded in hex and base64 (with each amount of padding), up to
+// the limit given, and read back from that text as the same bytes.
+BOOST_AUTO_TEST_CASE ( log_attachment_tests__encoding )
+{
+    const unsigned char frame[] = { 0x01, 0x08, 0x0f, 0x2a, 0xff };
+    const std::vector<std::string> hex = { "", "01", "0108", "01080f", "01080f2a", "01080f2aff" };
+    const std::vector<std::string> base64 = { "", "AQ==", "AQg=", "AQgP", "AQgPKg==", "AQgPKv8=" };
+
+    for(std::size_t length = 0; length <= sizeof(frame); length++)
+    {
+        for(auto encoding : { attachment_hex, attachment_base64 })
+        {
+            log_attachment attachment("test.frame", frame, length, encoding);
+            std::string text;
+            BOOST_CHECK(attachment.encode(text, 64) == length);
+            BOOST_CHECK(text == (encoding == attachment_hex ? hex[length] : base64[length]));
+
+            log_attachment parsed;
+            BOOST_REQUIRE(log_attachment::from_string("test.frame", attachment.encoding_name(), text, parsed));
+            BOOST_CHECK(parsed.name() == "test.frame");
+            BOOST_CHECK(parsed.encoding() == encoding);
+            BOOST_REQUIRE(parsed.length() == length);
+            BOOST_CHECK(length == 0 || std::equal(frame, frame + length, parsed.data()));
+        }
+    }
+
+    // encoding stops at the limit, and truncation keeps the size attached.
+    log_attachment attachment("test.frame", frame, sizeof(frame));
+    std::string text;
+    BOOST_CHECK(attachment.encode(text, 2) == 2);
+    BOOST_CHECK(text == "0108");
+    attachment.truncate(3);
+    BOOST_CHECK(attachment.truncated());
+    BOOST_CHECK(attachment.length() == 3 && attachment.size() == sizeof(frame));
+
+    // shared payloads aren't copied.
+    auto payload = std::make_shared<const log_attachment::bytes>(frame, frame + sizeof(frame));
+    log_attachment shared("test.shared", payload, attachment_base64);
+    BOOST_CHECK(shared.data() == payload->data());
+
+    // text that isn't encoded properly is refused.
+    log_attachment parsed;
+    BOOST_CHECK(!log_attachment::from_string("test", "hex", "0", parsed));
+    BOOST_CHECK(!log_attachment::from_string("test", "hex", "0g", parsed));
+    BOOST_CHECK(!log_attachment::from_string("test", "base64", "AQ=", parsed));
+    BOOST_CHECK(!log_attachment::from_string("test", "base64", "A=Q=", parsed));
+    BOOST_CHECK(!log_attachment::from_string("test", "base64", "AQ==AQ==", parsed));
+    BOOST_CHECK(!log_attachment::from_string("test", "uuencode", "", parsed));
+}
+
+//
+// log_attachment_tests__entries
+// checks attachments streamed to a client are written out by the writer (up to its limit),
+// read back from the log file, and kept through binary records (trimmed to fit if need be).
+BOOST_AUTO_TEST_CASE ( log_attachment_tests__entries )
+{
+    std::vector<unsigned char> frame(100);
+    for(std::size_t i = 0; i < frame.size(); i++)
+    {
+        frame[i] = static_cast<unsigned char>(i * 7);
+    }
+
+    auto xml = std::shared_ptr<std::stringstream>(new std::stringstream());
+    {
+        auto writer = log_writer::create_from_stream(xml, false, false);
+        writer->console_threshold(category::no_log);
+        writer->attachment_limit(64);
+        log_client client(writer);
+        client.info() << "frame received" << log_attachment("test.frame", frame.data(), 4)
+                      << log_attachment("test.large", frame.data(), frame.size(), attachment_base64) << lf::end;
+    }
+    BOOST_CHECK(xml->str().find("<attachment name=\"test.frame\" encoding=\"hex\" size=\"4\">00070e15</attachment>")
+            != std::string::npos);
+    BOOST_CHECK(xml->str().find("<attachment name=\"test.large\" encoding=\"base64\" size=\"100\" truncated=\"true\">")
+            != std::string::npos);
+
+    log_file_reader reader(xml);
+    auto entry = reader.next_entry();
+    BOOST_REQUIRE(entry != nullptr);
+    BOOST_REQUIRE(entry->attachments().size() == 2);
+    auto& large = entry->attachments()[1];
+    BOOST_CHECK(large.name() == "test.large" && large.encoding() == attachment_base64);
+    BOOST_CHECK(large.length() == 64 && large.size() == 100 && large.truncated());
+    BOOST_CHECK(std::equal(frame.begin(), frame.begin() + 64, large.data()));
+
+    // binary records keep attachments as they are ...
+    log_entry record_entry;
+    record_entry.entry_type(category::debugging);
+    record_entry.log_namespace("inglenook.logging.test");
+    record_entry.message("record");
+    record_entry.attachment(log_attachment("test.frame", frame.data(), frame.size()));
+    std::vector<char> buffer(log_record::encoded_size(record_entry));
+    BOOST_REQUIRE(log_record::encode(record_entry, buffer.data(), buffer.size()) == buffer.size());
+    auto decoded = log_record::decode(buffer.data(), buffer.size());
+    BOOST_REQUIRE(decoded != nullptr && decoded->attachments().size() == 1);
+    BOOST_CHECK(std::equal(frame.begin(), frame.end(), decoded->attachments()[0].data()));
+
+    // ... unless they have to be trimmed to fit (before the message is).
+    log_record::truncate(record_entry, buffer.size() - 40);
+    BOOST_CHECK(log_record::encoded_size(record_entry) <= buffer.size() - 40);
+    BOOST_CHECK(record_entry.message() == "record");
+    BOOST_CHECK(record_entry.attachments()[0].length() == 60 && record_entry.attachments()[0].size() == 100);
+}
+
+} // namespace inglenook::logging
+
+} // namespace inglenook
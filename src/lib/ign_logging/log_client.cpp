@@ -22,6 +22,10 @@
 // inglenook includes
 #include "log_client.h"
 
+// standard library includes
+#include <functional>
+#include <algorithm>
+
 
 namespace inglenook
 {
@@ -29,15 +33,108 @@ namespace inglenook
 namespace logging
 {
 
+/// a limit applied to every entry logged under a namespace.
+struct log_client_namespace_limit
+{
+    /// namespace the limit applies to.
+    std::string log_namespace;
+
+    /// the limit.
+    log_limit limit;
+};
+
+/// the state a thread keeps for a log_client (see log_client::thread_state()).
+struct log_client_thread_state
+{
+    /// the client the state belongs to (see log_client::m_id).
+    std::uint64_t client_id;
+
+    /// expires when the client is destroyed.
+    std::weak_ptr<bool> client_alive;
+
+    /// entry being collated on this thread, until it is ended with lf::end.
+    log_buffer buffer;
+
+    /// set if a default namespace has been set on this thread.
+    bool has_default_namespace;
+
+    /// default namespace set on this thread.
+    std::string default_namespace;
+
+    /// set if a default entry type has been set on this thread.
+    bool has_default_entry_type;
+
+    /// default entry type set on this thread.
+    category default_entry_type;
+
+    /// set while entries are being grouped on this thread (see log_client::begin_group()).
+    bool grouping;
+
+    /// entries ended on this thread since the group began.
+    std::vector<std::shared_ptr<log_entry>> group;
+
+    /// diagnostic context entries ended on this thread are logged in (see log_client::push_context()).
+    std::shared_ptr<const log_context> context;
+};
+
+//--------------------------------------------------------//
+// Hide the implementation in the anonymous namespace.
+namespace
+{
+
+    /// the log_client state kept by a thread, one for each client it has used.
+    struct thread_states
+    {
+        /// the client last used on the thread (so a thread using a single client never searches for its state).
+        std::uint64_t last_id = 0;
+
+        /// state kept for the client last used.
+        log_client_thread_state* last = nullptr;
+
+        /// state kept for each client used.
+        std::vector<std::unique_ptr<log_client_thread_state>> states;
+    };
+
+    /// the calling thread's states (created when first needed, see thread_states_release).
+    thread_local thread_states* current_thread_states = nullptr;
+
+    /// releases the calling thread's states when the thread exits.
+    struct thread_states_release
+    {
+        ~thread_states_release()
+        {
+            delete current_thread_states;
+            current_thread_states = nullptr;
+        }
+    };
+
+    /// registered to be destroyed at thread exit when it is first used (see log_client::find_thread_state()).
+    thread_local thread_states_release release_thread_states;
+
+    /// identifier given to the next client created (0 is never used, see thread_states::last_id).
+    std::atomic<std::uint64_t> next_client_id(1);
+
+}
+//--------------------------------------------------------//
+
+/// extended data item added to the next entry logged after entries have been suppressed.
+const char* const log_client::SUPPRESSED_KEY = "inglenook.logging.suppressed";
+
 /**
  * Creates a new log_client object.
  * Initializes a new log client to be use in conjunction with the specified log_writer output interface.
  * @param output_interface log_writer that completed entries should be written to.
  */
 log_client::log_client(std::shared_ptr<log_writer> output_interface)
-    : m_output_interface(output_interface)
+    : m_output_interface(output_interface),
+    m_id(next_client_id++),
+    m_alive(std::make_shared<bool>(true)),
+    m_namespace_limit_count(0)
 {
-    // nothing to do at the moment.
+    for(std::size_t i = 0; i < NAMESPACE_LIMIT_SLOTS; i++)
+    {
+        m_namespace_limits[i].store(nullptr);
+    }
 }
 
 /**
@@ -45,29 +142,94 @@ log_client::log_client(std::shared_ptr<log_writer> output_interface)
  */
 log_client::~log_client()
 {
-    // nothing to do at the moment.
+    // discard the state this thread kept for the client (other threads discard theirs once they notice it has gone,
+    // or when they exit), passing on any group left open.
+    m_alive.reset();
+    auto states = current_thread_states;
+    if(states != nullptr)
+    {
+        for(auto state = states->states.begin(); state != states->states.end(); state++)
+        {
+            if((*state)->client_id == m_id && !(*state)->group.empty())
+            {
+                m_output_interface->add_entries((*state)->group);
+            }
+        }
+
+        if(states->last_id == m_id)
+        {
+            states->last_id = 0;
+            states->last = nullptr;
+        }
+        states->states.erase(std::remove_if(states->states.begin(), states->states.end(),
+                [this](const std::unique_ptr<log_client_thread_state>& state) { return state->client_id == m_id; }),
+                states->states.end());
+    }
+
+    for(std::size_t i = 0; i < NAMESPACE_LIMIT_SLOTS; i++)
+    {
+        delete m_namespace_limits[i].load();
+    }
 }
 
 /**
- * Initializes the internal data buffer. .
+ * Gets the calling thread's state for this client: the entry it is writing and the defaults it has set. Each thread
+ * remembers the client it last used, so this costs a thread local read and a comparison in the usual case.
+ * @returns the calling thread's state.
  */
-void log_client::initialize_buffer()
+log_client_thread_state& log_client::thread_state() const
 {
-    // create a new log entry (this is now a tls_ptr to a shared_ptr to a buffer).
-    m_buffer.reset(new std::shared_ptr<log_entry_buffered>(new log_entry_buffered()));
+    auto states = current_thread_states;
+    if(states != nullptr && states->last_id == m_id)
+    {
+        return *states->last;
+    }
+    return find_thread_state();
 }
 
 /**
- * Initializes the internal data buffer if it is not already initialized for this thread.
+ * Finds the calling thread's state for this client, creating it (with an empty entry and no defaults) the first time
+ * the thread uses the client. State kept for clients that have since been destroyed is discarded along the way. A
+ * thread's state is released when it exits (or, should it log from a thread local destructor after that, leaked).
+ * @returns the calling thread's state.
  */
-void log_client::check_buffer()
+log_client_thread_state& log_client::find_thread_state() const
 {
-    // if the buffer has not been initialized for this thread...
-    if(m_buffer.get() == nullptr)
+    auto states = current_thread_states;
+    if(states == nullptr)
+    {
+        states = current_thread_states = new thread_states();
+
+        // (using the release object registers it to be destroyed when this thread exits.)
+        static_cast<void>(&release_thread_states);
+    }
+
+    log_client_thread_state* found = nullptr;
+    for(auto state = states->states.begin(); state != states->states.end();)
+    {
+        if((*state)->client_id == m_id)
+        {
+            found = state->get();
+        }
+        else if((*state)->client_alive.expired())
+        {
+            state = states->states.erase(state);
+            continue;
+        }
+        state++;
+    }
+
+    if(found == nullptr)
     {
-        // ...  then initialize it.
-        initialize_buffer();
+        found = new log_client_thread_state { m_id, m_alive, log_buffer(new log_entry_buffered()),
+                                              false, std::string(), false, category::unspecified, false,
+                                              std::vector<std::shared_ptr<log_entry>>(), nullptr };
+        states->states.push_back(std::unique_ptr<log_client_thread_state>(found));
     }
+
+    states->last_id = m_id;
+    states->last = found;
+    return *found;
 }
 
 /**
@@ -81,10 +243,11 @@ const std::string& log_client::default_namespace() const
     // local - as this can't be safely used as out by ref.
 
     // check if a class level override exists...
-    if (m_ts_default_namespace.get() != nullptr)
+    auto& state = thread_state();
+    if (state.has_default_namespace)
     {
         // .. and if so use it.
-        return *m_ts_default_namespace;
+        return state.default_namespace;
     }
     else
     {
@@ -100,7 +263,9 @@ const std::string& log_client::default_namespace() const
 void log_client::clear_default_namespace()
 {
     // update default namespace
-    m_ts_default_namespace.reset(nullptr);
+    auto& state = thread_state();
+    state.has_default_namespace = false;
+    state.default_namespace.clear();
 }
 
 /**
@@ -110,11 +275,9 @@ void log_client::clear_default_namespace()
 void log_client::default_namespace(const std::string& value)
 {
     // update default namespace
-    if(m_ts_default_namespace.get() == nullptr)
-    {
-        m_ts_default_namespace.reset(new std::string());
-    }
-    *m_ts_default_namespace = value;
+    auto& state = thread_state();
+    state.has_default_namespace = true;
+    state.default_namespace = value;
 }
 
 /**
@@ -124,9 +287,10 @@ void log_client::default_namespace(const std::string& value)
 const category& log_client::default_entry_type() const
 {
     // check if a default is set, else fall back to writers.
-    if (m_ts_default_entry_type.get() != nullptr)
+    auto& state = thread_state();
+    if (state.has_default_entry_type)
     {
-        return *m_ts_default_entry_type;
+        return state.default_entry_type;
     }
     else
     {
@@ -141,7 +305,7 @@ const category& log_client::default_entry_type() const
 void log_client::clear_default_entry_type()
 {
     // update default entry types
-    m_ts_default_entry_type.reset(nullptr);
+    thread_state().has_default_entry_type = false;
 }
 
 
@@ -152,12 +316,9 @@ void log_client::clear_default_entry_type()
 void log_client::default_entry_type(const category& value)
 {
     // update default entry types
-    if(m_ts_default_entry_type.get() == nullptr)
-    {
-        m_ts_default_entry_type.reset(new category);
-    }
-
-    *m_ts_default_entry_type = value;
+    auto& state = thread_state();
+    state.has_default_entry_type = true;
+    state.default_entry_type = value;
 }
 
 /**
@@ -168,15 +329,227 @@ void log_client::default_entry_type(const category& value)
  */
 template <class type> log_client& log_client::send_to_stream(type& x)
 {
-    // make sure buffers initialized
-    check_buffer();
+    // don't bother formatting anything in to entries that won't be logged.
+    auto buffer = message_target();
+    if(buffer == nullptr)
+    {
+        return *this;
+    }
 
     // push element in the message stream
-    (m_buffer->get()->message_buffer()) << x;
+    buffer->message_buffer() << x;
 
     return *this;
 }
 
+/**
+ * Gets the entry the message should be written in to, checking it against the limit for its namespace first (see
+ * check_namespace_limit()).
+ * @returns the current entry, or nullptr if it won't be logged (so nothing need be formatted).
+ */
+log_entry_buffered* log_client::message_target()
+{
+    auto buffer = thread_state().buffer.get();
+    if(!buffer->namespace_limit_checked())
+    {
+        check_namespace_limit();
+    }
+    return buffer->suppressed() ? nullptr : buffer;
+}
+
+/**
+ * Appends a message formatted from a split format string (see format()). The message is formatted in a buffer kept
+ * by each thread, then written to the entry in one go.
+ * @param segments the split format string.
+ * @param arguments an argument for each placeholder.
+ */
+void log_client::append_formatted(const log_format_segments& segments, const log_format_argument* arguments)
+{
+    auto buffer = message_target();
+    if(buffer == nullptr)
+    {
+        return;
+    }
+
+    thread_local std::string message;
+    message.clear();
+    log_format::format(message, segments, arguments);
+    buffer->message_buffer().write(message.data(), message.length());
+}
+
+/**
+ * Checks the current entry against the limit for its namespace (see limit_namespace()). This is done once per
+ * entry, when the first part of the message is streamed (or the entry is ended), so the namespace must be set
+ * before the message is. Suppressed entries are marked as such.
+ */
+void log_client::check_namespace_limit()
+{
+    auto buffer = thread_state().buffer.get();
+    buffer->namespace_limit_checked(true);
+
+    // nothing is limited (the usual case).
+    if(m_namespace_limit_count.load(std::memory_order_acquire) == 0)
+    {
+        return;
+    }
+
+    const std::string& log_namespace = buffer->log_namespace().empty() ? default_namespace() : buffer->log_namespace();
+    std::size_t slot = std::hash<std::string>()(log_namespace) % NAMESPACE_LIMIT_SLOTS;
+    for(std::size_t probe = 0; probe < NAMESPACE_LIMIT_SLOTS; probe++, slot = (slot + 1) % NAMESPACE_LIMIT_SLOTS)
+    {
+        auto namespace_limit = m_namespace_limits[slot].load(std::memory_order_acquire);
+        if(namespace_limit == nullptr)
+        {
+            break;
+        }
+        if(namespace_limit->log_namespace == log_namespace)
+        {
+            std::uint64_t suppressed = 0;
+            if(!namespace_limit->limit.admit(suppressed))
+            {
+                buffer->suppressed(true);
+            }
+            else
+            {
+                report_suppressed(suppressed);
+            }
+            break;
+        }
+    }
+}
+
+/**
+ * Records the number of entries a limit suppressed before the current entry in its extended data
+ * (see SUPPRESSED_KEY), adding to any count already recorded.
+ * @param suppressed number of entries suppressed.
+ */
+void log_client::report_suppressed(const std::uint64_t& suppressed)
+{
+    if(suppressed == 0)
+    {
+        return;
+    }
+
+    auto buffer = thread_state().buffer.get();
+    auto& extended_data = buffer->extended_data();
+    auto reported = extended_data.find(SUPPRESSED_KEY);
+    std::uint64_t total = suppressed + (reported == extended_data.end() ? 0 : std::stoull(reported->second));
+    buffer->extended_data(SUPPRESSED_KEY, std::to_string(total));
+}
+
+/**
+ * Starts a group of entries on this thread. Until end_group() is called, entries ended with lf::end are kept back and
+ * then passed to the log writer together (see log_writer::add_entries()): they are written one after the other with
+ * the same group id, and cost the writer's queue a single entry. Useful for stack dumps and other multi-line reports.
+ * Groups don't nest; starting a group while one is open adds to the open group. Entries being grouped are held in
+ * memory, so groups should be kept short (and ended, see log_group).
+ */
+void log_client::begin_group()
+{
+    thread_state().grouping = true;
+}
+
+/**
+ * Ends the group started on this thread by begin_group(), passing its entries to the log writer.
+ * @returns true if the group was written (false if it was empty, or the log writer didn't accept it).
+ */
+bool log_client::end_group()
+{
+    auto& state = thread_state();
+    state.grouping = false;
+    return !state.group.empty() && m_output_interface->add_entries(state.group);
+}
+
+/**
+ * Gets a future that completes once every entry this client (on any thread) has passed to the log writer has been
+ * written. Entries not yet ended, or in a group not yet ended, aren't waited on. See log_writer::flush().
+ * @param sync if set, the log file is synced to disk before the future completes.
+ * @returns future holding true once the entries have been written.
+ */
+std::future<bool> log_client::flush(const bool& sync)
+{
+    return m_output_interface->flush(sync);
+}
+
+/**
+ * Adds a key/value pair to the diagnostic context of this thread. Every entry ended on this thread (through this
+ * client) carries the context until the pair is removed with pop_context(), and the writer writes its pairs out with
+ * the entry's extended data (an entry's own data takes the place of a pair with the same key, as does a newer pair).
+ * The context is shared by the entries logged in it, never copied in to them; see log_context_scope.
+ * @param key key of the pair.
+ * @param value value of the pair.
+ */
+void log_client::push_context(const std::string& key, const log_field& value)
+{
+    auto& state = thread_state();
+    state.context = std::make_shared<const log_context>(state.context, key, value);
+}
+
+/**
+ * Removes the pair last added to the diagnostic context of this thread by push_context().
+ */
+void log_client::pop_context()
+{
+    auto& state = thread_state();
+    if(state.context != nullptr)
+    {
+        state.context = state.context->parent();
+    }
+}
+
+/**
+ * Gets the diagnostic context of this thread, for example to carry it over to a worker thread (see context(value)).
+ * @returns the context (nullptr if there is none).
+ */
+std::shared_ptr<const log_context> log_client::context()
+{
+    return thread_state().context;
+}
+
+/**
+ * Sets the diagnostic context of this thread, replacing whatever it had.
+ * @param value the context (shared, see context()), or nullptr to clear it.
+ */
+void log_client::context(const std::shared_ptr<const log_context>& value)
+{
+    thread_state().context = value;
+}
+
+/**
+ * Limits the entries logged under a namespace, replacing any limit already applied to it. Entries are checked
+ * against the limit before anything is formatted in to them, so the namespace must be set before the message
+ * (for example log_warning() << ns("device") << ...). Only entries logged through this client are limited.
+ * @param log_namespace namespace to limit.
+ * @param limit limit to apply (copied, see log_limit::log_limit(const log_limit&)).
+ * @returns true if the limit was applied, false if too many namespaces are already limited.
+ */
+bool log_client::limit_namespace(const std::string& log_namespace, const log_limit& limit)
+{
+    boost::mutex::scoped_lock lock(m_namespace_limits_mutex);
+
+    std::size_t slot = std::hash<std::string>()(log_namespace) % NAMESPACE_LIMIT_SLOTS;
+    for(std::size_t probe = 0; probe < NAMESPACE_LIMIT_SLOTS; probe++, slot = (slot + 1) % NAMESPACE_LIMIT_SLOTS)
+    {
+        auto namespace_limit = m_namespace_limits[slot].load();
+        if(namespace_limit == nullptr || namespace_limit->log_namespace == log_namespace)
+        {
+            auto replacement = new log_client_namespace_limit { log_namespace, limit };
+            m_namespace_limits[slot].store(replacement, std::memory_order_release);
+            if(namespace_limit == nullptr)
+            {
+                m_namespace_limit_count++;
+            }
+            else
+            {
+                m_replaced_namespace_limits.push_back(std::unique_ptr<log_client_namespace_limit>(namespace_limit));
+            }
+            return true;
+        }
+    }
+
+    return false;
+}
+
 /**
  * Sets the current message category to the specified category.
  * @param _category category (or entry type) to set this message as.
@@ -184,11 +557,8 @@ template <class type> log_client& log_client::send_to_stream(type& x)
  */
 log_client& log_client::create_log_stream(category _category)
 {
-    // make sure buffers initialized
-    check_buffer();
-
     // set the initial category
-    m_buffer->get()->entry_type(_category);
+    thread_state().buffer->entry_type(_category);
 
     // return the message stream (even though its not entirely what we are currently
     // working with it is the most relevant, usable std::ostream.
@@ -201,8 +571,7 @@ log_client& log_client::create_log_stream(category _category)
  */
 log_buffer& log_client::buffer()
 {
-    check_buffer();
-    return *m_buffer.get();
+    return thread_state().buffer;
 }
 
 /**
@@ -249,11 +618,90 @@ log_client& log_client::fatal() { return create_log_stream(category::fatal); }
  **/
 log_client& log_client::operator<<(const log_data& _log_data)
 {
-    // make sure buffers initialized
-    check_buffer();
+    // get this thread's entry
+    auto buffer = thread_state().buffer.get();
+
+    // the entry won't be logged.
+    if(buffer->suppressed())
+    {
+        return *this;
+    }
 
     // update namespace
-    m_buffer->get()->extended_data(_log_data.key(), _log_data.value());
+    buffer->extended_data(_log_data.key(), _log_data.value());
+
+    // return the stream
+    return *this;
+}
+
+/**
+ * processes typed data (see kv()) to add to the current entries data collection.
+ * @param _log_fields typed data to embue this message with.
+ * @returns always returns *this
+ **/
+log_client& log_client::operator<<(const log_fields& _log_fields)
+{
+    // get this thread's entry
+    auto buffer = thread_state().buffer.get();
+
+    // the entry won't be logged.
+    if(buffer->suppressed())
+    {
+        return *this;
+    }
+
+    // add each item, as it is.
+    auto& fields = _log_fields.fields();
+    for(auto field = fields.begin(); field != fields.end(); field++)
+    {
+        buffer->field(field->first, field->second);
+    }
+
+    // return the stream
+    return *this;
+}
+
+/**
+ * processes a binary payload to attach to the current entry. The payload isn't copied or encoded here (see
+ * log_attachment); the writer encodes it as the entry is written out.
+ * @param _log_attachment attachment to add.
+ * @returns always returns *this
+ **/
+log_client& log_client::operator<<(const log_attachment& _log_attachment)
+{
+    // get this thread's entry
+    auto buffer = thread_state().buffer.get();
+
+    // the entry won't be logged.
+    if(buffer->suppressed())
+    {
+        return *this;
+    }
+
+    buffer->attachment(_log_attachment);
+
+    // return the stream
+    return *this;
+}
+
+/**
+ * processes the call site of the current entry (see LOG_HERE). Only a pointer to the call site's static location is
+ * kept, so nothing is copied or formatted here.
+ * @param _log_source_location location of the call site.
+ * @returns always returns *this
+ **/
+log_client& log_client::operator<<(const log_source_location& _log_source_location)
+{
+    // get this thread's entry
+    auto buffer = thread_state().buffer.get();
+
+    // the entry won't be logged.
+    if(buffer->suppressed())
+    {
+        return *this;
+    }
+
+    buffer->source(&_log_source_location);
 
     // return the stream
     return *this;
@@ -266,16 +714,45 @@ log_client& log_client::operator<<(const log_data& _log_data)
  **/
 log_client& log_client::operator<<(const ns& _ns)
 {
-    // make sure buffers initialized
-    check_buffer();
+    // get this thread's entry
+    auto buffer = thread_state().buffer.get();
 
     // update namespace
-    m_buffer->get()->log_namespace(_ns.log_namespace());
+    buffer->log_namespace(_ns.log_namespace());
 
     // return the stream
     return *this;
 }
 
+/**
+ * processes a call site limit. Streamed before anything else, a suppressed entry costs next to nothing as
+ * nothing more is formatted in to it. The first entry logged after entries have been suppressed carries
+ * the number suppressed (see SUPPRESSED_KEY).
+ * @param _log_limit limit to apply to the entry (usually a static at the call site).
+ * @returns always returns *this
+ **/
+log_client& log_client::operator<<(log_limit& _log_limit)
+{
+    // get this thread's entry
+    auto buffer = thread_state().buffer.get();
+
+    // check the limit (unless something has already suppressed the entry).
+    std::uint64_t suppressed = 0;
+    if(!buffer->suppressed())
+    {
+        if(!_log_limit.admit(suppressed))
+        {
+            buffer->suppressed(true);
+        }
+        else
+        {
+            report_suppressed(suppressed);
+        }
+    }
+
+    return *this;
+}
+
 /**
  * processes a log file (lf) stream manipulator.
  * @param _lf Path identifying file to write XML to.
@@ -283,8 +760,9 @@ log_client& log_client::operator<<(const ns& _ns)
  **/
 log_client& log_client::operator<<(lf _lf)
 {
-    // make sure buffers initialized
-    check_buffer();
+    // get this thread's entry
+    auto& state = thread_state();
+    auto buffer = state.buffer.get();
 
     // decide how to handle modifier.
     switch(_lf)
@@ -292,8 +770,19 @@ log_client& log_client::operator<<(lf _lf)
         // end entry and flush (lf::end)
         case (lf::end):
         {
+            // suppressed entries are discarded (reusing the buffer for the next).
+            if(!buffer->namespace_limit_checked())
+            {
+                check_namespace_limit();
+            }
+            if(buffer->suppressed())
+            {
+                buffer->reset();
+                break;
+            }
+
             // add the entry to the log schedule and create next entry.
-            auto converted_buffer = std::dynamic_pointer_cast<log_entry>(*m_buffer);
+            auto converted_buffer = std::dynamic_pointer_cast<log_entry>(state.buffer);
 
             // ensure that the entry type is set...
             if(converted_buffer->entry_type() == category::unspecified)
@@ -309,9 +798,22 @@ log_client& log_client::operator<<(lf _lf)
                 converted_buffer->log_namespace(default_namespace());
             }
 
-            // schedule the entry for serialization and re-initialize buffer
-            m_output_interface->add_entry(converted_buffer);
-            initialize_buffer();
+            // the entry shares the thread's context (it is only written out by the writer).
+            if(state.context != nullptr)
+            {
+                converted_buffer->context(state.context);
+            }
+
+            // schedule the entry for serialization (or keep it for the group) and re-initialize buffer
+            if(state.grouping)
+            {
+                state.group.push_back(converted_buffer);
+            }
+            else
+            {
+                m_output_interface->add_entry(converted_buffer);
+            }
+            state.buffer.reset(new log_entry_buffered());
 
             break;
         }
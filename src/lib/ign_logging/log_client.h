@@ -19,14 +19,20 @@
 
 // standard library includes
 #include <iostream>
+#include <atomic>
+#include <future>
+#include <vector>
+#include <memory>
 
 // boost (http://boost.org) includes
-#include <boost/thread/tss.hpp>
+#include <boost/thread/mutex.hpp>
 
 // inglenook includes
 #include "log_writer.h"
 #include "log_entry_buffered.h"
 #include "log_entry_modifiers.h"
+#include "log_limit.h"
+#include "log_format.h"
 
 namespace inglenook
 {
@@ -46,8 +52,11 @@ enum lf : unsigned int
 /// shared points to a log buffer
 typedef std::shared_ptr<log_entry_buffered> log_buffer;
 
-/// thread specific data is held entirely within this data type.
-typedef boost::thread_specific_ptr<log_buffer> ts_log_buffer;
+/// the state each thread keeps for a log_client (defined in log_client.cpp).
+struct log_client_thread_state;
+
+/// a limit applied to a namespace (see log_client::limit_namespace(), defined in log_client.cpp).
+struct log_client_namespace_limit;
 
 /**
  * The log_client class provides a thread safe log writing interface for client applications.
@@ -113,14 +122,45 @@ public:
     /// Creates a fatal error log entry
     log_client& fatal();
 
+    // starts a group of entries on this thread, to be written together (see end_group()).
+    void begin_group();
+
+    // passes the entries ended since begin_group() to the log writer, as a group.
+    bool end_group();
+
+    // gets a future completing once the entries passed to the log writer so far have been written.
+    std::future<bool> flush(const bool& sync = false);
+
+    // adds a key/value pair to the diagnostic context of this thread (see log_context_scope).
+    void push_context(const std::string& key, const log_field& value);
+
+    // removes the pair last added to the diagnostic context of this thread.
+    void pop_context();
+
+    // gets the diagnostic context of this thread.
+    std::shared_ptr<const log_context> context();
+
+    // sets the diagnostic context of this thread (for example, one carried over from another thread).
+    void context(const std::shared_ptr<const log_context>& value);
+
+    // limits the entries logged under a namespace.
+    bool limit_namespace(const std::string& log_namespace, const log_limit& limit);
+
+    // appends a message formatted from a format string declared with FMT() (checked when compiled).
+    template <typename format_type, typename... argument_types>
+    log_client& format(const format_type& format_string, const argument_types&... arguments);
+
+    /// extended data item added to the next entry logged after entries have been suppressed (holding the count).
+    static const char* const SUPPRESSED_KEY;
+
 private:
 
 
-    /// initializes the data buffer for the current context.
-    void initialize_buffer();
+    // gets the calling thread's state for this client (its current entry and defaults).
+    log_client_thread_state& thread_state() const;
 
-    /// ensures that the internal buffer is initialized within the current context.
-    void check_buffer();
+    // finds (or creates) the calling thread's state for this client.
+    log_client_thread_state& find_thread_state() const;
 
     /// creates a log category of the specified type.
     inline log_client& create_log_stream(category _category);
@@ -129,19 +169,42 @@ private:
     /// buffer prior to stream write. nice and centralized.
     template <class type> inline log_client& send_to_stream(type& x);
 
+    // gets the entry to write the message in to (nullptr if the entry won't be logged).
+    log_entry_buffered* message_target();
+
+    // appends a message formatted from a split format string.
+    void append_formatted(const log_format_segments& segments, const log_format_argument* arguments);
+
+    // checks the current entry against the limit for its namespace (if it has not been already).
+    void check_namespace_limit();
+
+    // records the number of suppressed entries in the current entry.
+    void report_suppressed(const std::uint64_t& suppressed);
+
+    /// number of namespaces that can be limited.
+    static const std::size_t NAMESPACE_LIMIT_SLOTS = 64;
+
     /// pointer to the output interface that this client should submit log
     /// entries to. this is set at construction and shouldn't change.
     std::shared_ptr<log_writer> m_output_interface;
 
-    /// thread specific default entry type.
-    boost::thread_specific_ptr<category> m_ts_default_entry_type;
+    /// identifies this client's state in each thread (unique, unlike the address of the client).
+    std::uint64_t m_id;
+
+    /// held for the lifetime of the client, so threads can tell when the state they keep for it can be discarded.
+    std::shared_ptr<bool> m_alive;
+
+    /// namespace limits, hashed by namespace (slots are only ever filled or replaced, so can be read lock free).
+    std::atomic<log_client_namespace_limit*> m_namespace_limits[NAMESPACE_LIMIT_SLOTS];
 
-    /// thread specific default name space.
-    boost::thread_specific_ptr<std::string> m_ts_default_namespace;
+    /// number of namespaces limited.
+    std::atomic<std::size_t> m_namespace_limit_count;
 
-    /// thread specific data buffer used to collate stream input until a
-    /// log entry is flushed with lf::end;
-    ts_log_buffer m_buffer;
+    /// serializes changes to the namespace limits.
+    boost::mutex m_namespace_limits_mutex;
+
+    /// namespace limits that have been replaced (kept until destruction, as other threads may still be using them).
+    std::vector<std::unique_ptr<log_client_namespace_limit>> m_replaced_namespace_limits;
 
 public:
 
@@ -149,9 +212,21 @@ public:
 	
 	/// Stream operator to append a specified key:value pair to the current entries data collection.
 	log_client& operator<<(const log_data& _log_data);	
+
+	/// Stream operator to append typed key:value pairs (see kv()) to the current entries data collection.
+	log_client& operator<<(const log_fields& _log_fields);
 	
+	/// Stream operator to attach a binary payload to the current entry (encoded only when written out).
+	log_client& operator<<(const log_attachment& _log_attachment);
+
+	/// Stream operator to record the call site of the current entry (see LOG_HERE).
+	log_client& operator<<(const log_source_location& _log_source_location);
+
 	/// Stream operator to sets the current entries namespace
 	log_client& operator<<(const ns& _ns);
+
+	/// Stream operator to apply a call site limit to the current entry (stream it before anything else).
+	log_client& operator<<(log_limit& _log_limit);
 	
 	/// Stream operator to signal a log client action (log flag).
 	/// Most commonly used in the sense of lf::endl to commit the current message to 
@@ -213,6 +288,88 @@ public:
     //
 };
 
+/**
+ * Appends a message formatted from a format string declared with FMT(). The format string is checked against the
+ * arguments when the program is compiled (the number of placeholders, and that each argument suits its placeholder),
+ * and split in to pieces the first time it is used. Arguments are written as the stream operators would write them,
+ * without iostreams, so the entry reads the same as one streamed piece by piece (and costs a single write to the
+ * entries message buffer). Nothing is formatted in to entries that won't be logged.
+ * @param format_string format string (see FMT()).
+ * @param arguments an argument for each placeholder.
+ * @returns always returns *this
+ */
+template <typename format_type, typename... argument_types>
+log_client& log_client::format(const format_type&, const argument_types&... arguments)
+{
+    static_assert(std::is_base_of<log_format_string, format_type>::value,
+            "format strings are declared with FMT().");
+    static_assert(log_format::placeholders(format_type::text()) != log_format::MALFORMED,
+            "the format string isn't valid (placeholders are {}, {d}, {x}, {f} or {s}; braces are written {{ and }}).");
+    static_assert(log_format::placeholders(format_type::text()) == sizeof...(argument_types),
+            "the format string needs an argument for each placeholder.");
+    static_assert(log_format::arguments_accepted<format_type, 0, argument_types...>(),
+            "an argument doesn't suit its placeholder.");
+
+    // (each format string has a type of its own, so is split once.)
+    static const log_format_segments segments = log_format::split(format_type::text());
+
+    // (the trailing argument keeps the array from being empty.)
+    const log_format_argument formatted_arguments[] = { log_format_argument(arguments)..., log_format_argument(0) };
+    append_formatted(segments, formatted_arguments);
+    return *this;
+}
+
+/**
+ * Groups the entries a thread logs through a client for as long as it is in scope (see log_client::begin_group()).
+ */
+class log_group
+{
+
+public:
+
+    /// there is no copy constructor for this class.
+    log_group(log_group&) = delete;
+
+    /// starts a group of entries on the client.
+    explicit log_group(log_client& client) : m_client(client) { m_client.begin_group(); }
+
+    /// passes the entries logged to the log writer, as a group.
+    ~log_group() { m_client.end_group(); }
+
+private:
+
+    /// client the group is logged through.
+    log_client& m_client;
+};
+
+/**
+ * Adds a key/value pair to the diagnostic context of the thread for as long as it is in scope (see
+ * log_client::push_context()):
+ *
+ *     log_context_scope device(*ilog, "zwave.device", node_id);
+ *     log_info() << ns("zwave") << "polling" << lf::end;    // carries zwave.device
+ */
+class log_context_scope
+{
+
+public:
+
+    /// there is no copy constructor for this class.
+    log_context_scope(log_context_scope&) = delete;
+
+    /// adds the pair to the client's context on this thread.
+    log_context_scope(log_client& client, const std::string& key, const log_field& value) : m_client(client)
+    { m_client.push_context(key, value); }
+
+    /// removes the pair.
+    ~log_context_scope() { m_client.pop_context(); }
+
+private:
+
+    /// client the pair was added through.
+    log_client& m_client;
+};
+
 } // namespace inglenook::logging
 
 } // namespace inglenook
@@ -20,11 +20,16 @@
 #define BOOST_TEST_DYN_LINK
 #define BOOST_TEST_MODULE LOG_TEST_NAME
 
+// standard library includes
+#include <atomic>
+
 // boost (http://boost.org) includes
 #include <boost/test/unit_test.hpp>
+#include <boost/thread.hpp>
 
 // inglenook includes
 #include "log_client.h"
+#include "log_file_reader.h"
 
 namespace inglenook
 {
@@ -215,9 +220,8 @@ BOOST_AUTO_TEST_CASE ( log_client_tests__stream )
         _log_client << ns(second_log_namespace);
         BOOST_CHECK(_log_client.buffer()->log_namespace() == second_log_namespace);
 
-        // try to ensure that the log writer has chance to write anything it feels it should
-        boost::this_thread::yield();
-        boost::this_thread::sleep(boost::posix_time::milliseconds(10));
+        // make sure the log writer has written anything it feels it should
+        BOOST_CHECK(_log_client.flush().get());
         BOOST_CHECK(test_stream->str().length() == 0);
 
         // check flush operator
@@ -230,6 +234,150 @@ BOOST_AUTO_TEST_CASE ( log_client_tests__stream )
     BOOST_CHECK(test_stream->str().length() > 0);
 }
 
+//
+// log_client_tests__thread_state
+// checks each thread keeps its own entry and defaults for each client, that clients don't
+// share state (even when one takes the place of another), and that entries started on other
+// threads are logged as they were written there.
+BOOST_AUTO_TEST_CASE ( log_client_tests__thread_state )
+{
+    auto xml = std::shared_ptr<std::stringstream>(new std::stringstream());
+    {
+        auto writer = log_writer::create_from_stream(xml, false, false);
+        writer->console_threshold(category::no_log);
+        log_client first(writer);
+        log_client second(writer);
+
+        // clients keep separate entries and defaults on the same thread.
+        first.default_namespace("test.first");
+        first.info() << "first";
+        second.warning() << "second";
+        BOOST_CHECK(first.buffer()->message() == "first");
+        BOOST_CHECK(second.buffer()->message() == "second");
+        BOOST_CHECK(first.default_namespace() == "test.first");
+        BOOST_CHECK(second.default_namespace() == writer->default_namespace());
+
+        // other threads start with nothing written and no defaults (checked once they have joined).
+        const int THREADS = 4;
+        std::atomic<int> inherited(0);
+        boost::thread_group threads;
+        for(int i = 0; i < THREADS; i++)
+        {
+            threads.create_thread([&first, &second, &inherited, i]()
+            {
+                if(!first.buffer()->message().empty() || first.default_namespace() == "test.first")
+                {
+                    inherited++;
+                }
+                first.default_namespace("test.thread");
+                first.error() << "thread " << i;
+                second.info() << "unfinished";
+                first << lf::end;
+            });
+        }
+        threads.join_all();
+        BOOST_CHECK(inherited == 0);
+        BOOST_CHECK(first.buffer()->message() == "first");
+        BOOST_CHECK(first.default_namespace() == "test.first");
+        BOOST_CHECK(second.buffer()->message() == "second");
+        first.clear_default_namespace();
+        BOOST_CHECK(first.default_namespace() == writer->default_namespace());
+
+        // a client created in place of another starts afresh.
+        for(int i = 0; i < 2; i++)
+        {
+            std::unique_ptr<log_client> replaced(new log_client(writer));
+            BOOST_CHECK(replaced->buffer()->message().empty());
+            BOOST_CHECK(replaced->default_entry_type() == writer->default_entry_type());
+            replaced->default_entry_type(category::error);
+            *replaced << "replaced";
+        }
+    }
+
+    std::size_t logged = 0;
+    for(std::size_t found = xml->str().find("test.thread"); found != std::string::npos;
+        found = xml->str().find("test.thread", found + 1))
+    {
+        logged++;
+    }
+    BOOST_CHECK(logged == 4);
+    BOOST_CHECK(xml->str().find("unfinished") == std::string::npos);
+}
+
+//
+// log_client_tests__group
+// checks entries logged in a group are written one after the other with the same group id,
+// while another thread logs as fast as it can.
+BOOST_AUTO_TEST_CASE ( log_client_tests__group )
+{
+    const int GROUP_SIZE = 20;
+    const int INTERLOPERS = 500;
+    auto xml = std::shared_ptr<std::stringstream>(new std::stringstream());
+    {
+        auto writer = log_writer::create_from_stream(xml, false, false);
+        writer->console_threshold(category::no_log);
+        log_client client(writer);
+
+        boost::thread interloper([&client]()
+        {
+            for(int i = 0; i < INTERLOPERS; i++)
+            {
+                client.info() << ns("test.interloper") << "interloper " << i << lf::end;
+            }
+        });
+
+        for(int dump = 0; dump < 2; dump++)
+        {
+            log_group group(client);
+            for(int i = 0; i < GROUP_SIZE; i++)
+            {
+                client.error() << ns("test.dump") << "frame " << i << lf::end;
+                boost::this_thread::yield();
+            }
+
+            // nothing is written until the group ends.
+            BOOST_CHECK(writer->statistics().enqueued[category::error] == static_cast<std::uint64_t>(dump * GROUP_SIZE));
+        }
+
+        // empty groups aren't written.
+        client.begin_group();
+        BOOST_CHECK(!client.end_group());
+        interloper.join();
+    }
+
+    log_file_reader reader(xml);
+    std::vector<std::shared_ptr<log_entry>> entries;
+    for(auto entry = reader.next_entry(); entry != nullptr; entry = reader.next_entry())
+    {
+        entries.push_back(entry);
+    }
+    BOOST_REQUIRE(entries.size() == INTERLOPERS + 2 * GROUP_SIZE);
+
+    std::vector<std::uint64_t> group_ids;
+    for(std::size_t i = 0; i < entries.size(); i++)
+    {
+        if(entries[i]->log_namespace() != "test.dump")
+        {
+            BOOST_CHECK(entries[i]->fields().count(log_writer::GROUP_KEY) == 0);
+            continue;
+        }
+
+        // the group is written without interruption, in order.
+        BOOST_REQUIRE(i + GROUP_SIZE <= entries.size());
+        auto group_id = entries[i]->fields().at(log_writer::GROUP_KEY).uint64_value();
+        for(int member = 0; member < GROUP_SIZE; member++)
+        {
+            BOOST_CHECK(entries[i + member]->log_namespace() == "test.dump");
+            BOOST_CHECK(entries[i + member]->message() == "frame " + std::to_string(member));
+            BOOST_CHECK(entries[i + member]->fields().at(log_writer::GROUP_KEY).uint64_value() == group_id);
+        }
+        group_ids.push_back(group_id);
+        i += GROUP_SIZE - 1;
+    }
+    BOOST_REQUIRE(group_ids.size() == 2);
+    BOOST_CHECK(group_ids[0] != group_ids[1]);
+}
+
 } // namespace inglenook::logging
 
 } // namespace inglenook
@@ -0,0 +1,90 @@
+/*
+ * log_context.cpp: Diagnostic context shared by the log entries made within a scope.
+ * Copyright (C) 2012, Project Inglenook (http://www.project-inglenook.co.uk)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// inglenook includes
+#include "log_context.h"
+
+namespace inglenook
+{
+
+namespace logging
+{
+
+/**
+ * Creates a context, adding a key/value pair to another. The other context is shared, not copied.
+ * @param parent context to add the pair to (nullptr to start a new context).
+ * @param key key of the pair (replacing any pair in the parent with the same key).
+ * @param value value of the pair.
+ */
+log_context::log_context(const std::shared_ptr<const log_context>& parent, const std::string& key,
+        const log_field& value) :
+    m_parent(parent),
+    m_key(key),
+    m_value(value)
+{
+}
+
+/**
+ * Gets the key of the pair.
+ * @returns key of the pair.
+ */
+const std::string& log_context::key() const
+{
+    return m_key;
+}
+
+/**
+ * Gets the value of the pair.
+ * @returns value of the pair.
+ */
+const log_field& log_context::value() const
+{
+    return m_value;
+}
+
+/**
+ * Gets the context the pair was added to.
+ * @returns the context the pair was added to, or nullptr if this is the outermost pair.
+ */
+const std::shared_ptr<const log_context>& log_context::parent() const
+{
+    return m_parent;
+}
+
+/**
+ * Indicates if the pair has been replaced by one with the same key added since. Used when writing a context out, from
+ * its top down, so that each key is written once (with its newest value). Nothing is allocated, so this is safe to use
+ * from the crash handler.
+ * @param top the newest pair of the context.
+ * @returns true if a pair between top and this one (including top) has the same key.
+ */
+bool log_context::hidden_by(const log_context* top) const
+{
+    for(auto item = top; item != nullptr && item != this; item = item->m_parent.get())
+    {
+        if(item->m_key == m_key)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+} // namespace inglenook::logging
+
+} // namespace inglenook
@@ -0,0 +1,73 @@
+#pragma once
+/*
+ * log_context.h: Diagnostic context shared by the log entries made within a scope.
+ * Copyright (C) 2012, Project Inglenook (http://www.project-inglenook.co.uk)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// standard library includes
+#include <string>
+#include <memory>
+
+// inglenook includes
+#include "log_field.h"
+
+namespace inglenook
+{
+
+namespace logging
+{
+
+/**
+ * The log_context class holds one key/value pair of a diagnostic context (for example the device or session a thread
+ * is working for), and the context it was added to. Contexts never change once made: adding a pair makes a new context
+ * on top of the old one, so entries share the context they were logged in (see log_client::push_context()) rather
+ * than copying its pairs, and it is released with the last of them.
+ */
+class log_context
+{
+
+    public:
+
+        // creates a context, adding a pair to another.
+        log_context(const std::shared_ptr<const log_context>& parent, const std::string& key, const log_field& value);
+
+        /// gets the key of the pair.
+        const std::string& key() const;
+
+        /// gets the value of the pair.
+        const log_field& value() const;
+
+        /// gets the context the pair was added to (nullptr at the outermost pair).
+        const std::shared_ptr<const log_context>& parent() const;
+
+        // indicates if a pair added since this one (up to and including top) has the same key.
+        bool hidden_by(const log_context* top) const;
+
+    private:
+
+        /// the context the pair was added to.
+        std::shared_ptr<const log_context> m_parent;
+
+        /// key of the pair.
+        std::string m_key;
+
+        /// value of the pair.
+        log_field m_value;
+};
+
+} // namespace inglenook::logging
+
+} // namespace inglenook
@@ -0,0 +1,148 @@
+#pragma once
+/*
+* log_context_tests.h: Test routines for the log_context class (log_context.cpp/h)
+* Copyright (C) 2012, Project Inglenook (http://www.project-inglenook.co.uk)
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE LOG_TEST_NAME
+
+// standard includes
+#include <sstream>
+#include <vector>
+
+// boost (http://boost.org) includes
+#include <boost/test/unit_test.hpp>
+
+// inglenook includes
+#include "log_context.h"
+#include "log_record.h"
+#include "log_client.h"
+#include "log_file_reader.h"
+
+namespace inglenook
+{
+
+namespace logging
+{
+
+//
+// log_context_tests__scopes
+// checks scoped pairs are added to (and removed from) the context of the thread, that the
+// entries logged in a context share it, and that newer pairs and an entry's own data take
+// the place of pairs with the same key.
+BOOST_AUTO_TEST_CASE ( log_context_tests__scopes )
+{
+    auto writer = log_writer::create_from_stream(std::shared_ptr<std::stringstream>(new std::stringstream()),
+            false, false);
+    writer->console_threshold(category::no_log);
+    log_client client(writer);
+
+    BOOST_CHECK(client.context() == nullptr);
+    {
+        log_context_scope session(client, "test.session", "a1");
+        log_context_scope device(client, "test.device", 7);
+        auto context = client.context();
+        BOOST_REQUIRE(context != nullptr && context->key() == "test.device");
+        BOOST_CHECK(context->value() == log_field(7));
+        BOOST_REQUIRE(context->parent() != nullptr && context->parent()->key() == "test.session");
+        BOOST_CHECK(context->parent()->parent() == nullptr);
+
+        {
+            log_context_scope replaced(client, "test.session", "b2");
+            BOOST_CHECK(client.context()->parent() == context);
+            BOOST_CHECK(context->parent()->hidden_by(client.context().get()));
+            BOOST_CHECK(!context->hidden_by(client.context().get()));
+        }
+        BOOST_CHECK(client.context() == context);
+
+        // entries share the context.
+        log_entry first, second;
+        first.context(context);
+        second.context(context);
+        second.extended_data("test.device", "own");
+        BOOST_CHECK(first.context() == second.context());
+        BOOST_CHECK(!first.context_hidden(*context));
+        BOOST_CHECK(second.context_hidden(*context));
+    }
+    BOOST_CHECK(client.context() == nullptr);
+
+    // contexts can be carried over to another thread.
+    client.push_context("test.job", 1);
+    auto carried = client.context();
+    client.pop_context();
+    client.context(carried);
+    BOOST_CHECK(client.context() == carried);
+    client.context(nullptr);
+}
+
+//
+// log_context_tests__entries
+// checks the context is written out with the entries logged in it, read back from the log
+// file as extended data, and kept through binary records.
+BOOST_AUTO_TEST_CASE ( log_context_tests__entries )
+{
+    auto xml = std::shared_ptr<std::stringstream>(new std::stringstream());
+    {
+        auto writer = log_writer::create_from_stream(xml, false, false);
+        writer->console_threshold(category::no_log);
+        log_client client(writer);
+        log_context_scope session(client, "test.session", "a<1>");
+        log_context_scope device(client, "test.device", 7);
+        client.info() << "polling" << lf::end;
+        client.info() << "polled" << log_data("test.device", "8") << lf::end;
+    }
+    BOOST_CHECK(xml->str().find("<item key=\"test.device\" type=\"int64\"><![CDATA[7]]></item>") != std::string::npos);
+    BOOST_CHECK(xml->str().find("<item key=\"test.session\"><![CDATA[a&lt;1&gt;]]></item>") != std::string::npos);
+
+    log_file_reader reader(xml);
+    auto entry = reader.next_entry();
+    BOOST_REQUIRE(entry != nullptr);
+    BOOST_CHECK(entry->extended_data().at("test.session") == "a<1>");
+    BOOST_REQUIRE(entry->fields().count("test.device") == 1);
+    BOOST_CHECK(entry->fields().at("test.device") == log_field(7));
+
+    // the entry's own data is written in place of the context's.
+    entry = reader.next_entry();
+    BOOST_REQUIRE(entry != nullptr);
+    BOOST_CHECK(entry->extended_data().at("test.device") == "8");
+    BOOST_CHECK(entry->fields().count("test.device") == 0);
+    BOOST_CHECK(entry->extended_data().at("test.session") == "a<1>");
+
+    // binary records hold the context as the entry's own data.
+    auto context = std::make_shared<const log_context>(nullptr, "test.session", "a1");
+    context = std::make_shared<const log_context>(context, "test.device", 7);
+    context = std::make_shared<const log_context>(context, "test.session", "b2");
+    log_entry record_entry;
+    record_entry.entry_type(category::debugging);
+    record_entry.log_namespace("inglenook.logging.test");
+    record_entry.message("record");
+    record_entry.extended_data("test.own", "yes");
+    record_entry.context(context);
+    std::vector<char> buffer(log_record::encoded_size(record_entry));
+    BOOST_REQUIRE(log_record::encode(record_entry, buffer.data(), buffer.size()) == buffer.size());
+    auto decoded = log_record::decode(buffer.data(), buffer.size());
+    BOOST_REQUIRE(decoded != nullptr);
+    BOOST_CHECK(decoded->extended_data().size() == 2);
+    BOOST_CHECK(decoded->extended_data().at("test.session") == "b2");
+    BOOST_CHECK(decoded->extended_data().at("test.own") == "yes");
+    BOOST_REQUIRE(decoded->fields().count("test.device") == 1);
+    BOOST_CHECK(decoded->fields().at("test.device") == log_field(7));
+}
+
+} // namespace inglenook::logging
+
+} // namespace inglenook
@@ -0,0 +1,1157 @@
+/*
+ * log_crash_handler.cpp: Writes outstanding log entries when the process is fatally terminated.
+ * Copyright (C) 2012, Project Inglenook (http://www.project-inglenook.co.uk)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// inglenook includes
+#include "log_crash_handler.h"
+#include "log_file_stream.h"
+#include "log_mapped_file_stream.h"
+
+// standard library includes
+#include <exception>
+#include <cstring>
+#include <csignal>
+
+// platform includes
+#include <fcntl.h>
+#include <time.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+namespace inglenook
+{
+
+namespace logging
+{
+
+/// namespace that crash entries are written to.
+const char* const log_crash_handler::CRASH_NAMESPACE = "inglenook.logging.crash";
+
+//--------------------------------------------------------//
+// Hide the implementation in the anonymous namespace.
+// NOTE: everything reachable from emergency_flush() must remain async-signal-safe;
+//       no allocation, no locks, no iostreams and no exceptions.
+namespace
+{
+
+    /// size of the statically reserved buffer emergency output is formatted in to.
+    const std::size_t EMERGENCY_BUFFER_SIZE = 16384;
+
+    /// size of the alternate signal stack (allows stack overflows to be reported).
+    const std::size_t ALTERNATE_STACK_SIZE = 65536;
+
+    /// statically reserved buffer emergency output is formatted in to.
+    char emergency_buffer[EMERGENCY_BUFFER_SIZE];
+
+    /// number of bytes currently held in emergency_buffer.
+    std::size_t emergency_buffer_used = 0;
+
+    /// statically reserved alternate signal stack.
+    char alternate_stack[ALTERNATE_STACK_SIZE];
+
+    /// descriptor emergency output is written to (opened during installation).
+    int emergency_descriptor = -1;
+
+    /// descriptor of /dev/null, placed over the writer's own descriptor to fence off its output.
+    int fence_descriptor = -1;
+
+    /// writer the handler is installed against (kept alive while installed).
+    std::shared_ptr<log_writer> installed_writer;
+
+    /// file buffer of the installed writer (pending output is recovered from here).
+    const log_file_buffer* installed_file_buffer = nullptr;
+
+    /// mapped file buffer of the installed writer (its window is fenced off, and the file cut to its data).
+    const log_mapped_file_buffer* installed_mapped_file_buffer = nullptr;
+
+    /// formats the emergency entries can be written in, one for each of the writer's formatters.
+    enum emergency_format
+    {
+        emergency_format_xml,
+        emergency_format_jsonl,
+        emergency_format_logfmt
+    };
+
+    /// format of the installed writer (worked out during installation, so the handler makes no dynamic_cast).
+    emergency_format installed_format = emergency_format_xml;
+
+    /// set once a fatal event is being handled (std::terminate() -> std::abort() -> SIGABRT).
+    volatile sig_atomic_t handling_crash = 0;
+
+    /// signals intercepted by the handler.
+    const int handled_signals[] = { SIGSEGV, SIGBUS, SIGABRT };
+
+    /// number of signals intercepted by the handler.
+    const std::size_t HANDLED_SIGNAL_COUNT = sizeof(handled_signals) / sizeof(handled_signals[0]);
+
+    /// actions in place prior to installation, restored before a signal is re-raised.
+    struct sigaction previous_actions[HANDLED_SIGNAL_COUNT];
+
+    /// terminate handler in place prior to installation.
+    std::terminate_handler previous_terminate_handler = nullptr;
+
+    /**
+     * Writes the content of the emergency buffer to the emergency descriptor.
+     */
+    void emergency_write_buffer()
+    {
+        std::size_t written = 0;
+
+        // keep writing until everything is out (or the descriptor refuses to take more).
+        while(written < emergency_buffer_used)
+        {
+            ssize_t result = ::write(emergency_descriptor, emergency_buffer + written, emergency_buffer_used - written);
+            if(result < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            if(result <= 0)
+            {
+                break;
+            }
+            written += result;
+        }
+
+        emergency_buffer_used = 0;
+    }
+
+    /**
+     * Appends data to the emergency buffer, writing it out whenever it fills.
+     * @param data data to append.
+     * @param length number of bytes to append.
+     */
+    void emergency_append(const char* data, std::size_t length)
+    {
+        while(length > 0)
+        {
+            // copy as much as we can fit...
+            std::size_t chunk = EMERGENCY_BUFFER_SIZE - emergency_buffer_used;
+            chunk = chunk < length ? chunk : length;
+            std::memcpy(emergency_buffer + emergency_buffer_used, data, chunk);
+            emergency_buffer_used += chunk;
+            data += chunk;
+            length -= chunk;
+
+            // ... and make room if we have run out of it.
+            if(emergency_buffer_used == EMERGENCY_BUFFER_SIZE)
+            {
+                emergency_write_buffer();
+            }
+        }
+    }
+
+    /**
+     * Appends a null terminated string to the emergency buffer.
+     * @param text string to append.
+     */
+    void emergency_append(const char* text)
+    {
+        std::size_t length = 0;
+        while(text[length] != '\0')
+        {
+            length++;
+        }
+        emergency_append(text, length);
+    }
+
+    /**
+     * Appends a string to the emergency buffer, sanitizing it as log_writer does.
+     * @param text string to append.
+     */
+    void emergency_append_sanitized(const std::string& text)
+    {
+        const char* data = text.data();
+        std::size_t length = text.length();
+        std::size_t run_start = 0;
+
+        for(std::size_t i = 0; i < length; i++)
+        {
+            if(data[i] == '<' || data[i] == '>')
+            {
+                // write out the run of safe characters, then the replacement.
+                emergency_append(data + run_start, i - run_start);
+                emergency_append(data[i] == '<' ? "&lt;" : "&gt;");
+                run_start = i + 1;
+            }
+        }
+        emergency_append(data + run_start, length - run_start);
+    }
+
+    /**
+     * Appends a null terminated string to the emergency buffer as an attribute value, sanitizing it as log_writer does.
+     * @param text string to append (nothing is appended if it is nullptr).
+     */
+    void emergency_append_attribute(const char* text)
+    {
+        for(std::size_t i = 0; text != nullptr && text[i] != '\0'; i++)
+        {
+            switch(text[i])
+            {
+                case '<': emergency_append("&lt;"); break;
+                case '>': emergency_append("&gt;"); break;
+                case '"': emergency_append("&quot;"); break;
+                default: emergency_append(text + i, 1); break;
+            }
+        }
+    }
+
+    /**
+     * Appends a zero padded unsigned number to the emergency buffer.
+     * @param value number to append.
+     * @param width minimum number of digits to write.
+     */
+    void emergency_append_number(unsigned long long value, int width = 1)
+    {
+        char digits[24];
+        int count = 0;
+
+        // build the digits in reverse...
+        do
+        {
+            digits[count++] = '0' + (value % 10);
+            value /= 10;
+        }
+        while(value != 0 && count < 20);
+
+        // ... pad ...
+        while(count < width && count < 20)
+        {
+            digits[count++] = '0';
+        }
+
+        // ... and write out in the correct order.
+        char ordered[24];
+        for(int i = 0; i < count; i++)
+        {
+            ordered[i] = digits[count - i - 1];
+        }
+        emergency_append(ordered, count);
+    }
+
+    /**
+     * Appends the current UTC time in the format used by log_writer (%Y-%m-%dT%H:%M:%sZ).
+     * gmtime_r() is not async-signal-safe, so the calendar conversion is performed by hand.
+     */
+    void emergency_append_timestamp()
+    {
+        struct timespec now;
+        clock_gettime(CLOCK_REALTIME, &now);
+
+        long long seconds = now.tv_sec;
+        long long days = seconds / 86400;
+        long long seconds_of_day = seconds % 86400;
+
+        // convert days since the epoch to a civil date (proleptic gregorian calendar).
+        long long z = days + 719468;
+        long long era = (z >= 0 ? z : z - 146096) / 146097;
+        long long day_of_era = z - era * 146097;
+        long long year_of_era = (day_of_era - day_of_era / 1460 + day_of_era / 36524 - day_of_era / 146096) / 365;
+        long long day_of_year = day_of_era - (365 * year_of_era + year_of_era / 4 - year_of_era / 100);
+        long long month_index = (5 * day_of_year + 2) / 153;
+        long long day = day_of_year - (153 * month_index + 2) / 5 + 1;
+        long long month = month_index < 10 ? month_index + 3 : month_index - 9;
+        long long year = year_of_era + era * 400 + (month <= 2 ? 1 : 0);
+
+        emergency_append_number(year, 4);
+        emergency_append("-");
+        emergency_append_number(month, 2);
+        emergency_append("-");
+        emergency_append_number(day, 2);
+        emergency_append("T");
+        emergency_append_number(seconds_of_day / 3600, 2);
+        emergency_append(":");
+        emergency_append_number((seconds_of_day / 60) % 60, 2);
+        emergency_append(":");
+        emergency_append_number(seconds_of_day % 60, 2);
+        emergency_append(".");
+        emergency_append_number(now.tv_nsec / 1000, 6);
+        emergency_append("Z");
+    }
+
+    /**
+     * Appends the opening of a <log-entry> element, up to and including the message.
+     * @param entry_type category of the entry.
+     * @param log_namespace namespace of the entry.
+     * @param message message body (already sanitized or trusted).
+     */
+    void emergency_append_entry_start(category entry_type, const char* log_namespace)
+    {
+        emergency_append("<log-entry timestamp=\"");
+        emergency_append_timestamp();
+        emergency_append("\" severity=\"");
+        emergency_append_number(entry_type);
+        emergency_append("\" ns=\"");
+        emergency_append(log_namespace);
+        emergency_append("\"><message><![CDATA[");
+    }
+
+    /**
+     * Indicates if a field can be formatted safely (floating point numbers and times can't be, and are left out).
+     * @param field field to check.
+     * @returns true if the field can be appended.
+     */
+    bool emergency_field_safe(const log_field& field)
+    {
+        field_type type = field.type();
+        return type == field_string || type == field_int64 || type == field_uint64 || type == field_bool;
+    }
+
+    /**
+     * Appends the value of a number or flag field as it is written in every format.
+     * @param field field to append (a number or flag).
+     */
+    void emergency_append_scalar(const log_field& field)
+    {
+        if(field.type() == field_bool)
+        {
+            emergency_append(field.bool_value() ? "true" : "false");
+        }
+        else if(field.type() == field_int64 && field.int64_value() < 0)
+        {
+            emergency_append("-");
+            emergency_append_number(0 - static_cast<unsigned long long>(field.int64_value()));
+        }
+        else
+        {
+            emergency_append_number(field.bits());
+        }
+    }
+
+    /**
+     * Appends the data of an attachment in hex, whatever its encoding (it needs no more than a few digits to hand).
+     * @param attachment attachment to append.
+     * @param length number of bytes to append.
+     */
+    void emergency_append_hex(const log_attachment& attachment, const std::size_t& length)
+    {
+        char digits[128];
+        std::size_t used = 0;
+        for(std::size_t i = 0; i < length; i++)
+        {
+            digits[used++] = "0123456789abcdef"[attachment.data()[i] >> 4];
+            digits[used++] = "0123456789abcdef"[attachment.data()[i] & 0x0f];
+            if(used == sizeof(digits))
+            {
+                emergency_append(digits, used);
+                used = 0;
+            }
+        }
+        emergency_append(digits, used);
+    }
+
+    /**
+     * Appends an extended data item holding a field, if it can be formatted safely.
+     * @param key key of the item.
+     * @param field value of the item.
+     */
+    void emergency_append_field(const std::string& key, const log_field& field)
+    {
+        if(!emergency_field_safe(field))
+        {
+            return;
+        }
+        emergency_append("<item key=\"");
+        emergency_append(key.c_str());
+        if(field.type() != field_string)
+        {
+            emergency_append("\" type=\"");
+            emergency_append(field.type_name());
+        }
+        emergency_append("\"><![CDATA[");
+        if(field.type() == field_string)
+        {
+            emergency_append_sanitized(field.string_value());
+        }
+        else
+        {
+            emergency_append_scalar(field);
+        }
+        emergency_append("]]></item>");
+    }
+
+    /**
+     * Appends a queued log entry as XML.
+     * @param entry entry to append.
+     * @param attachment_limit largest number of bytes of each attachment to append (see log_writer::attachment_limit()).
+     */
+    void emergency_append_entry(log_entry& entry, const std::size_t& attachment_limit)
+    {
+        // log_entry::message() is called explicitly; buffered entries synchronize (and allocate)
+        // in their override, but have always been synchronized by log_writer::add_entry() already.
+        emergency_append_entry_start(entry.entry_type(), entry.log_namespace().c_str());
+        emergency_append_sanitized(entry.log_entry::message());
+        emergency_append("]]></message>");
+
+        // the call site is a static location, so safe to read.
+        auto source = entry.source();
+        if(source != nullptr)
+        {
+            emergency_append("<source file=\"");
+            emergency_append_attribute(source->file);
+            emergency_append("\" line=\"");
+            emergency_append_number(source->line);
+            emergency_append("\" function=\"");
+            emergency_append_attribute(source->function);
+            emergency_append("\"/>");
+        }
+
+        auto& extended_data = entry.extended_data();
+        auto& fields = entry.fields();
+        auto context = entry.context().get();
+        if(extended_data.size() > 0 || fields.size() > 0 || context != nullptr)
+        {
+            emergency_append("<extended-data>");
+            for(auto data = extended_data.begin(); data != extended_data.end(); data++)
+            {
+                emergency_append("<item key=\"");
+                emergency_append(data->first.c_str());
+                emergency_append("\"><![CDATA[");
+                emergency_append_sanitized(data->second);
+                emergency_append("]]></item>");
+            }
+
+            // typed values that can be formatted safely (floating point numbers and times can't be, and are left out).
+            for(auto field = fields.begin(); field != fields.end(); field++)
+            {
+                emergency_append_field(field->first, field->second);
+            }
+
+            // ... and the pairs of the context the entry was logged in.
+            for(auto item = context; item != nullptr; item = item->parent().get())
+            {
+                if(!entry.context_hidden(*item))
+                {
+                    emergency_append_field(item->key(), item->value());
+                }
+            }
+            emergency_append("</extended-data>");
+        }
+
+        // attachments are appended in hex whatever their encoding.
+        auto& attachments = entry.attachments();
+        for(auto attachment = attachments.begin(); attachment != attachments.end(); attachment++)
+        {
+            const std::size_t length = attachment->length() < attachment_limit ? attachment->length() : attachment_limit;
+            emergency_append("<attachment name=\"");
+            emergency_append(attachment->name().c_str());
+            emergency_append("\" encoding=\"hex\" size=\"");
+            emergency_append_number(attachment->size());
+            emergency_append(length < attachment->size() ? "\" truncated=\"true\">" : "\">");
+            emergency_append_hex(*attachment, length);
+            emergency_append("</attachment>");
+        }
+
+        emergency_append("</log-entry>");
+    }
+
+    /**
+     * Appends text escaped for a JSON string, as log_formatter::append_json_string() escapes it (without the quotes).
+     * @param text text to append.
+     * @param length length of the text.
+     */
+    void emergency_append_json_escaped(const char* text, const std::size_t& length)
+    {
+        std::size_t run_start = 0;
+        for(std::size_t i = 0; i < length; i++)
+        {
+            unsigned char c = static_cast<unsigned char>(text[i]);
+            if(c >= 0x20 && c != '"' && c != '\\')
+            {
+                continue;
+            }
+
+            emergency_append(text + run_start, i - run_start);
+            run_start = i + 1;
+            switch(c)
+            {
+                case '"': emergency_append("\\\""); break;
+                case '\\': emergency_append("\\\\"); break;
+                case '\n': emergency_append("\\n"); break;
+                case '\r': emergency_append("\\r"); break;
+                case '\t': emergency_append("\\t"); break;
+                default:
+                {
+                    const char escaped[] = { '\\', 'u', '0', '0', "0123456789abcdef"[c >> 4], "0123456789abcdef"[c & 0x0f] };
+                    emergency_append(escaped, sizeof(escaped));
+                    break;
+                }
+            }
+        }
+        emergency_append(text + run_start, length - run_start);
+    }
+
+    /**
+     * Appends text as a JSON string (quoted).
+     * @param text text to append.
+     * @param length length of the text.
+     */
+    void emergency_append_json_string(const char* text, const std::size_t& length)
+    {
+        emergency_append("\"");
+        emergency_append_json_escaped(text, length);
+        emergency_append("\"");
+    }
+
+    /**
+     * Appends a string as a JSON string (quoted).
+     * @param text text to append.
+     */
+    void emergency_append_json_string(const std::string& text)
+    {
+        emergency_append_json_string(text.data(), text.length());
+    }
+
+    /**
+     * Indicates if text has to be quoted as a logfmt value (see log_formatter::append_logfmt_value()).
+     * @param text text to check.
+     * @param length length of the text.
+     * @returns true if the text holds spaces, '=', quotes, backslashes or control characters.
+     */
+    bool emergency_logfmt_quoted(const char* text, const std::size_t& length)
+    {
+        for(std::size_t i = 0; i < length; i++)
+        {
+            if(static_cast<unsigned char>(text[i]) <= ' ' || text[i] == '=' || text[i] == '"' || text[i] == '\\')
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /**
+     * Appends text as a logfmt value, quoted only if it needs to be (or is empty).
+     * @param text text to append.
+     * @param length length of the text.
+     */
+    void emergency_append_logfmt_value(const char* text, const std::size_t& length)
+    {
+        if(length == 0 || emergency_logfmt_quoted(text, length))
+        {
+            emergency_append_json_string(text, length);
+        }
+        else
+        {
+            emergency_append(text, length);
+        }
+    }
+
+    /**
+     * Appends a string as a logfmt value.
+     * @param text text to append.
+     */
+    void emergency_append_logfmt_value(const std::string& text)
+    {
+        emergency_append_logfmt_value(text.data(), text.length());
+    }
+
+    /**
+     * Appends the key of a logfmt pair; anything that would end the key is written as '_'.
+     * @param key key to append.
+     */
+    void emergency_append_logfmt_key(const std::string& key)
+    {
+        for(std::size_t i = 0; i < key.length(); i++)
+        {
+            bool plain = static_cast<unsigned char>(key[i]) > ' ' && key[i] != '=' && key[i] != '"';
+            emergency_append(plain ? key.data() + i : "_", 1);
+        }
+    }
+
+    /**
+     * Measures a C string (as held by call sites), taking nullptr as empty.
+     * @param text string to measure (or nullptr).
+     * @returns length of the string.
+     */
+    std::size_t emergency_length(const char* text)
+    {
+        std::size_t length = 0;
+        while(text != nullptr && text[length] != '\0')
+        {
+            length++;
+        }
+        return length;
+    }
+
+    /**
+     * Appends a queued log entry as a line of JSON, as log_json_formatter would (typed values that can't be
+     * formatted safely are left out, and attachments are written in hex).
+     * @param entry entry to append.
+     * @param attachment_limit largest number of bytes of each attachment to append (see log_writer::attachment_limit()).
+     */
+    void emergency_append_json_entry(log_entry& entry, const std::size_t& attachment_limit)
+    {
+        emergency_append("{\"timestamp\":\"");
+        emergency_append_timestamp();
+        emergency_append("\",\"level\":\"");
+        emergency_append(log_formatter::category_name(entry.entry_type()));
+        emergency_append("\",\"ns\":");
+        emergency_append_json_string(entry.log_namespace());
+        emergency_append(",\"message\":");
+        emergency_append_json_string(entry.log_entry::message());
+
+        auto source = entry.source();
+        if(source != nullptr)
+        {
+            emergency_append(",\"source\":{\"file\":");
+            emergency_append_json_string(source->file == nullptr ? "" : source->file, emergency_length(source->file));
+            emergency_append(",\"line\":");
+            emergency_append_number(source->line);
+            emergency_append(",\"function\":");
+            emergency_append_json_string(source->function == nullptr ? "" : source->function,
+                    emergency_length(source->function));
+            emergency_append("}");
+        }
+
+        auto& extended_data = entry.extended_data();
+        auto& fields = entry.fields();
+        auto context = entry.context().get();
+        if(extended_data.size() > 0 || fields.size() > 0 || context != nullptr)
+        {
+            bool first = true;
+            for(auto data = extended_data.begin(); data != extended_data.end(); data++)
+            {
+                emergency_append(first ? ",\"data\":{" : ",");
+                emergency_append_json_string(data->first);
+                emergency_append(":");
+                emergency_append_json_string(data->second);
+                first = false;
+            }
+            for(auto field = fields.begin(); field != fields.end(); field++)
+            {
+                if(emergency_field_safe(field->second))
+                {
+                    emergency_append(first ? ",\"data\":{" : ",");
+                    emergency_append_json_string(field->first);
+                    emergency_append(":");
+                    if(field->second.type() == field_string)
+                    {
+                        emergency_append_json_string(field->second.string_value());
+                    }
+                    else
+                    {
+                        emergency_append_scalar(field->second);
+                    }
+                    first = false;
+                }
+            }
+            for(auto item = context; item != nullptr; item = item->parent().get())
+            {
+                if(!entry.context_hidden(*item) && emergency_field_safe(item->value()))
+                {
+                    emergency_append(first ? ",\"data\":{" : ",");
+                    emergency_append_json_string(item->key());
+                    emergency_append(":");
+                    if(item->value().type() == field_string)
+                    {
+                        emergency_append_json_string(item->value().string_value());
+                    }
+                    else
+                    {
+                        emergency_append_scalar(item->value());
+                    }
+                    first = false;
+                }
+            }
+            emergency_append(first ? ",\"data\":{}" : "}");
+        }
+
+        auto& attachments = entry.attachments();
+        for(auto attachment = attachments.begin(); attachment != attachments.end(); attachment++)
+        {
+            const std::size_t length = attachment->length() < attachment_limit ? attachment->length() : attachment_limit;
+            emergency_append(attachment == attachments.begin() ? ",\"attachments\":[{\"name\":" : ",{\"name\":");
+            emergency_append_json_string(attachment->name());
+            emergency_append(",\"encoding\":\"hex\",\"size\":");
+            emergency_append_number(attachment->size());
+            emergency_append(length < attachment->size() ? ",\"truncated\":true,\"data\":\"" : ",\"data\":\"");
+            emergency_append_hex(*attachment, length);
+            emergency_append("\"}");
+        }
+        emergency_append(attachments.empty() ? "}\n" : "]}\n");
+    }
+
+    /**
+     * Appends a queued log entry as a line of logfmt pairs, as log_logfmt_formatter would (typed values that can't be
+     * formatted safely are left out, and attachments are written in hex).
+     * @param entry entry to append.
+     * @param attachment_limit largest number of bytes of each attachment to append (see log_writer::attachment_limit()).
+     */
+    void emergency_append_logfmt_entry(log_entry& entry, const std::size_t& attachment_limit)
+    {
+        emergency_append("ts=");
+        emergency_append_timestamp();
+        emergency_append(" level=");
+        emergency_append(log_formatter::category_name(entry.entry_type()));
+        emergency_append(" ns=");
+        emergency_append_logfmt_value(entry.log_namespace());
+        emergency_append(" msg=");
+        emergency_append_logfmt_value(entry.log_entry::message());
+
+        // (the file and line are one value, quoted if the file name needs it.)
+        auto source = entry.source();
+        if(source != nullptr)
+        {
+            const char* file = source->file == nullptr ? "" : source->file;
+            std::size_t file_length = emergency_length(source->file);
+            bool quote = emergency_logfmt_quoted(file, file_length);
+            emergency_append(quote ? " source=\"" : " source=");
+            emergency_append_json_escaped(file, file_length);
+            emergency_append(":");
+            emergency_append_number(source->line);
+            emergency_append(quote ? "\" function=" : " function=");
+            emergency_append_logfmt_value(source->function == nullptr ? "" : source->function,
+                    emergency_length(source->function));
+        }
+
+        auto& extended_data = entry.extended_data();
+        for(auto data = extended_data.begin(); data != extended_data.end(); data++)
+        {
+            emergency_append(" ");
+            emergency_append_logfmt_key(data->first);
+            emergency_append("=");
+            emergency_append_logfmt_value(data->second);
+        }
+        auto& fields = entry.fields();
+        for(auto field = fields.begin(); field != fields.end(); field++)
+        {
+            if(emergency_field_safe(field->second))
+            {
+                emergency_append(" ");
+                emergency_append_logfmt_key(field->first);
+                emergency_append("=");
+                if(field->second.type() == field_string)
+                {
+                    emergency_append_logfmt_value(field->second.string_value());
+                }
+                else
+                {
+                    emergency_append_scalar(field->second);
+                }
+            }
+        }
+        for(auto item = entry.context().get(); item != nullptr; item = item->parent().get())
+        {
+            if(!entry.context_hidden(*item) && emergency_field_safe(item->value()))
+            {
+                emergency_append(" ");
+                emergency_append_logfmt_key(item->key());
+                emergency_append("=");
+                if(item->value().type() == field_string)
+                {
+                    emergency_append_logfmt_value(item->value().string_value());
+                }
+                else
+                {
+                    emergency_append_scalar(item->value());
+                }
+            }
+        }
+
+        auto& attachments = entry.attachments();
+        for(auto attachment = attachments.begin(); attachment != attachments.end(); attachment++)
+        {
+            const std::size_t length = attachment->length() < attachment_limit ? attachment->length() : attachment_limit;
+            emergency_append(" attachment.");
+            emergency_append_logfmt_key(attachment->name());
+            emergency_append(length == 0 ? "=\"\"" : "=");
+            emergency_append_hex(*attachment, length);
+            if(length < attachment->size())
+            {
+                emergency_append(" attachment.");
+                emergency_append_logfmt_key(attachment->name());
+                emergency_append(".truncated=true");
+            }
+        }
+        emergency_append("\n");
+    }
+
+    /**
+     * Appends a queued log entry in the installed writer's format.
+     * @param entry entry to append.
+     * @param attachment_limit largest number of bytes of each attachment to append (see log_writer::attachment_limit()).
+     */
+    void emergency_append_queued_entry(log_entry& entry, const std::size_t& attachment_limit)
+    {
+        switch(installed_format)
+        {
+            case emergency_format_jsonl: emergency_append_json_entry(entry, attachment_limit); break;
+            case emergency_format_logfmt: emergency_append_logfmt_entry(entry, attachment_limit); break;
+            default: emergency_append_entry(entry, attachment_limit); break;
+        }
+    }
+
+    /**
+     * Appends the entry describing why the process is terminating, in the installed writer's format.
+     * @param reason short description of why the process is terminating (trusted, nothing needs escaping).
+     * @param signal_number signal being handled, or 0 if not terminating because of a signal.
+     */
+    void emergency_append_crash_entry(const char* reason, int signal_number)
+    {
+        if(installed_format == emergency_format_xml)
+        {
+            emergency_append_entry_start(category::fatal, log_crash_handler::CRASH_NAMESPACE);
+            emergency_append("Process terminated by ");
+            emergency_append(reason);
+            emergency_append(".]]></message>");
+            if(signal_number != 0)
+            {
+                emergency_append("<extended-data><item key=\"signal\"><![CDATA[");
+                emergency_append_number(signal_number);
+                emergency_append("]]></item></extended-data>");
+            }
+            emergency_append("</log-entry>");
+            return;
+        }
+
+        const bool json = installed_format == emergency_format_jsonl;
+        emergency_append(json ? "{\"timestamp\":\"" : "ts=");
+        emergency_append_timestamp();
+        emergency_append(json ? "\",\"level\":\"fatal\",\"ns\":\"" : " level=fatal ns=");
+        emergency_append(log_crash_handler::CRASH_NAMESPACE);
+        emergency_append(json ? "\",\"message\":\"Process terminated by " : " msg=\"Process terminated by ");
+        emergency_append(reason);
+        emergency_append(".\"");
+        if(signal_number != 0)
+        {
+            emergency_append(json ? ",\"data\":{\"signal\":\"" : " signal=");
+            emergency_append_number(signal_number);
+            emergency_append(json ? "\"}" : "");
+        }
+        emergency_append(json ? "}\n" : "\n");
+    }
+
+    /**
+     * Gets a printable name for a signal.
+     * @param signal_number signal to name.
+     * @returns name of the signal.
+     */
+    const char* signal_name(int signal_number)
+    {
+        switch(signal_number)
+        {
+            case SIGSEGV: return "SIGSEGV";
+            case SIGBUS:  return "SIGBUS";
+            case SIGABRT: return "SIGABRT";
+            default:      return "unknown signal";
+        }
+    }
+
+}
+//--------------------------------------------------------//
+
+/**
+ * Installs the crash handler for the specified log writer.
+ * Only one writer can be protected at a time, installing the handler for a new writer uninstalls it from the
+ * previous one. The writer must be file backed (see log_writer::create_from_file_path() and
+ * log_writer::create_from_mapped_file_path()); writers emitting to arbitrary streams cannot be safely written to from
+ * a signal handler and are declined, as are writers with a formatter of their own (only the XML, JSON Lines and
+ * logfmt formats can be written from a signal handler). The writer's sink and format are worked out here, so the
+ * signal handler doesn't have to; set the writer's formatter first, it can't be changed while the handler is installed.
+ * @param writer log writer to protect.
+ * @returns true if the handler was installed.
+ */
+bool log_crash_handler::install(const std::shared_ptr<log_writer>& writer)
+{
+    // only one writer can be protected at a time.
+    uninstall();
+
+    // check this writer is one we can actually write on behalf of...
+    if(writer == nullptr || writer->m_output_file.empty())
+    {
+        return false;
+    }
+
+    // ... in a format we know how to write (holding the formatter to it).
+    emergency_format format;
+    {
+        boost::mutex::scoped_lock lock_queue((*writer->m_log_serialization_queue_mutex.get()));
+        if(dynamic_cast<log_xml_formatter*>(writer->m_formatter.get()) != nullptr)
+        {
+            format = emergency_format_xml;
+        }
+        else if(dynamic_cast<log_json_formatter*>(writer->m_formatter.get()) != nullptr)
+        {
+            format = emergency_format_jsonl;
+        }
+        else if(dynamic_cast<log_logfmt_formatter*>(writer->m_formatter.get()) != nullptr)
+        {
+            format = emergency_format_logfmt;
+        }
+        else
+        {
+            return false;
+        }
+        writer->m_crash_protected = true;
+    }
+
+    // open our own descriptors now, it is too late to do so once the process is dying.
+    int descriptor = ::open(writer->m_output_file.c_str(), O_WRONLY | O_APPEND | O_CLOEXEC);
+    int fence = ::open("/dev/null", O_WRONLY | O_CLOEXEC);
+    if(descriptor < 0 || fence < 0)
+    {
+        ::close(descriptor);
+        ::close(fence);
+        boost::mutex::scoped_lock lock_queue((*writer->m_log_serialization_queue_mutex.get()));
+        writer->m_crash_protected = false;
+        return false;
+    }
+
+    // record everything the handler will need.
+    emergency_descriptor = descriptor;
+    fence_descriptor = fence;
+    installed_writer = writer;
+    auto file_stream = dynamic_cast<log_file_stream*>(writer->m_output_stream.get());
+    installed_file_buffer = file_stream != nullptr ? &file_stream->file_buffer() : nullptr;
+    auto mapped_file_stream = dynamic_cast<log_mapped_file_stream*>(writer->m_output_stream.get());
+    installed_mapped_file_buffer = mapped_file_stream != nullptr ? &mapped_file_stream->file_buffer() : nullptr;
+    installed_format = format;
+    handling_crash = 0;
+
+    // provide an alternate stack for the installing thread so stack overflows can still be reported.
+    stack_t stack;
+    stack.ss_sp = alternate_stack;
+    stack.ss_size = ALTERNATE_STACK_SIZE;
+    stack.ss_flags = 0;
+    sigaltstack(&stack, nullptr);
+
+    // intercept fatal signals...
+    struct sigaction action;
+    std::memset(&action, 0, sizeof(action));
+    action.sa_sigaction = &log_crash_handler::_signal_handler;
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = SA_SIGINFO | SA_ONSTACK;
+    for(std::size_t i = 0; i < HANDLED_SIGNAL_COUNT; i++)
+    {
+        sigaction(handled_signals[i], &action, &previous_actions[i]);
+    }
+
+    // ... and unhandled exceptions.
+    previous_terminate_handler = std::set_terminate(&log_crash_handler::_terminate_handler);
+
+    return true;
+}
+
+/**
+ * Removes the crash handler, restoring the signal and terminate handlers that were in place before installation.
+ * Does nothing if the handler is not installed.
+ */
+void log_crash_handler::uninstall()
+{
+    if(!installed())
+    {
+        return;
+    }
+
+    // restore the previous handlers.
+    for(std::size_t i = 0; i < HANDLED_SIGNAL_COUNT; i++)
+    {
+        sigaction(handled_signals[i], &previous_actions[i], nullptr);
+    }
+    std::set_terminate(previous_terminate_handler);
+    previous_terminate_handler = nullptr;
+
+    // release the resources held on behalf of the writer.
+    ::close(emergency_descriptor);
+    ::close(fence_descriptor);
+    emergency_descriptor = -1;
+    fence_descriptor = -1;
+    installed_file_buffer = nullptr;
+    installed_mapped_file_buffer = nullptr;
+    {
+        boost::mutex::scoped_lock lock_queue((*installed_writer->m_log_serialization_queue_mutex.get()));
+        installed_writer->m_crash_protected = false;
+    }
+    installed_writer.reset();
+}
+
+/**
+ * Indicates if the crash handler is currently installed.
+ * @returns true if installed.
+ */
+bool log_crash_handler::installed()
+{
+    return installed_writer != nullptr;
+}
+
+/**
+ * Handles a fatal signal.
+ * Writes the emergency output, restores the previous action for the signal and re-raises it so the process
+ * terminates (or the previous handler runs) as it would have had the crash handler not been installed.
+ * @param signal_number signal being handled.
+ */
+void log_crash_handler::_signal_handler(int signal_number, siginfo_t*, void*)
+{
+    // write out what we can (once only - std::terminate() will abort() in to here).
+    if(!handling_crash)
+    {
+        handling_crash = 1;
+        _emergency_flush(signal_name(signal_number), signal_number);
+    }
+
+    // restore the previous action and re-raise, the signal is delivered once we return.
+    for(std::size_t i = 0; i < HANDLED_SIGNAL_COUNT; i++)
+    {
+        if(handled_signals[i] == signal_number)
+        {
+            sigaction(signal_number, &previous_actions[i], nullptr);
+        }
+    }
+    raise(signal_number);
+}
+
+/**
+ * Handles std::terminate().
+ * Writes the emergency output then hands over to the previous terminate handler (std::abort() by default).
+ */
+void log_crash_handler::_terminate_handler()
+{
+    if(!handling_crash)
+    {
+        handling_crash = 1;
+        _emergency_flush("std::terminate()", 0);
+    }
+
+    // continue termination as it would have happened without us.
+    if(previous_terminate_handler != nullptr)
+    {
+        previous_terminate_handler();
+    }
+    std::abort();
+}
+
+/**
+ * Writes the emergency output for the installed writer.
+ * The writer's own descriptor is first replaced with /dev/null, so nothing its serialization thread does from
+ * this point reaches the file. Then, in order; output buffered by the writer but not yet flushed, entries waiting
+ * in the serialization queue, an entry describing the reason for termination and the XML footer. The serialization
+ * queue is read without acquiring its mutex (the lock may be held by the thread that crashed), and an entry the
+ * serialization thread is part way through formatting is lost; this is best effort by necessity. The entries are
+ * written in the writer's format (XML, JSON Lines or logfmt, see log_writer::formatter()), which can't change while
+ * the handler is installed.
+ * @param reason short description of why the process is terminating.
+ * @param signal_number signal being handled, or 0 if not terminating because of a signal.
+ */
+void log_crash_handler::_emergency_flush(const char* reason, int signal_number)
+{
+    log_writer* writer = installed_writer.get();
+    if(writer == nullptr || emergency_descriptor < 0)
+    {
+        return;
+    }
+
+    emergency_buffer_used = 0;
+
+    // output the writer has serialized but not yet handed to the operating system.
+    if(installed_file_buffer != nullptr)
+    {
+        // fence off the writer (dup2 atomically swaps the file the descriptor refers to).
+        if(installed_file_buffer->descriptor() >= 0)
+        {
+            dup2(fence_descriptor, installed_file_buffer->descriptor());
+        }
+
+        // (a batch already handed to io_uring was bound to the file when submitted; let it land before what follows.)
+        installed_file_buffer->await_writes();
+        emergency_append(installed_file_buffer->pending_data(), installed_file_buffer->pending_size());
+    }
+
+    // a mapped file holds everything serialized already, but is preallocated beyond it. the writer's descriptor is
+    // fenced off first (as above), so it can't move its window on, grow the file or write past the window. the data
+    // is measured, and the window swapped for anonymous memory (mmap atomically replaces a mapping, as dup2 does a
+    // descriptor) so nothing more reaches the file, which is then cut to the data. what was copied in before the swap
+    // is already in the file (the window was shared), including the part of any entry the writer was still copying in
+    // (best effort, as above).
+    // the window can't be left mapped from the file, shared or private: cutting the file under it would fault
+    // (SIGBUS) the serialization thread as it next copies in, and the emergency output written after the data would
+    // race with its copies. mmap isn't on POSIX's list of async-signal-safe functions, but on Linux (the only platform
+    // with mapped files, see log_mapped_file_buffer) it is a bare system call, taking no locks and allocating nothing
+    // in the process, like the dup2 and ftruncate calls around it.
+    if(installed_mapped_file_buffer != nullptr)
+    {
+        const log_mapped_file_buffer* buffer = installed_mapped_file_buffer;
+        if(buffer->descriptor() >= 0)
+        {
+            dup2(fence_descriptor, buffer->descriptor());
+        }
+
+        char* window = buffer->window();
+        off_t data_size = buffer->data_size();
+        if(window != nullptr)
+        {
+            mmap(window, log_mapped_file_buffer::WINDOW_SIZE, PROT_READ | PROT_WRITE,
+                    MAP_FIXED | MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        }
+        ftruncate(emergency_descriptor, data_size);
+    }
+
+    // the emergency entries are written in the writer's format. a file the writer hadn't started yet gets its header
+    // first (the line based formats have none).
+    if(!writer->m_output_started && writer->m_write_header)
+    {
+        emergency_append(writer->m_header.data(), writer->m_header.length());
+    }
+
+    // an entry held back for coalescing came before anything still queued.
+    log_entry* held = writer->m_coalesce_held.get();
+    if(held != nullptr && held->entry_type() >= writer->xml_threshold())
+    {
+        emergency_append_queued_entry(*held, writer->attachment_limit());
+    }
+
+    // entries still waiting to be serialized (filtered as the serialization worker would).
+    auto queue = writer->m_log_serialization_queue.get();
+    if(queue != nullptr)
+    {
+        for(std::size_t i = 0; i < queue->size(); i++)
+        {
+            // (the rest of a group is carried by its first entry, see log_writer::add_entries().)
+            log_entry* entry = (*queue)[i].get();
+            for(std::size_t member = 0; entry != nullptr; member++)
+            {
+                if(entry->entry_type() != category::unspecified &&
+                   entry->entry_type() != category::no_log &&
+                   entry->entry_type() >= writer->xml_threshold() &&
+                   entry->log_namespace().length() > 0 &&
+                   entry->log_entry::message().length() > 0)
+                {
+                    emergency_append_queued_entry(*entry, writer->attachment_limit());
+                }
+
+                auto& group = (*queue)[i]->group();
+                entry = member < group.size() ? group[member].get() : nullptr;
+            }
+        }
+    }
+
+    // the reason we are going down.
+    emergency_append_crash_entry(reason, signal_number);
+
+    // close off the document if the writer would have done so.
+    if(writer->m_write_footer && installed_format == emergency_format_xml)
+    {
+        emergency_append("</log-entries>");
+        emergency_append("</inglenook-log-file>");
+    }
+
+    emergency_write_buffer();
+}
+
+} // namespace inglenook::logging
+
+} // namespace inglenook
@@ -0,0 +1,79 @@
+#pragma once
+/*
+ * log_crash_handler.h: Writes outstanding log entries when the process is fatally terminated.
+ * Copyright (C) 2012, Project Inglenook (http://www.project-inglenook.co.uk)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// standard library includes
+#include <memory>
+#include <csignal>
+
+// inglenook includes
+#include "log_writer.h"
+
+namespace inglenook
+{
+
+namespace logging
+{
+
+/**
+ * The log_crash_handler class rescues log output when the process is fatally terminated.
+ * Once installed against a file backed log_writer, SIGSEGV, SIGBUS, SIGABRT and std::terminate() are intercepted.
+ * Before the process is allowed to die the handler appends any output buffered by the writer, every entry still
+ * waiting in the serialization queue, an entry describing why the process terminated and (if the writer was
+ * configured to do so) the closing XML tags; in the writer's format, XML, JSON Lines or logfmt (writers with a
+ * formatter of their own are declined). Only async-signal-safe calls are made while doing so; all output
+ * is formatted in to a statically reserved buffer and written directly to a descriptor that was opened during
+ * installation. The original signal is then re-raised. Nothing is done on behalf of the handler until a fatal
+ * signal arrives, so it costs nothing during normal operation.
+ */
+class log_crash_handler
+{
+
+    public:
+
+        /// there is no default constructor for this class (all members are static).
+        log_crash_handler() = delete;
+
+        // installs the crash handler for the specified log writer.
+        static bool install(const std::shared_ptr<log_writer>& writer);
+
+        // removes the crash handler, restoring the previous handlers.
+        static void uninstall();
+
+        // indicates if the crash handler is currently installed.
+        static bool installed();
+
+        /// namespace that crash entries are written to.
+        static const char* const CRASH_NAMESPACE;
+
+    private:
+
+        /// handles fatal signals (installed with sigaction).
+        static void _signal_handler(int signal_number, siginfo_t* info, void* context);
+
+        /// handles std::terminate() (installed with std::set_terminate).
+        static void _terminate_handler();
+
+        /// writes everything outstanding for the installed writer (async-signal-safe).
+        static void _emergency_flush(const char* reason, int signal_number);
+
+};
+
+} // namespace inglenook::logging
+
+} // namespace inglenook
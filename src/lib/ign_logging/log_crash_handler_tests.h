@@ -0,0 +1,340 @@
+#pragma once
+/*
+* log_crash_handler_tests.h: Test routines for the log_crash_handler class (log_crash_handler.cpp/h)
+* Copyright (C) 2012, Project Inglenook (http://www.project-inglenook.co.uk)
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE LOG_TEST_NAME
+
+// standard includes
+#include <fstream>
+#include <sstream>
+#include <csignal>
+
+// platform includes
+#include <unistd.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+
+// boost (http://boost.org) includes
+#include <boost/test/unit_test.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/regex.hpp>
+
+// inglenook includes
+#include "log_crash_handler.h"
+
+namespace inglenook
+{
+
+namespace logging
+{
+
+/**
+ * Test scenario for log_crash_handler.
+ * Forks a child process which logs to the specified file with the crash handler installed, then terminates
+ * abnormally. Some entries are written out by the writer beforehand and one is left queued.
+ * @param log_file file for the child process to log to.
+ * @param use_terminate if true the child calls std::terminate(), otherwise std::abort().
+ * @param mapped if true the child writes through a memory mapped file (see log_writer::create_from_mapped_file_path()).
+ * @param busy if true the child crashes while the writer is still serializing a large backlog.
+ * @param format name of the format the child logs in (see log_formatter::create()).
+ * @returns the status of the child process (as reported by waitpid).
+ */
+int run_crashing_child(const boost::filesystem::path& log_file, const bool& use_terminate, const bool& mapped = false,
+        const bool& busy = false, const std::string& format = "xml")
+{
+    pid_t child = fork();
+    if(child == 0)
+    {
+        // we are about to crash deliberately, don't leave core files lying around.
+        struct rlimit no_core = { 0, 0 };
+        setrlimit(RLIMIT_CORE, &no_core);
+
+        // the test framework's own handlers would otherwise resume the test run in the child.
+        std::signal(SIGABRT, SIG_DFL);
+        std::signal(SIGSEGV, SIG_DFL);
+        std::signal(SIGBUS, SIG_DFL);
+
+        auto writer = mapped ? log_writer::create_from_mapped_file_path(log_file) : log_writer::create_from_file_path(log_file);
+        writer->console_threshold(category::no_log);
+        writer->formatter(log_formatter::create(format));
+        if(!log_crash_handler::install(writer))
+        {
+            _exit(1);
+        }
+
+        // these are written out before we crash...
+        for(int i = 0; i < 5; i++)
+        {
+            auto entry = std::shared_ptr<log_entry>(new log_entry());
+            entry->log_namespace("inglenook.logging.test");
+            entry->entry_type(category::information);
+            entry->message("buffered entry " + std::to_string(i) + " <escaped>");
+            writer->add_entry(entry);
+        }
+        if(!writer->flush().get())
+        {
+            _exit(2);
+        }
+
+        // ... and this one should still be waiting in the queue.
+        auto entry = std::shared_ptr<log_entry>(new log_entry());
+        entry->log_namespace("inglenook.logging.test");
+        entry->entry_type(category::information);
+        entry->message("queued entry");
+        entry->extended_data("test.key", "test value");
+        writer->add_entry(entry);
+
+        // keep the serializer writing as we crash, if asked: large entries, the last of them in many parts (each
+        // copied in to the window on its own). the crash waits for the queue to empty, as the queue is read without
+        // its mutex (see log_crash_handler::_emergency_flush()), so it is the mapped file that is raced.
+        if(busy)
+        {
+            for(int i = 0; i <= 40; i++)
+            {
+                auto entry = std::shared_ptr<log_entry>(new log_entry());
+                entry->log_namespace("inglenook.logging.test");
+                entry->entry_type(category::information);
+                entry->message("busy entry " + std::to_string(i) + " " + std::string(256 * 1024, 'x'));
+                for(int part = 0; i == 40 && part < 64; part++)
+                {
+                    entry->extended_data("part." + std::to_string(part), std::string(256 * 1024, 'y'));
+                }
+                writer->add_entry(entry);
+            }
+            while(writer->statistics().queue_depth > 0)
+            {
+                boost::this_thread::yield();
+            }
+        }
+
+        if(use_terminate)
+        {
+            std::terminate();
+        }
+        std::abort();
+    }
+
+    int status = 0;
+    waitpid(child, &status, 0);
+    return status;
+}
+
+/**
+ * Formatter of a format the crash handler doesn't know how to write.
+ */
+class log_crash_test_formatter : public log_formatter
+{
+
+    public:
+
+        virtual const char* name() const { return "test"; }
+
+        virtual void format_entry(std::string& output, log_entry& entry, const std::size_t&) const
+        {
+            output += entry.message() + "\n";
+        }
+};
+
+/**
+ * Reads the entire content of a file.
+ * @param file_path file to read.
+ * @returns content of the file.
+ */
+std::string read_crash_log(const boost::filesystem::path& file_path)
+{
+    std::ifstream input(file_path.native());
+    std::stringstream content;
+    content << input.rdbuf();
+    return content.str();
+}
+
+//
+// log_crash_handler_tests__install
+// checks the handler can only be installed against file backed writers in a format it
+// can write, that it holds the writer to its format and that it can be installed and removed cleanly.
+BOOST_AUTO_TEST_CASE ( log_crash_handler_tests__install )
+{
+    // stream writers are declined.
+    auto stream_writer = log_writer::create_from_stream(std::shared_ptr<std::stringstream>(new std::stringstream()));
+    BOOST_CHECK(!log_crash_handler::install(stream_writer));
+    BOOST_CHECK(!log_crash_handler::installed());
+
+    // file writers are accepted.
+    auto log_file = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("ign-crash-%%%%-%%%%.xml");
+    {
+        auto file_writer = log_writer::create_from_file_path(log_file);
+        BOOST_CHECK(log_crash_handler::install(file_writer));
+        BOOST_CHECK(log_crash_handler::installed());
+
+        // the format can't change under the handler...
+        BOOST_CHECK(!file_writer->formatter(log_formatter::create("jsonl")));
+        log_crash_handler::uninstall();
+        BOOST_CHECK(!log_crash_handler::installed());
+
+        // ... and formats the handler can't write are declined.
+        BOOST_CHECK(file_writer->formatter(std::shared_ptr<log_formatter>(new log_crash_test_formatter())));
+        BOOST_CHECK(!log_crash_handler::install(file_writer));
+        BOOST_CHECK(!log_crash_handler::installed());
+        BOOST_CHECK(file_writer->formatter(log_formatter::create("xml")));
+    }
+
+    // the writer closed the document normally.
+    std::string content = read_crash_log(log_file);
+    BOOST_CHECK(content.find(log_crash_handler::CRASH_NAMESPACE) == std::string::npos);
+    BOOST_CHECK(boost::regex_search(content, boost::regex("</log-entries></inglenook-log-file>$")));
+    boost::filesystem::remove(log_file);
+}
+
+//
+// log_crash_handler_tests__signal
+// checks that buffered and queued entries, the reason for termination and the
+// footer are written when the process aborts, and that the process still dies by the signal.
+BOOST_AUTO_TEST_CASE ( log_crash_handler_tests__signal )
+{
+    auto log_file = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("ign-crash-%%%%-%%%%.xml");
+    int status = run_crashing_child(log_file, false);
+
+    BOOST_CHECK(WIFSIGNALED(status));
+    BOOST_CHECK(WIFSIGNALED(status) && WTERMSIG(status) == SIGABRT);
+
+    std::string content = read_crash_log(log_file);
+    for(int i = 0; i < 5; i++)
+    {
+        BOOST_CHECK(content.find("buffered entry " + std::to_string(i) + " &lt;escaped&gt;") != std::string::npos);
+    }
+    BOOST_CHECK(boost::regex_search(content, boost::regex(
+            "<log-entry timestamp=\"[0-9]{4}-[0-9]{2}-[0-9]{2}T[0-9]{2}:[0-9]{2}:[0-9]{2}\\.[0-9]{6}Z\" severity=\"3\" "
+            "ns=\"inglenook\\.logging\\.test\"><message><!\\[CDATA\\[queued entry\\]\\]></message>"
+            "<extended-data><item key=\"test\\.key\"><!\\[CDATA\\[test value\\]\\]></item></extended-data></log-entry>")));
+    BOOST_CHECK(boost::regex_search(content, boost::regex(
+            "<log-entry timestamp=\"[^\"]+\" severity=\"6\" ns=\"inglenook\\.logging\\.crash\"><message><!\\[CDATA\\["
+            "Process terminated by SIGABRT\\.\\]\\]></message><extended-data><item key=\"signal\"><!\\[CDATA\\[6\\]\\]>"
+            "</item></extended-data></log-entry></log-entries></inglenook-log-file>$")));
+    boost::filesystem::remove(log_file);
+}
+
+//
+// log_crash_handler_tests__terminate
+// checks that std::terminate() is reported, and that the subsequent abort is not
+// reported a second time.
+BOOST_AUTO_TEST_CASE ( log_crash_handler_tests__terminate )
+{
+    auto log_file = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("ign-crash-%%%%-%%%%.xml");
+    int status = run_crashing_child(log_file, true);
+
+    BOOST_CHECK(WIFSIGNALED(status) && WTERMSIG(status) == SIGABRT);
+
+    std::string content = read_crash_log(log_file);
+    BOOST_CHECK(content.find("SIGABRT") == std::string::npos);
+    BOOST_CHECK(boost::regex_search(content, boost::regex(
+            "<message><!\\[CDATA\\[Process terminated by std::terminate\\(\\)\\.\\]\\]></message></log-entry>"
+            "</log-entries></inglenook-log-file>$")));
+    boost::filesystem::remove(log_file);
+}
+
+//
+// log_crash_handler_tests__json_lines
+// checks a writer formatting JSON Lines has its queued entry and the reason for termination written as JSON lines.
+BOOST_AUTO_TEST_CASE ( log_crash_handler_tests__json_lines )
+{
+    auto log_file = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("ign-crash-%%%%-%%%%.jsonl");
+    int status = run_crashing_child(log_file, false, false, false, "jsonl");
+
+    BOOST_CHECK(WIFSIGNALED(status) && WTERMSIG(status) == SIGABRT);
+
+    std::string content = read_crash_log(log_file);
+    BOOST_CHECK(content.find("\"message\":\"buffered entry 4 <escaped>\"") != std::string::npos);
+    BOOST_CHECK(boost::regex_search(content, boost::regex(
+            "\n\\{\"timestamp\":\"[0-9]{4}-[0-9]{2}-[0-9]{2}T[0-9]{2}:[0-9]{2}:[0-9]{2}\\.[0-9]{6}Z\",\"level\":\"information\","
+            "\"ns\":\"inglenook\\.logging\\.test\",\"message\":\"queued entry\",\"data\":\\{\"test\\.key\":\"test value\"\\}\\}\n"
+            "\\{\"timestamp\":\"[^\"]+\",\"level\":\"fatal\",\"ns\":\"inglenook\\.logging\\.crash\","
+            "\"message\":\"Process terminated by SIGABRT\\.\",\"data\":\\{\"signal\":\"6\"\\}\\}\n$")));
+    boost::filesystem::remove(log_file);
+}
+
+//
+// log_crash_handler_tests__logfmt
+// checks a writer formatting logfmt has its queued entry and the reason for termination written as logfmt lines.
+BOOST_AUTO_TEST_CASE ( log_crash_handler_tests__logfmt )
+{
+    auto log_file = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("ign-crash-%%%%-%%%%.log");
+    int status = run_crashing_child(log_file, false, false, false, "logfmt");
+
+    BOOST_CHECK(WIFSIGNALED(status) && WTERMSIG(status) == SIGABRT);
+
+    std::string content = read_crash_log(log_file);
+    BOOST_CHECK(content.find("msg=\"buffered entry 4 <escaped>\"") != std::string::npos);
+    BOOST_CHECK(boost::regex_search(content, boost::regex(
+            "\nts=[0-9]{4}-[0-9]{2}-[0-9]{2}T[0-9]{2}:[0-9]{2}:[0-9]{2}\\.[0-9]{6}Z level=information "
+            "ns=inglenook\\.logging\\.test msg=\"queued entry\" test\\.key=\"test value\"\n"
+            "ts=[^ ]+ level=fatal ns=inglenook\\.logging\\.crash msg=\"Process terminated by SIGABRT\\.\" signal=6\n$")));
+    boost::filesystem::remove(log_file);
+}
+
+//
+// log_crash_handler_tests__mapped_file
+// checks a writer through a memory mapped file has its file cut to the entries already written, before the
+// reason for termination is added, when the process aborts. (the serializer may be part way through the queued
+// entry as the handler runs, a moment that is too short to catch with the other writers, so it isn't looked for.)
+BOOST_AUTO_TEST_CASE ( log_crash_handler_tests__mapped_file )
+{
+    auto log_file = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("ign-crash-%%%%-%%%%.xml");
+    int status = run_crashing_child(log_file, false, true);
+
+    BOOST_CHECK(WIFSIGNALED(status) && WTERMSIG(status) == SIGABRT);
+
+    std::string content = read_crash_log(log_file);
+    BOOST_CHECK(content.find('\0') == std::string::npos);
+    BOOST_CHECK(content.find("<?xml") == 0);
+    BOOST_CHECK(content.find("buffered entry 4 &lt;escaped&gt;") != std::string::npos);
+    BOOST_CHECK(boost::regex_search(content, boost::regex(
+            "<message><!\\[CDATA\\[Process terminated by SIGABRT\\.\\]\\]></message><extended-data><item key=\"signal\">"
+            "<!\\[CDATA\\[6\\]\\]></item></extended-data></log-entry></log-entries></inglenook-log-file>$")));
+    boost::filesystem::remove(log_file);
+}
+
+//
+// log_crash_handler_tests__mapped_file_busy
+// checks the mapped file is fenced off from a serializer still writing in to it as the process aborts (the handler
+// swaps the window for anonymous memory, see log_crash_handler::_emergency_flush()): the file is cut to the entries
+// written (the last, too large for the window, is lost whole), followed by the reason for termination, and the
+// serializer isn't faulted by the file shrinking under it.
+BOOST_AUTO_TEST_CASE ( log_crash_handler_tests__mapped_file_busy )
+{
+    auto log_file = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("ign-crash-%%%%-%%%%.xml");
+    for(int attempt = 0; attempt < 5; attempt++)
+    {
+        int status = run_crashing_child(log_file, false, true, true);
+        BOOST_CHECK(WIFSIGNALED(status) && WTERMSIG(status) == SIGABRT);
+
+        std::string content = read_crash_log(log_file);
+        BOOST_CHECK(content.find('\0') == std::string::npos);
+        BOOST_CHECK(content.find("busy entry 0 ") != std::string::npos);
+        BOOST_CHECK(boost::regex_search(content, boost::regex(
+                "</message></log-entry><log-entry [^>]+><message><!\\[CDATA\\[Process terminated by SIGABRT\\.\\]\\]>"
+                "</message><extended-data><item key=\"signal\"><!\\[CDATA\\[6\\]\\]></item></extended-data></log-entry>"
+                "</log-entries></inglenook-log-file>$")));
+        boost::filesystem::remove(log_file);
+    }
+}
+
+} // namespace inglenook::logging
+
+} // namespace inglenook
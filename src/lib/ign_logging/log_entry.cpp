@@ -155,6 +155,12 @@ void log_entry::extended_data(const std::string& key, const std::string& value)
             m_extended.erase(iterator);
         }
     }
+
+    // a key holds one value, so any typed value it had is replaced (or removed) too.
+    if(!m_fields.empty())
+    {
+        m_fields.erase(key);
+    }
 }
 
 /**
@@ -168,6 +174,165 @@ const std::map<std::string, std::string>& log_entry::extended_data()
     return m_extended;
 }
 
+/**
+ * Adds or amends typed extended data associated with the entry.
+ * Numbers, flags and times are held as they are given, rather than converted to text, and are only rendered by
+ * whatever writes the entry out (binary records keep them as they are). Text values are simply added as extended
+ * data (see extended_data()). A key holds one value; any value it held before, typed or not, is replaced.
+ * @param key data element identifier.
+ * @param value data element value (empty text will attempt to remove an existing key).
+ */
+void log_entry::field(const std::string& key, const log_field& value)
+{
+    if(value.type() == field_string)
+    {
+        extended_data(key, value.string_value());
+        return;
+    }
+
+    m_fields[key] = value;
+    m_extended.erase(key);
+}
+
+/**
+ * Gets the typed extended data associated with the entry (text values are held as extended data).
+ * @returns entries typed extended data.
+ */
+const std::map<std::string, log_field>& log_entry::fields() const
+{
+    return m_fields;
+}
+
+/**
+ * Attaches a binary payload to the entry. The payload isn't copied (see log_attachment), and is only encoded by
+ * whichever sink writes the entry out.
+ * @param value the attachment.
+ */
+void log_entry::attachment(const log_attachment& value)
+{
+    m_attachments.push_back(value);
+}
+
+/**
+ * Gets the binary payloads attached to the entry.
+ * @returns the attachments, in the order they were attached.
+ */
+const std::vector<log_attachment>& log_entry::attachments() const
+{
+    return m_attachments;
+}
+
+/**
+ * Replaces the binary payloads attached to the entry.
+ * @param value the attachments.
+ */
+void log_entry::attachments(const std::vector<log_attachment>& value)
+{
+    m_attachments = value;
+}
+
+/**
+ * Gets the diagnostic context the entry was logged in. The context is shared with the other entries logged in it;
+ * its pairs are written out along with the entry's extended data (see context_hidden()).
+ * @returns the context, or nullptr if there was none.
+ */
+const std::shared_ptr<const log_context>& log_entry::context() const
+{
+    return m_context;
+}
+
+/**
+ * Sets the diagnostic context the entry was logged in.
+ * @param value the context (shared, not copied).
+ */
+void log_entry::context(const std::shared_ptr<const log_context>& value)
+{
+    m_context = value;
+}
+
+/**
+ * Indicates if a pair of the entry's context is left out when the entry is written, as a pair with the same key was
+ * added to the context since, or the entry has data of its own with the key. Nothing is allocated, so this is safe
+ * to use from the crash handler.
+ * @param item a pair of the entry's context.
+ * @returns true if the pair is replaced.
+ */
+bool log_entry::context_hidden(const log_context& item) const
+{
+    return item.hidden_by(m_context.get()) || m_extended.count(item.key()) > 0 || m_fields.count(item.key()) > 0;
+}
+
+/**
+ * Gets the call site the entry was logged from. Only a pointer to the call site's location is held (see LOG_HERE),
+ * its text is left to whichever sink writes the entry out.
+ * @returns the call site, or nullptr if it isn't known.
+ */
+const log_source_location* log_entry::source() const
+{
+    return m_source;
+}
+
+/**
+ * Sets the call site the entry was logged from.
+ * @param value the call site (which must outlive the entry, see LOG_HERE and log_source_location::intern()).
+ */
+void log_entry::source(const log_source_location* value)
+{
+    m_source = value;
+}
+
+/**
+ * Gets the time the entry was made.
+ * Entries are usually stamped by log_writer as they are written; this is only set when the entry was made
+ * somewhere else, such as another process submitting entries through the logging service daemon.
+ * @returns time the entry was made (UTC), or not_a_date_time if it has not been set.
+ */
+const boost::posix_time::ptime& log_entry::timestamp() const
+{
+    return m_timestamp;
+}
+
+/**
+ * Sets the time the entry was made.
+ * @param value time the entry was made (UTC).
+ */
+void log_entry::timestamp(const boost::posix_time::ptime& value)
+{
+    m_timestamp = value;
+}
+
+/**
+ * Gets the thread that logged the entry.
+ * log_writer::add_entry() records the thread an entry is logged from (unless it has already been set), the thread
+ * isn't written out with the entry. It is used to tell apart identical entries logged by different threads.
+ * @returns thread that logged the entry, or a default constructed id if it has not been set.
+ */
+const std::thread::id& log_entry::thread() const
+{
+    return m_thread;
+}
+
+/**
+ * Sets the thread that logged the entry.
+ * @param value thread that logged the entry.
+ */
+void log_entry::thread(const std::thread::id& value)
+{
+    m_thread = value;
+}
+
+/**
+ * Gets the entries queued along with this one.
+ * log_writer::add_entries() queues a group of entries as its first entry, carrying the rest here, so the group takes
+ * a single place in the serialization queue and is written without other entries coming between its members. The
+ * group isn't written out with the entry (each member carries log_writer::GROUP_KEY instead).
+ * @returns entries to write straight after this one (empty unless this entry leads a group).
+ */
+std::vector<std::shared_ptr<log_entry>>& log_entry::group()
+{
+    return m_group;
+}
+
 } // namespace inglenook::logging
 
 } // namespace inglenook
@@ -20,6 +20,18 @@
 // standard library includes
 #include <string>
 #include <map>
+#include <thread>
+#include <vector>
+#include <memory>
+
+// boost (http://boost.org) includes
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+
+// inglenook includes
+#include "log_field.h"
+#include "log_attachment.h"
+#include "log_source.h"
+#include "log_context.h"
 
 namespace inglenook
 {
@@ -87,6 +99,51 @@ class log_entry
         /// get the data records from the log.
         const std::map<std::string, std::string>& extended_data();
 
+        // add a typed data entry to the log (text is added as extended data).
+        void field(const std::string& key, const log_field& value);
+
+        /// get the typed data records from the log (other than text, see extended_data()).
+        const std::map<std::string, log_field>& fields() const;
+
+        /// attaches a binary payload to the entry.
+        void attachment(const log_attachment& value);
+
+        /// gets the binary payloads attached to the entry.
+        const std::vector<log_attachment>& attachments() const;
+
+        /// replaces the binary payloads attached to the entry.
+        void attachments(const std::vector<log_attachment>& value);
+
+        /// gets the diagnostic context the entry was logged in (nullptr if there was none).
+        const std::shared_ptr<const log_context>& context() const;
+
+        /// sets the diagnostic context the entry was logged in (shared, see log_client::push_context()).
+        void context(const std::shared_ptr<const log_context>& value);
+
+        // indicates if a pair of the entry's context is replaced by a newer pair or the entry's own data.
+        bool context_hidden(const log_context& item) const;
+
+        /// gets the call site the entry was logged from (nullptr if it isn't known).
+        const log_source_location* source() const;
+
+        /// sets the call site the entry was logged from (see LOG_HERE).
+        void source(const log_source_location* value);
+
+        /// gets the time the entry was made (not_a_date_time if the writer should use the time it is written).
+        const boost::posix_time::ptime& timestamp() const;
+
+        /// sets the time the entry was made (UTC).
+        void timestamp(const boost::posix_time::ptime& value);
+
+        /// gets the thread that logged the entry (a default id if it hasn't been passed to a log_writer yet).
+        const std::thread::id& thread() const;
+
+        /// sets the thread that logged the entry.
+        void thread(const std::thread::id& value);
+
+        /// gets the entries queued along with this one, to be written straight after it (see log_writer::add_entries()).
+        std::vector<std::shared_ptr<log_entry>>& group();
+
     private:
 
         /// internal variable for category.
@@ -100,6 +157,27 @@ class log_entry
 
         /// buffer for extended data.
         std::map<std::string, std::string> m_extended;
+
+        /// buffer for typed extended data.
+        std::map<std::string, log_field> m_fields;
+
+        /// binary payloads attached to the entry.
+        std::vector<log_attachment> m_attachments;
+
+        /// diagnostic context the entry was logged in.
+        std::shared_ptr<const log_context> m_context;
+
+        /// call site the entry was logged from.
+        const log_source_location* m_source = nullptr;
+
+        /// time the entry was made.
+        boost::posix_time::ptime m_timestamp;
+
+        /// thread that logged the entry.
+        std::thread::id m_thread;
+
+        /// entries queued along with this one.
+        std::vector<std::shared_ptr<log_entry>> m_group;
 };
 
 } // namespace inglenook::logging
@@ -31,7 +31,9 @@ namespace logging
 */
 log_entry_buffered::log_entry_buffered()
     : log_entry(),
-    m_message_buffer()
+    m_message_buffer(),
+    m_suppressed(false),
+    m_namespace_limit_checked(false)
 {
     // Nothing to do here at the moment.
 }
@@ -88,6 +90,57 @@ void log_entry_buffered::message(const std::string& value)
     log_entry::message(value);
 }
 
+/**
+ * Indicates the entry has been suppressed by a log_limit. Suppressed entries are discarded by the log_client
+ * rather than being passed to the writer, and nothing more is formatted in to them.
+ * @returns true if the entry has been suppressed.
+ */
+bool log_entry_buffered::suppressed() const
+{
+    return m_suppressed;
+}
+
+/**
+ * Sets if the entry has been suppressed by a log_limit.
+ * @param value new property value.
+ */
+void log_entry_buffered::suppressed(const bool& value)
+{
+    m_suppressed = value;
+}
+
+/**
+ * Indicates the entry has been checked against the namespace limits (this is done once per entry, before
+ * anything is formatted in to the message, see log_client::limit_namespace()).
+ * @returns true if the entry has been checked.
+ */
+bool log_entry_buffered::namespace_limit_checked() const
+{
+    return m_namespace_limit_checked;
+}
+
+/**
+ * Sets if the entry has been checked against the namespace limits.
+ * @param value new property value.
+ */
+void log_entry_buffered::namespace_limit_checked(const bool& value)
+{
+    m_namespace_limit_checked = value;
+}
+
+/**
+ * Empties the entry so it can be reused, as if it had just been created. This lets log_client discard suppressed
+ * entries without allocating a new one.
+ */
+void log_entry_buffered::reset()
+{
+    log_entry::operator=(log_entry());
+    m_message_buffer.clear();
+    m_message_buffer.str(std::string());
+    m_suppressed = false;
+    m_namespace_limit_checked = false;
+}
+
 
 } // namespace inglenook::logging
 
@@ -54,11 +54,32 @@ class log_entry_buffered: public log_entry
         /// sets the log message
         virtual void message(const std::string& value) override;
 
+        /// indicates the entry has been suppressed by a log_limit (it will be discarded rather than logged).
+        bool suppressed() const;
+
+        /// sets if the entry has been suppressed by a log_limit.
+        void suppressed(const bool& value);
+
+        /// indicates the entry has been checked against the namespace limits (see log_client::limit_namespace()).
+        bool namespace_limit_checked() const;
+
+        /// sets if the entry has been checked against the namespace limits.
+        void namespace_limit_checked(const bool& value);
+
+        // empties the entry so it can be reused.
+        void reset();
+
     private:
 
         /// log message content buffer
         std::stringstream m_message_buffer;
 
+        /// the entry has been suppressed by a log_limit.
+        bool m_suppressed;
+
+        /// the entry has been checked against the namespace limits.
+        bool m_namespace_limit_checked;
+
 };
 
 } // namespace inglenook::logging
@@ -19,6 +19,11 @@
 
 // standard library includes
 #include <string>
+#include <vector>
+#include <utility>
+
+// inglenook includes
+#include "log_field.h"
 
 namespace inglenook
 {
@@ -107,6 +112,82 @@ class log_data
 
 };
 
+/**
+ * Adds typed extended data to the log (see kv()).
+ */
+class log_fields
+{
+
+    public:
+
+        /**
+         * Adds a typed data item.
+         * @param key key for the data item.
+         * @param value value of the data item.
+         * @return this set of items.
+         */
+        log_fields& add(const std::string& key, const log_field& value)
+        {
+            m_fields.push_back(std::make_pair(key, value));
+            return *this;
+        }
+
+        /**
+         * Data items to add.
+         * @return key and value of each item, in the order they were given.
+         */
+        const std::vector<std::pair<std::string, log_field>>& fields() const
+        {
+            return m_fields;
+        }
+
+    private:
+
+        /// the data items to add.
+        std::vector<std::pair<std::string, log_field>> m_fields;
+
+};
+
+/**
+ * Ends the list of key and value pairs given to kv().
+ * @param fields data items added so far.
+ */
+inline void kv_add(log_fields&)
+{
+}
+
+/**
+ * Adds the next key and value pair given to kv().
+ * @param fields data items added so far.
+ * @param key key for the data item.
+ * @param value value of the data item (anything a log_field can hold).
+ * @param more further key and value pairs.
+ */
+template <typename value_type, typename... more_types>
+inline void kv_add(log_fields& fields, const std::string& key, const value_type& value, const more_types&... more)
+{
+    fields.add(key, log_field(value));
+    kv_add(fields, more...);
+}
+
+/**
+ * Adds typed extended data to the log. Numbers, flags and times are held as they are rather than converted to
+ * text (see log_entry::field()), so attaching them costs no more than copying them.
+ *
+ *     log_info() << "signal lost" << kv("rssi", -71, "snr", 3.5, "link.up", false) << lf::end;
+ *
+ * @param pairs key and value pairs.
+ * @return the data items to add.
+ */
+template <typename... pair_types>
+inline log_fields kv(const pair_types&... pairs)
+{
+    static_assert(sizeof...(pairs) % 2 == 0, "kv() takes key and value pairs.");
+    log_fields fields;
+    kv_add(fields, pairs...);
+    return fields;
+}
+
 } // namespace inglenook::logging
 
 } // namespace inglenook
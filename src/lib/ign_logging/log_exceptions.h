@@ -49,6 +49,15 @@ const unsigned long unable_to_aquire_shutdown_lock = module_error_base + 0x03;
 /// used by the serialization thread when it cannot acquire ownership of its notification mechanism lock.
 const unsigned long unable_to_aquire_queue_notification_lock = module_error_base + 0x04;
 
+/// a log ring could not be created, sized or mapped in log_ring::create().
+const unsigned long log_exception_ring_create = module_error_base + 0x05;
+
+/// a log ring could not be opened or mapped, or is not a log ring, in log_ring::open().
+const unsigned long log_exception_ring_open = module_error_base + 0x06;
+
+/// the logging service daemon could not be connected to in log_socket::connect().
+const unsigned long log_exception_socket_connect = module_error_base + 0x07;
+
 /// log file that was being written to (or attempted writing to) at time of exception.
 typedef boost::error_info<struct __log_file_name, boost::filesystem::path> log_file_name;
 
@@ -99,6 +108,28 @@ struct log_serialization_exception : virtual log_exception
     }
 };
 
+/**
+ * Thrown when a shared memory log ring (log_ring) cannot be created or opened.
+ */
+struct log_ring_exception : virtual log_exception
+{
+    /// provides a boiler plate explanation of the exception.
+    const char* what() const throw() {
+       return boost::locale::translate("Failed to create or open the log ring.").str().c_str();
+    }
+};
+
+/**
+ * Thrown when a connection to the logging service daemon (log_socket) cannot be made.
+ */
+struct log_socket_exception : virtual log_exception
+{
+    /// provides a boiler plate explanation of the exception.
+    const char* what() const throw() {
+       return boost::locale::translate("Failed to connect to the logging service.").str().c_str();
+    }
+};
+
 } // namespace inglenook::logging
 
 } // namespace inglenook
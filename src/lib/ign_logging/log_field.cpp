@@ -0,0 +1,434 @@
+/*
+ * log_field.cpp: Typed values for structured log entry fields.
+ * Copyright (C) 2012, Project Inglenook (http://www.project-inglenook.co.uk)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// inglenook includes
+#include "log_field.h"
+
+// standard library includes
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+// boost (http://boost.org) includes
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/algorithm/string/replace.hpp>
+
+namespace inglenook
+{
+
+namespace logging
+{
+
+//--------------------------------------------------------//
+// Hide the implementation in the anonymous namespace.
+namespace
+{
+
+    /// the unix epoch, time fields are held relative to this.
+    const boost::posix_time::ptime epoch(boost::gregorian::date(1970, 1, 1));
+
+    /// names of the field types (indexed by field_type).
+    const char* const TYPE_NAMES[] = { "string", "int64", "uint64", "double", "bool", "timestamp" };
+
+    /**
+     * Parses a whole string as a number.
+     * @param text text to parse.
+     * @param parse function parsing the number (strtoll() and friends), returning where it stopped.
+     * @param value [output] the number.
+     * @returns true if all of the text was a number.
+     */
+    template <typename number_type, typename parse_type>
+    bool parse_number(const std::string& text, parse_type parse, number_type& value)
+    {
+        if(text.empty())
+        {
+            return false;
+        }
+        char* end = nullptr;
+        value = parse(text.c_str(), &end);
+        return end == text.c_str() + text.length();
+    }
+
+}
+//--------------------------------------------------------//
+
+/**
+ * Creates an empty text field.
+ */
+log_field::log_field() :
+    m_type(field_string),
+    m_uint64(0)
+{
+}
+
+/**
+ * Creates a text field.
+ * @param value text to hold.
+ */
+log_field::log_field(const std::string& value) :
+    m_type(field_string),
+    m_uint64(0),
+    m_string(value)
+{
+}
+
+/**
+ * Creates a text field.
+ * @param value text to hold.
+ */
+log_field::log_field(const char* value) :
+    m_type(field_string),
+    m_uint64(0),
+    m_string(value == nullptr ? "" : value)
+{
+}
+
+/**
+ * Creates a signed integer field.
+ * @param value number to hold.
+ */
+log_field::log_field(int value) :
+    m_type(field_int64),
+    m_int64(value)
+{
+}
+
+/**
+ * Creates a signed integer field.
+ * @param value number to hold.
+ */
+log_field::log_field(long value) :
+    m_type(field_int64),
+    m_int64(value)
+{
+}
+
+/**
+ * Creates a signed integer field.
+ * @param value number to hold.
+ */
+log_field::log_field(long long value) :
+    m_type(field_int64),
+    m_int64(value)
+{
+}
+
+/**
+ * Creates an unsigned integer field.
+ * @param value number to hold.
+ */
+log_field::log_field(unsigned int value) :
+    m_type(field_uint64),
+    m_uint64(value)
+{
+}
+
+/**
+ * Creates an unsigned integer field.
+ * @param value number to hold.
+ */
+log_field::log_field(unsigned long value) :
+    m_type(field_uint64),
+    m_uint64(value)
+{
+}
+
+/**
+ * Creates an unsigned integer field.
+ * @param value number to hold.
+ */
+log_field::log_field(unsigned long long value) :
+    m_type(field_uint64),
+    m_uint64(value)
+{
+}
+
+/**
+ * Creates a floating point field.
+ * @param value number to hold.
+ */
+log_field::log_field(float value) :
+    m_type(field_double),
+    m_double(value)
+{
+}
+
+/**
+ * Creates a floating point field.
+ * @param value number to hold.
+ */
+log_field::log_field(double value) :
+    m_type(field_double),
+    m_double(value)
+{
+}
+
+/**
+ * Creates a boolean field.
+ * @param value flag to hold.
+ */
+log_field::log_field(bool value) :
+    m_type(field_bool),
+    m_uint64(0)
+{
+    m_bool = value;
+}
+
+/**
+ * Creates a time field. Times are held to the microsecond; special values (such as not_a_date_time) are held as
+ * the unix epoch.
+ * @param value time to hold (UTC).
+ */
+log_field::log_field(const boost::posix_time::ptime& value) :
+    m_type(field_timestamp),
+    m_int64(value.is_special() ? 0 : (value - epoch).total_microseconds())
+{
+}
+
+/**
+ * Gets the type of value held.
+ * @returns the field type.
+ */
+field_type log_field::type() const
+{
+    return m_type;
+}
+
+/**
+ * Gets the value of a signed integer field.
+ * @returns the value (undefined if the field holds another type).
+ */
+std::int64_t log_field::int64_value() const
+{
+    return m_int64;
+}
+
+/**
+ * Gets the value of an unsigned integer field.
+ * @returns the value (undefined if the field holds another type).
+ */
+std::uint64_t log_field::uint64_value() const
+{
+    return m_uint64;
+}
+
+/**
+ * Gets the value of a floating point field.
+ * @returns the value (undefined if the field holds another type).
+ */
+double log_field::double_value() const
+{
+    return m_double;
+}
+
+/**
+ * Gets the value of a boolean field.
+ * @returns the value (undefined if the field holds another type).
+ */
+bool log_field::bool_value() const
+{
+    return m_bool;
+}
+
+/**
+ * Gets the value of a time field.
+ * @returns the time (UTC, undefined if the field holds another type).
+ */
+boost::posix_time::ptime log_field::timestamp_value() const
+{
+    return epoch + boost::posix_time::microseconds(m_int64);
+}
+
+/**
+ * Gets the value of a text field.
+ * @returns the text (empty if the field holds another type).
+ */
+const std::string& log_field::string_value() const
+{
+    return m_string;
+}
+
+/**
+ * Gets the bits of the value, so that it can be held in a binary record without conversion.
+ * @returns the bits of the value (0 for text fields).
+ */
+std::uint64_t log_field::bits() const
+{
+    if(m_type == field_bool)
+    {
+        return m_bool ? 1 : 0;
+    }
+    return m_type == field_string ? 0 : m_uint64;
+}
+
+/**
+ * Renders the value as text. Integers are written in full, floating point numbers with as few digits as will read
+ * back as the same number, booleans as "true" or "false" and times in ISO 8601 format (as log entry timestamps are).
+ * @returns the value as text.
+ */
+std::string log_field::to_string() const
+{
+    switch(m_type)
+    {
+        case field_int64:
+            return std::to_string(m_int64);
+
+        case field_uint64:
+            return std::to_string(m_uint64);
+
+        case field_double:
+        {
+            // the shortest of the usual precisions that reads back as the same number.
+            char text[32];
+            std::snprintf(text, sizeof(text), "%.15g", m_double);
+            if(std::strtod(text, nullptr) != m_double)
+            {
+                std::snprintf(text, sizeof(text), "%.17g", m_double);
+            }
+            return text;
+        }
+
+        case field_bool:
+            return m_bool ? "true" : "false";
+
+        case field_timestamp:
+            return boost::posix_time::to_iso_extended_string(timestamp_value()) + "Z";
+
+        default:
+            return m_string;
+    }
+}
+
+/**
+ * Gets the name of the type held, as used by the type attribute of extended data items.
+ * @returns name of the type ("string", "int64", "uint64", "double", "bool" or "timestamp").
+ */
+const char* log_field::type_name() const
+{
+    return TYPE_NAMES[m_type <= field_timestamp ? m_type : field_string];
+}
+
+/**
+ * Creates a field from its type and bits (see bits()).
+ * @param type type of the field.
+ * @param bits bits of the value.
+ * @param field [output] the field.
+ * @returns true if the type is known (and not text, which has no bits).
+ */
+bool log_field::from_bits(const field_type& type, const std::uint64_t& bits, log_field& field)
+{
+    if(type == field_string || type > field_timestamp)
+    {
+        return false;
+    }
+    field = log_field();
+    field.m_type = type;
+    field.m_uint64 = bits;
+    if(type == field_bool)
+    {
+        field.m_bool = bits != 0;
+    }
+    return true;
+}
+
+/**
+ * Creates a field from its type name and text, as written by log_writer (see type_name() and to_string()).
+ * @param type_name name of the type.
+ * @param text value as text.
+ * @param field [output] the field.
+ * @returns true if the type is known and the text is a valid value of the type.
+ */
+bool log_field::from_string(const std::string& type_name, const std::string& text, log_field& field)
+{
+    try
+    {
+        if(type_name == TYPE_NAMES[field_string])
+        {
+            field = log_field(text);
+            return true;
+        }
+        if(type_name == TYPE_NAMES[field_int64])
+        {
+            long long value;
+            if(parse_number(text, [](const char* start, char** end) { return std::strtoll(start, end, 10); }, value))
+            {
+                field = log_field(value);
+                return true;
+            }
+        }
+        else if(type_name == TYPE_NAMES[field_uint64])
+        {
+            unsigned long long value;
+            if(text[0] != '-' &&
+               parse_number(text, [](const char* start, char** end) { return std::strtoull(start, end, 10); }, value))
+            {
+                field = log_field(value);
+                return true;
+            }
+        }
+        else if(type_name == TYPE_NAMES[field_double])
+        {
+            double value;
+            if(parse_number(text, [](const char* start, char** end) { return std::strtod(start, end); }, value))
+            {
+                field = log_field(value);
+                return true;
+            }
+        }
+        else if(type_name == TYPE_NAMES[field_bool])
+        {
+            if(text == "true" || text == "false")
+            {
+                field = log_field(text == "true");
+                return true;
+            }
+        }
+        else if(type_name == TYPE_NAMES[field_timestamp])
+        {
+            std::string time = text;
+            boost::replace_all(time, "T", " ");
+            boost::replace_all(time, "Z", "");
+            auto value = boost::posix_time::time_from_string(time);
+            if(!value.is_special())
+            {
+                field = log_field(value);
+                return true;
+            }
+        }
+    }
+    catch(std::exception&)
+    {
+        // (not a valid time.)
+    }
+    return false;
+}
+
+/**
+ * Compares two fields. Fields are equal if they hold the same type and value.
+ * @param other field to compare with.
+ * @returns true if the fields are equal.
+ */
+bool log_field::operator==(const log_field& other) const
+{
+    return m_type == other.m_type &&
+           (m_type == field_string ? m_string == other.m_string : bits() == other.bits());
+}
+
+} // namespace inglenook::logging
+
+} // namespace inglenook
@@ -0,0 +1,154 @@
+#pragma once
+/*
+ * log_field.h: Typed values for structured log entry fields.
+ * Copyright (C) 2012, Project Inglenook (http://www.project-inglenook.co.uk)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// standard library includes
+#include <string>
+#include <cstdint>
+
+// boost (http://boost.org) includes
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+
+namespace inglenook
+{
+
+namespace logging
+{
+
+/**
+ * Log field types
+ * The type of value held by a log_field. The values are used in binary records, so must not change.
+ */
+enum field_type : unsigned int
+{
+    field_string    = 0x00,  /**< Text (held as extended data, see log_entry::field()). */
+    field_int64     = 0x01,  /**< Signed 64 bit integer. */
+    field_uint64    = 0x02,  /**< Unsigned 64 bit integer. */
+    field_double    = 0x03,  /**< Double precision floating point number. */
+    field_bool      = 0x04,  /**< Boolean. */
+    field_timestamp = 0x05   /**< Time (UTC, to the microsecond). */
+};
+
+/**
+ * The log_field class holds a typed value for a structured log entry field (see log_entry::field() and kv()).
+ * Values are held as they were given, and only rendered as text by whichever sink writes them out.
+ */
+class log_field
+{
+
+    public:
+
+        /// creates an empty text field.
+        log_field();
+
+        /// creates a text field.
+        log_field(const std::string& value);
+
+        /// creates a text field.
+        log_field(const char* value);
+
+        /// creates a signed integer field.
+        log_field(int value);
+
+        /// creates a signed integer field.
+        log_field(long value);
+
+        /// creates a signed integer field.
+        log_field(long long value);
+
+        /// creates an unsigned integer field.
+        log_field(unsigned int value);
+
+        /// creates an unsigned integer field.
+        log_field(unsigned long value);
+
+        /// creates an unsigned integer field.
+        log_field(unsigned long long value);
+
+        /// creates a floating point field.
+        log_field(float value);
+
+        /// creates a floating point field.
+        log_field(double value);
+
+        /// creates a boolean field.
+        log_field(bool value);
+
+        /// creates a time field.
+        log_field(const boost::posix_time::ptime& value);
+
+        /// gets the type of value held.
+        field_type type() const;
+
+        /// gets the value of a field_int64 field.
+        std::int64_t int64_value() const;
+
+        /// gets the value of a field_uint64 field.
+        std::uint64_t uint64_value() const;
+
+        /// gets the value of a field_double field.
+        double double_value() const;
+
+        /// gets the value of a field_bool field.
+        bool bool_value() const;
+
+        // gets the value of a field_timestamp field.
+        boost::posix_time::ptime timestamp_value() const;
+
+        /// gets the value of a field_string field.
+        const std::string& string_value() const;
+
+        /// gets the value's bits (for binary records, see log_record; 0 for text fields).
+        std::uint64_t bits() const;
+
+        // renders the value as text.
+        std::string to_string() const;
+
+        // gets the name of the type held (as used by the type attribute of extended data items).
+        const char* type_name() const;
+
+        // creates a field from its bits (see bits()).
+        static bool from_bits(const field_type& type, const std::uint64_t& bits, log_field& field);
+
+        // creates a field from its type name and text (see type_name() and to_string()).
+        static bool from_string(const std::string& type_name, const std::string& text, log_field& field);
+
+        // compares two fields.
+        bool operator==(const log_field& other) const;
+
+    private:
+
+        /// type of value held.
+        field_type m_type;
+
+        /// the value (timestamps are held as microseconds since the unix epoch).
+        union
+        {
+            std::int64_t m_int64;
+            std::uint64_t m_uint64;
+            double m_double;
+            bool m_bool;
+        };
+
+        /// the value of a text field.
+        std::string m_string;
+};
+
+} // namespace inglenook::logging
+
+} // namespace inglenook
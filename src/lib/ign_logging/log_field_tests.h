@@ -0,0 +1,140 @@
+#pragma once
+/*
+* log_field_tests.h: Test routines for the log_field class (log_field.cpp/h)
+* Copyright (C) 2012, Project Inglenook (http://www.project-inglenook.co.uk)
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE LOG_TEST_NAME
+
+// standard includes
+#include <sstream>
+#include <vector>
+#include <limits>
+
+// boost (http://boost.org) includes
+#include <boost/test/unit_test.hpp>
+
+// inglenook includes
+#include "log_field.h"
+#include "log_record.h"
+#include "log_client.h"
+#include "log_file_reader.h"
+
+namespace inglenook
+{
+
+namespace logging
+{
+
+//
+// log_field_tests__values
+// checks each type of value is held as given, rendered as text, and read back from
+// that text (and its bits) as the same value.
+BOOST_AUTO_TEST_CASE ( log_field_tests__values )
+{
+    const auto time = boost::posix_time::ptime(boost::gregorian::date(2012, 12, 21), boost::posix_time::microseconds(123456));
+    const std::vector<log_field> values = { log_field(-71), log_field(std::numeric_limits<long long>::min()),
+            log_field(42u), log_field(std::numeric_limits<unsigned long long>::max()), log_field(0.1), log_field(-2.5f),
+            log_field(1e300), log_field(true), log_field(false), log_field(time), log_field("text") };
+    const std::vector<std::string> text = { "-71", "-9223372036854775808", "42", "18446744073709551615", "0.1", "-2.5",
+            "1e+300", "true", "false", "2012-12-21T00:00:00.123456Z", "text" };
+    const std::vector<field_type> types = { field_int64, field_int64, field_uint64, field_uint64, field_double,
+            field_double, field_double, field_bool, field_bool, field_timestamp, field_string };
+
+    for(std::size_t i = 0; i < values.size(); i++)
+    {
+        BOOST_CHECK(values[i].type() == types[i]);
+        BOOST_CHECK(values[i].to_string() == text[i]);
+
+        log_field parsed;
+        BOOST_CHECK(log_field::from_string(values[i].type_name(), text[i], parsed));
+        BOOST_CHECK(parsed == values[i]);
+        if(types[i] != field_string)
+        {
+            log_field unpacked;
+            BOOST_CHECK(log_field::from_bits(types[i], values[i].bits(), unpacked));
+            BOOST_CHECK(unpacked == values[i]);
+        }
+    }
+    BOOST_CHECK(values[0].int64_value() == -71);
+    BOOST_CHECK(values[3].uint64_value() == std::numeric_limits<unsigned long long>::max());
+    BOOST_CHECK(values[4].double_value() == 0.1);
+    BOOST_CHECK(values[7].bool_value());
+    BOOST_CHECK(values[9].timestamp_value() == time);
+
+    // text that isn't a value of the type is refused.
+    log_field parsed;
+    BOOST_CHECK(!log_field::from_string("int64", "12abc", parsed));
+    BOOST_CHECK(!log_field::from_string("uint64", "-1", parsed));
+    BOOST_CHECK(!log_field::from_string("double", "", parsed));
+    BOOST_CHECK(!log_field::from_string("bool", "yes", parsed));
+    BOOST_CHECK(!log_field::from_string("timestamp", "yesterday", parsed));
+    BOOST_CHECK(!log_field::from_string("complex", "1+2i", parsed));
+}
+
+//
+// log_field_tests__entries
+// checks typed data added with kv() keeps its type through binary records and log files,
+// and that a key holds one value whether typed or not.
+BOOST_AUTO_TEST_CASE ( log_field_tests__entries )
+{
+    log_entry entry;
+    entry.field("test.rssi", -71);
+    entry.extended_data("test.snr", "high");
+    entry.field("test.snr", 3.5);
+    entry.field("test.name", "text");
+    BOOST_CHECK(entry.fields().size() == 2);
+    BOOST_CHECK(entry.extended_data().size() == 1);
+    entry.extended_data("test.rssi", "");
+    BOOST_CHECK(entry.fields().size() == 1);
+
+    // binary records keep values as they are.
+    entry.entry_type(category::warning);
+    entry.log_namespace("inglenook.logging.test");
+    entry.message("record");
+    entry.field("test.up", false);
+    std::vector<char> buffer(log_record::encoded_size(entry));
+    BOOST_REQUIRE(log_record::encode(entry, buffer.data(), buffer.size()) == buffer.size());
+    auto decoded = log_record::decode(buffer.data(), buffer.size());
+    BOOST_REQUIRE(decoded != nullptr);
+    BOOST_CHECK(decoded->fields() == entry.fields());
+    BOOST_CHECK(decoded->extended_data().at("test.name") == "text");
+
+    // log files mark values with their type, and the reader restores it.
+    auto xml = std::shared_ptr<std::stringstream>(new std::stringstream());
+    {
+        auto writer = log_writer::create_from_stream(xml, false, false);
+        writer->console_threshold(category::no_log);
+        log_client client(writer);
+        client.info() << "signal lost" << kv("test.rssi", -71, "test.snr", 3.5, "test.up", false, "test.name", "<markup>")
+                      << lf::end;
+    }
+    BOOST_CHECK(xml->str().find("<item key=\"test.rssi\" type=\"int64\"><![CDATA[-71]]></item>") != std::string::npos);
+
+    log_file_reader reader(xml);
+    auto read_entry = reader.next_entry();
+    BOOST_REQUIRE(read_entry != nullptr);
+    BOOST_REQUIRE(read_entry->fields().size() == 3);
+    BOOST_CHECK(read_entry->fields().at("test.rssi") == log_field(-71));
+    BOOST_CHECK(read_entry->fields().at("test.snr") == log_field(3.5));
+    BOOST_CHECK(read_entry->fields().at("test.up") == log_field(false));
+    BOOST_CHECK(read_entry->extended_data().at("test.name") == "<markup>");
+}
+
+} // namespace inglenook::logging
+
+} // namespace inglenook
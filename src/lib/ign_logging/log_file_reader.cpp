@@ -0,0 +1,335 @@
+/*
+ * log_file_reader.cpp: Reads log entries back out of Inglenook log files.
+ * Copyright (C) 2012, Project Inglenook (http://www.project-inglenook.co.uk)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// inglenook includes
+#include "log_file_reader.h"
+#include "log_exceptions.h"
+
+// standard library includes
+#include <fstream>
+
+// boost (http://boost.org) includes
+#include <boost/algorithm/string/replace.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+namespace inglenook
+{
+
+namespace logging
+{
+
+//--------------------------------------------------------//
+// Hide the implementation in the anonymous namespace.
+namespace
+{
+
+    /// start of every entry.
+    const std::string ENTRY_OPEN = "<log-entry ";
+
+    /// end of every entry.
+    const std::string ENTRY_CLOSE = "</log-entry>";
+
+    /**
+     * Finds the text between two markers.
+     * @param text text to search.
+     * @param start marker the value follows.
+     * @param end marker the value is followed by.
+     * @param position [in/out] where to start searching, moved past the end marker if the value is found.
+     * @param value [output] the text between the markers.
+     * @returns true if the value was found.
+     */
+    bool find_between(const std::string& text, const std::string& start, const std::string& end,
+            std::size_t& position, std::string& value)
+    {
+        std::size_t value_start = text.find(start, position);
+        if(value_start == std::string::npos)
+        {
+            return false;
+        }
+        value_start += start.length();
+
+        std::size_t value_end = text.find(end, value_start);
+        if(value_end == std::string::npos)
+        {
+            return false;
+        }
+
+        value = text.substr(value_start, value_end - value_start);
+        position = value_end + end.length();
+        return true;
+    }
+
+    /**
+     * Reverses the sanitizing log_writer applies to messages and extended data values.
+     * @param value value to restore.
+     * @returns value as it was logged.
+     */
+    std::string unsanitize(std::string value)
+    {
+        boost::replace_all(value, "&lt;", "<");
+        boost::replace_all(value, "&gt;", ">");
+        return value;
+    }
+
+}
+//--------------------------------------------------------//
+
+/**
+ * Creates a new log_file_reader reading from the specified stream.
+ * @param input_stream stream to read entries from.
+ */
+log_file_reader::log_file_reader(const std::shared_ptr<std::istream>& input_stream) :
+    m_input_stream(input_stream),
+    m_position(0),
+    m_malformed_entries(0)
+{
+}
+
+/**
+ * Creates a new log_file_reader reading from the specified file.
+ * @param input_file log file to read.
+ * @returns new reader.
+ * @throws log_not_found_exception if the file can't be opened.
+ */
+std::shared_ptr<log_file_reader> log_file_reader::create_from_file_path(const boost::filesystem::path& input_file)
+{
+    auto input_stream = std::shared_ptr<std::istream>(new std::ifstream(input_file.native(), std::ios::in | std::ios::binary));
+    if(input_stream->fail())
+    {
+        using namespace inglenook::core::exceptions;
+        BOOST_THROW_EXCEPTION(log_not_found_exception()
+                << inglenook_error_number(log_exception_bad_file_path)
+                << log_file_name(input_file));
+    }
+
+    return std::shared_ptr<log_file_reader>(new log_file_reader(input_stream));
+}
+
+/**
+ * Reads the next entry. Anything between entries (the header, footer and so on) is skipped over.
+ * Entries keep the time they were logged at, the time the writer stamped them with if they weren't given one.
+ * @returns next entry, or nullptr once the end of the input has been reached.
+ */
+std::shared_ptr<log_entry> log_file_reader::next_entry()
+{
+    while(true)
+    {
+        // find the start of the next entry...
+        std::size_t entry_start = m_buffer.find(ENTRY_OPEN, m_position);
+        if(entry_start == std::string::npos)
+        {
+            // (keeping enough to spot an entry split between reads.)
+            m_position = std::max(m_position, m_buffer.length() - std::min(m_buffer.length(), ENTRY_OPEN.length() - 1));
+            if(!_fill())
+            {
+                return nullptr;
+            }
+            continue;
+        }
+
+        // ... and where it ends.
+        std::size_t entry_end = m_buffer.find(ENTRY_CLOSE, entry_start);
+        if(entry_end == std::string::npos)
+        {
+            m_position = entry_start;
+            if(!_fill())
+            {
+                // the input ends part way through an entry (perhaps it is still being written).
+                m_malformed_entries++;
+                m_position = m_buffer.length();
+                return nullptr;
+            }
+            continue;
+        }
+        entry_end += ENTRY_CLOSE.length();
+        m_position = entry_end;
+
+        auto entry = _parse(m_buffer.substr(entry_start, entry_end - entry_start));
+        if(entry != nullptr)
+        {
+            return entry;
+        }
+        m_malformed_entries++;
+    }
+}
+
+/**
+ * Gets the number of entries skipped because they couldn't be understood (including one cut short by the end of
+ * the input).
+ * @returns number of entries skipped.
+ */
+std::uint64_t log_file_reader::malformed_entries() const
+{
+    return m_malformed_entries;
+}
+
+/**
+ * Reads more of the input in to the buffer, discarding what has already been parsed.
+ * @returns true if anything was read.
+ */
+bool log_file_reader::_fill()
+{
+    m_buffer.erase(0, m_position);
+    m_position = 0;
+
+    if(!m_input_stream->good())
+    {
+        return false;
+    }
+
+    std::size_t buffered = m_buffer.length();
+    m_buffer.resize(buffered + READ_SIZE);
+    m_input_stream->read(&m_buffer[buffered], READ_SIZE);
+    m_buffer.resize(buffered + m_input_stream->gcount());
+    return m_buffer.length() > buffered;
+}
+
+/**
+ * Builds an entry from a <log-entry> element, as written by log_writer::_log_serialization_worker_serialize().
+ * @param element the element, from <log-entry to </log-entry>.
+ * @returns the entry, or nullptr if the element couldn't be understood.
+ */
+std::shared_ptr<log_entry> log_file_reader::_parse(const std::string& element) const
+{
+    auto entry = std::shared_ptr<log_entry>(new log_entry());
+
+    // the attributes...
+    std::size_t tag_end = element.find('>');
+    if(tag_end == std::string::npos)
+    {
+        return nullptr;
+    }
+    std::string tag = element.substr(0, tag_end);
+    std::string timestamp, severity, log_namespace;
+    std::size_t timestamp_position = 0, severity_position = 0, namespace_position = 0;
+    if(!find_between(tag, " timestamp=\"", "\"", timestamp_position, timestamp) ||
+       !find_between(tag, " severity=\"", "\"", severity_position, severity) ||
+       !find_between(tag, " ns=\"", "\"", namespace_position, log_namespace))
+    {
+        return nullptr;
+    }
+
+    try
+    {
+        // (stored as 2012-12-21T00:00:00.000000Z)
+        boost::replace_all(timestamp, "T", " ");
+        boost::replace_all(timestamp, "Z", "");
+        entry->timestamp(boost::posix_time::time_from_string(timestamp));
+
+        unsigned long entry_type = std::stoul(severity);
+        if(entry_type > category::fatal)
+        {
+            return nullptr;
+        }
+        entry->entry_type(static_cast<category>(entry_type));
+    }
+    catch(std::exception&)
+    {
+        return nullptr;
+    }
+    if(entry->timestamp().is_special())
+    {
+        return nullptr;
+    }
+    entry->log_namespace(log_namespace);
+
+    // ... the message ...
+    std::string message;
+    std::size_t position = tag_end;
+    if(!find_between(element, "<message><![CDATA[", "]]></message>", position, message))
+    {
+        return nullptr;
+    }
+    entry->message(unsanitize(message));
+
+    // ... the call site (if it was recorded), held once however many entries were logged from it ...
+    std::string file, line, function;
+    std::size_t source_position = position;
+    if(find_between(element, "<source file=\"", "\" line=\"", source_position, file) &&
+       find_between(element, "", "\" function=\"", source_position, line) &&
+       find_between(element, "", "\"/>", source_position, function))
+    {
+        try
+        {
+            boost::replace_all(file, "&quot;", "\"");
+            boost::replace_all(function, "&quot;", "\"");
+            entry->source(log_source_location::intern(unsanitize(file), std::stoul(line), unsanitize(function)));
+            position = source_position;
+        }
+        catch(std::exception&)
+        {
+            // (the call site is left out.)
+        }
+    }
+
+    // ... and any extended data (typed values are restored to their type, or kept as text if not understood).
+    std::string key, value;
+    while(find_between(element, "<item key=\"", "\"><![CDATA[", position, key) &&
+          find_between(element, "", "]]></item>", position, value))
+    {
+        const std::string TYPE_ATTRIBUTE = "\" type=\"";
+        std::size_t type_start = key.find(TYPE_ATTRIBUTE);
+        log_field field;
+        if(type_start != std::string::npos &&
+           log_field::from_string(key.substr(type_start + TYPE_ATTRIBUTE.length()), unsanitize(value), field))
+        {
+            entry->field(key.substr(0, type_start), field);
+        }
+        else
+        {
+            entry->extended_data(key.substr(0, type_start), unsanitize(value));
+        }
+    }
+
+    // ... and any attachments (kept truncated if they were written so, with the size attached).
+    std::string attributes, text;
+    while(find_between(element, "<attachment name=\"", "\">", position, attributes) &&
+          find_between(element, "", "</attachment>", position, text))
+    {
+        const std::string ENCODING_ATTRIBUTE = "\" encoding=\"";
+        const std::string SIZE_ATTRIBUTE = "\" size=\"";
+        std::size_t encoding_start = attributes.find(ENCODING_ATTRIBUTE);
+        std::size_t size_start = attributes.find(SIZE_ATTRIBUTE);
+        if(encoding_start == std::string::npos || size_start == std::string::npos || size_start < encoding_start)
+        {
+            continue;
+        }
+
+        log_attachment attachment;
+        std::string encoding = attributes.substr(encoding_start + ENCODING_ATTRIBUTE.length(),
+                size_start - encoding_start - ENCODING_ATTRIBUTE.length());
+        if(log_attachment::from_string(attributes.substr(0, encoding_start), encoding, text, attachment))
+        {
+            try
+            {
+                attachment.size(std::stoull(attributes.substr(size_start + SIZE_ATTRIBUTE.length())));
+            }
+            catch(std::exception&)
+            {
+                // (the size is what was read.)
+            }
+            entry->attachment(attachment);
+        }
+    }
+
+    return entry;
+}
+
+} // namespace inglenook::logging
+
+} // namespace inglenook
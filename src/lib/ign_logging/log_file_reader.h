@@ -0,0 +1,93 @@
+#pragma once
+/*
+ * log_file_reader.h: Reads log entries back out of Inglenook log files.
+ * Copyright (C) 2012, Project Inglenook (http://www.project-inglenook.co.uk)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// standard library includes
+#include <memory>
+#include <string>
+#include <istream>
+#include <cstdint>
+
+// boost (http://boost.org) includes
+#include <boost/filesystem.hpp>
+
+// inglenook includes
+#include "log_entry.h"
+
+namespace inglenook
+{
+
+namespace logging
+{
+
+/**
+ * The log_file_reader class reads log entries back out of a log file written by log_writer (see
+ * inglenook-log-file.xsd). Entries are read one at a time, so files of any size can be read, and files with
+ * no header or footer (for example those several processes have appended to) are read as well as complete ones.
+ * Entries that can't be understood are skipped and counted (see malformed_entries()).
+ */
+class log_file_reader
+{
+
+    public:
+
+        /// there is no default constructor for the log_file_reader.
+        log_file_reader() = delete;
+
+        /// there is no copy constructor for the log_file_reader.
+        log_file_reader(const log_file_reader&) = delete;
+
+        // creates a new log_file_reader reading from the specified stream.
+        explicit log_file_reader(const std::shared_ptr<std::istream>& input_stream);
+
+        // creates a new log_file_reader reading from the specified file.
+        static std::shared_ptr<log_file_reader> create_from_file_path(const boost::filesystem::path& input_file);
+
+        // reads the next entry.
+        std::shared_ptr<log_entry> next_entry();
+
+        /// gets the number of entries skipped because they couldn't be understood.
+        std::uint64_t malformed_entries() const;
+
+    private:
+
+        // reads more of the input in to the buffer.
+        bool _fill();
+
+        // builds an entry from a <log-entry> element.
+        std::shared_ptr<log_entry> _parse(const std::string& element) const;
+
+        /// amount of input read at a time.
+        static const std::size_t READ_SIZE = 65536;
+
+        /// stream entries are read from.
+        std::shared_ptr<std::istream> m_input_stream;
+
+        /// input read but not yet parsed (from m_position onwards).
+        std::string m_buffer;
+
+        /// position in m_buffer parsing has reached.
+        std::size_t m_position;
+
+        /// number of entries skipped.
+        std::uint64_t m_malformed_entries;
+};
+
+} // namespace inglenook::logging
+
+} // namespace inglenook
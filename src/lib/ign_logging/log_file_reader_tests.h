@@ -0,0 +1,132 @@
+#pragma once
+/*
+* log_file_reader_tests.h: Test routines for the log_file_reader class (log_file_reader.cpp/h)
+* Copyright (C) 2012, Project Inglenook (http://www.project-inglenook.co.uk)
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE LOG_TEST_NAME
+
+// standard includes
+#include <sstream>
+
+// boost (http://boost.org) includes
+#include <boost/test/unit_test.hpp>
+
+// inglenook includes
+#include "log_file_reader.h"
+#include "log_writer.h"
+#include "log_exceptions.h"
+
+namespace inglenook
+{
+
+namespace logging
+{
+
+//
+// log_file_reader_tests__round_trip
+// checks entries written by a log_writer are read back as they were logged, in order,
+// including entries that straddle the reader's reads.
+BOOST_AUTO_TEST_CASE ( log_file_reader_tests__round_trip )
+{
+    const int ENTRY_COUNT = 2000;
+    const auto first_timestamp = boost::posix_time::ptime(boost::gregorian::date(2012, 12, 21),
+            boost::posix_time::microseconds(123456));
+
+    auto xml = std::shared_ptr<std::stringstream>(new std::stringstream());
+    {
+        auto writer = log_writer::create_from_stream(xml, true, true);
+        writer->console_threshold(category::no_log);
+        writer->xml_threshold(category::debugging);
+        for(int i = 0; i < ENTRY_COUNT; i++)
+        {
+            auto entry = std::shared_ptr<log_entry>(new log_entry());
+            entry->entry_type(static_cast<category>(category::debugging + i % 6));
+            entry->log_namespace("inglenook.logging.test");
+            entry->message("entry " + std::to_string(i) + " <with markup> & an ampersand");
+            entry->timestamp(first_timestamp + boost::posix_time::milliseconds(i));
+            if(i % 3 == 0)
+            {
+                entry->extended_data("test.number", std::to_string(i));
+                entry->extended_data("test.markup", "<item>");
+            }
+            BOOST_REQUIRE(writer->add_entry(entry));
+        }
+    }
+    BOOST_REQUIRE(xml->str().length() > 65536 * 2);
+
+    log_file_reader reader(xml);
+    for(int i = 0; i < ENTRY_COUNT; i++)
+    {
+        auto entry = reader.next_entry();
+        BOOST_REQUIRE(entry != nullptr);
+        BOOST_CHECK(entry->entry_type() == static_cast<category>(category::debugging + i % 6));
+        BOOST_CHECK(entry->log_namespace() == "inglenook.logging.test");
+        BOOST_CHECK(entry->message() == "entry " + std::to_string(i) + " <with markup> & an ampersand");
+        BOOST_CHECK(entry->timestamp() == first_timestamp + boost::posix_time::milliseconds(i));
+        if(i % 3 == 0)
+        {
+            BOOST_REQUIRE(entry->extended_data().size() == 2);
+            BOOST_CHECK(entry->extended_data().at("test.number") == std::to_string(i));
+            BOOST_CHECK(entry->extended_data().at("test.markup") == "<item>");
+        }
+        else
+        {
+            BOOST_CHECK(entry->extended_data().empty());
+        }
+    }
+    BOOST_CHECK(reader.next_entry() == nullptr);
+    BOOST_CHECK(reader.next_entry() == nullptr);
+    BOOST_CHECK(reader.malformed_entries() == 0);
+}
+
+//
+// log_file_reader_tests__malformed
+// checks entries that can't be understood (or are cut short) are skipped and counted, and
+// that entries in files without a header or footer are still read.
+BOOST_AUTO_TEST_CASE ( log_file_reader_tests__malformed )
+{
+    const std::string good_entry = "<log-entry timestamp=\"2012-12-21T00:00:00Z\" severity=\"4\" ns=\"inglenook.test\">"
+            "<message><![CDATA[good]]></message></log-entry>";
+
+    auto input = std::shared_ptr<std::stringstream>(new std::stringstream());
+    *input << "left over from an earlier write</log-entry>"
+           << "<log-entry timestamp=\"yesterday\" severity=\"4\" ns=\"inglenook.test\"><message><![CDATA[bad time]]></message></log-entry>"
+           << "<log-entry timestamp=\"2012-12-21T00:00:00Z\" severity=\"42\" ns=\"inglenook.test\"><message><![CDATA[bad category]]></message></log-entry>"
+           << "<log-entry timestamp=\"2012-12-21T00:00:00Z\" severity=\"4\" ns=\"inglenook.test\"></log-entry>"
+           << good_entry
+           << "<log-entry timestamp=\"2012-12-21T00:00:00Z\" severity=\"4\" ns=\"inglenook.test\"><message><![CDATA[cut sh";
+
+    log_file_reader reader(input);
+    auto entry = reader.next_entry();
+    BOOST_REQUIRE(entry != nullptr);
+    BOOST_CHECK(entry->entry_type() == category::warning);
+    BOOST_CHECK(entry->log_namespace() == "inglenook.test");
+    BOOST_CHECK(entry->message() == "good");
+    BOOST_CHECK(entry->timestamp() == boost::posix_time::ptime(boost::gregorian::date(2012, 12, 21)));
+    BOOST_CHECK(reader.malformed_entries() == 3);
+
+    BOOST_CHECK(reader.next_entry() == nullptr);
+    BOOST_CHECK(reader.malformed_entries() == 4);
+
+    // files that can't be opened are reported.
+    BOOST_CHECK_THROW(log_file_reader::create_from_file_path("/this/file/does/not/exist.xml"), log_not_found_exception);
+}
+
+} // namespace inglenook::logging
+
+} // namespace inglenook
@@ -0,0 +1,557 @@
+/*
+ * log_file_stream.cpp: File backed output stream used by log_writer for log files.
+ * Copyright (C) 2012, Project Inglenook (http://www.project-inglenook.co.uk)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// inglenook includes
+#include "log_file_stream.h"
+
+// standard library includes
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+// platform includes
+#include <fcntl.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+namespace inglenook
+{
+
+namespace logging
+{
+
+const std::size_t log_file_buffer::ASYNC_BUFFER_SIZE;
+
+/**
+ * The submission and completion rings shared with the kernel by an asynchronous log_file_buffer, and the two batches
+ * it alternates between. The rings are driven with the raw system calls (there is no dependency on liburing); only
+ * the thread filling the buffer submits and reaps, so the only ordering needed is with the kernel.
+ */
+struct log_file_ring
+{
+    /// closes the ring and releases its mappings.
+    ~log_file_ring()
+    {
+        if(sqes != MAP_FAILED)
+        {
+            munmap(sqes, sqes_size);
+        }
+        if(cq_map != MAP_FAILED && cq_map != sq_map)
+        {
+            munmap(cq_map, cq_map_size);
+        }
+        if(sq_map != MAP_FAILED)
+        {
+            munmap(sq_map, sq_map_size);
+        }
+        if(descriptor >= 0)
+        {
+            ::close(descriptor);
+        }
+    }
+
+    /// descriptor of the ring.
+    int descriptor = -1;
+
+    /// mapping of the submission ring (and of the completion ring, where the kernel maps both together).
+    void* sq_map = MAP_FAILED;
+    std::size_t sq_map_size = 0;
+
+    /// mapping of the completion ring.
+    void* cq_map = MAP_FAILED;
+    std::size_t cq_map_size = 0;
+
+    /// mapping of the submission queue entries.
+    void* sqes = MAP_FAILED;
+    std::size_t sqes_size = 0;
+
+    /// fields of the submission ring.
+    unsigned* sq_tail = nullptr;
+    unsigned* sq_mask = nullptr;
+    unsigned* sq_array = nullptr;
+
+    /// fields of the completion ring.
+    unsigned* cq_head = nullptr;
+    unsigned* cq_tail = nullptr;
+    unsigned* cq_mask = nullptr;
+    io_uring_cqe* cqes = nullptr;
+
+    /// the two batches, one filled whilst the other is written.
+    std::unique_ptr<char[]> batches[2];
+
+    /// index of the batch being filled.
+    int filling = 0;
+
+    /// the batch being written.
+    const char* written_data = nullptr;
+    std::size_t written_length = 0;
+
+    /// number of completions still to come.
+    unsigned outstanding = 0;
+
+    /// set if a write or sync has failed since the last time the writes were completed.
+    bool failed = false;
+};
+
+//--------------------------------------------------------//
+// Hide the implementation in the anonymous namespace.
+namespace
+{
+
+    /// number of entries in each ring (a batch and its sync, at most, are ever in flight).
+    const unsigned RING_ENTRIES = 4;
+
+    /// completion tag of a batch being written.
+    const std::uint64_t RING_WRITE = 1;
+
+    /// completion tag of a sync following a batch.
+    const std::uint64_t RING_SYNC = 2;
+
+    /**
+     * Enters the ring, submitting entries and/or waiting on completions.
+     * @param ring ring to enter.
+     * @param submit number of entries to submit.
+     * @param wait number of completions to wait for.
+     * @returns number of entries submitted, or -1 on failure (errno is set).
+     */
+    int ring_enter(const log_file_ring& ring, const unsigned& submit, const unsigned& wait)
+    {
+        int result;
+        do
+        {
+            result = static_cast<int>(syscall(__NR_io_uring_enter, ring.descriptor, submit, wait,
+                    wait > 0 ? IORING_ENTER_GETEVENTS : 0, nullptr, 0));
+        }
+        while(result < 0 && errno == EINTR);
+        return result;
+    }
+
+    /**
+     * Sets up a ring and the batches that go with it.
+     * @param batch_size size of each batch.
+     * @returns the ring, or nullptr if io_uring is unavailable (or can't append to a file at its current position).
+     */
+    std::unique_ptr<log_file_ring> create_ring(const std::size_t& batch_size)
+    {
+        io_uring_params parameters;
+        std::memset(&parameters, 0, sizeof(parameters));
+
+        std::unique_ptr<log_file_ring> ring(new log_file_ring());
+        ring->descriptor = static_cast<int>(syscall(__NR_io_uring_setup, RING_ENTRIES, &parameters));
+        if(ring->descriptor < 0 || !(parameters.features & IORING_FEAT_RW_CUR_POS))
+        {
+            return nullptr;
+        }
+
+        // map the rings (together, if the kernel allows it) and the submission queue entries.
+        ring->sq_map_size = parameters.sq_off.array + parameters.sq_entries * sizeof(unsigned);
+        ring->cq_map_size = parameters.cq_off.cqes + parameters.cq_entries * sizeof(io_uring_cqe);
+        if(parameters.features & IORING_FEAT_SINGLE_MMAP)
+        {
+            ring->sq_map_size = std::max(ring->sq_map_size, ring->cq_map_size);
+        }
+        ring->sq_map = mmap(nullptr, ring->sq_map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                ring->descriptor, IORING_OFF_SQ_RING);
+        if(ring->sq_map == MAP_FAILED)
+        {
+            return nullptr;
+        }
+        ring->cq_map = (parameters.features & IORING_FEAT_SINGLE_MMAP) ? ring->sq_map :
+                mmap(nullptr, ring->cq_map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                ring->descriptor, IORING_OFF_CQ_RING);
+        ring->sqes_size = parameters.sq_entries * sizeof(io_uring_sqe);
+        ring->sqes = mmap(nullptr, ring->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                ring->descriptor, IORING_OFF_SQES);
+        if(ring->cq_map == MAP_FAILED || ring->sqes == MAP_FAILED)
+        {
+            return nullptr;
+        }
+
+        char* sq = static_cast<char*>(ring->sq_map);
+        ring->sq_tail = reinterpret_cast<unsigned*>(sq + parameters.sq_off.tail);
+        ring->sq_mask = reinterpret_cast<unsigned*>(sq + parameters.sq_off.ring_mask);
+        ring->sq_array = reinterpret_cast<unsigned*>(sq + parameters.sq_off.array);
+        char* cq = static_cast<char*>(ring->cq_map);
+        ring->cq_head = reinterpret_cast<unsigned*>(cq + parameters.cq_off.head);
+        ring->cq_tail = reinterpret_cast<unsigned*>(cq + parameters.cq_off.tail);
+        ring->cq_mask = reinterpret_cast<unsigned*>(cq + parameters.cq_off.ring_mask);
+        ring->cqes = reinterpret_cast<io_uring_cqe*>(cq + parameters.cq_off.cqes);
+
+        ring->batches[0].reset(new char[batch_size]);
+        ring->batches[1].reset(new char[batch_size]);
+        return ring;
+    }
+
+    /**
+     * Queues an entry on the submission ring (it is submitted by the next ring_enter()).
+     * @param ring ring to queue the entry on.
+     * @param queued number of entries already queued since the last submission.
+     * @returns the entry, cleared, for the caller to fill in.
+     */
+    io_uring_sqe* ring_queue(log_file_ring& ring, const unsigned& queued)
+    {
+        unsigned tail = *ring.sq_tail + queued;
+        unsigned index = tail & *ring.sq_mask;
+        io_uring_sqe* entry = static_cast<io_uring_sqe*>(ring.sqes) + index;
+        std::memset(entry, 0, sizeof(*entry));
+        ring.sq_array[index] = index;
+        return entry;
+    }
+
+}
+//--------------------------------------------------------//
+
+/**
+ * Creates a closed buffer; open() must be called before any output is written.
+ */
+log_file_buffer::log_file_buffer()
+    : m_descriptor(-1)
+{
+    setp(m_buffer, m_buffer + BUFFER_SIZE);
+}
+
+/**
+ * Flushes any remaining output and closes the file.
+ */
+log_file_buffer::~log_file_buffer()
+{
+    close();
+}
+
+/**
+ * Opens the specified file for appending, creating it if it does not exist.
+ * @param file_path path of the file to append to.
+ * @param asynchronous if set, writes are handed to io_uring where it is available (see asynchronous()).
+ * @returns true if the file was opened.
+ */
+bool log_file_buffer::open(const std::string& file_path, const bool& asynchronous)
+{
+    // only one file per buffer.
+    if(is_open())
+    {
+        return false;
+    }
+
+    m_descriptor = ::open(file_path.c_str(), O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+
+    // fill the first batch, unless we are left writing synchronously.
+    if(is_open() && asynchronous)
+    {
+        m_ring = create_ring(ASYNC_BUFFER_SIZE);
+        if(m_ring != nullptr)
+        {
+            setp(m_ring->batches[0].get(), m_ring->batches[0].get() + ASYNC_BUFFER_SIZE);
+        }
+    }
+    return is_open();
+}
+
+/**
+ * Flushes any remaining output and closes the file, once the writes handed to io_uring have finished. Does nothing
+ * if no file is open.
+ */
+void log_file_buffer::close()
+{
+    if(is_open())
+    {
+        sync();
+        complete_writes();
+        setp(m_buffer, m_buffer + BUFFER_SIZE);
+        m_ring.reset();
+        ::close(m_descriptor);
+        m_descriptor = -1;
+    }
+}
+
+/**
+ * Waits for the batch handed to io_uring (and the sync following it, if any) to finish. A batch the kernel only
+ * wrote part of is finished off synchronously. Returns straight away if the buffer isn't asynchronous.
+ * @returns true if everything handed over since the last call was written (and synced).
+ */
+bool log_file_buffer::complete_writes()
+{
+    if(m_ring == nullptr)
+    {
+        return true;
+    }
+
+    log_file_ring& ring = *m_ring;
+    while(ring.outstanding > 0)
+    {
+        // take whatever has completed...
+        unsigned head = *ring.cq_head;
+        unsigned tail = __atomic_load_n(ring.cq_tail, __ATOMIC_ACQUIRE);
+        for(; head != tail; head++)
+        {
+            const io_uring_cqe& completion = ring.cqes[head & *ring.cq_mask];
+            if(completion.user_data == RING_WRITE)
+            {
+                // (a short write ends the link, so a sync queued behind it is cancelled and done here instead.)
+                std::size_t written = completion.res > 0 ? static_cast<std::size_t>(completion.res) : 0;
+                if(completion.res < 0 && completion.res != -EAGAIN)
+                {
+                    ring.failed = true;
+                }
+                else if(written < ring.written_length)
+                {
+                    ring.failed = !write_fully(ring.written_data + written, ring.written_length - written) || ring.failed;
+                }
+            }
+            else if(completion.user_data == RING_SYNC && completion.res < 0)
+            {
+                ring.failed = (completion.res != -ECANCELED || fsync(m_descriptor) != 0) || ring.failed;
+            }
+            ring.outstanding--;
+        }
+        __atomic_store_n(ring.cq_head, head, __ATOMIC_RELEASE);
+
+        // ... and wait for the rest.
+        if(ring.outstanding > 0 && ring_enter(ring, 0, ring.outstanding) < 0)
+        {
+            ring.failed = true;
+            break;
+        }
+    }
+
+    bool written = !ring.failed;
+    ring.failed = false;
+    return written;
+}
+
+/**
+ * Writes the buffer and waits for the file's data (and metadata) to reach the disk. An asynchronous buffer hands the
+ * sync to io_uring along with the buffer, linked so that it only runs once the buffer has been written.
+ * @returns true on success.
+ */
+bool log_file_buffer::synchronize()
+{
+    if(!is_open())
+    {
+        return false;
+    }
+    if(m_ring != nullptr)
+    {
+        return submit_batch(true) && complete_writes();
+    }
+    return sync() == 0 && fsync(m_descriptor) == 0;
+}
+
+/**
+ * Waits for the batch handed to io_uring to finish, leaving the completion for complete_writes() to take. Only
+ * system calls are made, so this is safe from a signal handler (see log_crash_handler).
+ */
+void log_file_buffer::await_writes() const
+{
+    if(m_ring != nullptr && m_ring->outstanding > 0)
+    {
+        ring_enter(*m_ring, 0, m_ring->outstanding);
+    }
+}
+
+/**
+ * Writes the buffer to the file, making room for more output.
+ * @param character character to append after the buffer is written (or eof).
+ * @returns eof on failure, otherwise something other than eof.
+ */
+log_file_buffer::int_type log_file_buffer::overflow(int_type character)
+{
+    // empty the buffer...
+    if(sync() != 0)
+    {
+        return traits_type::eof();
+    }
+
+    // ... and store the character that didn't fit.
+    if(!traits_type::eq_int_type(character, traits_type::eof()))
+    {
+        *pptr() = traits_type::to_char_type(character);
+        pbump(1);
+    }
+
+    return traits_type::not_eof(character);
+}
+
+/**
+ * Writes a block of characters.
+ * Blocks that fit are copied in to the buffer whole (the buffer is written out first if required), larger blocks
+ * are written directly to the file, in a single write, once the buffer has been emptied. A block is never split
+ * between the two; log_writer hands over each entry as one block, so entries are never split between writes.
+ * @param data characters to write.
+ * @param count number of characters to write.
+ * @returns number of characters written.
+ */
+std::streamsize log_file_buffer::xsputn(const char_type* data, std::streamsize count)
+{
+    // make room if this block won't fit.
+    if(count > epptr() - pptr() && sync() != 0)
+    {
+        return 0;
+    }
+
+    // copy in to the buffer if it fits...
+    if(count <= epptr() - pptr())
+    {
+        std::memcpy(pptr(), data, count);
+        pbump(count);
+        return count;
+    }
+
+    // ... otherwise bypass it (once the batches before it have been written, if asynchronous).
+    return complete_writes() && write_fully(data, count) ? count : 0;
+}
+
+/**
+ * Writes the buffer to the file. An asynchronous buffer hands it to io_uring instead, and returns once it has.
+ * @returns 0 on success, -1 on failure.
+ */
+int log_file_buffer::sync()
+{
+    // there is nothing we can do without a file.
+    if(!is_open())
+    {
+        return pptr() == pbase() ? 0 : -1;
+    }
+
+    if(m_ring != nullptr)
+    {
+        return submit_batch(false) ? 0 : -1;
+    }
+
+    bool written = write_fully(pbase(), pptr() - pbase());
+    setp(m_buffer, m_buffer + BUFFER_SIZE);
+    return written ? 0 : -1;
+}
+
+/**
+ * Hands the put area to io_uring to be appended to the file, then starts filling the other batch. The batch before
+ * has to have been written first (the two are never in flight together, so they can't land out of order); normally
+ * it has long since finished, having been written whilst this one was filled.
+ * Should io_uring refuse the batch, it is written synchronously instead, and so is everything after it.
+ * @param synchronize if set, a sync of the file is queued to run once the batch is written.
+ * @returns true if the batch was handed over or written (and everything before it was written).
+ */
+bool log_file_buffer::submit_batch(const bool& synchronize)
+{
+    // the other batch is about to be filled, make sure it has been written.
+    bool written = complete_writes();
+
+    std::size_t length = pptr() - pbase();
+    if(length == 0 && !synchronize)
+    {
+        return written;
+    }
+
+    // queue the batch, and the sync after it if asked for...
+    log_file_ring& ring = *m_ring;
+    unsigned queued = 0;
+    if(length > 0)
+    {
+        io_uring_sqe* write = ring_queue(ring, queued++);
+        write->opcode = IORING_OP_WRITE;
+        write->fd = m_descriptor;
+        write->addr = reinterpret_cast<std::uint64_t>(pbase());
+        write->len = static_cast<std::uint32_t>(length);
+        write->off = static_cast<std::uint64_t>(-1);
+        write->flags = synchronize ? IOSQE_IO_LINK : 0;
+        write->user_data = RING_WRITE;
+    }
+    if(synchronize)
+    {
+        // (a full fsync rather than IORING_FSYNC_DATASYNC; a synced flush waits for the metadata too, as it does when
+        // writing synchronously or through a mapped file, see log_writer::flush().)
+        io_uring_sqe* sync = ring_queue(ring, queued++);
+        sync->opcode = IORING_OP_FSYNC;
+        sync->fd = m_descriptor;
+        sync->user_data = RING_SYNC;
+    }
+
+    // ... and hand it over. if the kernel won't have it, the batch is taken back and written here, and the buffer
+    // writes synchronously from then on (as if io_uring had never been available).
+    unsigned tail = *ring.sq_tail;
+    __atomic_store_n(ring.sq_tail, tail + queued, __ATOMIC_RELEASE);
+    if(ring_enter(ring, queued, 0) < 0)
+    {
+        __atomic_store_n(ring.sq_tail, tail, __ATOMIC_RELEASE);
+        written = write_fully(pbase(), length) && (!synchronize || fsync(m_descriptor) == 0) && written;
+        setp(m_buffer, m_buffer + BUFFER_SIZE);
+        m_ring.reset();
+        return written;
+    }
+    ring.outstanding += queued;
+    ring.written_data = pbase();
+    ring.written_length = length;
+
+    // fill the other batch whilst this one is written.
+    ring.filling ^= 1;
+    setp(ring.batches[ring.filling].get(), ring.batches[ring.filling].get() + ASYNC_BUFFER_SIZE);
+    return written;
+}
+
+/**
+ * Writes data to the file in full, retrying partial and interrupted writes.
+ * A write to a file opened for appending lands at the end of the file in one piece, so concurrent appenders cannot
+ * interleave within it. A partial write (the disk is full, or a signal arrived part way through) is the exception;
+ * the remainder is appended by a second write and may land after another process's output.
+ * @param data data to write.
+ * @param length number of bytes to write.
+ * @returns true if all the data was written.
+ */
+bool log_file_buffer::write_fully(const char* data, std::size_t length)
+{
+    while(length > 0)
+    {
+        ssize_t result = ::write(m_descriptor, data, length);
+        if(result < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if(result <= 0)
+        {
+            return false;
+        }
+        data += result;
+        length -= result;
+    }
+    return true;
+}
+
+/**
+ * Opens the specified file for appending.
+ * The fail bit is set on the stream if the file cannot be opened.
+ * @param file_path path of the file to append to.
+ * @param asynchronous if set, writes are handed to io_uring where it is available (see log_file_buffer).
+ */
+log_file_stream::log_file_stream(const std::string& file_path, const bool& asynchronous)
+    : std::ostream(nullptr)
+{
+    // attach the buffer (this clears the bad bit set by the null buffer above).
+    rdbuf(&m_buffer);
+
+    // open the file for appending, flag on failure as std::ofstream would.
+    if(!m_buffer.open(file_path, asynchronous))
+    {
+        setstate(std::ios::failbit);
+    }
+}
+
+} // namespace inglenook::logging
+
+} // namespace inglenook
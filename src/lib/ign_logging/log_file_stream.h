@@ -0,0 +1,160 @@
+#pragma once
+/*
+ * log_file_stream.h: File backed output stream used by log_writer for log files.
+ * Copyright (C) 2012, Project Inglenook (http://www.project-inglenook.co.uk)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// standard library includes
+#include <memory>
+#include <ostream>
+#include <streambuf>
+#include <string>
+
+// platform includes
+#include <limits.h>
+
+namespace inglenook
+{
+
+namespace logging
+{
+
+/// submission and completion rings used by an asynchronous log_file_buffer (see log_file_stream.cpp).
+struct log_file_ring;
+
+/**
+ * Stream buffer appending to a file through a POSIX file descriptor.
+ * Behaves much as std::filebuf opened with std::ios::app, but exposes its descriptor and the bytes which have
+ * been serialized but not yet handed to the operating system. This is used by log_crash_handler to recover
+ * buffered output when the process is terminated; reading the put area neither allocates nor locks so it is safe
+ * from a signal handler. Writes smaller than the buffer are never split between the file and the buffer.
+ * The buffer is PIPE_BUF bytes, so each write handed to the operating system holds only whole blocks (log entries) and
+ * is small enough to be appended atomically; unless a single block is larger, in which case it is written on its own.
+ * This lets several processes append to the same log file at once without their entries interleaving.
+ * A buffer opened asynchronously hands its writes to the kernel through io_uring rather than making them itself, so
+ * whoever is filling it never waits on write(2). It fills one batch (ASYNC_BUFFER_SIZE bytes) whilst the other is
+ * being written, only waiting if the previous batch still hasn't been written when the next is ready. Batches are
+ * larger than PIPE_BUF, so such a file shouldn't be shared with other appenders. Where io_uring isn't available (an
+ * old kernel, or one that has it disabled) the buffer writes synchronously, as it would otherwise.
+ */
+class log_file_buffer : public std::streambuf
+{
+
+    public:
+
+        /// creates a closed buffer.
+        log_file_buffer();
+
+        /// there is no copy constructor for the log_file_buffer (deleted).
+        log_file_buffer(const log_file_buffer&) = delete;
+
+        /// flushes and closes the buffer.
+        virtual ~log_file_buffer();
+
+        // opens the specified file for appending (asynchronously through io_uring, if asked and available).
+        bool open(const std::string& file_path, const bool& asynchronous = false);
+
+        // flushes and closes the file.
+        void close();
+
+        // waits for the writes handed to io_uring to finish (nothing to wait for if not asynchronous).
+        bool complete_writes();
+
+        // writes the buffer and waits for the file to reach the disk (fsync).
+        bool synchronize();
+
+        // waits for the batch being written to finish, without taking its result (safe from a signal handler).
+        void await_writes() const;
+
+        /// indicates if writes are being handed to io_uring.
+        bool asynchronous() const { return m_ring != nullptr; }
+
+        /// indicates if a file is open.
+        bool is_open() const { return m_descriptor >= 0; }
+
+        /// gets the descriptor of the open file (or -1).
+        int descriptor() const { return m_descriptor; }
+
+        /// gets the start of the data that has been buffered but not yet written to the file.
+        const char* pending_data() const { return pbase(); }
+
+        /// gets the number of bytes that have been buffered but not yet written to the file.
+        std::size_t pending_size() const { return pptr() - pbase(); }
+
+    protected:
+
+        // writes the buffer, and the character if one is provided.
+        virtual int_type overflow(int_type character);
+
+        // writes a block of characters.
+        virtual std::streamsize xsputn(const char_type* data, std::streamsize count);
+
+        // writes the buffer to the file.
+        virtual int sync();
+
+    private:
+
+        /// size of the put area.
+        static const std::size_t BUFFER_SIZE = PIPE_BUF;
+
+        /// size of each of the batches written asynchronously.
+        static const std::size_t ASYNC_BUFFER_SIZE = 64 * 1024;
+
+        /// writes the specified data to the file in full.
+        bool write_fully(const char* data, std::size_t length);
+
+        /// hands the put area to io_uring, and fills the other batch whilst it is written.
+        bool submit_batch(const bool& synchronize);
+
+        /// descriptor of the open file.
+        int m_descriptor;
+
+        /// storage for the put area.
+        char m_buffer[BUFFER_SIZE];
+
+        /// rings and batches of an asynchronous buffer (nullptr if writing synchronously).
+        std::unique_ptr<log_file_ring> m_ring;
+
+};
+
+/**
+ * Output stream writing (appending) to a log file through a log_file_buffer.
+ * Behaves as std::ofstream opened with std::ios::app.
+ */
+class log_file_stream : public std::ostream
+{
+
+    public:
+
+        // opens the specified file for appending (asynchronously through io_uring, if asked and available).
+        log_file_stream(const std::string& file_path, const bool& asynchronous = false);
+
+        /// gets the underlying file buffer.
+        const log_file_buffer& file_buffer() const { return m_buffer; }
+
+        /// gets the underlying file buffer.
+        log_file_buffer& file_buffer() { return m_buffer; }
+
+    private:
+
+        /// buffer backing this stream.
+        log_file_buffer m_buffer;
+
+};
+
+} // namespace inglenook::logging
+
+} // namespace inglenook
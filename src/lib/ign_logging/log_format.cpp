@@ -0,0 +1,215 @@
+/*
+ * log_format.cpp: Compile time checked format strings for log messages.
+ * Copyright (C) 2012, Project Inglenook (http://www.project-inglenook.co.uk)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// inglenook includes
+#include "log_format.h"
+
+// standard library includes
+#include <cstdio>
+#include <cstring>
+
+namespace inglenook
+{
+
+namespace logging
+{
+
+/// returned by placeholders() for format strings that aren't valid (see log_format.h).
+constexpr std::size_t log_format::MALFORMED;
+
+//--------------------------------------------------------//
+// Hide the implementation in the anonymous namespace.
+namespace
+{
+
+    /**
+     * Appends an unsigned number.
+     * @param output message to append to.
+     * @param value number to append.
+     * @param hexadecimal set to write the number in hexadecimal (lower case, as std::hex does).
+     */
+    void append_unsigned(std::string& output, std::uint64_t value, const bool& hexadecimal)
+    {
+        const std::uint64_t base = hexadecimal ? 16 : 10;
+        char digits[24];
+        char* start = digits + sizeof(digits);
+        do
+        {
+            *--start = "0123456789abcdef"[value % base];
+            value /= base;
+        }
+        while(value != 0);
+        output.append(start, digits + sizeof(digits) - start);
+    }
+
+    /**
+     * Appends a signed number.
+     * @param output message to append to.
+     * @param value number to append.
+     */
+    void append_signed(std::string& output, const std::int64_t& value)
+    {
+        if(value < 0)
+        {
+            output.push_back('-');
+            append_unsigned(output, 0 - static_cast<std::uint64_t>(value), false);
+        }
+        else
+        {
+            append_unsigned(output, static_cast<std::uint64_t>(value), false);
+        }
+    }
+
+}
+//--------------------------------------------------------//
+
+/**
+ * Appends the argument to a message. Arguments are written as the stream operators would write them to a freshly
+ * created stream (in the classic locale), so messages read the same whichever way they were logged: integers in
+ * decimal, floating point numbers with six significant digits, flags as 1 or 0 and characters as themselves.
+ * @param output message to append to.
+ * @param specifier the type the placeholder expects ('\0' for any). {x} writes integers in hexadecimal (negative
+ *        numbers as std::hex would, as their two's complement at the size given) and {d} writes characters as numbers.
+ */
+void log_format_argument::append(std::string& output, const char& specifier) const
+{
+    switch(m_type)
+    {
+        case signed_integer:
+        case character:
+            if(specifier == 'x')
+            {
+                std::uint64_t mask = m_size >= sizeof(std::uint64_t) ? ~static_cast<std::uint64_t>(0) :
+                        (static_cast<std::uint64_t>(1) << (m_size * 8)) - 1;
+                append_unsigned(output, static_cast<std::uint64_t>(m_signed) & mask, true);
+            }
+            else if(m_type == character && specifier != 'd')
+            {
+                output.push_back(static_cast<char>(m_signed));
+            }
+            else
+            {
+                append_signed(output, m_signed);
+            }
+            break;
+
+        case unsigned_integer:
+        case boolean:
+            append_unsigned(output, m_unsigned, specifier == 'x');
+            break;
+
+        case floating_point:
+        {
+            char number[32];
+            int length = std::snprintf(number, sizeof(number), "%g", m_double);
+            output.append(number, length);
+            break;
+        }
+
+        case long_floating:
+        {
+            char number[48];
+            int length = std::snprintf(number, sizeof(number), "%Lg", m_long_double);
+            output.append(number, length);
+            break;
+        }
+
+        case text:
+            if(m_text != nullptr)
+            {
+                output.append(m_text, m_size > 0 ? m_size : std::strlen(m_text));
+            }
+            break;
+    }
+}
+
+/**
+ * Splits a format string in to the text to copy and the placeholders to replace, so that it need only be parsed once
+ * (log_client::format() does so the first time each format string is used). Escaped braces ({{ and }}) become text.
+ * The format string must be valid (see placeholders()), and outlive the segments.
+ * @param text the format string.
+ * @returns the pieces of the format string, in order.
+ */
+log_format_segments log_format::split(const char* text)
+{
+    log_format_segments segments;
+    const char* run_start = text;
+    const char* position = text;
+    while(*position != '\0')
+    {
+        bool escape = (position[0] == '{' && position[1] == '{') || (position[0] == '}' && position[1] == '}');
+        if(!escape && position[0] != '{')
+        {
+            position++;
+            continue;
+        }
+
+        // close off the text so far (keeping the first of an escaped pair of braces) ...
+        std::size_t length = position - run_start + (escape ? 1 : 0);
+        if(length > 0)
+        {
+            log_format_segment segment = { run_start, length, false, '\0' };
+            segments.push_back(segment);
+        }
+
+        // ... and move past the escape or placeholder.
+        if(escape)
+        {
+            position += 2;
+        }
+        else
+        {
+            std::size_t placeholder = placeholder_length(position);
+            log_format_segment segment = { position, placeholder, true, placeholder == 3 ? position[1] : '\0' };
+            segments.push_back(segment);
+            position += placeholder;
+        }
+        run_start = position;
+    }
+    if(position != run_start)
+    {
+        log_format_segment segment = { run_start, static_cast<std::size_t>(position - run_start), false, '\0' };
+        segments.push_back(segment);
+    }
+    return segments;
+}
+
+/**
+ * Formats a message, appending the text of the format string and each argument in turn.
+ * @param output message to append to.
+ * @param segments the split format string (see split()).
+ * @param arguments an argument for each placeholder.
+ */
+void log_format::format(std::string& output, const log_format_segments& segments, const log_format_argument* arguments)
+{
+    for(auto segment = segments.begin(); segment != segments.end(); segment++)
+    {
+        if(segment->placeholder)
+        {
+            (arguments++)->append(output, segment->specifier);
+        }
+        else
+        {
+            output.append(segment->text, segment->length);
+        }
+    }
+}
+
+} // namespace inglenook::logging
+
+} // namespace inglenook
@@ -0,0 +1,283 @@
+#pragma once
+/*
+ * log_format.h: Compile time checked format strings for log messages.
+ * Copyright (C) 2012, Project Inglenook (http://www.project-inglenook.co.uk)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// standard library includes
+#include <string>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+/**
+ * Declares a format string for log_client::format() (and log_info() etc., see logging.h).
+ * The literal is checked against the arguments it is given when the program is compiled:
+ *
+ *     log_info(FMT("temp={} dev={x}"), temperature, device_id) << lf::end;
+ *
+ * Each {} is replaced by the next argument, written as it would be by the stream operators. A placeholder may
+ * name the type it expects: {d} an integer, {x} an integer (written in hexadecimal), {f} a floating point number or
+ * {s} text. Braces are written with {{ and }}.
+ */
+#define FMT(literal) \
+    ([]() \
+    { \
+        struct format_string : ::inglenook::logging::log_format_string \
+        { \
+            static constexpr const char* text() { return literal; } \
+        }; \
+        return format_string(); \
+    }())
+
+namespace inglenook
+{
+
+namespace logging
+{
+
+/// base of the types declared by FMT() (each format string has a type of its own).
+struct log_format_string
+{
+};
+
+/// a piece of a format string, either text to copy or a placeholder (see log_format::split()).
+struct log_format_segment
+{
+    /// text to copy (not terminated).
+    const char* text;
+
+    /// length of the text.
+    std::size_t length;
+
+    /// set if this is a placeholder rather than text.
+    bool placeholder;
+
+    /// the type the placeholder expects ('\0' for any).
+    char specifier;
+};
+
+/// a format string split in to pieces.
+typedef std::vector<log_format_segment> log_format_segments;
+
+/**
+ * An argument to a format string, held without converting it (or copying text, which must outlive the call).
+ */
+class log_format_argument
+{
+
+    public:
+
+        /// kinds of argument.
+        enum argument_type : unsigned int
+        {
+            signed_integer   = 0x00,
+            unsigned_integer = 0x01,
+            floating_point   = 0x02,
+            long_floating    = 0x03,
+            boolean          = 0x04,
+            character        = 0x05,
+            text             = 0x06
+        };
+
+        /// creates an argument (integers, floating point numbers, flags, characters or text).
+        log_format_argument(short value) : m_type(signed_integer), m_size(sizeof(value)), m_signed(value) {}
+        log_format_argument(int value) : m_type(signed_integer), m_size(sizeof(value)), m_signed(value) {}
+        log_format_argument(long value) : m_type(signed_integer), m_size(sizeof(value)), m_signed(value) {}
+        log_format_argument(long long value) : m_type(signed_integer), m_size(sizeof(value)), m_signed(value) {}
+        log_format_argument(unsigned short value) : m_type(unsigned_integer), m_size(sizeof(value)), m_unsigned(value) {}
+        log_format_argument(unsigned int value) : m_type(unsigned_integer), m_size(sizeof(value)), m_unsigned(value) {}
+        log_format_argument(unsigned long value) : m_type(unsigned_integer), m_size(sizeof(value)), m_unsigned(value) {}
+        log_format_argument(unsigned long long value) : m_type(unsigned_integer), m_size(sizeof(value)), m_unsigned(value) {}
+        log_format_argument(float value) : m_type(floating_point), m_size(sizeof(value)), m_double(value) {}
+        log_format_argument(double value) : m_type(floating_point), m_size(sizeof(value)), m_double(value) {}
+        log_format_argument(long double value) : m_type(long_floating), m_size(sizeof(value)), m_long_double(value) {}
+        log_format_argument(bool value) : m_type(boolean), m_size(sizeof(value)), m_unsigned(value ? 1 : 0) {}
+        log_format_argument(char value) : m_type(character), m_size(sizeof(value)), m_signed(value) {}
+        log_format_argument(signed char value) : m_type(character), m_size(sizeof(value)), m_signed(value) {}
+        log_format_argument(unsigned char value) : m_type(character), m_size(sizeof(value)), m_signed(value) {}
+        log_format_argument(const char* value) : m_type(text), m_size(0), m_text(value) {}
+        log_format_argument(const std::string& value) : m_type(text), m_size(value.length()), m_text(value.data()) {}
+
+        /// gets the kind of argument.
+        argument_type type() const { return m_type; }
+
+        // appends the argument to a message, as the placeholder specifies.
+        void append(std::string& output, const char& specifier) const;
+
+    private:
+
+        /// kind of argument.
+        argument_type m_type;
+
+        /// size of the argument as given (bytes), or the length of std::string text.
+        std::size_t m_size;
+
+        /// the argument.
+        union
+        {
+            std::int64_t m_signed;
+            std::uint64_t m_unsigned;
+            double m_double;
+            long double m_long_double;
+            const char* m_text;
+        };
+};
+
+/**
+ * The log_format class checks format strings at compile time and formats messages from them at run time, without
+ * iostreams (see FMT() and log_client::format()).
+ */
+class log_format
+{
+
+    public:
+
+        /// there is no default constructor for this class (all members are static).
+        log_format() = delete;
+
+        /// returned by placeholders() for format strings that aren't valid.
+        static constexpr std::size_t MALFORMED = static_cast<std::size_t>(-1);
+
+        /**
+         * Checks a placeholder type ('\0' for {}).
+         * @param specifier character naming the type.
+         * @returns true if the placeholder is valid.
+         */
+        static constexpr bool valid_specifier(const char specifier)
+        {
+            return specifier == 'd' || specifier == 'x' || specifier == 'f' || specifier == 's';
+        }
+
+        /**
+         * Gets the length of the placeholder at the start of some text.
+         * @param text text starting with '{'.
+         * @returns length of the placeholder, 0 if it isn't valid.
+         */
+        static constexpr std::size_t placeholder_length(const char* text)
+        {
+            return text[1] == '}' ? 2 : (valid_specifier(text[1]) && text[2] == '}' ? 3 : 0);
+        }
+
+        /**
+         * Counts the placeholders in a format string.
+         * @param text the format string.
+         * @returns number of placeholders, MALFORMED if the format string isn't valid.
+         */
+        static constexpr std::size_t placeholders(const char* text)
+        {
+            return *text == '\0' ? 0 :
+                   ((text[0] == '{' && text[1] == '{') || (text[0] == '}' && text[1] == '}')) ? placeholders(text + 2) :
+                   text[0] == '{' ? (placeholder_length(text) == 0 ? MALFORMED : add(1, placeholders(text + placeholder_length(text)))) :
+                   text[0] == '}' ? MALFORMED :
+                   placeholders(text + 1);
+        }
+
+        /**
+         * Gets the type expected by a placeholder.
+         * @param text the format string.
+         * @param index number of the placeholder.
+         * @returns the character naming the type, '\0' for any.
+         */
+        static constexpr char specifier(const char* text, const std::size_t index)
+        {
+            return *text == '\0' ? '\0' :
+                   ((text[0] == '{' && text[1] == '{') || (text[0] == '}' && text[1] == '}')) ? specifier(text + 2, index) :
+                   text[0] == '{' ? (index == 0 ? (text[1] == '}' ? '\0' : text[1]) :
+                                     specifier(text + (placeholder_length(text) == 0 ? 1 : placeholder_length(text)), index - 1)) :
+                   specifier(text + 1, index);
+        }
+
+        /**
+         * Checks an argument suits the placeholder it replaces.
+         * @param specifier the type the placeholder expects ('\0' for any).
+         * @returns true if the argument can be written in to the placeholder.
+         */
+        template <typename argument_type>
+        static constexpr bool accepts(const char specifier)
+        {
+            return specifier == '\0' ? (integral<argument_type>() || floating<argument_type>() || textual<argument_type>() ||
+                                        std::is_same<typename std::decay<argument_type>::type, bool>::value) :
+                   (specifier == 'd' || specifier == 'x') ? integral<argument_type>() :
+                   specifier == 'f' ? floating<argument_type>() :
+                   specifier == 's' ? textual<argument_type>() :
+                   false;
+        }
+
+        /**
+         * Checks each argument suits the placeholder it replaces (once there are none left).
+         * @returns true.
+         */
+        template <typename format_type, std::size_t index>
+        static constexpr bool arguments_accepted()
+        {
+            return true;
+        }
+
+        /**
+         * Checks each argument suits the placeholder it replaces.
+         * @returns true if every argument can be written in to its placeholder.
+         */
+        template <typename format_type, std::size_t index, typename first_type, typename... rest_types>
+        static constexpr bool arguments_accepted()
+        {
+            return accepts<first_type>(specifier(format_type::text(), index)) &&
+                   arguments_accepted<format_type, index + 1, rest_types...>();
+        }
+
+        // splits a format string in to text and placeholders.
+        static log_format_segments split(const char* text);
+
+        // formats a message from a split format string and its arguments.
+        static void format(std::string& output, const log_format_segments& segments, const log_format_argument* arguments);
+
+    private:
+
+        /// adds to a placeholder count (unless it is MALFORMED).
+        static constexpr std::size_t add(const std::size_t count, const std::size_t rest)
+        {
+            return rest == MALFORMED ? MALFORMED : count + rest;
+        }
+
+        /// checks if an argument is an integer (characters included, flags not).
+        template <typename argument_type>
+        static constexpr bool integral()
+        {
+            return std::is_integral<typename std::decay<argument_type>::type>::value &&
+                   !std::is_same<typename std::decay<argument_type>::type, bool>::value;
+        }
+
+        /// checks if an argument is a floating point number.
+        template <typename argument_type>
+        static constexpr bool floating()
+        {
+            return std::is_floating_point<typename std::decay<argument_type>::type>::value;
+        }
+
+        /// checks if an argument is text.
+        template <typename argument_type>
+        static constexpr bool textual()
+        {
+            return std::is_same<typename std::decay<argument_type>::type, std::string>::value ||
+                   std::is_same<typename std::decay<argument_type>::type, const char*>::value ||
+                   std::is_same<typename std::decay<argument_type>::type, char*>::value;
+        }
+};
+
+} // namespace inglenook::logging
+
+} // namespace inglenook
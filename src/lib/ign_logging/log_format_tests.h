@@ -0,0 +1,116 @@
+#pragma once
+/*
+* log_format_tests.h: Test routines for the log_format class (log_format.cpp/h)
+* Copyright (C) 2012, Project Inglenook (http://www.project-inglenook.co.uk)
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE LOG_TEST_NAME
+
+// standard includes
+#include <sstream>
+#include <limits>
+
+// boost (http://boost.org) includes
+#include <boost/test/unit_test.hpp>
+
+// inglenook includes
+#include "log_format.h"
+#include "log_client.h"
+
+namespace inglenook
+{
+
+namespace logging
+{
+
+//
+// log_format_tests__parsing
+// checks format strings are understood when compiled: placeholders are counted (escaped
+// braces aside), malformed strings are refused, and arguments are checked against their
+// placeholders.
+BOOST_AUTO_TEST_CASE ( log_format_tests__parsing )
+{
+    static_assert(log_format::placeholders("no placeholders") == 0, "");
+    static_assert(log_format::placeholders("temp={} dev={x} name={s}") == 3, "");
+    static_assert(log_format::placeholders("{{escaped}} {}") == 1, "");
+    static_assert(log_format::placeholders("unclosed {") == log_format::MALFORMED, "");
+    static_assert(log_format::placeholders("stray }") == log_format::MALFORMED, "");
+    static_assert(log_format::placeholders("unknown {q}") == log_format::MALFORMED, "");
+    static_assert(log_format::specifier("{} {x} {{}} {f}", 1) == 'x', "");
+    static_assert(log_format::specifier("{} {x} {{}} {f}", 2) == 'f', "");
+
+    static_assert(log_format::accepts<int>('\0') && log_format::accepts<int>('d') && log_format::accepts<int>('x'), "");
+    static_assert(!log_format::accepts<int>('f') && !log_format::accepts<int>('s'), "");
+    static_assert(log_format::accepts<double>('f') && !log_format::accepts<double>('d'), "");
+    static_assert(log_format::accepts<char[6]>('s') && log_format::accepts<std::string>('s'), "");
+    static_assert(log_format::accepts<bool>('\0') && !log_format::accepts<bool>('d'), "");
+    static_assert(!log_format::accepts<std::stringstream>('\0'), "");
+
+    auto segments = log_format::split("a{{b}}{}c{x}");
+    BOOST_REQUIRE(segments.size() == 5);
+    BOOST_CHECK(std::string(segments[0].text, segments[0].length) == "a{");
+    BOOST_CHECK(std::string(segments[1].text, segments[1].length) == "b}");
+    BOOST_CHECK(segments[2].placeholder && segments[2].specifier == '\0');
+    BOOST_CHECK(std::string(segments[3].text, segments[3].length) == "c");
+    BOOST_CHECK(segments[4].placeholder && segments[4].specifier == 'x');
+}
+
+//
+// log_format_tests__output
+// checks messages formatted from format strings read exactly as they would had the same
+// arguments been streamed.
+BOOST_AUTO_TEST_CASE ( log_format_tests__output )
+{
+    auto xml = std::shared_ptr<std::stringstream>(new std::stringstream());
+    auto writer = log_writer::create_from_stream(xml, false, false);
+    writer->console_threshold(category::no_log);
+    log_client client(writer);
+
+    const std::string name = "sensor <a>";
+    const char* label = "label";
+    std::stringstream expected;
+    expected << "temp=" << 21.5 << " dev=" << 42 << " name=" << name << " label=" << label << " {braces}"
+             << " min=" << std::numeric_limits<long long>::min() << " max=" << std::numeric_limits<unsigned long long>::max()
+             << " small=" << 1.0e-7f << " long=" << 1.25L << " flag=" << true << " char=" << 'c'
+             << " hex=" << std::hex << -1 << "/" << 255u << std::dec << " code=" << static_cast<int>('c');
+
+    client.info().format(FMT("temp={} dev={d} name={s} label={} {{braces}} min={} max={} small={f} long={} flag={} "
+                             "char={} hex={x}/{x} code={d}"), 21.5, 42, name, label,
+            std::numeric_limits<long long>::min(), std::numeric_limits<unsigned long long>::max(),
+            1.0e-7f, 1.25L, true, 'c', -1, 255u, 'c');
+    BOOST_CHECK(client.buffer()->message() == expected.str());
+    client << lf::end;
+
+    // formatted and streamed pieces mix, and entries without placeholders need no arguments.
+    client.warning().format(FMT("first {} "), 1) << "second " << 2;
+    client.format(FMT(" third"));
+    BOOST_CHECK(client.buffer()->message() == "first 1 second 2 third");
+    client << lf::end;
+
+    // nothing is formatted in to entries that won't be logged.
+    auto limit = log_limit::every(2);
+    client.info() << limit << "admitted";
+    client << lf::end;
+    client.info() << limit;
+    client.format(FMT("suppressed {}"), 1);
+    BOOST_CHECK(client.buffer()->message().empty());
+    client << lf::end;
+}
+
+} // namespace inglenook::logging
+
+} // namespace inglenook
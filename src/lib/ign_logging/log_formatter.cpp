@@ -0,0 +1,670 @@
+/*
+ * log_formatter.cpp: Formats log entries for a log_writer (XML, JSON Lines and logfmt).
+ * Copyright (C) 2012, Project Inglenook (http://www.project-inglenook.co.uk)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// inglenook includes
+#include "log_formatter.h"
+#include "log_context.h"
+
+// standard library includes
+#include <cmath>
+
+// boost (http://boost.org) includes
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+namespace inglenook
+{
+
+namespace logging
+{
+
+//--------------------------------------------------------//
+// Hide the implementation in the anonymous namespace.
+namespace
+{
+
+    /// names of the categories, indexed by category (see log_formatter::category_name()).
+    const char* const CATEGORY_NAMES[] =
+    {
+        "unspecified", "debugging", "verbose", "information", "warning", "error", "fatal"
+    };
+
+    /// digits used to write numbers in hexadecimal.
+    const char HEX_DIGITS[] = "0123456789abcdef";
+
+    /**
+     * Appends a key for a logfmt pair; anything that would end the key (spaces, '=', quotes or control characters) is
+     * written as '_'.
+     * @param output string to append to.
+     * @param key key to append.
+     */
+    void append_logfmt_key(std::string& output, const std::string& key)
+    {
+        for(auto c = key.begin(); c != key.end(); c++)
+        {
+            bool plain = static_cast<unsigned char>(*c) > ' ' && *c != '=' && *c != '"';
+            output += plain ? *c : '_';
+        }
+    }
+
+}
+//--------------------------------------------------------//
+
+/**
+ * Appends the text a file starts with, before its first entry. Formats without a header append nothing.
+ * @param output string to append to.
+ * @param pid id of the process the log belongs to.
+ * @param process_name name of the process the log belongs to.
+ */
+void log_formatter::format_header(std::string&, const pid_type&, const std::string&) const
+{
+}
+
+/**
+ * Appends the text a file ends with, after its last entry. Formats without a footer append nothing.
+ * @param output string to append to.
+ */
+void log_formatter::format_footer(std::string&) const
+{
+}
+
+/**
+ * Creates a formatter by name.
+ * @param name name of the format: "xml" (log_xml_formatter), "jsonl" (log_json_formatter) or "logfmt"
+ *        (log_logfmt_formatter).
+ * @returns the formatter, nullptr if the format is unknown.
+ */
+std::shared_ptr<log_formatter> log_formatter::create(const std::string& name)
+{
+    if(name == "xml")
+    {
+        return std::make_shared<log_xml_formatter>();
+    }
+    if(name == "jsonl")
+    {
+        return std::make_shared<log_json_formatter>();
+    }
+    if(name == "logfmt")
+    {
+        return std::make_shared<log_logfmt_formatter>();
+    }
+    return nullptr;
+}
+
+/**
+ * Gets the name of a category, as the line based formats (and log_writer's metrics file) write it.
+ * @param entry_type category to name.
+ * @returns name of the category ("unspecified" for anything out of range).
+ */
+const char* log_formatter::category_name(const category& entry_type)
+{
+    return entry_type <= category::fatal ? CATEGORY_NAMES[entry_type] : CATEGORY_NAMES[category::unspecified];
+}
+
+/**
+ * Appends an unsigned number in decimal.
+ * @param output string to append to.
+ * @param value number to append.
+ * @param width smallest number of digits to write (padded with leading zeros).
+ */
+void log_formatter::append_number(std::string& output, std::uint64_t value, const std::size_t& width)
+{
+    char digits[24];
+    std::size_t used = 0;
+    do
+    {
+        digits[sizeof(digits) - ++used] = static_cast<char>('0' + value % 10);
+        value /= 10;
+    }
+    while(value != 0 || (used < width && used < sizeof(digits)));
+    output.append(digits + sizeof(digits) - used, used);
+}
+
+/**
+ * Appends a signed number in decimal.
+ * @param output string to append to.
+ * @param value number to append.
+ */
+void log_formatter::append_number(std::string& output, const std::int64_t& value)
+{
+    if(value < 0)
+    {
+        output += '-';
+        append_number(output, static_cast<std::uint64_t>(0) - static_cast<std::uint64_t>(value));
+    }
+    else
+    {
+        append_number(output, static_cast<std::uint64_t>(value));
+    }
+}
+
+/**
+ * Appends the time an entry was logged, as ISO 8601 in UTC with fractional seconds (2012-12-21T00:00:00.000000Z).
+ * Entries that weren't given a time are written with the current time.
+ * @param output string to append to.
+ * @param entry entry to append the time of.
+ */
+void log_formatter::append_timestamp(std::string& output, log_entry& entry)
+{
+    auto timestamp = entry.timestamp().is_not_a_date_time() ?
+            boost::posix_time::second_clock::universal_time() : entry.timestamp();
+    auto date = timestamp.date().year_month_day();
+    auto time = timestamp.time_of_day();
+
+    append_number(output, static_cast<std::uint64_t>(date.year), 4);
+    output += '-';
+    append_number(output, static_cast<std::uint64_t>(date.month), 2);
+    output += '-';
+    append_number(output, static_cast<std::uint64_t>(date.day), 2);
+    output += 'T';
+    append_number(output, static_cast<std::uint64_t>(time.hours()), 2);
+    output += ':';
+    append_number(output, static_cast<std::uint64_t>(time.minutes()), 2);
+    output += ':';
+    append_number(output, static_cast<std::uint64_t>(time.seconds()), 2);
+    output += '.';
+    append_number(output, static_cast<std::uint64_t>(time.fractional_seconds()),
+            boost::posix_time::time_duration::num_fractional_digits());
+    output += 'Z';
+}
+
+/**
+ * Appends text escaped for XML. Character data is written in CDATA sections, so only the angle brackets need
+ * escaping; attribute values (quotes set) escape double quotes as well.
+ * @param output string to append to.
+ * @param text text to append.
+ * @param quotes set if the text is an attribute value.
+ */
+void log_formatter::append_xml_escaped(std::string& output, const std::string& text, const bool& quotes)
+{
+    std::size_t run_start = 0;
+    for(std::size_t i = 0; i < text.length(); i++)
+    {
+        const char* escaped = text[i] == '<' ? "&lt;" : text[i] == '>' ? "&gt;" : (quotes && text[i] == '"') ? "&quot;" : nullptr;
+        if(escaped != nullptr)
+        {
+            output.append(text, run_start, i - run_start);
+            output += escaped;
+            run_start = i + 1;
+        }
+    }
+    output.append(text, run_start, std::string::npos);
+}
+
+/**
+ * Appends text as a quoted JSON string, escaping quotes, backslashes and control characters. Text is passed through
+ * as UTF-8.
+ * @param output string to append to.
+ * @param text text to append.
+ * @param length length of the text.
+ */
+void log_formatter::append_json_string(std::string& output, const char* text, const std::size_t& length)
+{
+    output += '"';
+    std::size_t run_start = 0;
+    for(std::size_t i = 0; i < length; i++)
+    {
+        unsigned char c = static_cast<unsigned char>(text[i]);
+        if(c >= 0x20 && c != '"' && c != '\\')
+        {
+            continue;
+        }
+
+        output.append(text + run_start, i - run_start);
+        run_start = i + 1;
+        switch(c)
+        {
+            case '"': output += "\\\""; break;
+            case '\\': output += "\\\\"; break;
+            case '\n': output += "\\n"; break;
+            case '\r': output += "\\r"; break;
+            case '\t': output += "\\t"; break;
+            default:
+                output += "\\u00";
+                output += HEX_DIGITS[c >> 4];
+                output += HEX_DIGITS[c & 0x0f];
+                break;
+        }
+    }
+    output.append(text + run_start, length - run_start);
+    output += '"';
+}
+
+/**
+ * Appends a field as a JSON value: numbers and flags as they are, anything else (and numbers JSON can't hold, such
+ * as infinity) as a string.
+ * @param output string to append to.
+ * @param value field to append.
+ */
+void log_formatter::append_json_value(std::string& output, const log_field& value)
+{
+    switch(value.type())
+    {
+        case field_int64:
+            append_number(output, value.int64_value());
+            break;
+
+        case field_uint64:
+            append_number(output, value.uint64_value());
+            break;
+
+        case field_double:
+            if(std::isfinite(value.double_value()))
+            {
+                output += value.to_string();
+            }
+            else
+            {
+                append_json_string(output, value.to_string());
+            }
+            break;
+
+        case field_bool:
+            output += value.bool_value() ? "true" : "false";
+            break;
+
+        case field_string:
+            append_json_string(output, value.string_value());
+            break;
+
+        default:
+            append_json_string(output, value.to_string());
+            break;
+    }
+}
+
+/**
+ * Appends text as a logfmt value. Values holding spaces, '=', quotes, backslashes or control characters (or nothing
+ * at all) are quoted, with quotes, backslashes and control characters escaped as they are in JSON, so an entry
+ * always stays on a single line.
+ * @param output string to append to.
+ * @param text text to append.
+ */
+void log_formatter::append_logfmt_value(std::string& output, const std::string& text)
+{
+    bool quote = text.empty();
+    for(auto c = text.begin(); c != text.end() && !quote; c++)
+    {
+        quote = static_cast<unsigned char>(*c) <= ' ' || *c == '=' || *c == '"' || *c == '\\';
+    }
+
+    if(quote)
+    {
+        append_json_string(output, text.data(), text.length());
+    }
+    else
+    {
+        output += text;
+    }
+}
+
+/**
+ * Appends the XML declaration and the opening of an Inglenook log file, up to the start of its entries.
+ * @param output string to append to.
+ * @param pid id of the process the log belongs to.
+ * @param process_name name of the process the log belongs to.
+ */
+void log_xml_formatter::format_header(std::string& output, const pid_type& pid, const std::string& process_name) const
+{
+    // write out the xml data type declaration, then the root node and type in the xsd.
+    output += "<?xml version=\"1.0\" encoding=\"UTF-8\"?>";
+    output += "<inglenook-log-file xmlns=\"http://schemas.project-inglenook.co.uk/"  // domain for schema's
+              "0.00-DEVELOPMENT/"                                                      // software version
+              "schemas/"                                                               // keep top level tidy for html.
+              "file-formats/"                                                          // types of schema
+              "inglenook-log-file.xsd\">";                                             // specific file.
+
+    // write out binary information block (just because the binary name can be tampered with, it is escaped).
+    output += "<process-id pid=\"";
+    append_number(output, static_cast<std::int64_t>(pid));
+    output += "\"><binary-name><![CDATA[";
+    append_xml_escaped(output, process_name);
+    output += "]]></binary-name><binary-version><![CDATA[";
+    output += inglenook::core::application::version();
+    output += "]]></binary-version><log-writer-version><![CDATA[v1.0.0000]]></log-writer-version></process-id>";
+    output += "<log-entries>";
+}
+
+/**
+ * Appends the closing of an Inglenook log file.
+ * @param output string to append to.
+ */
+void log_xml_formatter::format_footer(std::string& output) const
+{
+    output += "</log-entries></inglenook-log-file>";
+}
+
+/**
+ * Appends an entry as a <log-entry> element. This is what we are aiming for:
+ *
+ *  <log-entry timestamp="2012-12-21T00:00:00.00Z" severity="4" ns="inglenook.sample.process">
+ *     <message><![CDATA[Yikes! Something incredibly Mayan happened to the process - cannot continue.]]></message>
+ *     <source file="src/sample/process.cpp" line="42" function="run"/>
+ *     <extended-data>
+ *         <item key="sample.specific"><![CDATA[Kittens]]></item>
+ *         <item key="sample.host"><![CDATA[127.0.0.1]]></item>
+ *         <item key="sample.rssi" type="int64"><![CDATA[-71]]></item>
+ *     <extended-data>
+ *     <attachment name="sample.frame" encoding="hex" size="4">01080f2a</attachment>
+ *  </log-entry>
+ *
+ * @param output string to append to.
+ * @param entry entry to append.
+ * @param attachment_limit largest number of bytes of each attachment to encode.
+ */
+void log_xml_formatter::format_entry(std::string& output, log_entry& entry, const std::size_t& attachment_limit) const
+{
+    // open the <log-entry> dom element
+    output += "<log-entry timestamp=\"";
+    append_timestamp(output, entry);
+    output += "\" severity=\"";
+    append_number(output, static_cast<std::uint64_t>(entry.entry_type()));
+    output += "\" ns=\"";
+    output += entry.log_namespace();
+    output += "\">";
+
+    // output the message body (sanitized, this can contain user input).
+    output += "<message><![CDATA[";
+    append_xml_escaped(output, entry.message());
+    output += "]]></message>";
+
+    // the call site is only resolved to text now (file and function names are fixed, but may hold markup).
+    auto source = entry.source();
+    if(source != nullptr)
+    {
+        output += "<source file=\"";
+        append_xml_escaped(output, source->file == nullptr ? "" : source->file, true);
+        output += "\" line=\"";
+        append_number(output, static_cast<std::uint64_t>(source->line));
+        output += "\" function=\"";
+        append_xml_escaped(output, source->function == nullptr ? "" : source->function, true);
+        output += "\"/>";
+    }
+
+    // check for extended data (the pairs of the context the entry was logged in are written with it).
+    auto& extended_data = entry.extended_data();
+    auto& fields = entry.fields();
+    auto& context = entry.context();
+    if(extended_data.size() > 0 || fields.size() > 0 || context != nullptr)
+    {
+        output += "<extended-data>";
+
+        // (not only value is sanitized.)
+        for(auto data = extended_data.begin(); data != extended_data.end(); data++)
+        {
+            output += "<item key=\"";
+            output += data->first;
+            output += "\"><![CDATA[";
+            append_xml_escaped(output, data->second);
+            output += "]]></item>";
+        }
+
+        // typed data is rendered now, and marked with its type (values can't hold markup).
+        for(auto field = fields.begin(); field != fields.end(); field++)
+        {
+            output += "<item key=\"";
+            output += field->first;
+            output += "\" type=\"";
+            output += field->second.type_name();
+            output += "\"><![CDATA[";
+            output += field->second.to_string();
+            output += "]]></item>";
+        }
+
+        // the context is written from its newest pair out, each key once (the entry's own data comes first).
+        for(auto item = context.get(); item != nullptr; item = item->parent().get())
+        {
+            if(entry.context_hidden(*item))
+            {
+                continue;
+            }
+
+            output += "<item key=\"";
+            output += item->key();
+            output += "\"";
+            if(item->value().type() != field_string)
+            {
+                output += " type=\"";
+                output += item->value().type_name();
+                output += "\"";
+            }
+            output += "><![CDATA[";
+            append_xml_escaped(output, item->value().to_string());
+            output += "]]></item>";
+        }
+
+        output += "</extended-data>";
+    }
+
+    // attachments are encoded now, up to the limit (encoded text can't hold markup).
+    auto& attachments = entry.attachments();
+    for(auto attachment = attachments.begin(); attachment != attachments.end(); attachment++)
+    {
+        output += "<attachment name=\"";
+        output += attachment->name();
+        output += "\" encoding=\"";
+        output += attachment->encoding_name();
+        output += "\" size=\"";
+        append_number(output, static_cast<std::uint64_t>(attachment->size()));
+        output += "\"";
+
+        // (the encoded text is written in place, then the element closed around it.)
+        std::string encoded;
+        std::size_t length = attachment->encode(encoded, attachment_limit);
+        output += length < attachment->size() ? " truncated=\"true\">" : ">";
+        output += encoded;
+        output += "</attachment>";
+    }
+
+    // close the <log-entry>
+    output += "</log-entry>";
+}
+
+/**
+ * Appends an entry as a single line JSON object, for example:
+ *
+ *  {"timestamp":"2012-12-21T00:00:00.000000Z","level":"fatal","ns":"inglenook.sample.process","message":"Yikes!",
+ *   "source":{"file":"src/sample/process.cpp","line":42,"function":"run"},"data":{"sample.host":"127.0.0.1",
+ *   "sample.rssi":-71},"attachments":[{"name":"sample.frame","encoding":"hex","size":4,"data":"01080f2a"}]}
+ *
+ * Typed data is written as JSON numbers and flags. Attachments cut short by the limit are marked "truncated":true.
+ * @param output string to append to.
+ * @param entry entry to append.
+ * @param attachment_limit largest number of bytes of each attachment to encode.
+ */
+void log_json_formatter::format_entry(std::string& output, log_entry& entry, const std::size_t& attachment_limit) const
+{
+    output += "{\"timestamp\":\"";
+    append_timestamp(output, entry);
+    output += "\",\"level\":\"";
+    output += category_name(entry.entry_type());
+    output += "\",\"ns\":";
+    append_json_string(output, entry.log_namespace());
+    output += ",\"message\":";
+    append_json_string(output, entry.message());
+
+    auto source = entry.source();
+    if(source != nullptr)
+    {
+        output += ",\"source\":{\"file\":";
+        append_json_string(output, source->file == nullptr ? "" : source->file);
+        output += ",\"line\":";
+        append_number(output, static_cast<std::uint64_t>(source->line));
+        output += ",\"function\":";
+        append_json_string(output, source->function == nullptr ? "" : source->function);
+        output += "}";
+    }
+
+    auto& extended_data = entry.extended_data();
+    auto& fields = entry.fields();
+    auto& context = entry.context();
+    if(extended_data.size() > 0 || fields.size() > 0 || context != nullptr)
+    {
+        char separator = '{';
+        output += ",\"data\":";
+        for(auto data = extended_data.begin(); data != extended_data.end(); data++)
+        {
+            output += separator;
+            append_json_string(output, data->first);
+            output += ':';
+            append_json_string(output, data->second);
+            separator = ',';
+        }
+        for(auto field = fields.begin(); field != fields.end(); field++)
+        {
+            output += separator;
+            append_json_string(output, field->first);
+            output += ':';
+            append_json_value(output, field->second);
+            separator = ',';
+        }
+        for(auto item = context.get(); item != nullptr; item = item->parent().get())
+        {
+            if(!entry.context_hidden(*item))
+            {
+                output += separator;
+                append_json_string(output, item->key());
+                output += ':';
+                append_json_value(output, item->value());
+                separator = ',';
+            }
+        }
+        output += separator == '{' ? "{}" : "}";
+    }
+
+    auto& attachments = entry.attachments();
+    if(!attachments.empty())
+    {
+        std::string encoded;
+        output += ",\"attachments\":[";
+        for(auto attachment = attachments.begin(); attachment != attachments.end(); attachment++)
+        {
+            encoded.clear();
+            std::size_t length = attachment->encode(encoded, attachment_limit);
+            output += attachment == attachments.begin() ? "{\"name\":" : ",{\"name\":";
+            append_json_string(output, attachment->name());
+            output += ",\"encoding\":\"";
+            output += attachment->encoding_name();
+            output += "\",\"size\":";
+            append_number(output, static_cast<std::uint64_t>(attachment->size()));
+            output += length < attachment->size() ? ",\"truncated\":true,\"data\":\"" : ",\"data\":\"";
+            output += encoded;
+            output += "\"}";
+        }
+        output += "]";
+    }
+
+    output += "}\n";
+}
+
+/**
+ * Appends an entry as a line of logfmt key=value pairs, for example:
+ *
+ *  ts=2012-12-21T00:00:00.000000Z level=fatal ns=inglenook.sample.process msg="Yikes! Something happened"
+ *  source=src/sample/process.cpp:42 function=run sample.host=127.0.0.1 sample.rssi=-71 attachment.sample.frame=01080f2a
+ *
+ * Extended data, typed data and the context are written under their own keys, attachments under "attachment."
+ * followed by their name (with ".truncated=true" after any cut short by the limit).
+ * @param output string to append to.
+ * @param entry entry to append.
+ * @param attachment_limit largest number of bytes of each attachment to encode.
+ */
+void log_logfmt_formatter::format_entry(std::string& output, log_entry& entry, const std::size_t& attachment_limit) const
+{
+    output += "ts=";
+    append_timestamp(output, entry);
+    output += " level=";
+    output += category_name(entry.entry_type());
+    output += " ns=";
+    append_logfmt_value(output, entry.log_namespace());
+    output += " msg=";
+    append_logfmt_value(output, entry.message());
+
+    auto source = entry.source();
+    if(source != nullptr)
+    {
+        std::string location = source->file == nullptr ? "" : source->file;
+        location += ':';
+        append_number(location, static_cast<std::uint64_t>(source->line));
+        output += " source=";
+        append_logfmt_value(output, location);
+        output += " function=";
+        append_logfmt_value(output, source->function == nullptr ? "" : source->function);
+    }
+
+    auto& extended_data = entry.extended_data();
+    for(auto data = extended_data.begin(); data != extended_data.end(); data++)
+    {
+        output += ' ';
+        append_logfmt_key(output, data->first);
+        output += '=';
+        append_logfmt_value(output, data->second);
+    }
+    auto& fields = entry.fields();
+    for(auto field = fields.begin(); field != fields.end(); field++)
+    {
+        output += ' ';
+        append_logfmt_key(output, field->first);
+        output += '=';
+        if(field->second.type() == field_int64)
+        {
+            append_number(output, field->second.int64_value());
+        }
+        else if(field->second.type() == field_uint64)
+        {
+            append_number(output, field->second.uint64_value());
+        }
+        else
+        {
+            append_logfmt_value(output, field->second.to_string());
+        }
+    }
+    for(auto item = entry.context().get(); item != nullptr; item = item->parent().get())
+    {
+        if(!entry.context_hidden(*item))
+        {
+            output += ' ';
+            append_logfmt_key(output, item->key());
+            output += '=';
+            append_logfmt_value(output, item->value().to_string());
+        }
+    }
+
+    auto& attachments = entry.attachments();
+    std::string encoded;
+    for(auto attachment = attachments.begin(); attachment != attachments.end(); attachment++)
+    {
+        encoded.clear();
+        std::size_t length = attachment->encode(encoded, attachment_limit);
+        output += " attachment.";
+        append_logfmt_key(output, attachment->name());
+        output += '=';
+        append_logfmt_value(output, encoded);
+        if(length < attachment->size())
+        {
+            output += " attachment.";
+            append_logfmt_key(output, attachment->name());
+            output += ".truncated=true";
+        }
+    }
+
+    output += '\n';
+}
+
+} // namespace inglenook::logging
+
+} // namespace inglenook
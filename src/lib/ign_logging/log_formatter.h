@@ -0,0 +1,153 @@
+#pragma once
+/*
+ * log_formatter.h: Formats log entries for a log_writer (XML, JSON Lines and logfmt).
+ * Copyright (C) 2012, Project Inglenook (http://www.project-inglenook.co.uk)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// standard library includes
+#include <cstdint>
+#include <memory>
+#include <string>
+
+// boost (http://boost.org) includes
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+
+// inglenook includes
+#include <ign_core/application.h>
+#include "log_entry.h"
+
+namespace inglenook
+{
+
+namespace logging
+{
+
+/**
+ * The log_formatter class turns log entries in to the text a log_writer writes out (see log_writer::formatter()).
+ * Entries are appended to a string the writer keeps between entries, never through iostreams, using the escaping
+ * and number helpers shared by every format. A format may start and end files with a header and footer; the line
+ * based formats have neither, so their files can be appended to and joined freely.
+ */
+class log_formatter
+{
+
+    public:
+
+        /// releases the formatter.
+        virtual ~log_formatter() {}
+
+        /// gets the name of the format (see create()).
+        virtual const char* name() const = 0;
+
+        // appends the text a file starts with (nothing by default).
+        virtual void format_header(std::string& output, const pid_type& pid, const std::string& process_name) const;
+
+        // appends the text a file ends with (nothing by default).
+        virtual void format_footer(std::string& output) const;
+
+        /// appends an entry, encoding no more than attachment_limit bytes of each attachment.
+        virtual void format_entry(std::string& output, log_entry& entry, const std::size_t& attachment_limit) const = 0;
+
+        // creates a formatter by name ("xml", "jsonl" or "logfmt").
+        static std::shared_ptr<log_formatter> create(const std::string& name);
+
+        // gets the name of a category ("debugging", "warning" and so on).
+        static const char* category_name(const category& entry_type);
+
+        // appends an unsigned number.
+        static void append_number(std::string& output, std::uint64_t value, const std::size_t& width = 0);
+
+        // appends a signed number.
+        static void append_number(std::string& output, const std::int64_t& value);
+
+        // appends text as a JSON string (quoted).
+        static void append_json_string(std::string& output, const char* text, const std::size_t& length);
+
+        // appends text as a JSON string (quoted).
+        static void append_json_string(std::string& output, const std::string& text)
+        {
+            append_json_string(output, text.data(), text.length());
+        }
+
+    protected:
+
+        // appends the time an entry was logged (ISO 8601, UTC).
+        static void append_timestamp(std::string& output, log_entry& entry);
+
+        // appends text escaped for XML character data (and attribute values, if quotes is set).
+        static void append_xml_escaped(std::string& output, const std::string& text, const bool& quotes = false);
+
+        // appends a field as a JSON value.
+        static void append_json_value(std::string& output, const log_field& value);
+
+        // appends text as a logfmt value (quoted only if it needs to be).
+        static void append_logfmt_value(std::string& output, const std::string& text);
+};
+
+/**
+ * Formats entries as the elements of an Inglenook log file (see the XSD in schemas/), the writer's default.
+ */
+class log_xml_formatter : public log_formatter
+{
+
+    public:
+
+        /// gets the name of the format.
+        virtual const char* name() const { return "xml"; }
+
+        // appends the XML declaration and the opening of the document.
+        virtual void format_header(std::string& output, const pid_type& pid, const std::string& process_name) const;
+
+        // appends the closing of the document.
+        virtual void format_footer(std::string& output) const;
+
+        // appends an entry as a <log-entry> element.
+        virtual void format_entry(std::string& output, log_entry& entry, const std::size_t& attachment_limit) const;
+};
+
+/**
+ * Formats entries as JSON Lines (jsonlines.org): one JSON object per entry, per line.
+ */
+class log_json_formatter : public log_formatter
+{
+
+    public:
+
+        /// gets the name of the format.
+        virtual const char* name() const { return "jsonl"; }
+
+        // appends an entry as a single line JSON object.
+        virtual void format_entry(std::string& output, log_entry& entry, const std::size_t& attachment_limit) const;
+};
+
+/**
+ * Formats entries as logfmt: one line of key=value pairs per entry.
+ */
+class log_logfmt_formatter : public log_formatter
+{
+
+    public:
+
+        /// gets the name of the format.
+        virtual const char* name() const { return "logfmt"; }
+
+        // appends an entry as a line of key=value pairs.
+        virtual void format_entry(std::string& output, log_entry& entry, const std::size_t& attachment_limit) const;
+};
+
+} // namespace inglenook::logging
+
+} // namespace inglenook
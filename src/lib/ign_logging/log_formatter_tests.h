@@ -0,0 +1,179 @@
+#pragma once
+/*
+* log_formatter_tests.h: Test routines for the log_formatter classes (log_formatter.cpp/h)
+* Copyright (C) 2012, Project Inglenook (http://www.project-inglenook.co.uk)
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE LOG_TEST_NAME
+
+// standard includes
+#include <sstream>
+
+// boost (http://boost.org) includes
+#include <boost/test/unit_test.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+// inglenook includes
+#include "log_formatter.h"
+#include "log_writer.h"
+
+namespace inglenook
+{
+
+namespace logging
+{
+
+/**
+ * Creates an entry with a fixed time, for formatters to write out.
+ * @param message message of the entry.
+ * @returns the entry.
+ */
+log_entry create_formatter_entry(const std::string& message)
+{
+    log_entry entry;
+    entry.entry_type(category::warning);
+    entry.log_namespace("test.formatter");
+    entry.message(message);
+    entry.timestamp(boost::posix_time::ptime(boost::gregorian::date(2012, 12, 21),
+            boost::posix_time::time_duration(1, 2, 3) + boost::posix_time::microseconds(456)));
+    return entry;
+}
+
+//
+// log_formatter_tests__create
+// checks formatters are created by name, unknown names are refused, and categories are named.
+BOOST_AUTO_TEST_CASE ( log_formatter_tests__create )
+{
+    BOOST_CHECK(std::string(log_formatter::create("xml")->name()) == "xml");
+    BOOST_CHECK(std::string(log_formatter::create("jsonl")->name()) == "jsonl");
+    BOOST_CHECK(std::string(log_formatter::create("logfmt")->name()) == "logfmt");
+    BOOST_CHECK(log_formatter::create("bogus") == nullptr);
+
+    BOOST_CHECK(std::string(log_formatter::category_name(category::debugging)) == "debugging");
+    BOOST_CHECK(std::string(log_formatter::category_name(category::fatal)) == "fatal");
+    BOOST_CHECK(std::string(log_formatter::category_name(static_cast<category>(42))) == "unspecified");
+}
+
+//
+// log_formatter_tests__xml
+// checks the xml formatter writes the elements the writer always has, with user text escaped.
+BOOST_AUTO_TEST_CASE ( log_formatter_tests__xml )
+{
+    auto entry = create_formatter_entry("a <b> \"c\"");
+    entry.extended_data("test.host", "127.0.0.1");
+    entry.field("test.rssi", -71);
+
+    std::string output;
+    log_xml_formatter().format_entry(output, entry, 1024);
+    BOOST_CHECK(output == "<log-entry timestamp=\"2012-12-21T01:02:03.000456Z\" severity=\"4\" ns=\"test.formatter\">"
+                          "<message><![CDATA[a &lt;b&gt; \"c\"]]></message>"
+                          "<extended-data><item key=\"test.host\"><![CDATA[127.0.0.1]]></item>"
+                          "<item key=\"test.rssi\" type=\"int64\"><![CDATA[-71]]></item></extended-data>"
+                          "</log-entry>");
+
+    std::string header, footer;
+    log_xml_formatter().format_header(header, 42, "test");
+    log_xml_formatter().format_footer(footer);
+    BOOST_CHECK(header.find("<?xml version=\"1.0\" encoding=\"UTF-8\"?>") == 0);
+    BOOST_CHECK(header.find("<process-id pid=\"42\"><binary-name><![CDATA[test]]>") != std::string::npos);
+    BOOST_CHECK(footer == "</log-entries></inglenook-log-file>");
+}
+
+//
+// log_formatter_tests__json
+// checks json lines escape text, write typed data as json values and mark truncated attachments,
+// one object per line.
+BOOST_AUTO_TEST_CASE ( log_formatter_tests__json )
+{
+    const unsigned char frame[] = { 0x01, 0x08, 0x0f, 0x2a };
+    auto entry = create_formatter_entry("quote \" slash \\ line\nend\x01");
+    entry.extended_data("test.host", "127.0.0.1");
+    entry.field("test.rssi", -71);
+    entry.field("test.up", true);
+    entry.field("test.snr", 3.5);
+    entry.attachment(log_attachment("test.frame", frame, sizeof(frame)));
+
+    std::string output;
+    log_json_formatter().format_entry(output, entry, 2);
+    BOOST_CHECK(output == "{\"timestamp\":\"2012-12-21T01:02:03.000456Z\",\"level\":\"warning\",\"ns\":\"test.formatter\","
+                          "\"message\":\"quote \\\" slash \\\\ line\\nend\\u0001\","
+                          "\"data\":{\"test.host\":\"127.0.0.1\",\"test.rssi\":-71,\"test.snr\":3.5,\"test.up\":true},"
+                          "\"attachments\":[{\"name\":\"test.frame\",\"encoding\":\"hex\",\"size\":4,\"truncated\":true,"
+                          "\"data\":\"0108\"}]}\n");
+
+    // headers and footers are empty, so files are only lines of entries.
+    std::string header, footer;
+    log_json_formatter().format_header(header, 42, "test");
+    log_json_formatter().format_footer(footer);
+    BOOST_CHECK(header.empty() && footer.empty());
+}
+
+//
+// log_formatter_tests__logfmt
+// checks logfmt pairs are quoted only when they must be, keys are kept whole, and entries stay
+// on one line.
+BOOST_AUTO_TEST_CASE ( log_formatter_tests__logfmt )
+{
+    auto entry = create_formatter_entry("two words\nand a line");
+    entry.extended_data("test.host", "127.0.0.1");
+    entry.extended_data("test key=", "a=b");
+    entry.field("test.rssi", -71);
+
+    std::string output;
+    log_logfmt_formatter().format_entry(output, entry, 1024);
+    BOOST_CHECK(output == "ts=2012-12-21T01:02:03.000456Z level=warning ns=test.formatter msg=\"two words\\nand a line\" "
+                          "test_key_=\"a=b\" test.host=127.0.0.1 test.rssi=-71\n");
+}
+
+//
+// log_formatter_tests__writer
+// checks a writer given a line based formatter writes no header or footer, one line per entry,
+// and refuses a new formatter once it has started writing.
+BOOST_AUTO_TEST_CASE ( log_formatter_tests__writer )
+{
+    auto lines = std::shared_ptr<std::stringstream>(new std::stringstream());
+    {
+        auto writer = log_writer::create_from_stream(lines, true, true);
+        writer->console_threshold(category::no_log);
+        BOOST_CHECK(!writer->formatter(nullptr));
+        BOOST_CHECK(writer->formatter(std::make_shared<log_json_formatter>()));
+        BOOST_CHECK(std::string(writer->formatter()->name()) == "jsonl");
+
+        for(int i = 0; i < 3; i++)
+        {
+            auto entry = std::make_shared<log_entry>(create_formatter_entry("entry"));
+            writer->add_entry(entry);
+        }
+        BOOST_CHECK(writer->flush().get());
+        BOOST_CHECK(!writer->formatter(std::make_shared<log_logfmt_formatter>()));
+        BOOST_CHECK(std::string(writer->formatter()->name()) == "jsonl");
+    }
+
+    std::string line;
+    int count = 0;
+    while(std::getline(*lines, line))
+    {
+        BOOST_CHECK(line.find("{\"timestamp\":") == 0);
+        BOOST_CHECK(line.find("\"message\":\"entry\"}") != std::string::npos);
+        count++;
+    }
+    BOOST_CHECK(count == 3);
+}
+
+} // namespace inglenook::logging
+
+} // namespace inglenook
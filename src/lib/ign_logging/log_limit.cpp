@@ -0,0 +1,162 @@
+/*
+ * log_limit.cpp: Sampling and rate limits for noisy log call sites and namespaces.
+ * Copyright (C) 2012, Project Inglenook (http://www.project-inglenook.co.uk)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// inglenook includes
+#include "log_limit.h"
+#include "log_span.h"
+
+// standard library includes
+#include <algorithm>
+
+namespace inglenook
+{
+
+namespace logging
+{
+
+/**
+ * Creates a new limit.
+ * @param sample_every log every Nth entry (1 to consider every entry).
+ * @param rate maximum entries per second (0 for no limit).
+ * @param burst entries that can be logged at once before the rate applies.
+ */
+log_limit::log_limit(const std::uint32_t& sample_every, const double& rate, const std::uint32_t& burst) :
+    m_sample_every(std::max<std::uint32_t>(sample_every, 1)),
+    m_rate(std::max(rate, 0.0)),
+    m_burst(std::max<std::uint32_t>(burst, 1)),
+    m_interval(m_rate > 0 ? static_cast<std::int64_t>(1000000000.0 / m_rate) : 0),
+    m_considered(0),
+    m_next_due(0),
+    m_pending(0),
+    m_suppressed(0)
+{
+}
+
+/**
+ * Creates a limit with the same settings as another. The new limit starts afresh (nothing has been suppressed
+ * and the full burst is available).
+ * @param other limit to copy the settings of.
+ */
+log_limit::log_limit(const log_limit& other) :
+    log_limit(other.m_sample_every, other.m_rate, other.m_burst)
+{
+}
+
+/**
+ * Creates a limit which logs every Nth entry (the first, the N+1th and so on).
+ * @param n sampling interval.
+ * @returns the limit.
+ */
+log_limit log_limit::every(const std::uint32_t& n)
+{
+    return log_limit(n, 0, 1);
+}
+
+/**
+ * Creates a limit which logs at most a number of entries per second. Up to burst entries can be logged at once,
+ * after which entries are logged at the rate (as if from a bucket of burst tokens, refilled at the rate).
+ * @param rate maximum entries per second.
+ * @param burst entries that can be logged at once.
+ * @returns the limit.
+ */
+log_limit log_limit::per_second(const double& rate, const std::uint32_t& burst)
+{
+    return log_limit(1, rate, burst);
+}
+
+/**
+ * Checks if an entry may be logged. This is lock free; the rate is enforced by keeping the time the next entry
+ * would be due were entries logged at exactly the maximum rate, admitting entries up to (burst - 1) intervals
+ * ahead of it (the generic cell rate algorithm, equivalent to a token bucket held in a single word).
+ * @param suppressed [output] if the entry is admitted, the number of entries suppressed since the last one was.
+ * @returns true if the entry may be logged.
+ */
+bool log_limit::admit(std::uint64_t& suppressed)
+{
+    bool admitted = m_sample_every <= 1 || m_considered.fetch_add(1, std::memory_order_relaxed) % m_sample_every == 0;
+
+    if(admitted && m_interval > 0)
+    {
+        const std::int64_t now = log_tracer::now();
+        const std::int64_t tolerance = m_interval * (m_burst - 1);
+        std::int64_t next_due = m_next_due.load(std::memory_order_relaxed);
+        while(true)
+        {
+            std::int64_t due = std::max(next_due, now);
+            if(due - now > tolerance)
+            {
+                admitted = false;
+                break;
+            }
+            if(m_next_due.compare_exchange_weak(next_due, due + m_interval, std::memory_order_relaxed))
+            {
+                break;
+            }
+        }
+    }
+
+    if(!admitted)
+    {
+        m_pending.fetch_add(1, std::memory_order_relaxed);
+        m_suppressed.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    suppressed = m_pending.exchange(0, std::memory_order_relaxed);
+    return true;
+}
+
+/**
+ * Gets the number of entries this limit has suppressed.
+ * @returns entries suppressed since the limit was created.
+ */
+std::uint64_t log_limit::suppressed() const
+{
+    return m_suppressed.load(std::memory_order_relaxed);
+}
+
+/**
+ * Gets the sampling interval.
+ * @returns N, where every Nth entry is logged (1 if every entry is considered).
+ */
+std::uint32_t log_limit::sample_every() const
+{
+    return m_sample_every;
+}
+
+/**
+ * Gets the maximum rate.
+ * @returns entries per second, 0 if the rate isn't limited.
+ */
+double log_limit::rate() const
+{
+    return m_rate;
+}
+
+/**
+ * Gets the number of entries that can be logged at once before the rate applies.
+ * @returns burst size.
+ */
+std::uint32_t log_limit::burst() const
+{
+    return m_burst;
+}
+
+} // namespace inglenook::logging
+
+} // namespace inglenook
@@ -0,0 +1,106 @@
+#pragma once
+/*
+ * log_limit.h: Sampling and rate limits for noisy log call sites and namespaces.
+ * Copyright (C) 2012, Project Inglenook (http://www.project-inglenook.co.uk)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// standard library includes
+#include <atomic>
+#include <cstdint>
+
+namespace inglenook
+{
+
+namespace logging
+{
+
+/**
+ * The log_limit class limits how many entries a call site (or namespace, see log_client::limit_namespace()) logs.
+ * A limit either samples entries (logging every Nth) or limits their rate (logging at most N per second, allowing
+ * bursts of a set size). Checking a limit is lock free, and log_client checks it before formatting anything, so a
+ * suppressed entry costs very little. The number of entries suppressed is reported in the next entry logged.
+ *
+ *     static log_limit flapping = log_limit::per_second(10, 50);
+ *     log_warning() << flapping << "device " << id << " is flapping" << lf::end;
+ */
+class log_limit
+{
+
+    public:
+
+        /// there is no default constructor for this class (see every() and per_second()).
+        log_limit() = delete;
+
+        // creates a limit with the same settings as another (but none of its history).
+        log_limit(const log_limit& other);
+
+        /// limits can't be assigned (they may be in use by several threads).
+        log_limit& operator=(const log_limit&) = delete;
+
+        // creates a limit which logs every Nth entry.
+        static log_limit every(const std::uint32_t& n);
+
+        // creates a limit which logs at most a number of entries per second.
+        static log_limit per_second(const double& rate, const std::uint32_t& burst = 1);
+
+        // checks if an entry may be logged.
+        bool admit(std::uint64_t& suppressed);
+
+        /// gets the number of entries this limit has suppressed.
+        std::uint64_t suppressed() const;
+
+        /// gets the sampling interval (1 if every entry is considered).
+        std::uint32_t sample_every() const;
+
+        /// gets the maximum rate (entries per second, 0 if the rate isn't limited).
+        double rate() const;
+
+        /// gets the number of entries that can be logged at once before the rate applies.
+        std::uint32_t burst() const;
+
+    private:
+
+        // creates a new limit.
+        log_limit(const std::uint32_t& sample_every, const double& rate, const std::uint32_t& burst);
+
+        /// log every Nth entry.
+        std::uint32_t m_sample_every;
+
+        /// maximum entries per second (0 for no limit).
+        double m_rate;
+
+        /// entries that can be logged at once.
+        std::uint32_t m_burst;
+
+        /// time between entries at the maximum rate (nanoseconds).
+        std::int64_t m_interval;
+
+        /// number of entries considered (for sampling).
+        std::atomic<std::uint64_t> m_considered;
+
+        /// time the next entry would be due if entries arrived at exactly the maximum rate (monotonic nanoseconds).
+        std::atomic<std::int64_t> m_next_due;
+
+        /// entries suppressed since the last entry was admitted.
+        std::atomic<std::uint64_t> m_pending;
+
+        /// entries suppressed in total.
+        std::atomic<std::uint64_t> m_suppressed;
+};
+
+} // namespace inglenook::logging
+
+} // namespace inglenook
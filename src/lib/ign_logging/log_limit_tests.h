@@ -0,0 +1,174 @@
+#pragma once
+/*
+* log_limit_tests.h: Test routines for the log_limit class (log_limit.cpp/h)
+* Copyright (C) 2012, Project Inglenook (http://www.project-inglenook.co.uk)
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE LOG_TEST_NAME
+
+// standard includes
+#include <sstream>
+#include <vector>
+#include <atomic>
+
+// boost (http://boost.org) includes
+#include <boost/test/unit_test.hpp>
+#include <boost/thread/thread.hpp>
+
+// inglenook includes
+#include "log_limit.h"
+#include "log_client.h"
+#include "log_file_reader.h"
+
+namespace inglenook
+{
+
+namespace logging
+{
+
+//
+// log_limit_tests__sampling
+// checks a sampling limit admits every Nth entry, reporting how many were suppressed
+// in between.
+BOOST_AUTO_TEST_CASE ( log_limit_tests__sampling )
+{
+    auto limit = log_limit::every(3);
+    BOOST_CHECK(limit.sample_every() == 3);
+    BOOST_CHECK(limit.rate() == 0);
+
+    for(int i = 0; i < 10; i++)
+    {
+        std::uint64_t suppressed = 99;
+        bool admitted = limit.admit(suppressed);
+        BOOST_CHECK(admitted == (i % 3 == 0));
+        if(admitted)
+        {
+            BOOST_CHECK(suppressed == (i == 0 ? 0u : 2u));
+        }
+    }
+    BOOST_CHECK(limit.suppressed() == 6);
+
+    // copies start afresh.
+    log_limit copy(limit);
+    BOOST_CHECK(copy.sample_every() == 3);
+    BOOST_CHECK(copy.suppressed() == 0);
+}
+
+//
+// log_limit_tests__rate
+// checks a rate limit admits its burst and then holds entries to its rate, including
+// when many threads share it.
+BOOST_AUTO_TEST_CASE ( log_limit_tests__rate )
+{
+    // (at one entry every 1000 seconds, only the burst gets through.)
+    auto limit = log_limit::per_second(0.001, 5);
+    std::uint64_t suppressed = 0;
+    for(int i = 0; i < 15; i++)
+    {
+        BOOST_CHECK(limit.admit(suppressed) == (i < 5));
+    }
+    BOOST_CHECK(limit.suppressed() == 10);
+
+    // at a thousand a second, entries are admitted again soon enough.
+    auto fast_limit = log_limit::per_second(1000);
+    BOOST_CHECK(fast_limit.admit(suppressed));
+    BOOST_CHECK(!fast_limit.admit(suppressed));
+    boost::this_thread::sleep(boost::posix_time::milliseconds(5));
+    BOOST_CHECK(fast_limit.admit(suppressed));
+    BOOST_CHECK(suppressed == 1);
+
+    // exactly the burst is admitted, however many threads race for it.
+    const int THREAD_COUNT = 8;
+    auto shared_limit = log_limit::per_second(0.001, 100);
+    std::atomic<int> admitted(0);
+    std::vector<std::shared_ptr<boost::thread>> threads;
+    for(int i = 0; i < THREAD_COUNT; i++)
+    {
+        threads.push_back(std::shared_ptr<boost::thread>(new boost::thread([&shared_limit, &admitted]()
+        {
+            std::uint64_t thread_suppressed = 0;
+            for(int j = 0; j < 1000; j++)
+            {
+                if(shared_limit.admit(thread_suppressed))
+                {
+                    admitted++;
+                }
+            }
+        })));
+    }
+    for(auto thread = threads.begin(); thread != threads.end(); thread++)
+    {
+        (*thread)->join();
+    }
+    BOOST_CHECK(admitted == 100);
+    BOOST_CHECK(shared_limit.suppressed() == THREAD_COUNT * 1000 - 100);
+}
+
+//
+// log_limit_tests__client
+// checks call site and namespace limits applied through a log_client: suppressed entries
+// are neither formatted nor logged, and the next entry logged carries the suppressed count.
+BOOST_AUTO_TEST_CASE ( log_limit_tests__client )
+{
+    auto xml = std::shared_ptr<std::stringstream>(new std::stringstream());
+    {
+        auto writer = log_writer::create_from_stream(xml, false, false);
+        writer->console_threshold(category::no_log);
+        log_client client(writer);
+
+        // a call site logging every other entry.
+        auto call_site = log_limit::every(2);
+        for(int i = 0; i < 6; i++)
+        {
+            client.warning() << call_site << "call site " << i;
+            BOOST_CHECK(client.buffer()->message() == (i % 2 == 0 ? "call site " + std::to_string(i) : ""));
+            client << log_data("test.number", std::to_string(i)) << lf::end;
+        }
+
+        // a namespace allowed two entries (and no more for a very long time).
+        BOOST_CHECK(client.limit_namespace("inglenook.noisy", log_limit::per_second(0.001, 2)));
+        for(int i = 0; i < 5; i++)
+        {
+            client.info() << ns("inglenook.noisy") << "noisy " << i << lf::end;
+            client.info() << ns("inglenook.quiet") << "quiet " << i << lf::end;
+        }
+
+        // replacing the limit starts it afresh.
+        BOOST_CHECK(client.limit_namespace("inglenook.noisy", log_limit::per_second(0.001, 1)));
+        client.info() << ns("inglenook.noisy") << "noisy again" << lf::end;
+        client.info() << ns("inglenook.noisy") << "noisy suppressed" << lf::end;
+    }
+
+    log_file_reader reader(xml);
+    std::vector<std::string> messages, suppressed;
+    for(auto entry = reader.next_entry(); entry != nullptr; entry = reader.next_entry())
+    {
+        messages.push_back(entry->message());
+        auto count = entry->extended_data().find(log_client::SUPPRESSED_KEY);
+        suppressed.push_back(count == entry->extended_data().end() ? "" : count->second);
+    }
+
+    const std::vector<std::string> expected_messages = { "call site 0", "call site 2", "call site 4",
+            "noisy 0", "quiet 0", "noisy 1", "quiet 1", "quiet 2", "quiet 3", "quiet 4", "noisy again" };
+    const std::vector<std::string> expected_suppressed = { "", "1", "1", "", "", "", "", "", "", "", "" };
+    BOOST_CHECK(messages == expected_messages);
+    BOOST_CHECK(suppressed == expected_suppressed);
+}
+
+} // namespace inglenook::logging
+
+} // namespace inglenook
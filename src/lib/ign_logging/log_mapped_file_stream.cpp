@@ -0,0 +1,376 @@
+/*
+ * log_mapped_file_stream.cpp: Preallocated, memory mapped output stream used by log_writer for log files.
+ * Copyright (C) 2012, Project Inglenook (http://www.project-inglenook.co.uk)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// inglenook includes
+#include "log_mapped_file_stream.h"
+
+// standard library includes
+#include <algorithm>
+#include <cstring>
+
+// platform includes
+#include <fcntl.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace inglenook
+{
+
+namespace logging
+{
+
+const off_t log_mapped_file_buffer::EXTENT_SIZE;
+const std::size_t log_mapped_file_buffer::WINDOW_SIZE;
+
+//--------------------------------------------------------//
+// Hide the implementation in the anonymous namespace.
+namespace
+{
+
+    /**
+     * Gets the size of a page, which mapped windows must start on.
+     * @returns page size in bytes.
+     */
+    off_t page_size()
+    {
+        static const off_t size = sysconf(_SC_PAGESIZE);
+        return size;
+    }
+
+}
+//--------------------------------------------------------//
+
+/**
+ * Creates a closed buffer; open() must be called before any output is written.
+ */
+log_mapped_file_buffer::log_mapped_file_buffer()
+    : m_descriptor(-1),
+      m_window(nullptr),
+      m_window_offset(0),
+      m_data_size(0),
+      m_allocated_size(0),
+      m_synced_size(0)
+{
+    setp(nullptr, nullptr);
+}
+
+/**
+ * Truncates the file to the data written and closes it.
+ */
+log_mapped_file_buffer::~log_mapped_file_buffer()
+{
+    close();
+}
+
+/**
+ * Opens the specified file for appending, creating it if it does not exist. Output is appended after the data
+ * already in the file; zeros left at the end of a file that was never closed (see find_data_end()) are overwritten.
+ * @param file_path path of the file to append to.
+ * @returns true if the file was opened and mapped.
+ */
+bool log_mapped_file_buffer::open(const std::string& file_path)
+{
+    // only one file per buffer.
+    if(is_open())
+    {
+        return false;
+    }
+
+    m_descriptor = ::open(file_path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    struct stat status;
+    if(!is_open() || fstat(m_descriptor, &status) != 0)
+    {
+        close();
+        return false;
+    }
+
+    // carry on from the end of the data (the rest of the file is preallocation we can reuse).
+    m_allocated_size = status.st_size;
+    m_data_size = find_data_end(status.st_size);
+    m_synced_size = m_data_size;
+    if(!map_window(m_data_size))
+    {
+        close();
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Unmaps the window, truncates the file to the data that was written (giving back the preallocation beyond it) and
+ * closes the file. Does nothing if no file is open.
+ */
+void log_mapped_file_buffer::close()
+{
+    if(is_open())
+    {
+        unmap_window();
+        if(m_allocated_size != m_data_size)
+        {
+            ftruncate(m_descriptor, m_data_size);
+        }
+        ::close(m_descriptor);
+        m_descriptor = -1;
+        m_allocated_size = 0;
+        m_data_size = 0;
+    }
+}
+
+/**
+ * Writes the data back to the file, and waits for it (and the file's metadata) to reach the disk. Windows already
+ * moved past are written back by the fsync.
+ * @returns true on success.
+ */
+bool log_mapped_file_buffer::synchronize()
+{
+    if(!is_open())
+    {
+        return false;
+    }
+
+    bool synchronized = true;
+    if(m_window != nullptr && pptr() != m_window)
+    {
+        synchronized = msync(m_window, pptr() - m_window, MS_SYNC) == 0;
+    }
+    m_synced_size = data_size();
+    return fsync(m_descriptor) == 0 && synchronized;
+}
+
+/**
+ * Moves the window along to the end of the data, making room for more output.
+ * @param character character to append once the window has moved (or eof).
+ * @returns eof on failure, otherwise something other than eof.
+ */
+log_mapped_file_buffer::int_type log_mapped_file_buffer::overflow(int_type character)
+{
+    // move the window along...
+    if(!map_window(data_size()))
+    {
+        return traits_type::eof();
+    }
+
+    // ... and store the character that didn't fit.
+    if(!traits_type::eq_int_type(character, traits_type::eof()))
+    {
+        *pptr() = traits_type::to_char_type(character);
+        pbump(1);
+    }
+
+    return traits_type::not_eof(character);
+}
+
+/**
+ * Copies a block of characters in to the window, moving the window along first if it won't fit. A block larger than
+ * the window is written to the file directly (after the data), and the window moved past it.
+ * @param data characters to write.
+ * @param count number of characters to write.
+ * @returns number of characters written.
+ */
+std::streamsize log_mapped_file_buffer::xsputn(const char_type* data, std::streamsize count)
+{
+    // move the window along if this block won't fit.
+    if(count > epptr() - pptr() && !map_window(data_size()))
+    {
+        return 0;
+    }
+
+    // copy in to the window if it fits...
+    if(count <= epptr() - pptr())
+    {
+        std::memcpy(pptr(), data, count);
+        pbump(count);
+        return count;
+    }
+
+    // ... otherwise write it after the data, and move the window past it.
+    off_t offset = data_size();
+    if(!preallocate(offset + count))
+    {
+        return 0;
+    }
+    for(std::streamsize written = 0; written < count; )
+    {
+        ssize_t result = pwrite(m_descriptor, data + written, count - written, offset + written);
+        if(result < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if(result <= 0)
+        {
+            return 0;
+        }
+        written += result;
+    }
+    return map_window(offset + count) ? count : 0;
+}
+
+/**
+ * Starts writing the data added to the window since the last call back to the file (msync, MS_ASYNC). The data is
+ * already visible to anyone reading the file; this only hurries it to the disk. See synchronize() to wait for it.
+ * @returns 0 on success, -1 on failure.
+ */
+int log_mapped_file_buffer::sync()
+{
+    // there is nothing we can do without a file.
+    if(!is_open() || m_window == nullptr)
+    {
+        return is_open() ? 0 : -1;
+    }
+
+    // (only whole pages can be synced, from the one holding the first unsynced byte.)
+    off_t end = data_size();
+    off_t start = std::max(m_synced_size, m_window_offset);
+    start -= (start - m_window_offset) % page_size();
+    if(end > start && msync(m_window + (start - m_window_offset), end - start, MS_ASYNC) != 0)
+    {
+        return -1;
+    }
+    m_synced_size = end;
+    return 0;
+}
+
+/**
+ * Maps the window over the file, starting on the page holding the specified offset, and points the put area at the
+ * offset. The file is preallocated to cover the whole window first (touching a mapping beyond the end of a file
+ * faults). Any window already mapped is unmapped; the operating system writes it back in its own time.
+ * @param offset offset in the file the put area should start at.
+ * @returns true on success.
+ */
+bool log_mapped_file_buffer::map_window(const off_t& offset)
+{
+    unmap_window();
+    m_data_size = offset;
+
+    off_t window_offset = offset - offset % page_size();
+    if(!preallocate(window_offset + static_cast<off_t>(WINDOW_SIZE)))
+    {
+        return false;
+    }
+
+    void* window = mmap(nullptr, WINDOW_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_descriptor,
+            window_offset);
+    if(window == MAP_FAILED)
+    {
+        return false;
+    }
+
+    m_window = static_cast<char*>(window);
+    m_window_offset = window_offset;
+    setp(m_window, m_window + WINDOW_SIZE);
+    pbump(static_cast<int>(offset - window_offset));
+    return true;
+}
+
+/**
+ * Unmaps the window (if there is one), remembering the length of the data.
+ */
+void log_mapped_file_buffer::unmap_window()
+{
+    if(m_window != nullptr)
+    {
+        m_data_size = data_size();
+        munmap(m_window, WINDOW_SIZE);
+        m_window = nullptr;
+        setp(nullptr, nullptr);
+    }
+}
+
+/**
+ * Preallocates the file, in whole extents, so that it is at least the specified length. Filesystems which can't
+ * preallocate have the file extended instead (sparsely).
+ * @param length length the file needs to be.
+ * @returns true on success.
+ */
+bool log_mapped_file_buffer::preallocate(const off_t& length)
+{
+    if(length <= m_allocated_size)
+    {
+        return true;
+    }
+
+    off_t allocated = ((length + EXTENT_SIZE - 1) / EXTENT_SIZE) * EXTENT_SIZE;
+    int result;
+    do
+    {
+        result = fallocate(m_descriptor, 0, m_allocated_size, allocated - m_allocated_size);
+    }
+    while(result != 0 && errno == EINTR);
+    if(result != 0 && (errno != EOPNOTSUPP || ftruncate(m_descriptor, allocated) != 0))
+    {
+        return false;
+    }
+
+    m_allocated_size = allocated;
+    return true;
+}
+
+/**
+ * Finds the end of the data in a file. A file that wasn't closed (the process was killed) is left at its
+ * preallocated length, the data followed by zeros; log files never end in a zero, so the data ends after the last
+ * byte that isn't one.
+ * @param file_size length of the file.
+ * @returns length of the data.
+ */
+off_t log_mapped_file_buffer::find_data_end(const off_t& file_size) const
+{
+    char block[4096];
+    off_t end = file_size;
+    while(end > 0)
+    {
+        off_t start = end > static_cast<off_t>(sizeof(block)) ? end - static_cast<off_t>(sizeof(block)) : 0;
+        ssize_t length = pread(m_descriptor, block, end - start, start);
+        if(length != end - start)
+        {
+            return end;
+        }
+        for(ssize_t i = length; i > 0; i--)
+        {
+            if(block[i - 1] != '\0')
+            {
+                return start + i;
+            }
+        }
+        end = start;
+    }
+    return 0;
+}
+
+/**
+ * Opens the specified file for appending.
+ * The fail bit is set on the stream if the file cannot be opened.
+ * @param file_path path of the file to append to.
+ */
+log_mapped_file_stream::log_mapped_file_stream(const std::string& file_path)
+    : std::ostream(nullptr)
+{
+    // attach the buffer (this clears the bad bit set by the null buffer above).
+    rdbuf(&m_buffer);
+
+    // open the file for appending, flag on failure as std::ofstream would.
+    if(!m_buffer.open(file_path))
+    {
+        setstate(std::ios::failbit);
+    }
+}
+
+} // namespace inglenook::logging
+
+} // namespace inglenook
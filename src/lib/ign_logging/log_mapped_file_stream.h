@@ -0,0 +1,165 @@
+#pragma once
+/*
+ * log_mapped_file_stream.h: Preallocated, memory mapped output stream used by log_writer for log files.
+ * Copyright (C) 2012, Project Inglenook (http://www.project-inglenook.co.uk)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// standard library includes
+#include <ostream>
+#include <streambuf>
+#include <string>
+
+// platform includes
+#include <sys/types.h>
+
+namespace inglenook
+{
+
+namespace logging
+{
+
+/**
+ * Stream buffer appending to a file through a sliding memory mapped window.
+ * The file is grown in large preallocated extents (fallocate), so a long running log is laid out in a few large
+ * pieces rather than in the many small ones a stream of small appends leaves behind on flash storage. Output is
+ * copied straight in to the mapping (the put area is the window), leaving the operating system to write it back;
+ * sync() asks for that to start (msync, MS_ASYNC) and synchronize() waits for it to finish. The file is truncated to
+ * the length of what was written when it is closed; one left at its preallocated length (the process was killed) is
+ * trimmed of its trailing zeros when it is next opened.
+ * Unlike log_file_buffer, only one process may append to a file at a time.
+ */
+class log_mapped_file_buffer : public std::streambuf
+{
+
+    public:
+
+        /// creates a closed buffer.
+        log_mapped_file_buffer();
+
+        /// there is no copy constructor for the log_mapped_file_buffer (deleted).
+        log_mapped_file_buffer(const log_mapped_file_buffer&) = delete;
+
+        /// truncates and closes the file.
+        virtual ~log_mapped_file_buffer();
+
+        // opens the specified file for appending.
+        bool open(const std::string& file_path);
+
+        // truncates the file to the data written and closes it.
+        void close();
+
+        // writes the data back to the file and waits for it to reach the disk (msync, fsync).
+        bool synchronize();
+
+        /// indicates if a file is open.
+        bool is_open() const { return m_descriptor >= 0; }
+
+        /// gets the descriptor of the open file (or -1).
+        int descriptor() const { return m_descriptor; }
+
+        /// gets the start of the mapped window (nullptr if there is none).
+        char* window() const { return m_window; }
+
+        /// gets the offset in the file of the start of the mapped window.
+        off_t window_offset() const { return m_window_offset; }
+
+        /// gets the size of the mapped window.
+        std::size_t window_size() const { return m_window != nullptr ? WINDOW_SIZE : 0; }
+
+        /// gets the length of the data in the file (the file itself is preallocated beyond it).
+        off_t data_size() const { return m_window != nullptr ? m_window_offset + (pptr() - m_window) : m_data_size; }
+
+        /// gets the length the file has been preallocated to.
+        off_t allocated_size() const { return m_allocated_size; }
+
+        /// size of the extents the file is grown by.
+        static const off_t EXTENT_SIZE = 4 * 1024 * 1024;
+
+        /// size of the window mapped at the end of the data.
+        static const std::size_t WINDOW_SIZE = 1024 * 1024;
+
+    protected:
+
+        // moves the window along, and stores the character if one is provided.
+        virtual int_type overflow(int_type character);
+
+        // copies a block of characters in to the window.
+        virtual std::streamsize xsputn(const char_type* data, std::streamsize count);
+
+        // starts writing the data back to the file (msync, MS_ASYNC).
+        virtual int sync();
+
+    private:
+
+        /// maps the window from the page holding the specified offset.
+        bool map_window(const off_t& offset);
+
+        /// unmaps the window.
+        void unmap_window();
+
+        /// preallocates the file up to (at least) the specified length.
+        bool preallocate(const off_t& length);
+
+        /// finds the end of the data in a file, before any zeros left by preallocation.
+        off_t find_data_end(const off_t& file_size) const;
+
+        /// descriptor of the open file.
+        int m_descriptor;
+
+        /// the mapped window (the put area).
+        char* m_window;
+
+        /// offset in the file of the start of the window.
+        off_t m_window_offset;
+
+        /// length of the data in the file whilst there is no window.
+        off_t m_data_size;
+
+        /// length the file has been preallocated to.
+        off_t m_allocated_size;
+
+        /// offset in the file up to which writing back has been started (see sync()).
+        off_t m_synced_size;
+
+};
+
+/**
+ * Output stream appending to a log file through a log_mapped_file_buffer.
+ */
+class log_mapped_file_stream : public std::ostream
+{
+
+    public:
+
+        // opens the specified file for appending.
+        log_mapped_file_stream(const std::string& file_path);
+
+        /// gets the underlying file buffer.
+        const log_mapped_file_buffer& file_buffer() const { return m_buffer; }
+
+        /// gets the underlying file buffer.
+        log_mapped_file_buffer& file_buffer() { return m_buffer; }
+
+    private:
+
+        /// buffer backing this stream.
+        log_mapped_file_buffer m_buffer;
+
+};
+
+} // namespace inglenook::logging
+
+} // namespace inglenook
@@ -0,0 +1,470 @@
+/*
+ * log_record.cpp: Compact binary encoding of log entries passed between processes.
+ * Copyright (C) 2012, Project Inglenook (http://www.project-inglenook.co.uk)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// inglenook includes
+#include "log_record.h"
+
+// standard library includes
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+
+namespace inglenook
+{
+
+namespace logging
+{
+
+//--------------------------------------------------------//
+// Hide the implementation in the anonymous namespace.
+namespace
+{
+
+    /// fixed size portion at the start of every record.
+    struct record_header
+    {
+        /// category of the entry.
+        std::uint32_t entry_type;
+
+        /// length of the namespace.
+        std::uint32_t namespace_length;
+
+        /// length of the message.
+        std::uint32_t message_length;
+
+        /// number of extended data items.
+        std::uint32_t extended_count;
+
+        /// number of typed extended data items.
+        std::uint32_t field_count;
+
+        /// number of attachments.
+        std::uint32_t attachment_count;
+
+        /// line of the call site (the call site's file and function follow the message, see log_entry::source()).
+        std::uint32_t source_line;
+
+        /// length of the call site's file (0 with no function if the call site isn't known).
+        std::uint32_t source_file_length;
+
+        /// length of the call site's function.
+        std::uint32_t source_function_length;
+
+        /// time the entry was made (microseconds since the unix epoch, UTC).
+        std::int64_t timestamp;
+    };
+
+    /// fixed size portion at the start of every extended data item.
+    struct record_item_header
+    {
+        /// length of the key.
+        std::uint32_t key_length;
+
+        /// length of the value.
+        std::uint32_t value_length;
+    };
+
+    /// fixed size portion at the start of every typed extended data item (the value is held as is).
+    struct record_field_header
+    {
+        /// length of the key.
+        std::uint32_t key_length;
+
+        /// type of the value (see field_type).
+        std::uint32_t type;
+
+        /// bits of the value (see log_field::bits()).
+        std::uint64_t bits;
+    };
+
+    /// fixed size portion at the start of every attachment (the bytes held follow the name).
+    struct record_attachment_header
+    {
+        /// length of the name.
+        std::uint32_t name_length;
+
+        /// how the attachment is written out (see attachment_encoding).
+        std::uint32_t encoding;
+
+        /// number of bytes held.
+        std::uint64_t length;
+
+        /// number of bytes attached (see log_attachment::size()).
+        std::uint64_t size;
+    };
+
+    /// the unix epoch, records store time relative to this.
+    const boost::posix_time::ptime epoch(boost::gregorian::date(1970, 1, 1));
+
+}
+//--------------------------------------------------------//
+
+/**
+ * Gets the number of bytes required to encode an entry.
+ * @param entry entry to measure.
+ * @returns size of the encoded record in bytes.
+ */
+std::size_t log_record::encoded_size(log_entry& entry)
+{
+    std::size_t size = sizeof(record_header) + entry.log_namespace().length() + entry.message().length();
+
+    auto source = entry.source();
+    if(source != nullptr)
+    {
+        size += (source->file == nullptr ? 0 : std::strlen(source->file)) +
+                (source->function == nullptr ? 0 : std::strlen(source->function));
+    }
+
+    auto& extended_data = entry.extended_data();
+    for(auto data = extended_data.begin(); data != extended_data.end(); data++)
+    {
+        size += sizeof(record_item_header) + data->first.length() + data->second.length();
+    }
+
+    auto& fields = entry.fields();
+    for(auto field = fields.begin(); field != fields.end(); field++)
+    {
+        size += sizeof(record_field_header) + field->first.length();
+    }
+
+    // (the pairs of the entry's context are held as the entry's own data.)
+    for(auto item = entry.context().get(); item != nullptr; item = item->parent().get())
+    {
+        if(!entry.context_hidden(*item))
+        {
+            size += item->value().type() == field_string ?
+                    sizeof(record_item_header) + item->key().length() + item->value().string_value().length() :
+                    sizeof(record_field_header) + item->key().length();
+        }
+    }
+
+    auto& attachments = entry.attachments();
+    for(auto attachment = attachments.begin(); attachment != attachments.end(); attachment++)
+    {
+        size += sizeof(record_attachment_header) + attachment->name().length() + attachment->length();
+    }
+
+    return size;
+}
+
+/**
+ * Encodes an entry in to the specified buffer.
+ * If the entry has not been timestamped, the current time is recorded.
+ * @param entry entry to encode.
+ * @param destination buffer to encode the entry in to.
+ * @param capacity size of the buffer.
+ * @returns number of bytes written, or 0 if the buffer was too small.
+ */
+std::size_t log_record::encode(log_entry& entry, char* destination, const std::size_t& capacity)
+{
+    std::size_t size = encoded_size(entry);
+    if(size > capacity)
+    {
+        return 0;
+    }
+
+    // stamp the entry now if it hasn't been already, the receiver will get to it later.
+    auto timestamp = entry.timestamp().is_not_a_date_time() ?
+            boost::posix_time::microsec_clock::universal_time() : entry.timestamp();
+
+    // write the header...
+    record_header header;
+    header.entry_type = entry.entry_type();
+    header.namespace_length = entry.log_namespace().length();
+    header.message_length = entry.message().length();
+    header.extended_count = entry.extended_data().size();
+    header.field_count = entry.fields().size();
+    for(auto item = entry.context().get(); item != nullptr; item = item->parent().get())
+    {
+        if(!entry.context_hidden(*item))
+        {
+            (item->value().type() == field_string ? header.extended_count : header.field_count)++;
+        }
+    }
+    header.attachment_count = entry.attachments().size();
+    auto source = entry.source();
+    header.source_line = source == nullptr ? 0 : source->line;
+    header.source_file_length = source == nullptr || source->file == nullptr ? 0 : std::strlen(source->file);
+    header.source_function_length = source == nullptr || source->function == nullptr ? 0 : std::strlen(source->function);
+    header.timestamp = (timestamp - epoch).total_microseconds();
+    std::memcpy(destination, &header, sizeof(header));
+    destination += sizeof(header);
+
+    // ... the namespace and message ...
+    std::memcpy(destination, entry.log_namespace().data(), header.namespace_length);
+    destination += header.namespace_length;
+    std::memcpy(destination, entry.message().data(), header.message_length);
+    destination += header.message_length;
+
+    // ... the call site (as text, the receiver holds its own copy of each call site) ...
+    if(header.source_file_length > 0)
+    {
+        std::memcpy(destination, source->file, header.source_file_length);
+        destination += header.source_file_length;
+    }
+    if(header.source_function_length > 0)
+    {
+        std::memcpy(destination, source->function, header.source_function_length);
+        destination += header.source_function_length;
+    }
+
+    // ... and the extended data.
+    auto& extended_data = entry.extended_data();
+    for(auto data = extended_data.begin(); data != extended_data.end(); data++)
+    {
+        record_item_header item;
+        item.key_length = data->first.length();
+        item.value_length = data->second.length();
+        std::memcpy(destination, &item, sizeof(item));
+        destination += sizeof(item);
+        std::memcpy(destination, data->first.data(), item.key_length);
+        destination += item.key_length;
+        std::memcpy(destination, data->second.data(), item.value_length);
+        destination += item.value_length;
+    }
+
+    // ... the text pairs of the context (the receiver takes them as the entry's own) ...
+    auto& context = entry.context();
+    for(auto pair = context.get(); pair != nullptr; pair = pair->parent().get())
+    {
+        if(pair->value().type() != field_string || entry.context_hidden(*pair))
+        {
+            continue;
+        }
+        record_item_header item;
+        item.key_length = pair->key().length();
+        item.value_length = pair->value().string_value().length();
+        std::memcpy(destination, &item, sizeof(item));
+        destination += sizeof(item);
+        std::memcpy(destination, pair->key().data(), item.key_length);
+        destination += item.key_length;
+        std::memcpy(destination, pair->value().string_value().data(), item.value_length);
+        destination += item.value_length;
+    }
+
+    // ... and typed extended data.
+    auto& fields = entry.fields();
+    for(auto field = fields.begin(); field != fields.end(); field++)
+    {
+        record_field_header item;
+        item.key_length = field->first.length();
+        item.type = field->second.type();
+        item.bits = field->second.bits();
+        std::memcpy(destination, &item, sizeof(item));
+        destination += sizeof(item);
+        std::memcpy(destination, field->first.data(), item.key_length);
+        destination += item.key_length;
+    }
+
+    // ... and the typed pairs of the context.
+    for(auto pair = context.get(); pair != nullptr; pair = pair->parent().get())
+    {
+        if(pair->value().type() == field_string || entry.context_hidden(*pair))
+        {
+            continue;
+        }
+        record_field_header item;
+        item.key_length = pair->key().length();
+        item.type = pair->value().type();
+        item.bits = pair->value().bits();
+        std::memcpy(destination, &item, sizeof(item));
+        destination += sizeof(item);
+        std::memcpy(destination, pair->key().data(), item.key_length);
+        destination += item.key_length;
+    }
+
+    // ... and the attachments.
+    auto& attachments = entry.attachments();
+    for(auto attachment = attachments.begin(); attachment != attachments.end(); attachment++)
+    {
+        record_attachment_header item;
+        item.name_length = attachment->name().length();
+        item.encoding = attachment->encoding();
+        item.length = attachment->length();
+        item.size = attachment->size();
+        std::memcpy(destination, &item, sizeof(item));
+        destination += sizeof(item);
+        std::memcpy(destination, attachment->name().data(), item.name_length);
+        destination += item.name_length;
+        if(item.length > 0)
+        {
+            std::memcpy(destination, attachment->data(), item.length);
+            destination += item.length;
+        }
+    }
+
+    return size;
+}
+
+/**
+ * Decodes an entry from the specified buffer.
+ * @param source buffer holding the record.
+ * @param length number of bytes in the buffer.
+ * @returns decoded entry, or nullptr if the buffer does not hold a valid record.
+ */
+std::shared_ptr<log_entry> log_record::decode(const char* source, const std::size_t& length)
+{
+    const char* end = source + length;
+
+    // read the header...
+    record_header header;
+    if(length < sizeof(header))
+    {
+        return nullptr;
+    }
+    std::memcpy(&header, source, sizeof(header));
+    source += sizeof(header);
+
+    // ... make sure the namespace, message and call site are all there ...
+    if(static_cast<std::size_t>(end - source) < static_cast<std::size_t>(header.namespace_length) + header.message_length +
+            header.source_file_length + header.source_function_length)
+    {
+        return nullptr;
+    }
+
+    auto entry = std::shared_ptr<log_entry>(new log_entry());
+    entry->entry_type(static_cast<category>(header.entry_type));
+    entry->timestamp(epoch + boost::posix_time::microseconds(header.timestamp));
+    entry->log_namespace(std::string(source, header.namespace_length));
+    source += header.namespace_length;
+    entry->message(std::string(source, header.message_length));
+    source += header.message_length;
+
+    // ... the call site (held once, however many records name it) ...
+    if(header.source_line > 0 || header.source_file_length > 0 || header.source_function_length > 0)
+    {
+        std::string file(source, header.source_file_length);
+        source += header.source_file_length;
+        std::string function(source, header.source_function_length);
+        source += header.source_function_length;
+        entry->source(log_source_location::intern(file, header.source_line, function));
+    }
+
+    // ... and read each of the extended data items.
+    for(std::uint32_t i = 0; i < header.extended_count; i++)
+    {
+        record_item_header item;
+        if(static_cast<std::size_t>(end - source) < sizeof(item))
+        {
+            return nullptr;
+        }
+        std::memcpy(&item, source, sizeof(item));
+        source += sizeof(item);
+
+        if(static_cast<std::size_t>(end - source) < static_cast<std::size_t>(item.key_length) + item.value_length)
+        {
+            return nullptr;
+        }
+        std::string key(source, item.key_length);
+        source += item.key_length;
+        entry->extended_data(key, std::string(source, item.value_length));
+        source += item.value_length;
+    }
+
+    // ... and each of the typed extended data items.
+    for(std::uint32_t i = 0; i < header.field_count; i++)
+    {
+        record_field_header item;
+        if(static_cast<std::size_t>(end - source) < sizeof(item))
+        {
+            return nullptr;
+        }
+        std::memcpy(&item, source, sizeof(item));
+        source += sizeof(item);
+
+        log_field field;
+        if(static_cast<std::size_t>(end - source) < item.key_length ||
+           !log_field::from_bits(static_cast<field_type>(item.type), item.bits, field))
+        {
+            return nullptr;
+        }
+        entry->field(std::string(source, item.key_length), field);
+        source += item.key_length;
+    }
+
+    // ... and each of the attachments.
+    for(std::uint32_t i = 0; i < header.attachment_count; i++)
+    {
+        record_attachment_header item;
+        if(static_cast<std::size_t>(end - source) < sizeof(item))
+        {
+            return nullptr;
+        }
+        std::memcpy(&item, source, sizeof(item));
+        source += sizeof(item);
+
+        if(static_cast<std::size_t>(end - source) < item.name_length ||
+           static_cast<std::size_t>(end - source) - item.name_length < item.length ||
+           item.encoding > attachment_base64)
+        {
+            return nullptr;
+        }
+        std::string name(source, item.name_length);
+        source += item.name_length;
+        log_attachment attachment(name, source, item.length, static_cast<attachment_encoding>(item.encoding));
+        attachment.size(item.size);
+        entry->attachment(attachment);
+        source += item.length;
+    }
+
+    return entry;
+}
+
+/**
+ * Trims an entry so that it encodes in no more than the specified size. Attachments are trimmed first, last attached
+ * first (trimmed attachments remember their size, see log_attachment::truncated()), then the message. Entries with
+ * a trimmed message are marked with the extended data item "inglenook.logging.truncated", holding the original
+ * message length.
+ * @param entry entry to trim.
+ * @param maximum_size largest encoded size allowed.
+ */
+void log_record::truncate(log_entry& entry, const std::size_t& maximum_size)
+{
+    std::size_t encoded = encoded_size(entry);
+    if(encoded <= maximum_size)
+    {
+        return;
+    }
+
+    if(!entry.attachments().empty())
+    {
+        std::size_t excess = encoded - maximum_size;
+        auto attachments = entry.attachments();
+        for(auto attachment = attachments.rbegin(); attachment != attachments.rend() && excess > 0; attachment++)
+        {
+            std::size_t trim = std::min(attachment->length(), excess);
+            attachment->truncate(attachment->length() - trim);
+            excess -= trim;
+        }
+        entry.attachments(attachments);
+        if(excess == 0)
+        {
+            return;
+        }
+    }
+
+    std::string message = entry.message();
+    entry.extended_data("inglenook.logging.truncated", std::to_string(message.length()));
+    std::size_t size = encoded_size(entry);
+    message.resize(message.length() - std::min(message.length(), size - std::min(size, maximum_size)));
+    entry.message(message);
+}
+
+} // namespace inglenook::logging
+
+} // namespace inglenook
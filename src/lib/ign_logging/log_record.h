@@ -0,0 +1,64 @@
+#pragma once
+/*
+ * log_record.h: Compact binary encoding of log entries passed between processes.
+ * Copyright (C) 2012, Project Inglenook (http://www.project-inglenook.co.uk)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// standard library includes
+#include <memory>
+#include <cstddef>
+
+// inglenook includes
+#include "log_entry.h"
+
+namespace inglenook
+{
+
+namespace logging
+{
+
+/**
+ * The log_record class converts log entries to and from a compact binary record.
+ * Records are used to pass entries between processes on the same host (for example from a client process to the
+ * logging service daemon), so are encoded in native byte order. A record holds the category, time, namespace,
+ * message, call site, extended data (with the pairs of its context) and attachments of an entry (typed values and
+ * attachments are kept as they are); formatting is left to whoever receives it.
+ */
+class log_record
+{
+
+    public:
+
+        /// there is no default constructor for this class (all members are static).
+        log_record() = delete;
+
+        // gets the number of bytes required to encode an entry.
+        static std::size_t encoded_size(log_entry& entry);
+
+        // encodes an entry in to the specified buffer.
+        static std::size_t encode(log_entry& entry, char* destination, const std::size_t& capacity);
+
+        // decodes an entry from the specified buffer.
+        static std::shared_ptr<log_entry> decode(const char* source, const std::size_t& length);
+
+        // trims the attachments and message of an entry so it encodes in no more than the specified size.
+        static void truncate(log_entry& entry, const std::size_t& maximum_size);
+
+};
+
+} // namespace inglenook::logging
+
+} // namespace inglenook
@@ -0,0 +1,98 @@
+#pragma once
+/*
+* log_record_tests.h: Test routines for the log_record class (log_record.cpp/h)
+* Copyright (C) 2012, Project Inglenook (http://www.project-inglenook.co.uk)
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE LOG_TEST_NAME
+
+// standard includes
+#include <vector>
+
+// boost (http://boost.org) includes
+#include <boost/test/unit_test.hpp>
+
+// inglenook includes
+#include "log_record.h"
+
+namespace inglenook
+{
+
+namespace logging
+{
+
+//
+// log_record_tests__round_trip
+// checks that every part of an entry survives being encoded and decoded, and
+// that an entry is stamped with the current time if it has not been already.
+BOOST_AUTO_TEST_CASE ( log_record_tests__round_trip )
+{
+    log_entry entry;
+    entry.entry_type(category::warning);
+    entry.log_namespace("inglenook.logging.test");
+    entry.message(std::string("message with \0 embedded", 23));
+    entry.extended_data("first.key", "first value");
+    entry.extended_data("second.key", "second value");
+
+    // unstamped entries are given the current time.
+    auto before = boost::posix_time::microsec_clock::universal_time();
+    std::vector<char> buffer(log_record::encoded_size(entry));
+    BOOST_CHECK(log_record::encode(entry, buffer.data(), buffer.size()) == buffer.size());
+    auto after = boost::posix_time::microsec_clock::universal_time();
+
+    auto decoded = log_record::decode(buffer.data(), buffer.size());
+    BOOST_REQUIRE(decoded != nullptr);
+    BOOST_CHECK(decoded->entry_type() == category::warning);
+    BOOST_CHECK(decoded->log_namespace() == "inglenook.logging.test");
+    BOOST_CHECK(decoded->message() == entry.message());
+    BOOST_CHECK(decoded->extended_data().size() == 2);
+    BOOST_CHECK(decoded->extended_data().at("first.key") == "first value");
+    BOOST_CHECK(decoded->extended_data().at("second.key") == "second value");
+    BOOST_CHECK(decoded->timestamp() >= before && decoded->timestamp() <= after);
+
+    // stamped entries keep their time.
+    auto timestamp = boost::posix_time::ptime(boost::gregorian::date(2012, 6, 1), boost::posix_time::microseconds(123456789));
+    entry.timestamp(timestamp);
+    log_record::encode(entry, buffer.data(), buffer.size());
+    BOOST_CHECK(log_record::decode(buffer.data(), buffer.size())->timestamp() == timestamp);
+}
+
+//
+// log_record_tests__invalid
+// checks that buffers too small to encode in to are refused, and that truncated
+// records are not decoded.
+BOOST_AUTO_TEST_CASE ( log_record_tests__invalid )
+{
+    log_entry entry;
+    entry.entry_type(category::information);
+    entry.log_namespace("inglenook.logging.test");
+    entry.message("message");
+    entry.extended_data("key", "value");
+
+    std::vector<char> buffer(log_record::encoded_size(entry));
+    BOOST_CHECK(log_record::encode(entry, buffer.data(), buffer.size() - 1) == 0);
+    BOOST_CHECK(log_record::encode(entry, buffer.data(), buffer.size()) == buffer.size());
+
+    for(std::size_t length = 0; length < buffer.size(); length++)
+    {
+        BOOST_CHECK(log_record::decode(buffer.data(), length) == nullptr);
+    }
+}
+
+} // namespace inglenook::logging
+
+} // namespace inglenook
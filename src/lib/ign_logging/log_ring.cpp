@@ -0,0 +1,632 @@
+/*
+ * log_ring.cpp: Shared memory ring used to pass log entries to the logging service daemon.
+ * Copyright (C) 2012, Project Inglenook (http://www.project-inglenook.co.uk)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// inglenook includes
+#include "log_ring.h"
+#include "log_record.h"
+#include "log_exceptions.h"
+#include "log_span.h"
+#include <ign_directories/directories.h>
+
+// standard library includes
+#include <atomic>
+#include <cstring>
+#include <ctime>
+#include <new>
+#include <vector>
+
+// boost (http://boost.org) includes
+#include <boost/exception/all.hpp>
+
+// platform includes
+#include <fcntl.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace inglenook
+{
+
+namespace logging
+{
+
+/// default size of the record area (bytes, must be a power of two).
+const std::size_t log_ring::DEFAULT_CAPACITY;
+
+/// the daemon is considered gone if it hasn't stamped a ring for this long.
+const int log_ring::COLLECTOR_TIMEOUT;
+
+/// file name of the daemon's heartbeat file in the ring directory.
+const char* const log_ring::COLLECTOR_HEARTBEAT_FILE = "collector.heartbeat";
+
+/// extension of ring files.
+const char* const log_ring::RING_FILE_EXTENSION = ".ring";
+
+/// size reserved for the process name in the ring header.
+const std::size_t RING_PROCESS_NAME_LENGTH = 256;
+
+/**
+ * Layout of the shared header at the start of a ring file.
+ * Counters are free running byte positions; the record area offset is the position modulo the capacity. Members
+ * written by different sides are kept on separate cache lines.
+ */
+struct log_ring_header
+{
+    /// identifies the file as a log ring (written last during creation).
+    std::atomic<std::uint32_t> magic;
+
+    /// layout version of the ring.
+    std::uint32_t version;
+
+    /// size of the record area in bytes (power of two).
+    std::uint64_t capacity;
+
+    /// process id of the process that created the ring.
+    std::int64_t pid;
+
+    /// name of the process that created the ring (null terminated).
+    char process_name[RING_PROCESS_NAME_LENGTH];
+
+    /// position up to which space has been reserved by clients.
+    alignas(64) std::atomic<std::uint64_t> reserved;
+
+    /// position up to which records have been consumed and space given back by the daemon.
+    alignas(64) std::atomic<std::uint64_t> released;
+
+    /// last time the daemon collected from the ring (CLOCK_MONOTONIC milliseconds).
+    alignas(64) std::atomic<std::int64_t> heartbeat;
+
+    /// non zero once the client has finished with the ring.
+    std::atomic<std::uint32_t> closed;
+};
+
+//--------------------------------------------------------//
+// Hide the implementation in the anonymous namespace.
+namespace
+{
+
+    /// identifies a log ring file ("ILOG").
+    const std::uint32_t RING_MAGIC = 0x474f4c49;
+
+    /// current layout version.
+    const std::uint32_t RING_VERSION = 1;
+
+    /// space reserved for the header at the start of the file (the record area starts page aligned).
+    const std::size_t RING_HEADER_SIZE = 4096;
+
+    /// smallest record area allowed.
+    const std::size_t RING_MINIMUM_CAPACITY = 4096;
+
+    /// record slot has been reserved but not yet committed (or is free).
+    const std::uint32_t RECORD_EMPTY = 0;
+
+    /// record slot holds a committed log_record.
+    const std::uint32_t RECORD_COMMITTED = 1;
+
+    /// record slot is padding up to the end of the record area.
+    const std::uint32_t RECORD_PADDING = 2;
+
+    /// header at the start of every record slot.
+    struct record_header
+    {
+        /// state of the slot (RECORD_*), written last by the client.
+        std::atomic<std::uint32_t> state;
+
+        /// length of the record following this header.
+        std::uint32_t length;
+    };
+
+    /**
+     * Rounds a size up to the record slot alignment.
+     * @param size size to round.
+     * @returns rounded size.
+     */
+    std::uint64_t slot_size(const std::uint64_t& size)
+    {
+        return (size + 7) & ~static_cast<std::uint64_t>(7);
+    }
+
+    /**
+     * Gets the current time from the monotonic clock (shared by every process on the host).
+     * @returns milliseconds since an arbitrary point.
+     */
+    std::int64_t monotonic_ms()
+    {
+        return log_tracer::now() / 1000000;
+    }
+
+}
+//--------------------------------------------------------//
+
+static_assert(sizeof(log_ring_header) <= RING_HEADER_SIZE, "log_ring_header must fit in the reserved header space");
+
+/**
+ * Maps an open ring file. The descriptor is closed once the file is mapped.
+ * @param ring_file path of the ring file.
+ * @param descriptor descriptor of the open ring file.
+ * @param owner indicates if this side created the ring.
+ */
+log_ring::log_ring(const boost::filesystem::path& ring_file, const int& descriptor, const bool& owner) :
+    m_file(ring_file),
+    m_header(nullptr),
+    m_records(nullptr),
+    m_mapped_size(0),
+    m_owner(owner)
+{
+    using namespace inglenook::core::exceptions;
+    const unsigned long error_number = owner ? log_exception_ring_create : log_exception_ring_open;
+
+    // find out how much there is to map...
+    struct stat file_status;
+    if(fstat(descriptor, &file_status) != 0 || static_cast<std::size_t>(file_status.st_size) < RING_HEADER_SIZE + RING_MINIMUM_CAPACITY)
+    {
+        ::close(descriptor);
+        BOOST_THROW_EXCEPTION(log_ring_exception()
+                << inglenook_error_number(error_number)
+                << log_file_name(ring_file));
+    }
+
+    // ... and map it.
+    void* mapping = mmap(nullptr, file_status.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, descriptor, 0);
+    int mapping_error = errno;
+    ::close(descriptor);
+    if(mapping == MAP_FAILED)
+    {
+        BOOST_THROW_EXCEPTION(log_ring_exception()
+                << inglenook_error_number(error_number)
+                << c_error_number(mapping_error)
+                << log_file_name(ring_file));
+    }
+
+    m_mapped_size = file_status.st_size;
+    m_header = static_cast<log_ring_header*>(mapping);
+    m_records = static_cast<char*>(mapping) + RING_HEADER_SIZE;
+}
+
+/**
+ * Creates a new ring for the calling process to push entries in to. Any existing file is replaced.
+ * @param ring_file path of the ring file to create.
+ * @param pid process id of the process creating the ring.
+ * @param process_name name of the process creating the ring.
+ * @param capacity size of the record area (bytes, must be a power of two no smaller than 4KiB).
+ * @returns shared pointer to the new ring.
+ */
+std::shared_ptr<log_ring> log_ring::create(const boost::filesystem::path& ring_file,
+        const pid_type& pid, const std::string& process_name, const std::size_t& capacity)
+{
+    using namespace inglenook::core::exceptions;
+
+    // the ring relies on the capacity being a power of two to wrap cheaply.
+    if(capacity < RING_MINIMUM_CAPACITY || (capacity & (capacity - 1)) != 0)
+    {
+        BOOST_THROW_EXCEPTION(log_ring_exception()
+                << inglenook_error_number(log_exception_ring_create)
+                << log_file_name(ring_file));
+    }
+
+    // make sure the ring directory exists.
+    boost::system::error_code filesystem_error;
+    auto parent_directory = boost::filesystem::absolute(ring_file).parent_path();
+    if(!boost::filesystem::exists(parent_directory) && !boost::filesystem::create_directories(parent_directory, filesystem_error))
+    {
+        BOOST_THROW_EXCEPTION(log_ring_exception()
+                << boost_filesystem_error(filesystem_error)
+                << inglenook_error_number(log_exception_ring_create)
+                << log_file_name(ring_file));
+    }
+
+    // create the file at the required size (the record area starts out zeroed, as it must).
+    int descriptor = ::open(ring_file.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0660);
+    if(descriptor < 0 || ftruncate(descriptor, RING_HEADER_SIZE + capacity) != 0)
+    {
+        int file_error = errno;
+        if(descriptor >= 0)
+        {
+            ::close(descriptor);
+        }
+        BOOST_THROW_EXCEPTION(log_ring_exception()
+                << c_error_number(file_error)
+                << inglenook_error_number(log_exception_ring_create)
+                << log_file_name(ring_file));
+    }
+
+    auto ring = std::shared_ptr<log_ring>(new log_ring(ring_file, descriptor, true));
+
+    // fill out the header, the daemon won't touch it until the magic number is in place.
+    auto header = new (ring->m_header) log_ring_header();
+    header->version = RING_VERSION;
+    header->capacity = capacity;
+    header->pid = pid;
+    std::strncpy(header->process_name, process_name.c_str(), RING_PROCESS_NAME_LENGTH - 1);
+    header->reserved.store(0, std::memory_order_relaxed);
+    header->released.store(0, std::memory_order_relaxed);
+    header->closed.store(0, std::memory_order_relaxed);
+
+    // give the daemon a chance to find the ring before clients consider it absent.
+    header->heartbeat.store(monotonic_ms(), std::memory_order_relaxed);
+    header->magic.store(RING_MAGIC, std::memory_order_release);
+
+    return ring;
+}
+
+/**
+ * Opens a ring created by another process, so entries can be collected from it.
+ * @param ring_file path of the ring file to open.
+ * @returns shared pointer to the opened ring.
+ */
+std::shared_ptr<log_ring> log_ring::open(const boost::filesystem::path& ring_file)
+{
+    using namespace inglenook::core::exceptions;
+
+    int descriptor = ::open(ring_file.c_str(), O_RDWR | O_CLOEXEC);
+    if(descriptor < 0)
+    {
+        BOOST_THROW_EXCEPTION(log_ring_exception()
+                << c_error_number(errno)
+                << inglenook_error_number(log_exception_ring_open)
+                << log_file_name(ring_file));
+    }
+
+    auto ring = std::shared_ptr<log_ring>(new log_ring(ring_file, descriptor, false));
+
+    // make sure this really is a (completely initialized) ring.
+    auto header = ring->m_header;
+    if(header->magic.load(std::memory_order_acquire) != RING_MAGIC ||
+       header->version != RING_VERSION ||
+       header->capacity + RING_HEADER_SIZE != ring->m_mapped_size ||
+       (header->capacity & (header->capacity - 1)) != 0)
+    {
+        BOOST_THROW_EXCEPTION(log_ring_exception()
+                << inglenook_error_number(log_exception_ring_open)
+                << log_file_name(ring_file));
+    }
+
+    return ring;
+}
+
+/**
+ * Gets the directory rings are created in, and in which the daemon looks for them.
+ * @returns ring directory (under directories::tmp()).
+ */
+boost::filesystem::path log_ring::default_ring_directory()
+{
+    return inglenook::directories::tmp() / "log-rings";
+}
+
+/**
+ * Gets the ring file for the specified process.
+ * @param pid process id of the process.
+ * @returns path of the processes ring file.
+ */
+boost::filesystem::path log_ring::default_ring_file(const pid_type& pid)
+{
+    return default_ring_directory() / (std::to_string(pid) + RING_FILE_EXTENSION);
+}
+
+/**
+ * Indicates if the logging service daemon appears to be running, based on its heartbeat file.
+ * @param ring_directory directory the daemon is collecting rings from.
+ * @returns true if the daemon has stamped its heartbeat recently.
+ */
+bool log_ring::collector_running(const boost::filesystem::path& ring_directory)
+{
+    boost::system::error_code filesystem_error;
+    auto heartbeat_file = ring_directory / COLLECTOR_HEARTBEAT_FILE;
+    std::time_t last_heartbeat = boost::filesystem::last_write_time(heartbeat_file, filesystem_error);
+    if(filesystem_error)
+    {
+        return false;
+    }
+
+    return std::difftime(std::time(nullptr), last_heartbeat) * 1000 < COLLECTOR_TIMEOUT;
+}
+
+/**
+ * Stamps the daemon's heartbeat file, so new clients know the daemon is running.
+ * @param ring_directory directory the daemon is collecting rings from.
+ */
+void log_ring::collector_heartbeat(const boost::filesystem::path& ring_directory)
+{
+    auto heartbeat_file = ring_directory / COLLECTOR_HEARTBEAT_FILE;
+
+    // create the file if this is the first beat...
+    if(!boost::filesystem::exists(heartbeat_file))
+    {
+        boost::filesystem::create_directories(ring_directory);
+        int descriptor = ::open(heartbeat_file.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+        if(descriptor >= 0)
+        {
+            ::close(descriptor);
+        }
+    }
+
+    // ... otherwise just touch it.
+    boost::system::error_code filesystem_error;
+    boost::filesystem::last_write_time(heartbeat_file, std::time(nullptr), filesystem_error);
+}
+
+/**
+ * Unmaps the ring.
+ * On the creating side the ring is closed first, and if there is nothing left in it for the daemon to collect
+ * (or no daemon to collect it) the file is removed. The daemon removes rings it has finished collecting.
+ */
+log_ring::~log_ring()
+{
+    if(m_owner)
+    {
+        close();
+
+        // nobody is going to clean up after us...
+        if(empty() && !collector_alive())
+        {
+            boost::system::error_code filesystem_error;
+            boost::filesystem::remove(m_file, filesystem_error);
+        }
+    }
+
+    munmap(m_header, m_mapped_size);
+}
+
+/**
+ * Pushes an entry in to the ring.
+ * Space is reserved with a compare-and-swap on the reservation counter, the entry is encoded directly in to the
+ * mapped record area and the record is then committed. Safe to call from any number of threads concurrently; no
+ * locks are taken and no system calls are made.
+ * @param entry entry to push.
+ * @returns true if the entry was pushed, false if there was not enough free space (or the entry is too large).
+ */
+bool log_ring::push(log_entry& entry)
+{
+    log_entry* entries[] = { &entry };
+    std::size_t lengths[] = { log_record::encoded_size(entry) };
+    return _push(entries, lengths, 1);
+}
+
+/**
+ * Pushes a group of entries in to the ring, one after another.
+ * Space for the whole group is reserved with a single compare-and-swap, so no other thread's entries can come
+ * between its members and the daemon pops them together. Together the encoded entries can be no larger than the
+ * largest single entry (see max_entry_size()). Thread safe, as push().
+ * @param entries entries to push, in order.
+ * @returns true if the entries were pushed, false if there was not enough free space (or the group is too large).
+ */
+bool log_ring::push(const std::vector<std::shared_ptr<log_entry>>& entries)
+{
+    std::vector<log_entry*> members;
+    std::vector<std::size_t> lengths;
+    members.reserve(entries.size());
+    lengths.reserve(entries.size());
+    for(auto entry = entries.begin(); entry != entries.end(); entry++)
+    {
+        members.push_back(entry->get());
+        lengths.push_back(log_record::encoded_size(**entry));
+    }
+    return members.empty() || _push(members.data(), lengths.data(), members.size());
+}
+
+/**
+ * Reserves space for, encodes and commits a run of records (see push()).
+ * @param entries entries to push, in order.
+ * @param lengths encoded size of each entry.
+ * @param count number of entries.
+ * @returns true if the entries were pushed, false if there was not enough free space (or they are too large).
+ */
+bool log_ring::_push(log_entry* const* entries, const std::size_t* lengths, const std::size_t& count)
+{
+    const std::uint64_t capacity = m_header->capacity;
+    std::uint64_t run_length = 0;
+    std::uint64_t run_size = 0;
+    for(std::size_t i = 0; i < count; i++)
+    {
+        run_length += lengths[i];
+        run_size += slot_size(sizeof(record_header) + lengths[i]);
+    }
+
+    // runs larger than this can never be pushed.
+    if(run_length > max_entry_size())
+    {
+        return false;
+    }
+
+    // reserve space for the records (and padding, if they won't fit before the end of the record area).
+    std::uint64_t position = m_header->reserved.load(std::memory_order_relaxed);
+    std::uint64_t padding = 0;
+    do
+    {
+        std::uint64_t offset = position & (capacity - 1);
+        padding = (capacity - offset < run_size) ? capacity - offset : 0;
+
+        // make sure the daemon has given back enough space.
+        if(position + padding + run_size - m_header->released.load(std::memory_order_acquire) > capacity)
+        {
+            return false;
+        }
+    }
+    while(!m_header->reserved.compare_exchange_weak(position, position + padding + run_size,
+            std::memory_order_acq_rel, std::memory_order_relaxed));
+
+    // publish the padding, if there is any.
+    if(padding > 0)
+    {
+        auto padding_record = reinterpret_cast<record_header*>(m_records + (position & (capacity - 1)));
+        padding_record->length = padding - sizeof(record_header);
+        padding_record->state.store(RECORD_PADDING, std::memory_order_release);
+        position += padding;
+    }
+
+    // write the records and publish them.
+    for(std::size_t i = 0; i < count; i++)
+    {
+        auto record = reinterpret_cast<record_header*>(m_records + (position & (capacity - 1)));
+        record->length = lengths[i];
+        log_record::encode(*entries[i], reinterpret_cast<char*>(record + 1), lengths[i]);
+        record->state.store(RECORD_COMMITTED, std::memory_order_release);
+        position += slot_size(sizeof(record_header) + lengths[i]);
+    }
+
+    return true;
+}
+
+/**
+ * Pops the next entry from the ring.
+ * Only one thread (in one process) may pop from a ring. Records are returned in the order their space was
+ * reserved; if the next record has been reserved but not yet committed, nothing is returned until it is.
+ * @returns next entry, or nullptr if there is no committed entry available.
+ */
+std::shared_ptr<log_entry> log_ring::pop()
+{
+    const std::uint64_t capacity = m_header->capacity;
+
+    while(true)
+    {
+        std::uint64_t position = m_header->released.load(std::memory_order_relaxed);
+        if(position == m_header->reserved.load(std::memory_order_acquire))
+        {
+            return nullptr;
+        }
+
+        // wait for the client to finish writing the record.
+        std::uint64_t offset = position & (capacity - 1);
+        auto record = reinterpret_cast<record_header*>(m_records + offset);
+        std::uint32_t state = record->state.load(std::memory_order_acquire);
+        if(state == RECORD_EMPTY)
+        {
+            return nullptr;
+        }
+
+        // a record overrunning the record area means the ring has been corrupted, give up on its contents.
+        std::uint64_t record_size = slot_size(sizeof(record_header) + record->length);
+        if(record_size > capacity - offset)
+        {
+            m_header->released.store(m_header->reserved.load(std::memory_order_acquire), std::memory_order_release);
+            return nullptr;
+        }
+
+        std::shared_ptr<log_entry> entry = nullptr;
+        if(state == RECORD_COMMITTED)
+        {
+            entry = log_record::decode(reinterpret_cast<const char*>(record + 1), record->length);
+        }
+
+        // clear the slot so old data is never mistaken for a committed record, then give the space back.
+        std::memset(m_records + offset, 0, record_size);
+        m_header->released.store(position + record_size, std::memory_order_release);
+
+        // skip over padding (and anything that failed to decode).
+        if(entry != nullptr)
+        {
+            return entry;
+        }
+    }
+}
+
+/**
+ * Indicates if there are entries waiting in the ring (committed or not).
+ * @returns true if the ring is empty.
+ */
+bool log_ring::empty() const
+{
+    return m_header->released.load(std::memory_order_acquire) == m_header->reserved.load(std::memory_order_acquire);
+}
+
+/**
+ * Marks the ring as being collected. The daemon calls this every time it collects from the ring.
+ */
+void log_ring::heartbeat()
+{
+    m_header->heartbeat.store(monotonic_ms(), std::memory_order_release);
+}
+
+/**
+ * Indicates if the ring is being collected (the daemon has stamped it within COLLECTOR_TIMEOUT).
+ * Reads the monotonic clock, which does not require a system call on supported platforms.
+ * @returns true if the daemon appears to be collecting from the ring.
+ */
+bool log_ring::collector_alive() const
+{
+    return monotonic_ms() - m_header->heartbeat.load(std::memory_order_acquire) < COLLECTOR_TIMEOUT;
+}
+
+/**
+ * Marks the ring as closed; the creating process will push no more entries.
+ */
+void log_ring::close()
+{
+    m_header->closed.store(1, std::memory_order_release);
+}
+
+/**
+ * Indicates if the ring has been closed by the creating process.
+ * @returns true if closed.
+ */
+bool log_ring::closed() const
+{
+    return m_header->closed.load(std::memory_order_acquire) != 0;
+}
+
+/**
+ * Indicates if the process that created the ring is still running.
+ * @returns true if the process is running.
+ */
+bool log_ring::owner_alive() const
+{
+    return kill(static_cast<pid_t>(m_header->pid), 0) == 0 || errno == EPERM;
+}
+
+/**
+ * Gets the size of the largest entry that can be pushed in to the ring.
+ * This is limited to a quarter of the record area, so a single entry can never monopolize the ring.
+ * @returns largest encoded entry size (bytes).
+ */
+std::size_t log_ring::max_entry_size() const
+{
+    return m_header->capacity / 4 - sizeof(record_header);
+}
+
+/**
+ * Gets the process id of the process that created the ring.
+ * @returns process id.
+ */
+pid_type log_ring::pid() const
+{
+    return static_cast<pid_type>(m_header->pid);
+}
+
+/**
+ * Gets the name of the process that created the ring.
+ * @returns process name.
+ */
+std::string log_ring::process_name() const
+{
+    return std::string(m_header->process_name, strnlen(m_header->process_name, RING_PROCESS_NAME_LENGTH));
+}
+
+/**
+ * Gets the path of the ring file.
+ * @returns ring file path.
+ */
+const boost::filesystem::path& log_ring::file() const
+{
+    return m_file;
+}
+
+} // namespace inglenook::logging
+
+} // namespace inglenook
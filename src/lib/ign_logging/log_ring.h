@@ -0,0 +1,165 @@
+#pragma once
+/*
+ * log_ring.h: Shared memory ring used to pass log entries to the logging service daemon.
+ * Copyright (C) 2012, Project Inglenook (http://www.project-inglenook.co.uk)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// standard library includes
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+// boost (http://boost.org) includes
+#include <boost/filesystem.hpp>
+
+// inglenook includes
+#include <ign_core/application.h>
+#include "log_entry.h"
+
+namespace inglenook
+{
+
+namespace logging
+{
+
+/// layout of the shared header at the start of a ring file (see log_ring.cpp).
+struct log_ring_header;
+
+/**
+ * The log_ring class is a shared memory ring buffer carrying log entries from a client process to the logging
+ * service daemon (ign_logd).
+ * Each client process creates one ring, a memory mapped file under directories::tmp(). Any number of threads in the
+ * client push entries (encoded by log_record) in to the ring; space is reserved with a single compare-and-swap (for a
+ * group of entries too, keeping them together) and each record is published by setting its commit flag, so pushing
+ * an entry makes no system calls. The daemon maps every ring it finds, pops the committed records in order and writes
+ * them out. The daemon stamps a heartbeat in to each ring it is collecting, clients use this to detect the daemon has
+ * gone away and fall back to writing locally.
+ */
+class log_ring
+{
+
+    protected:
+
+        // (there is no default constructor for the log_ring)
+        log_ring() = delete;
+
+        // maps an open ring file.
+        log_ring(const boost::filesystem::path& ring_file, const int& descriptor, const bool& owner);
+
+    public:
+
+        /// there is no copy constructor for the log_ring (deleted).
+        log_ring(const log_ring&) = delete;
+
+        // creates a new ring (client side).
+        static std::shared_ptr<log_ring> create(const boost::filesystem::path& ring_file,
+                const pid_type& pid, const std::string& process_name, const std::size_t& capacity = DEFAULT_CAPACITY);
+
+        // opens an existing ring (daemon side).
+        static std::shared_ptr<log_ring> open(const boost::filesystem::path& ring_file);
+
+        // gets the directory rings are created in.
+        static boost::filesystem::path default_ring_directory();
+
+        // gets the ring file for the specified process.
+        static boost::filesystem::path default_ring_file(const pid_type& pid);
+
+        // indicates if the logging service daemon appears to be running.
+        static bool collector_running(const boost::filesystem::path& ring_directory);
+
+        // marks the logging service daemon as running.
+        static void collector_heartbeat(const boost::filesystem::path& ring_directory);
+
+        // unmaps the ring (closing it, and removing it if nobody will collect it, on the creating side).
+        virtual ~log_ring();
+
+        // pushes an entry in to the ring (client side, thread safe).
+        bool push(log_entry& entry);
+
+        // pushes a group of entries in to the ring, with nothing between them (client side, thread safe).
+        bool push(const std::vector<std::shared_ptr<log_entry>>& entries);
+
+        // pops the next entry from the ring (daemon side, single consumer).
+        std::shared_ptr<log_entry> pop();
+
+        // indicates if there are entries waiting in the ring.
+        bool empty() const;
+
+        // marks the ring as being collected (daemon side).
+        void heartbeat();
+
+        // indicates if the ring is being collected (client side).
+        bool collector_alive() const;
+
+        // marks the ring as closed, no more entries will be pushed (client side).
+        void close();
+
+        // indicates if the ring has been closed.
+        bool closed() const;
+
+        // indicates if the process that created the ring is still running.
+        bool owner_alive() const;
+
+        /// gets the size of the largest entry that can be pushed (as encoded by log_record).
+        std::size_t max_entry_size() const;
+
+        /// gets the process id of the process that created the ring.
+        pid_type pid() const;
+
+        /// gets the name of the process that created the ring.
+        std::string process_name() const;
+
+        /// gets the path of the ring file.
+        const boost::filesystem::path& file() const;
+
+        /// default size of the record area (bytes, must be a power of two).
+        static const std::size_t DEFAULT_CAPACITY = 262144; // 256KiB
+
+        /// the daemon is considered gone if it hasn't stamped a ring for this long.
+        static const int COLLECTOR_TIMEOUT = 5000; // ms (5 seconds)
+
+        /// file name of the daemon's heartbeat file in the ring directory.
+        static const char* const COLLECTOR_HEARTBEAT_FILE;
+
+        /// extension of ring files.
+        static const char* const RING_FILE_EXTENSION;
+
+    private:
+
+        /// reserves space for, encodes and commits a run of records.
+        bool _push(log_entry* const* entries, const std::size_t* lengths, const std::size_t& count);
+
+        /// path of the ring file.
+        boost::filesystem::path m_file;
+
+        /// mapped header of the ring.
+        log_ring_header* m_header;
+
+        /// mapped record area of the ring.
+        char* m_records;
+
+        /// total size of the mapping.
+        std::size_t m_mapped_size;
+
+        /// indicates if this side created the ring.
+        bool m_owner;
+
+};
+
+} // namespace inglenook::logging
+
+} // namespace inglenook
@@ -0,0 +1,465 @@
+#pragma once
+/*
+* log_ring_tests.h: Test routines for the log_ring class (log_ring.cpp/h)
+* Copyright (C) 2012, Project Inglenook (http://www.project-inglenook.co.uk)
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE LOG_TEST_NAME
+
+// standard includes
+#include <vector>
+#include <atomic>
+#include <sstream>
+
+// boost (http://boost.org) includes
+#include <boost/test/unit_test.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/regex.hpp>
+
+// inglenook includes
+#include <ign_core/environment.h>
+#include <ign_core/environment_variables.h>
+#include <ign_directories/directories.h>
+#include "log_ring.h"
+#include "log_writer.h"
+
+namespace inglenook
+{
+
+namespace logging
+{
+
+/**
+ * Points the temporary and log directories at a scratch directory for the duration of a test.
+ */
+struct log_ring_test_directories
+{
+    /// scratch directory used by the test.
+    boost::filesystem::path root;
+
+    /// previous temporary directory setting.
+    std::string previous_tmp;
+
+    /// previous log directory setting.
+    std::string previous_log;
+
+    log_ring_test_directories() :
+        root(boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("ign-ring-%%%%-%%%%")),
+        previous_tmp(core::environment::get(core::environment::variables::DIR_TMP)),
+        previous_log(core::environment::get(core::environment::variables::DIR_LOG))
+    {
+        boost::filesystem::create_directories(root / "log");
+        core::environment::set(core::environment::variables::DIR_TMP, (root / "tmp").native());
+        core::environment::set(core::environment::variables::DIR_LOG, (root / "log").native());
+    }
+
+    ~log_ring_test_directories()
+    {
+        core::environment::set(core::environment::variables::DIR_TMP, previous_tmp);
+        core::environment::set(core::environment::variables::DIR_LOG, previous_log);
+        boost::filesystem::remove_all(root);
+    }
+};
+
+/**
+ * Creates a numbered test entry.
+ * @param number number to put in the message.
+ * @returns new entry.
+ */
+std::shared_ptr<log_entry> make_ring_entry(const int& number)
+{
+    auto entry = std::shared_ptr<log_entry>(new log_entry());
+    entry->entry_type(category::information);
+    entry->log_namespace("inglenook.logging.test");
+    entry->message("ring entry " + std::to_string(number));
+    return entry;
+}
+
+/**
+ * Stream buffer standing in for a stalled file system, writes block until the buffer is released.
+ * (log_writer hands over each entry with a single write, so only xsputn needs to block.)
+ */
+class log_ring_stalling_buffer : public std::stringbuf
+{
+
+    public:
+
+        log_ring_stalling_buffer() : m_stalled(true) {}
+
+        /// lets blocked (and future) writes complete.
+        void release()
+        {
+            boost::mutex::scoped_lock lock(m_mutex);
+            m_stalled = false;
+            m_released.notify_all();
+        }
+
+        /// gets everything written so far.
+        std::string contents()
+        {
+            boost::mutex::scoped_lock lock(m_mutex);
+            return str();
+        }
+
+    protected:
+
+        virtual std::streamsize xsputn(const char_type* data, std::streamsize count)
+        {
+            boost::mutex::scoped_lock lock(m_mutex);
+            while(m_stalled)
+            {
+                m_released.wait(lock);
+            }
+            return std::stringbuf::xsputn(data, count);
+        }
+
+    private:
+
+        bool m_stalled;
+        boost::mutex m_mutex;
+        boost::condition_variable m_released;
+};
+
+//
+// log_ring_tests__push_pop
+// checks entries come out of a ring intact, in order, and that the ring is
+// visible (with its owner details) to another mapping of the same file.
+BOOST_AUTO_TEST_CASE ( log_ring_tests__push_pop )
+{
+    log_ring_test_directories directories;
+    auto ring_file = log_ring::default_ring_file(1234);
+    auto client = log_ring::create(ring_file, 1234, "ring-test");
+    auto collector = log_ring::open(ring_file);
+
+    BOOST_CHECK(collector->pid() == 1234);
+    BOOST_CHECK(collector->process_name() == "ring-test");
+    BOOST_CHECK(collector->empty());
+    BOOST_CHECK(collector->pop() == nullptr);
+
+    auto timestamp = boost::posix_time::ptime(boost::gregorian::date(2012, 6, 1), boost::posix_time::microseconds(42));
+    auto entry = make_ring_entry(0);
+    entry->entry_type(category::error);
+    entry->timestamp(timestamp);
+    entry->extended_data("test.key", "test value");
+    BOOST_CHECK(client->push(*entry));
+    BOOST_CHECK(client->push(*make_ring_entry(1)));
+    BOOST_CHECK(!collector->empty());
+
+    auto popped = collector->pop();
+    BOOST_REQUIRE(popped != nullptr);
+    BOOST_CHECK(popped->entry_type() == category::error);
+    BOOST_CHECK(popped->log_namespace() == "inglenook.logging.test");
+    BOOST_CHECK(popped->message() == "ring entry 0");
+    BOOST_CHECK(popped->timestamp() == timestamp);
+    BOOST_CHECK(popped->extended_data().at("test.key") == "test value");
+
+    popped = collector->pop();
+    BOOST_REQUIRE(popped != nullptr);
+    BOOST_CHECK(popped->message() == "ring entry 1");
+    BOOST_CHECK(collector->pop() == nullptr);
+    BOOST_CHECK(collector->empty());
+
+    // closing is seen by the collector, and an empty ring is removed by its owner once nobody is collecting.
+    client->close();
+    BOOST_CHECK(collector->closed());
+}
+
+//
+// log_ring_tests__wrap_and_full
+// checks that a small ring wraps around correctly many times over, that pushes
+// fail (rather than overwrite) once it is full and succeed again once it is drained.
+BOOST_AUTO_TEST_CASE ( log_ring_tests__wrap_and_full )
+{
+    log_ring_test_directories directories;
+    auto ring_file = log_ring::default_ring_file(1234);
+    auto client = log_ring::create(ring_file, 1234, "ring-test", 4096);
+    auto collector = log_ring::open(ring_file);
+
+    // oversize entries are refused outright.
+    auto oversize = make_ring_entry(0);
+    oversize->message(std::string(client->max_entry_size(), 'x'));
+    BOOST_CHECK(!client->push(*oversize));
+
+    // push and pop enough to go round the ring many times.
+    for(int i = 0; i < 2000; i++)
+    {
+        BOOST_REQUIRE(client->push(*make_ring_entry(i)));
+        auto popped = collector->pop();
+        BOOST_REQUIRE(popped != nullptr);
+        BOOST_CHECK(popped->message() == "ring entry " + std::to_string(i));
+    }
+
+    // fill the ring...
+    int pushed = 0;
+    while(client->push(*make_ring_entry(pushed)))
+    {
+        pushed++;
+    }
+    BOOST_CHECK(pushed > 0);
+
+    // ... nothing was lost ...
+    BOOST_CHECK(collector->pop()->message() == "ring entry 0");
+    BOOST_CHECK(client->push(*make_ring_entry(pushed)));
+    for(int i = 1; i <= pushed; i++)
+    {
+        auto popped = collector->pop();
+        BOOST_REQUIRE(popped != nullptr);
+        BOOST_CHECK(popped->message() == "ring entry " + std::to_string(i));
+    }
+
+    // ... and nothing extra was added.
+    BOOST_CHECK(collector->pop() == nullptr);
+}
+
+//
+// log_ring_tests__threads
+// checks that entries pushed from several threads at once are all collected,
+// and in the order each thread pushed them.
+BOOST_AUTO_TEST_CASE ( log_ring_tests__threads )
+{
+    log_ring_test_directories directories;
+    auto ring_file = log_ring::default_ring_file(1234);
+    auto client = log_ring::create(ring_file, 1234, "ring-test", 16384);
+    auto collector = log_ring::open(ring_file);
+
+    const int thread_count = 4;
+    const int entry_count = 5000;
+    std::atomic<int> producers_running(thread_count);
+    boost::thread_group producers;
+    for(int t = 0; t < thread_count; t++)
+    {
+        producers.create_thread([&client, &producers_running, t, entry_count]()
+        {
+            for(int i = 0; i < entry_count; i++)
+            {
+                auto entry = make_ring_entry(i);
+                entry->log_namespace("thread." + std::to_string(t));
+                while(!client->push(*entry))
+                {
+                    boost::this_thread::yield();
+                }
+            }
+            producers_running--;
+        });
+    }
+
+    // collect while the producers are running.
+    std::vector<int> next(thread_count, 0);
+    int collected = 0;
+    bool ordered = true;
+    while(collected < thread_count * entry_count)
+    {
+        auto popped = collector->pop();
+        if(popped == nullptr)
+        {
+            if(producers_running == 0 && collector->empty())
+            {
+                break;
+            }
+            boost::this_thread::yield();
+            continue;
+        }
+
+        int t = std::stoi(popped->log_namespace().substr(7));
+        ordered = ordered && popped->message() == "ring entry " + std::to_string(next[t]);
+        next[t]++;
+        collected++;
+    }
+    producers.join_all();
+
+    BOOST_CHECK(ordered);
+    BOOST_CHECK(collected == thread_count * entry_count);
+}
+
+//
+// log_ring_tests__service
+// checks that log_writer::create_from_service() only uses a ring when the logging
+// service daemon is running, and falls back to a local log file otherwise.
+BOOST_AUTO_TEST_CASE ( log_ring_tests__service )
+{
+    log_ring_test_directories directories;
+
+    // nobody is collecting, so the writer should log for itself.
+    {
+        auto writer = log_writer::create_from_service(1234, "ring-test");
+        BOOST_CHECK(!writer->using_service());
+        BOOST_CHECK(!boost::filesystem::exists(log_ring::default_ring_file(1234)));
+    }
+    BOOST_CHECK(!boost::filesystem::is_empty(directories.root / "log"));
+
+    // pretend to be the daemon.
+    log_ring::collector_heartbeat(log_ring::default_ring_directory());
+    BOOST_CHECK(log_ring::collector_running(log_ring::default_ring_directory()));
+    {
+        auto writer = log_writer::create_from_service(1235, "ring-test");
+        writer->console_threshold(category::no_log);
+        writer->xml_threshold(category::warning);
+        BOOST_CHECK(writer->using_service());
+
+        auto collector = log_ring::open(log_ring::default_ring_file(1235));
+        BOOST_CHECK(collector->process_name() == "ring-test");
+
+        // entries below the threshold stay in the process, the rest go to the daemon.
+        auto entry = make_ring_entry(0);
+        BOOST_CHECK(writer->add_entry(entry));
+        entry = make_ring_entry(1);
+        entry->entry_type(category::warning);
+        BOOST_CHECK(writer->add_entry(entry));
+
+        // oversize messages are truncated to fit.
+        entry = make_ring_entry(2);
+        entry->entry_type(category::warning);
+        entry->message(std::string(log_ring::DEFAULT_CAPACITY, 'x'));
+        BOOST_CHECK(writer->add_entry(entry));
+
+        auto popped = collector->pop();
+        BOOST_REQUIRE(popped != nullptr);
+        BOOST_CHECK(popped->message() == "ring entry 1");
+        popped = collector->pop();
+        BOOST_REQUIRE(popped != nullptr);
+        BOOST_CHECK(popped->extended_data().at("inglenook.logging.truncated") == std::to_string(log_ring::DEFAULT_CAPACITY));
+        BOOST_CHECK(popped->message().length() < log_ring::DEFAULT_CAPACITY);
+        BOOST_CHECK(collector->pop() == nullptr);
+    }
+}
+
+//
+// log_ring_tests__service_group
+// checks a group of entries passed to the logging service daemon arrives together, even with
+// another thread of the process logging single entries as fast as it can.
+BOOST_AUTO_TEST_CASE ( log_ring_tests__service_group )
+{
+    log_ring_test_directories directories;
+    log_ring::collector_heartbeat(log_ring::default_ring_directory());
+    auto writer = log_writer::create_from_service(1236, "ring-test");
+    writer->console_threshold(category::no_log);
+    BOOST_REQUIRE(writer->using_service());
+    auto collector = log_ring::open(log_ring::default_ring_file(1236));
+
+    const int GROUP_COUNT = 200;
+    const int GROUP_SIZE = 5;
+    std::atomic<bool> grouping(true);
+    boost::thread flooder([&writer, &grouping]()
+    {
+        for(int i = 0; grouping; i++)
+        {
+            auto entry = make_ring_entry(i);
+            writer->add_entry(entry);
+        }
+    });
+    boost::thread grouper([&writer, &grouping, GROUP_COUNT, GROUP_SIZE]()
+    {
+        for(int g = 0; g < GROUP_COUNT; g++)
+        {
+            std::vector<std::shared_ptr<log_entry>> group;
+            for(int m = 0; m < GROUP_SIZE; m++)
+            {
+                auto entry = make_ring_entry(m);
+                entry->log_namespace("group." + std::to_string(g));
+                group.push_back(entry);
+            }
+            writer->add_entries(group);
+        }
+        grouping = false;
+    });
+
+    // collect as the daemon would, checking each group's members come one after another.
+    int groups = 0;
+    int member = 0;
+    bool together = true;
+    while(grouping || !collector->empty())
+    {
+        collector->heartbeat();
+        auto popped = collector->pop();
+        if(popped == nullptr)
+        {
+            boost::this_thread::yield();
+            continue;
+        }
+        bool grouped = popped->log_namespace().compare(0, 6, "group.") == 0;
+        together = together && (grouped ? popped->message() == "ring entry " + std::to_string(member) : member == 0);
+        member = grouped ? (member + 1) % GROUP_SIZE : member;
+        groups += grouped && member == 0 ? 1 : 0;
+    }
+    grouper.join();
+    flooder.join();
+    while(auto popped = collector->pop())
+    {
+        together = together && popped->log_namespace().compare(0, 6, "group.") != 0 && member == 0;
+    }
+
+    BOOST_CHECK(together);
+    BOOST_CHECK(groups == GROUP_COUNT);
+    BOOST_CHECK(writer->using_service());
+}
+
+//
+// log_ring_tests__writer_spill
+// checks a writer whose output stream stalls keeps accepting entries (spilling them in to a
+// ring) and, once the stream recovers, writes every entry out in order.
+BOOST_AUTO_TEST_CASE ( log_ring_tests__writer_spill )
+{
+    log_ring_test_directories directories;
+    const int ENTRY_COUNT = 1000;
+
+    log_ring_stalling_buffer buffer;
+    auto writer = log_writer::create_from_stream(std::shared_ptr<std::ostream>(new std::ostream(&buffer)), false, false);
+    writer->console_threshold(category::no_log);
+
+    // the stream is stalled, yet every entry should be accepted...
+    for(int i = 0; i < ENTRY_COUNT; i++)
+    {
+        auto entry = make_ring_entry(i);
+        BOOST_CHECK(writer->add_entry(entry));
+    }
+    auto counters = writer->stall_counters();
+    BOOST_CHECK(counters.spilled_entries > 0);
+    BOOST_CHECK(counters.spilled_bytes > 0);
+    BOOST_CHECK(counters.replay_time == 0);
+
+    // ... without leaving a spill file behind.
+    BOOST_CHECK(boost::filesystem::is_empty(inglenook::directories::tmp() / "log-spill"));
+
+    // let the stream recover, and wait for the spill to be replayed.
+    buffer.release();
+    const std::string last_entry = "ring entry " + std::to_string(ENTRY_COUNT - 1) + "]";
+    for(int i = 0; i < 100 && buffer.contents().find(last_entry) == std::string::npos; i++)
+    {
+        boost::this_thread::sleep(boost::posix_time::milliseconds(50));
+    }
+
+    // the stall was noticed (spilling only starts once the stream has been stalled for a while).
+    counters = writer->stall_counters();
+    BOOST_CHECK(counters.stalls == 1);
+    BOOST_CHECK(counters.stall_time >= 500);
+    writer.reset();
+
+    // every entry is written out, in order.
+    std::string output = buffer.contents();
+    const boost::regex numbered_entry("ring entry ([0-9]+)");
+    int expected = 0;
+    for(boost::sregex_iterator match(output.begin(), output.end(), numbered_entry), end; match != end; match++)
+    {
+        BOOST_CHECK(std::stoi((*match)[1]) == expected++);
+    }
+    BOOST_CHECK(expected == ENTRY_COUNT);
+}
+
+} // namespace inglenook::logging
+
+} // namespace inglenook
@@ -0,0 +1,277 @@
+/*
+ * log_socket.cpp: Unix domain socket connection used to pass log entries to the logging service daemon.
+ * Copyright (C) 2012, Project Inglenook (http://www.project-inglenook.co.uk)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// inglenook includes
+#include "log_socket.h"
+#include "log_ring.h"
+#include "log_record.h"
+#include "log_exceptions.h"
+
+// standard library includes
+#include <cstring>
+
+// boost (http://boost.org) includes
+#include <boost/exception/all.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+
+// platform includes
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+namespace inglenook
+{
+
+namespace logging
+{
+
+/// largest frame that can be exchanged with the daemon.
+const std::size_t log_socket::MAX_FRAME_SIZE;
+
+/// amount of time send() waits for a busy daemon before giving up.
+const int log_socket::BUSY_TIMEOUT;
+
+/// file name of the daemon's socket in the ring directory.
+const char* const log_socket::SOCKET_FILE = "ign_logd.socket";
+
+/**
+ * Wraps a connected socket. The socket is closed when the log_socket is destroyed.
+ * @param descriptor connected socket.
+ */
+log_socket::log_socket(const int& descriptor) :
+    m_descriptor(descriptor),
+    m_busy(false),
+    m_disconnected(false),
+    m_frame(MAX_FRAME_SIZE)
+{
+}
+
+/**
+ * Connects to the logging service daemon and announces the process being logged for.
+ * @param pid process id of the process entries are sent on behalf of.
+ * @param process_name name of the process entries are sent on behalf of.
+ * @param socket_file socket the daemon is listening on.
+ * @returns shared pointer to the connection.
+ */
+std::shared_ptr<log_socket> log_socket::connect(const pid_type& pid, const std::string& process_name, const boost::filesystem::path& socket_file)
+{
+    using namespace inglenook::core::exceptions;
+
+    struct sockaddr_un address;
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if(socket_file.native().length() >= sizeof(address.sun_path))
+    {
+        BOOST_THROW_EXCEPTION(log_socket_exception()
+                << c_error_number(ENAMETOOLONG)
+                << inglenook_error_number(log_exception_socket_connect)
+                << log_file_name(socket_file));
+    }
+    std::strncpy(address.sun_path, socket_file.c_str(), sizeof(address.sun_path) - 1);
+
+    int descriptor = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if(descriptor < 0 || ::connect(descriptor, reinterpret_cast<struct sockaddr*>(&address), sizeof(address)) != 0)
+    {
+        int socket_error = errno;
+        if(descriptor >= 0)
+        {
+            ::close(descriptor);
+        }
+        BOOST_THROW_EXCEPTION(log_socket_exception()
+                << c_error_number(socket_error)
+                << inglenook_error_number(log_exception_socket_connect)
+                << log_file_name(socket_file));
+    }
+
+    // don't let a stuck daemon hang the caller when the socket buffer is full.
+    struct timeval send_timeout = { 0, BUSY_TIMEOUT * 1000 };
+    setsockopt(descriptor, SOL_SOCKET, SO_SNDTIMEO, &send_timeout, sizeof(send_timeout));
+
+    auto connection = std::shared_ptr<log_socket>(new log_socket(descriptor));
+
+    // tell the daemon who we are.
+    std::int64_t hello_pid = pid;
+    std::size_t name_length = std::min(process_name.length(), MAX_FRAME_SIZE - 1 - sizeof(hello_pid));
+    std::memcpy(connection->m_frame.data() + 1, &hello_pid, sizeof(hello_pid));
+    std::memcpy(connection->m_frame.data() + 1 + sizeof(hello_pid), process_name.data(), name_length);
+    if(!connection->_send_frame(log_socket_frame::hello, sizeof(hello_pid) + name_length))
+    {
+        BOOST_THROW_EXCEPTION(log_socket_exception()
+                << inglenook_error_number(log_exception_socket_connect)
+                << log_file_name(socket_file));
+    }
+
+    return connection;
+}
+
+/**
+ * Gets the socket the logging service daemon listens on.
+ * @returns socket path (in the ring directory).
+ */
+boost::filesystem::path log_socket::default_socket_file()
+{
+    return log_ring::default_ring_directory() / SOCKET_FILE;
+}
+
+/**
+ * Disconnects from the logging service daemon. Entries already sent will still be written.
+ */
+log_socket::~log_socket()
+{
+    ::close(m_descriptor);
+}
+
+/**
+ * Sends an entry to the logging service daemon.
+ * If the daemon has asked us to hold off, waits up to BUSY_TIMEOUT for it to catch up. Oversize messages are
+ * truncated to fit in a frame (see log_record::truncate()).
+ * @param entry entry to send.
+ * @returns true if the entry was sent, false if the daemon is busy or has gone away.
+ */
+bool log_socket::send(log_entry& entry)
+{
+    // find out if the daemon wants us to hold off.
+    _receive_status(0);
+    if(m_busy)
+    {
+        _receive_status(BUSY_TIMEOUT);
+    }
+    if(m_busy || m_disconnected)
+    {
+        return false;
+    }
+
+    log_record::truncate(entry, MAX_FRAME_SIZE - 1);
+    std::size_t length = log_record::encode(entry, m_frame.data() + 1, MAX_FRAME_SIZE - 1);
+    return _send_frame(log_socket_frame::entry, length);
+}
+
+/**
+ * Asks the logging service daemon to close the log file of the process we are logging for (writing its
+ * footer), once every connection for the process has gone.
+ * @returns true if the request was sent.
+ */
+bool log_socket::close_log()
+{
+    return _send_frame(log_socket_frame::close_log, 0);
+}
+
+/**
+ * Indicates if the logging service daemon has asked us to hold off sending entries.
+ * @returns true if the daemon is busy.
+ */
+bool log_socket::busy()
+{
+    _receive_status(0);
+    return m_busy;
+}
+
+/**
+ * Indicates if the logging service daemon has gone away (closed the connection, or the connection failed). A
+ * daemon that is only slow to read, or has asked us to hold off, has not gone away.
+ * @returns true if nothing more can be sent.
+ */
+bool log_socket::disconnected()
+{
+    _receive_status(0);
+    return m_disconnected;
+}
+
+/**
+ * Sends a single frame to the daemon.
+ * @param type type of the frame.
+ * @param payload_length length of the payload (already in m_frame, after the type).
+ * @returns true if the frame was sent.
+ */
+bool log_socket::_send_frame(const log_socket_frame& type, const std::size_t& payload_length)
+{
+    if(m_disconnected)
+    {
+        return false;
+    }
+
+    m_frame[0] = static_cast<char>(type);
+    ssize_t sent = ::send(m_descriptor, m_frame.data(), payload_length + 1, MSG_NOSIGNAL);
+    if(sent < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+    {
+        m_disconnected = true;
+    }
+
+    return sent == static_cast<ssize_t>(payload_length + 1);
+}
+
+/**
+ * Reads any frames the daemon has sent us. With no timeout, only frames already waiting are read; otherwise
+ * waits up to the timeout for the daemon to say it is ready.
+ * @param timeout maximum time to wait (milliseconds).
+ */
+void log_socket::_receive_status(const int& timeout)
+{
+    auto give_up = boost::posix_time::microsec_clock::universal_time() + boost::posix_time::milliseconds(timeout);
+
+    while(!m_disconnected)
+    {
+        int wait = 0;
+        if(timeout > 0)
+        {
+            if(!m_busy)
+            {
+                return;
+            }
+            wait = std::max<long>(0, (give_up - boost::posix_time::microsec_clock::universal_time()).total_milliseconds());
+        }
+
+        struct pollfd status = { m_descriptor, POLLIN, 0 };
+        int ready = poll(&status, 1, wait);
+        if(ready < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if(ready <= 0)
+        {
+            return;
+        }
+
+        char frame[16];
+        ssize_t received = recv(m_descriptor, frame, sizeof(frame), MSG_DONTWAIT);
+        if(received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+        {
+            continue;
+        }
+        if(received <= 0)
+        {
+            m_disconnected = true;
+            return;
+        }
+
+        if(frame[0] == static_cast<char>(log_socket_frame::busy))
+        {
+            m_busy = true;
+        }
+        else if(frame[0] == static_cast<char>(log_socket_frame::ready))
+        {
+            m_busy = false;
+        }
+    }
+}
+
+} // namespace inglenook::logging
+
+} // namespace inglenook
@@ -0,0 +1,130 @@
+#pragma once
+/*
+ * log_socket.h: Unix domain socket connection used to pass log entries to the logging service daemon.
+ * Copyright (C) 2012, Project Inglenook (http://www.project-inglenook.co.uk)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// standard library includes
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+// boost (http://boost.org) includes
+#include <boost/filesystem.hpp>
+
+// inglenook includes
+#include <ign_core/application.h>
+#include "log_entry.h"
+
+namespace inglenook
+{
+
+namespace logging
+{
+
+/**
+ * Types of frame exchanged with the logging service daemon. Every frame is a single packet starting with
+ * its type; the rest of the packet depends on the type.
+ */
+enum class log_socket_frame : std::uint8_t
+{
+    hello     = 0x01, /**< client to daemon: pid (int64) followed by the process name. Always sent first. */
+    entry     = 0x02, /**< client to daemon: a log entry (encoded by log_record). */
+    close_log = 0x03, /**< client to daemon: the process has finished logging, the log file can be closed. */
+    busy      = 0x04, /**< daemon to client: the daemon is falling behind, stop sending entries. */
+    ready     = 0x05  /**< daemon to client: the daemon has caught up, entries can be sent again. */
+};
+
+/**
+ * The log_socket class is a connection to the logging service daemon (ign_logd) over a unix domain socket.
+ * Unlike log_ring, any process can connect on behalf of another; the connection announces the process id and
+ * name the entries belong to, and the daemon writes them to that process's log file (shared by every connection
+ * for the same process). This suits short lived processes such as ign_log_write, which log on behalf of a script.
+ * The daemon tells clients to hold off when it is falling behind (see send()).
+ */
+class log_socket
+{
+
+    protected:
+
+        // (there is no default constructor for the log_socket)
+        log_socket() = delete;
+
+        // wraps a connected socket.
+        log_socket(const int& descriptor);
+
+    public:
+
+        /// there is no copy constructor for the log_socket (deleted).
+        log_socket(const log_socket&) = delete;
+
+        // connects to the logging service daemon.
+        static std::shared_ptr<log_socket> connect(const pid_type& pid, const std::string& process_name,
+                const boost::filesystem::path& socket_file = default_socket_file());
+
+        // gets the socket the logging service daemon listens on.
+        static boost::filesystem::path default_socket_file();
+
+        // disconnects from the logging service daemon.
+        virtual ~log_socket();
+
+        // sends an entry to the logging service daemon.
+        bool send(log_entry& entry);
+
+        // asks the logging service daemon to close the log file.
+        bool close_log();
+
+        // indicates if the logging service daemon has asked us to hold off.
+        bool busy();
+
+        // indicates if the logging service daemon has gone away.
+        bool disconnected();
+
+        /// largest frame that can be exchanged with the daemon.
+        static const std::size_t MAX_FRAME_SIZE = 65536; // 64KiB
+
+        /// amount of time send() waits for a busy daemon before giving up.
+        static const int BUSY_TIMEOUT = 250; // ms (0.25 seconds)
+
+        /// file name of the daemon's socket in the ring directory.
+        static const char* const SOCKET_FILE;
+
+    private:
+
+        /// sends a single frame (the payload is encoded in to m_frame after the type by the caller).
+        bool _send_frame(const log_socket_frame& type, const std::size_t& payload_length);
+
+        /// reads any frames sent by the daemon, waiting up to timeout for one to arrive.
+        void _receive_status(const int& timeout);
+
+        /// connected socket.
+        int m_descriptor;
+
+        /// set while the daemon has asked us to hold off.
+        bool m_busy;
+
+        /// set if the daemon has gone away.
+        bool m_disconnected;
+
+        /// buffer frames are encoded in to.
+        std::vector<char> m_frame;
+
+};
+
+} // namespace inglenook::logging
+
+} // namespace inglenook
@@ -0,0 +1,136 @@
+#pragma once
+/*
+* log_socket_tests.h: Test routines for the log_socket class (log_socket.cpp/h)
+* Copyright (C) 2012, Project Inglenook (http://www.project-inglenook.co.uk)
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE LOG_TEST_NAME
+
+// standard includes
+#include <cstring>
+
+// platform includes
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+// boost (http://boost.org) includes
+#include <boost/test/unit_test.hpp>
+#include <boost/filesystem.hpp>
+
+// inglenook includes
+#include "log_socket.h"
+#include "log_record.h"
+#include "log_exceptions.h"
+
+namespace inglenook
+{
+
+namespace logging
+{
+
+/**
+ * Creates a listening socket standing in for the logging service daemon.
+ * @param socket_file path to listen on.
+ * @returns listening socket.
+ */
+int listen_as_daemon(const boost::filesystem::path& socket_file)
+{
+    struct sockaddr_un address;
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    std::strncpy(address.sun_path, socket_file.c_str(), sizeof(address.sun_path) - 1);
+
+    int listener = socket(AF_UNIX, SOCK_SEQPACKET, 0);
+    bind(listener, reinterpret_cast<struct sockaddr*>(&address), sizeof(address));
+    listen(listener, 1);
+    return listener;
+}
+
+//
+// log_socket_tests__frames
+// checks that a connection announces the process it logs for, that entries and
+// close requests arrive as single frames, and that the daemon can hold the client off.
+BOOST_AUTO_TEST_CASE ( log_socket_tests__frames )
+{
+    auto socket_file = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("ign-socket-%%%%-%%%%");
+
+    // nobody listening...
+    BOOST_CHECK_THROW(log_socket::connect(1234, "socket-test", socket_file), log_socket_exception);
+
+    int listener = listen_as_daemon(socket_file);
+    auto client = log_socket::connect(1234, "socket-test", socket_file);
+    int daemon = accept(listener, nullptr, nullptr);
+    BOOST_REQUIRE(daemon >= 0);
+
+    // the first frame says who the client is.
+    std::vector<char> frame(log_socket::MAX_FRAME_SIZE);
+    ssize_t received = recv(daemon, frame.data(), frame.size(), 0);
+    std::int64_t pid = 0;
+    BOOST_REQUIRE(received == static_cast<ssize_t>(1 + sizeof(pid) + 11));
+    BOOST_CHECK(frame[0] == static_cast<char>(log_socket_frame::hello));
+    std::memcpy(&pid, frame.data() + 1, sizeof(pid));
+    BOOST_CHECK(pid == 1234);
+    BOOST_CHECK(std::string(frame.data() + 1 + sizeof(pid), 11) == "socket-test");
+
+    // entries are sent as records...
+    log_entry entry;
+    entry.entry_type(category::warning);
+    entry.log_namespace("inglenook.logging.test");
+    entry.message("socket entry");
+    BOOST_CHECK(client->send(entry));
+    received = recv(daemon, frame.data(), frame.size(), 0);
+    BOOST_REQUIRE(received > 1);
+    BOOST_CHECK(frame[0] == static_cast<char>(log_socket_frame::entry));
+    auto decoded = log_record::decode(frame.data() + 1, received - 1);
+    BOOST_REQUIRE(decoded != nullptr);
+    BOOST_CHECK(decoded->message() == "socket entry");
+
+    // ... and oversize messages are trimmed to fit a frame.
+    entry.message(std::string(log_socket::MAX_FRAME_SIZE, 'x'));
+    BOOST_CHECK(client->send(entry));
+    received = recv(daemon, frame.data(), frame.size(), 0);
+    BOOST_CHECK(received == static_cast<ssize_t>(log_socket::MAX_FRAME_SIZE));
+
+    // a busy daemon holds the client off until it is ready again.
+    char status = static_cast<char>(log_socket_frame::busy);
+    ::send(daemon, &status, 1, 0);
+    BOOST_CHECK(client->busy());
+    BOOST_CHECK(!client->send(entry));
+    status = static_cast<char>(log_socket_frame::ready);
+    ::send(daemon, &status, 1, 0);
+    BOOST_CHECK(!client->busy());
+    BOOST_CHECK(!client->disconnected());
+
+    // closing the log is a frame of its own.
+    BOOST_CHECK(client->close_log());
+    received = recv(daemon, frame.data(), frame.size(), 0);
+    BOOST_CHECK(received == 1 && frame[0] == static_cast<char>(log_socket_frame::close_log));
+
+    // once the daemon has gone, nothing more can be sent.
+    ::close(daemon);
+    entry.message("after close");
+    BOOST_CHECK(!client->send(entry));
+    BOOST_CHECK(client->disconnected());
+
+    ::close(listener);
+    boost::filesystem::remove(socket_file);
+}
+
+} // namespace inglenook::logging
+
+} // namespace inglenook
@@ -0,0 +1,102 @@
+/*
+ * log_source.cpp: Source locations (call sites) of log entries.
+ * Copyright (C) 2012, Project Inglenook (http://www.project-inglenook.co.uk)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// inglenook includes
+#include "log_source.h"
+
+// standard library includes
+#include <map>
+#include <tuple>
+#include <memory>
+
+// boost (http://boost.org) includes
+#include <boost/thread/mutex.hpp>
+
+namespace inglenook
+{
+
+namespace logging
+{
+
+//--------------------------------------------------------//
+// Hide the implementation in the anonymous namespace.
+namespace
+{
+
+    /// a location created by log_source_location::intern(), holding its own text.
+    struct interned_location
+    {
+        /// source file.
+        std::string file;
+
+        /// function the entry was logged from.
+        std::string function;
+
+        /// the location (pointing at the text above).
+        log_source_location location;
+    };
+
+    /// key identifying an interned location (file, line, function).
+    typedef std::tuple<std::string, unsigned int, std::string> interned_key;
+
+    /**
+     * Gets the locations interned so far (kept for the life of the process, as entries point at them).
+     * @returns the interned locations.
+     */
+    std::map<interned_key, std::unique_ptr<interned_location>>& interned_locations()
+    {
+        static std::map<interned_key, std::unique_ptr<interned_location>>* locations =
+                new std::map<interned_key, std::unique_ptr<interned_location>>();
+        return *locations;
+    }
+
+    /// serializes access to the interned locations.
+    boost::mutex interned_locations_mutex;
+
+}
+//--------------------------------------------------------//
+
+/**
+ * Finds the location describing a call site known only by its text (for example one read from a binary record
+ * sent by another process, or from a log file), creating it the first time the call site is seen. Each call site
+ * is held once, however many entries refer to it, for the life of the process.
+ * @param file source file.
+ * @param line line in the source file.
+ * @param function function the entry was logged from.
+ * @returns the location (never destroyed).
+ */
+const log_source_location* log_source_location::intern(const std::string& file, const unsigned int& line,
+        const std::string& function)
+{
+    boost::mutex::scoped_lock lock(interned_locations_mutex);
+
+    auto& locations = interned_locations();
+    auto& interned = locations[interned_key(file, line, function)];
+    if(interned == nullptr)
+    {
+        interned.reset(new interned_location { file, function, log_source_location() });
+        interned->location.file = interned->file.c_str();
+        interned->location.line = line;
+        interned->location.function = interned->function.c_str();
+    }
+    return &interned->location;
+}
+
+} // namespace inglenook::logging
+
+} // namespace inglenook
@@ -0,0 +1,66 @@
+#pragma once
+/*
+ * log_source.h: Source locations (call sites) of log entries.
+ * Copyright (C) 2012, Project Inglenook (http://www.project-inglenook.co.uk)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// standard library includes
+#include <string>
+
+/**
+ * Gets the source location of the call site it is used at, for streaming to log_client:
+ *
+ *     log_warning() << LOG_HERE << "checksum mismatch" << lf::end;
+ *
+ * The location is held in a static descriptor belonging to the call site (created the first time it is reached), so
+ * entries carry a pointer to it and no text is copied or formatted until the entry is written out. See also the
+ * LOG_INFO (etc.) macros in logging.h.
+ */
+#define LOG_HERE \
+    ([](const char* function) -> const ::inglenook::logging::log_source_location& \
+    { \
+        static const ::inglenook::logging::log_source_location location = { __FILE__, __LINE__, function }; \
+        return location; \
+    }(__func__))
+
+namespace inglenook
+{
+
+namespace logging
+{
+
+/**
+ * The source location of a log entry's call site (see LOG_HERE). Locations are never destroyed, so entries need only
+ * point at them.
+ */
+struct log_source_location
+{
+    /// source file (as given to the compiler).
+    const char* file;
+
+    /// line in the source file.
+    unsigned int line;
+
+    /// function the entry was logged from.
+    const char* function;
+
+    // finds (or creates) the location describing a call site in another process or log file.
+    static const log_source_location* intern(const std::string& file, const unsigned int& line, const std::string& function);
+};
+
+} // namespace inglenook::logging
+
+} // namespace inglenook
@@ -0,0 +1,122 @@
+#pragma once
+/*
+* log_source_tests.h: Test routines for source locations (log_source.cpp/h)
+* Copyright (C) 2012, Project Inglenook (http://www.project-inglenook.co.uk)
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE LOG_TEST_NAME
+
+// standard includes
+#include <sstream>
+#include <vector>
+#include <cstring>
+
+// boost (http://boost.org) includes
+#include <boost/test/unit_test.hpp>
+
+// inglenook includes
+#include "log_source.h"
+#include "log_record.h"
+#include "log_client.h"
+#include "log_file_reader.h"
+
+namespace inglenook
+{
+
+namespace logging
+{
+
+//
+// log_source_tests__call_site
+// checks each call site has a single location (whichever entry it is reached for), that
+// holds the enclosing function, and that interning text gives the same location back.
+BOOST_AUTO_TEST_CASE ( log_source_tests__call_site )
+{
+    std::vector<const log_source_location*> locations;
+    for(int i = 0; i < 2; i++)
+    {
+        locations.push_back(&LOG_HERE);
+    }
+    const unsigned int line = __LINE__ + 1;
+    const log_source_location* other = &LOG_HERE;
+
+    BOOST_CHECK(locations[0] == locations[1]);
+    BOOST_CHECK(other != locations[0]);
+    BOOST_CHECK(other->line == line && locations[0]->line == line - 3);
+    BOOST_CHECK(std::strstr(other->file, "log_source_tests.h") != nullptr);
+    BOOST_CHECK(std::strcmp(other->function, "test_method") == 0);
+
+    auto interned = log_source_location::intern("zwave/driver.cpp", 42, "poll");
+    BOOST_CHECK(interned == log_source_location::intern("zwave/driver.cpp", 42, "poll"));
+    BOOST_CHECK(interned != log_source_location::intern("zwave/driver.cpp", 43, "poll"));
+    BOOST_CHECK(std::strcmp(interned->file, "zwave/driver.cpp") == 0 && interned->line == 42);
+}
+
+//
+// log_source_tests__entries
+// checks call sites streamed to a client are written out by the writer, read back from
+// the log file and kept through binary records.
+BOOST_AUTO_TEST_CASE ( log_source_tests__entries )
+{
+    const log_source_location* location = nullptr;
+    auto xml = std::shared_ptr<std::stringstream>(new std::stringstream());
+    {
+        auto writer = log_writer::create_from_stream(xml, false, false);
+        writer->console_threshold(category::no_log);
+        log_client client(writer);
+        client.warning() << LOG_HERE << "checksum mismatch" << lf::end;
+        location = &LOG_HERE;
+        client.info() << "no call site" << lf::end;
+    }
+
+    std::ostringstream expected;
+    expected << "<source file=\"" << location->file << "\" line=\"" << location->line - 1
+             << "\" function=\"test_method\"/>";
+    BOOST_CHECK(xml->str().find(expected.str()) != std::string::npos);
+
+    log_file_reader reader(xml);
+    auto entry = reader.next_entry();
+    BOOST_REQUIRE(entry != nullptr && entry->source() != nullptr);
+    BOOST_CHECK(std::strcmp(entry->source()->file, location->file) == 0);
+    BOOST_CHECK(entry->source()->line == location->line - 1);
+    BOOST_CHECK(entry->message() == "checksum mismatch");
+    entry = reader.next_entry();
+    BOOST_REQUIRE(entry != nullptr);
+    BOOST_CHECK(entry->source() == nullptr);
+
+    // binary records carry the call site's text, and the receiver holds it once.
+    log_entry record_entry;
+    record_entry.entry_type(category::debugging);
+    record_entry.log_namespace("inglenook.logging.test");
+    record_entry.message("record");
+    record_entry.source(location);
+    std::vector<char> buffer(log_record::encoded_size(record_entry));
+    BOOST_REQUIRE(log_record::encode(record_entry, buffer.data(), buffer.size()) == buffer.size());
+    auto first = log_record::decode(buffer.data(), buffer.size());
+    auto second = log_record::decode(buffer.data(), buffer.size());
+    BOOST_REQUIRE(first != nullptr && second != nullptr && first->source() != nullptr);
+    BOOST_CHECK(first->source() == second->source());
+    BOOST_CHECK(std::strcmp(first->source()->function, "test_method") == 0);
+    BOOST_CHECK(first->message() == "record");
+
+    // records cut short are refused.
+    BOOST_CHECK(log_record::decode(buffer.data(), buffer.size() - 1) == nullptr);
+}
+
+} // namespace inglenook::logging
+
+} // namespace inglenook
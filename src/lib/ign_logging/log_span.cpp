@@ -0,0 +1,568 @@
+/*
+ * log_span.cpp: Lightweight tracing spans and counters, written out through a log_writer.
+ * Copyright (C) 2012, Project Inglenook (http://www.project-inglenook.co.uk)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// inglenook includes
+#include "log_span.h"
+#include "log_formatter.h"
+
+// standard library includes
+#include <algorithm>
+#include <cstring>
+#include <iomanip>
+#include <map>
+#include <set>
+#include <sstream>
+
+// boost (http://boost.org) includes
+#include <boost/thread/mutex.hpp>
+
+// platform includes
+#include <time.h>
+
+namespace inglenook
+{
+
+namespace logging
+{
+
+//--------------------------------------------------------//
+// Hide the implementation in the anonymous namespace.
+namespace
+{
+
+    /// an event as held in a trace (native byte order, like log_record).
+    struct trace_event_record
+    {
+        /// when the span began, or the counter was recorded (nanoseconds).
+        std::int64_t begin;
+
+        /// how long the span took (nanoseconds), or the value of the counter.
+        std::int64_t value;
+
+        /// identifies the name of the span or counter (see log_span_site::id).
+        std::uint32_t site;
+
+        /// what was recorded (see span_kind).
+        std::uint32_t kind;
+    };
+
+    /// most events passed to the writer in a single entry.
+    const std::size_t BATCH_LIMIT = 4096;
+
+    /// a thread's events, not yet passed to the writer.
+    struct trace_buffer
+    {
+        /// identifies the thread in traces.
+        std::uint64_t thread;
+
+        /// number of entries passed to the writer by the thread.
+        std::uint64_t batches;
+
+        /// number of events to pass to the writer at a time.
+        std::size_t capacity;
+
+        /// the events (handed to the writer as they are, see flush_buffer()).
+        std::shared_ptr<log_attachment::bytes> events;
+    };
+
+    /// serializes access to the writer and the names of spans and counters.
+    boost::mutex tracer_mutex;
+
+    /// writer traces are passed to (nullptr while tracing is stopped).
+    std::shared_ptr<log_writer> tracer_writer;
+
+    /// category of the entries holding traces.
+    category tracer_entry_type = category::information;
+
+    /// names of the spans and counters recorded, indexed by id - 1.
+    std::vector<const char*> site_names;
+
+    /// identifies the next thread to record an event.
+    std::atomic<std::uint64_t> next_trace_thread(1);
+
+    /**
+     * Gets the number of events to pass to a writer at a time: as many as fit in an attachment it writes out in full
+     * (see log_writer::attachment_limit()), up to BATCH_LIMIT.
+     * @param writer the writer (nullptr if tracing has stopped, in which case events are dropped one at a time).
+     * @returns number of events.
+     */
+    std::size_t batch_capacity(const std::shared_ptr<log_writer>& writer)
+    {
+        std::size_t limit = writer == nullptr ? 0 : writer->attachment_limit();
+        return std::max<std::size_t>(1, std::min(BATCH_LIMIT, limit / sizeof(trace_event_record)));
+    }
+
+    /**
+     * Passes a thread's events to the writer as a single entry, holding the events as they were recorded and the
+     * names of the spans and counters among them. The events are dropped if tracing has been stopped since.
+     * @param buffer the thread's events.
+     */
+    void flush_buffer(trace_buffer& buffer)
+    {
+        if(buffer.events == nullptr || buffer.events->empty())
+        {
+            return;
+        }
+
+        // find which names the entry needs ...
+        auto events = buffer.events;
+        std::size_t count = events->size() / sizeof(trace_event_record);
+        std::set<std::uint32_t> ids;
+        for(std::size_t i = 0; i < count; i++)
+        {
+            trace_event_record event;
+            std::memcpy(&event, events->data() + i * sizeof(event), sizeof(event));
+            ids.insert(event.site);
+        }
+
+        // ... and look them up, along with where the entry goes.
+        std::shared_ptr<log_writer> writer;
+        category entry_type;
+        std::map<std::uint32_t, std::string> names;
+        {
+            boost::mutex::scoped_lock lock(tracer_mutex);
+            writer = tracer_writer;
+            entry_type = tracer_entry_type;
+            for(auto id = ids.begin(); id != ids.end(); id++)
+            {
+                if(*id > 0 && *id <= site_names.size())
+                {
+                    names[*id] = site_names[*id - 1];
+                }
+            }
+        }
+
+        buffer.capacity = batch_capacity(writer);
+        buffer.events = std::make_shared<log_attachment::bytes>();
+        buffer.events->reserve(buffer.capacity * sizeof(trace_event_record));
+        if(writer == nullptr)
+        {
+            return;
+        }
+
+        auto entry = std::make_shared<log_entry>();
+        entry->entry_type(entry_type);
+        entry->log_namespace(log_tracer::TRACE_NAMESPACE);
+        entry->message("traced " + std::to_string(count) + " events (thread " + std::to_string(buffer.thread) +
+                ", batch " + std::to_string(++buffer.batches) + ")");
+        entry->field(log_tracer::THREAD_KEY, static_cast<std::uint64_t>(buffer.thread));
+        for(auto name = names.begin(); name != names.end(); name++)
+        {
+            entry->extended_data(log_tracer::SITE_KEY + std::to_string(name->first), name->second);
+        }
+        entry->attachment(log_attachment(log_tracer::EVENTS_ATTACHMENT, events, attachment_base64));
+        writer->add_entry(entry);
+    }
+
+    /// the calling thread's events (created when first needed, see trace_buffer_release).
+    thread_local trace_buffer* current_trace_buffer = nullptr;
+
+    /// passes on, then releases, the calling thread's events when the thread exits.
+    struct trace_buffer_release
+    {
+        ~trace_buffer_release()
+        {
+            if(current_trace_buffer != nullptr)
+            {
+                flush_buffer(*current_trace_buffer);
+            }
+            delete current_trace_buffer;
+            current_trace_buffer = nullptr;
+        }
+    };
+
+    /// registered to be destroyed at thread exit when it is first used (see create_buffer()).
+    thread_local trace_buffer_release release_trace_buffer;
+
+    /**
+     * Creates the calling thread's buffer, the first time it records an event.
+     * @returns the buffer.
+     */
+    trace_buffer* create_buffer()
+    {
+        std::shared_ptr<log_writer> writer;
+        {
+            boost::mutex::scoped_lock lock(tracer_mutex);
+            writer = tracer_writer;
+        }
+
+        auto buffer = current_trace_buffer = new trace_buffer { next_trace_thread++, 0, batch_capacity(writer),
+                std::make_shared<log_attachment::bytes>() };
+        buffer->events->reserve(buffer->capacity * sizeof(trace_event_record));
+
+        // (using the release object registers it to be destroyed when this thread exits.)
+        static_cast<void>(&release_trace_buffer);
+        return buffer;
+    }
+
+    /**
+     * Gives a span or counter an id, the first time it is recorded.
+     * @param site where the span or counter is recorded from.
+     * @returns the id.
+     */
+    std::uint32_t register_site(log_span_site& site)
+    {
+        boost::mutex::scoped_lock lock(tracer_mutex);
+        std::uint32_t id = site.id.load(std::memory_order_relaxed);
+        if(id == 0)
+        {
+            site_names.push_back(site.name);
+            id = site_names.size();
+            site.id.store(id, std::memory_order_release);
+        }
+        return id;
+    }
+
+    /**
+     * Writes a time in microseconds, to the nanosecond.
+     * @param output stream to write to.
+     * @param nanoseconds the time.
+     */
+    void write_microseconds(std::ostream& output, std::int64_t nanoseconds)
+    {
+        if(nanoseconds < 0)
+        {
+            output << "-";
+            nanoseconds = -nanoseconds;
+        }
+        output << nanoseconds / 1000 << "." << std::setw(3) << std::setfill('0') << nanoseconds % 1000
+               << std::setfill(' ');
+    }
+
+    /**
+     * Describes a duration, in the most suitable unit.
+     * @param nanoseconds the duration.
+     * @returns the duration (for example "2.500us").
+     */
+    std::string describe_duration(const std::int64_t& nanoseconds)
+    {
+        const char* const UNITS[] = { "ns", "us", "ms", "s" };
+        double value = static_cast<double>(nanoseconds);
+        std::size_t unit = 0;
+        while(unit < 3 && (value >= 1000 || value <= -1000))
+        {
+            value /= 1000;
+            unit++;
+        }
+
+        std::ostringstream description;
+        description << std::fixed << std::setprecision(unit == 0 ? 0 : 3) << value << UNITS[unit];
+        return description.str();
+    }
+
+}
+//--------------------------------------------------------//
+
+/// namespace of the entries holding traces.
+const char* const log_tracer::TRACE_NAMESPACE = "inglenook.logging.trace";
+
+/// typed extended data key holding the thread the events were recorded on.
+const char* const log_tracer::THREAD_KEY = "inglenook.logging.trace.thread";
+
+/// extended data key (followed by an id) holding the name of a span or counter.
+const char* const log_tracer::SITE_KEY = "inglenook.logging.trace.site.";
+
+/// name of the attachment holding the events.
+const char* const log_tracer::EVENTS_ATTACHMENT = "inglenook.logging.trace.events";
+
+/// set while tracing.
+std::atomic<bool> log_tracer::m_enabled(false);
+
+/**
+ * Starts tracing. Spans and counters recorded from now on are passed to the specified writer, a thread's worth at a
+ * time, as entries in the TRACE_NAMESPACE namespace. The entries hold the events as a binary attachment, so are as
+ * large as the writer's attachment limit allows. Give tracing a writer of its own (with its console threshold set to
+ * category::no_log) to keep traces out of the main log.
+ * @param writer writer to pass the events to.
+ * @param entry_type category of the entries holding the events (the writer's thresholds must let them through).
+ */
+void log_tracer::start(const std::shared_ptr<log_writer>& writer, const category& entry_type)
+{
+    {
+        boost::mutex::scoped_lock lock(tracer_mutex);
+        tracer_writer = writer;
+        tracer_entry_type = entry_type;
+    }
+    m_enabled.store(writer != nullptr, std::memory_order_relaxed);
+}
+
+/**
+ * Stops tracing, passing the events recorded on the calling thread to the writer and then letting go of it. Threads
+ * pass their events on when their buffers fill up or they exit, so threads still running should flush() before
+ * tracing stops; events they recorded that are left in their buffers are dropped.
+ */
+void log_tracer::stop()
+{
+    m_enabled.store(false, std::memory_order_relaxed);
+    flush();
+
+    boost::mutex::scoped_lock lock(tracer_mutex);
+    tracer_writer.reset();
+}
+
+/**
+ * Passes the events recorded on the calling thread to the writer (rather than waiting for its buffer to fill).
+ */
+void log_tracer::flush()
+{
+    if(current_trace_buffer != nullptr)
+    {
+        flush_buffer(*current_trace_buffer);
+    }
+}
+
+/**
+ * Gets the time from the clock spans are timed with: the monotonic clock, so spans aren't thrown by the time of day
+ * being changed. The rest of the library reads the monotonic clock through here too.
+ * @returns the time (nanoseconds).
+ */
+std::int64_t log_tracer::now()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return static_cast<std::int64_t>(now.tv_sec) * 1000000000 + now.tv_nsec;
+}
+
+/**
+ * Records an event in the calling thread's buffer, passing the buffer to the writer if it is full. Nothing is copied
+ * other than the event itself (the name is identified by the site's id). Used by IGN_SPAN and IGN_COUNTER, which only
+ * call this while tracing.
+ * @param site where the event is recorded from.
+ * @param kind what was recorded.
+ * @param begin when the span began, or the counter was recorded (see now()).
+ * @param value how long the span took (nanoseconds), or the value of the counter.
+ */
+void log_tracer::record(log_span_site& site, const span_kind& kind, const std::int64_t& begin, const std::int64_t& value)
+{
+    auto buffer = current_trace_buffer;
+    if(buffer == nullptr)
+    {
+        buffer = create_buffer();
+    }
+
+    std::uint32_t id = site.id.load(std::memory_order_acquire);
+    if(id == 0)
+    {
+        id = register_site(site);
+    }
+
+    trace_event_record event = { begin, value, id, kind };
+    auto bytes = reinterpret_cast<const unsigned char*>(&event);
+    buffer->events->insert(buffer->events->end(), bytes, bytes + sizeof(event));
+    if(buffer->events->size() >= buffer->capacity * sizeof(event))
+    {
+        flush_buffer(*buffer);
+    }
+}
+
+/**
+ * Reads the events held by an entry written by the tracer. Events cut off by the writer's attachment limit are
+ * left out.
+ * @param entry the entry (read back from a log file, for example).
+ * @param events [output] the events are appended to this.
+ * @returns true if the entry holds a trace.
+ */
+bool log_tracer::decode(log_entry& entry, std::vector<log_span_event>& events)
+{
+    if(entry.log_namespace() != TRACE_NAMESPACE)
+    {
+        return false;
+    }
+
+    auto& attachments = entry.attachments();
+    auto attachment = std::find_if(attachments.begin(), attachments.end(),
+            [](const log_attachment& item) { return item.name() == EVENTS_ATTACHMENT; });
+    if(attachment == attachments.end())
+    {
+        return false;
+    }
+
+    std::uint64_t thread = 0;
+    auto& fields = entry.fields();
+    auto thread_field = fields.find(THREAD_KEY);
+    if(thread_field != fields.end() && thread_field->second.type() == field_uint64)
+    {
+        thread = thread_field->second.uint64_value();
+    }
+
+    // the names are held as extended data, keyed by id.
+    const std::string SITE_PREFIX = SITE_KEY;
+    std::map<std::uint32_t, std::string> names;
+    auto& extended_data = entry.extended_data();
+    for(auto data = extended_data.lower_bound(SITE_PREFIX);
+        data != extended_data.end() && data->first.compare(0, SITE_PREFIX.length(), SITE_PREFIX) == 0; data++)
+    {
+        try
+        {
+            names[std::stoul(data->first.substr(SITE_PREFIX.length()))] = data->second;
+        }
+        catch(std::exception&)
+        {
+            // (not one of ours.)
+        }
+    }
+
+    std::size_t count = attachment->length() / sizeof(trace_event_record);
+    for(std::size_t i = 0; i < count; i++)
+    {
+        trace_event_record record;
+        std::memcpy(&record, attachment->data() + i * sizeof(record), sizeof(record));
+        if(record.kind > span_counter)
+        {
+            continue;
+        }
+
+        auto name = names.find(record.site);
+        events.push_back(log_span_event { name == names.end() ? "site " + std::to_string(record.site) : name->second,
+                static_cast<span_kind>(record.kind), thread, record.begin, record.value });
+    }
+    return true;
+}
+
+/**
+ * Converts the traces in a log file to Chrome's trace event format, which can be loaded in to Perfetto
+ * (ui.perfetto.dev) or chrome://tracing. Spans are written as complete ("X") events and counters as counter ("C")
+ * events, on the thread they were recorded on; times are in microseconds on the monotonic clock.
+ * @param reader the log file.
+ * @param output stream to write the JSON to.
+ * @returns number of events written.
+ */
+std::size_t log_tracer::write_chrome_trace(log_file_reader& reader, std::ostream& output)
+{
+    std::size_t written = 0;
+    std::vector<log_span_event> events;
+    std::string name;
+
+    output << "{\"traceEvents\":[";
+    for(auto entry = reader.next_entry(); entry != nullptr; entry = reader.next_entry())
+    {
+        events.clear();
+        if(!decode(*entry, events))
+        {
+            continue;
+        }
+
+        for(auto event = events.begin(); event != events.end(); event++)
+        {
+            name.clear();
+            log_formatter::append_json_string(name, event->name);
+            output << (written++ == 0 ? "\n" : ",\n") << "{\"name\":" << name << ",\"ph\":\"" << (event->kind == span_complete ? "X" : "C") << "\",\"ts\":";
+            write_microseconds(output, event->begin);
+            if(event->kind == span_complete)
+            {
+                output << ",\"dur\":";
+                write_microseconds(output, event->value);
+            }
+            output << ",\"pid\":1,\"tid\":" << event->thread;
+            if(event->kind == span_counter)
+            {
+                output << ",\"args\":{\"value\":" << event->value << "}";
+            }
+            output << "}";
+        }
+    }
+    output << "\n],\"displayTimeUnit\":\"ns\"}" << std::endl;
+
+    return written;
+}
+
+/**
+ * Summarizes the traces in a log file: for each span, the number recorded, their percentiles and a histogram of the
+ * time they took (in power of two buckets), and for each counter, the number of values recorded and their range.
+ * @param reader the log file.
+ * @param output stream to write the summary to.
+ * @returns number of events summarized.
+ */
+std::size_t log_tracer::write_summary(log_file_reader& reader, std::ostream& output)
+{
+    const std::size_t BAR_WIDTH = 40;
+
+    std::size_t summarized = 0;
+    std::map<std::string, std::vector<std::int64_t>> spans;
+    std::map<std::string, std::vector<std::int64_t>> counters;
+    std::vector<log_span_event> events;
+    for(auto entry = reader.next_entry(); entry != nullptr; entry = reader.next_entry())
+    {
+        events.clear();
+        decode(*entry, events);
+        for(auto event = events.begin(); event != events.end(); event++)
+        {
+            (event->kind == span_complete ? spans : counters)[event->name].push_back(event->value);
+            summarized++;
+        }
+    }
+
+    for(auto span = spans.begin(); span != spans.end(); span++)
+    {
+        auto& durations = span->second;
+        std::sort(durations.begin(), durations.end());
+        std::int64_t total = 0;
+        for(auto duration = durations.begin(); duration != durations.end(); duration++)
+        {
+            total += *duration;
+        }
+        auto percentile = [&durations](const std::size_t& percent)
+                { return durations[std::min(durations.size() - 1, durations.size() * percent / 100)]; };
+
+        output << "span " << span->first << ": " << durations.size() << " recorded, total "
+               << describe_duration(total) << std::endl
+               << "    min " << describe_duration(durations.front())
+               << "  mean " << describe_duration(total / static_cast<std::int64_t>(durations.size()))
+               << "  p50 " << describe_duration(percentile(50))
+               << "  p90 " << describe_duration(percentile(90))
+               << "  p99 " << describe_duration(percentile(99))
+               << "  max " << describe_duration(durations.back()) << std::endl;
+
+        // bucket b holds durations in [2^b, 2^(b+1)) nanoseconds (bucket 0 also holds anything shorter).
+        std::vector<std::size_t> buckets(64, 0);
+        std::size_t first = 63, last = 0;
+        for(auto duration = durations.begin(); duration != durations.end(); duration++)
+        {
+            std::size_t bucket = 0;
+            while(bucket < 62 && *duration >= (static_cast<std::int64_t>(2) << bucket))
+            {
+                bucket++;
+            }
+            buckets[bucket]++;
+            first = std::min(first, bucket);
+            last = std::max(last, bucket);
+        }
+        std::size_t tallest = *std::max_element(buckets.begin(), buckets.end());
+        for(std::size_t bucket = first; bucket <= last; bucket++)
+        {
+            std::size_t width = (buckets[bucket] * BAR_WIDTH + tallest - 1) / tallest;
+            output << "    " << std::setw(10) << describe_duration(bucket == 0 ? 0 : static_cast<std::int64_t>(1) << bucket)
+                   << " - " << std::left << std::setw(10) << describe_duration(static_cast<std::int64_t>(2) << bucket)
+                   << std::right << std::setw(8) << buckets[bucket] << " " << std::string(width, '#') << std::endl;
+        }
+    }
+
+    for(auto counter = counters.begin(); counter != counters.end(); counter++)
+    {
+        auto& values = counter->second;
+        output << "counter " << counter->first << ": " << values.size() << " recorded, min "
+               << *std::min_element(values.begin(), values.end()) << ", max "
+               << *std::max_element(values.begin(), values.end()) << ", last " << values.back() << std::endl;
+    }
+
+    return summarized;
+}
+
+} // namespace inglenook::logging
+
+} // namespace inglenook
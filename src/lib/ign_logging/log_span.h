@@ -0,0 +1,215 @@
+#pragma once
+/*
+ * log_span.h: Lightweight tracing spans and counters, written out through a log_writer.
+ * Copyright (C) 2012, Project Inglenook (http://www.project-inglenook.co.uk)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// standard library includes
+#include <atomic>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+// inglenook includes
+#include "log_writer.h"
+#include "log_file_reader.h"
+
+// (joins two tokens, after expanding them.)
+#define IGN_SPAN_CONCAT_(a, b) a##b
+#define IGN_SPAN_CONCAT(a, b) IGN_SPAN_CONCAT_(a, b)
+
+/**
+ * Times the rest of the enclosing scope as a span (see log_tracer), for example:
+ *
+ *     void poll() { IGN_SPAN("zwave.poll"); ... }
+ *
+ * The name must be a string literal (it is kept, not copied). While tracing is stopped a span costs a relaxed load and
+ * two well predicted tests (one as it begins, one as it ends), with no clock read and no call.
+ */
+#define IGN_SPAN(name) \
+    static ::inglenook::logging::log_span_site IGN_SPAN_CONCAT(ign_span_site_, __LINE__) = { name, { 0 } }; \
+    ::inglenook::logging::log_span IGN_SPAN_CONCAT(ign_span_, __LINE__)(IGN_SPAN_CONCAT(ign_span_site_, __LINE__))
+
+/**
+ * Records the value of a counter (for example a queue length) at this point in time (see log_tracer). The name must be
+ * a string literal, and the value is only evaluated while tracing.
+ */
+#define IGN_COUNTER(name, value) \
+    do \
+    { \
+        if(::inglenook::logging::log_tracer::enabled()) \
+        { \
+            static ::inglenook::logging::log_span_site ign_counter_site = { name, { 0 } }; \
+            ::inglenook::logging::log_tracer::record(ign_counter_site, ::inglenook::logging::span_counter, \
+                    ::inglenook::logging::log_tracer::now(), static_cast<std::int64_t>(value)); \
+        } \
+    } \
+    while(false)
+
+namespace inglenook
+{
+
+namespace logging
+{
+
+/**
+ * Trace event kinds
+ * The values are used in the traces written out, so must not change.
+ */
+enum span_kind : std::uint32_t
+{
+    span_complete = 0x00,  /**< A span, with the time it took. */
+    span_counter  = 0x01   /**< The value of a counter. */
+};
+
+/**
+ * A place spans or counters are recorded from (see IGN_SPAN and IGN_COUNTER), static to the call site.
+ */
+struct log_span_site
+{
+    /// name of the span or counter (a string literal).
+    const char* name;
+
+    /// identifies the name in the traces written out (0 until first recorded).
+    std::atomic<std::uint32_t> id;
+};
+
+/**
+ * A span or counter value read back from a trace (see log_tracer::decode()).
+ */
+struct log_span_event
+{
+    /// name of the span or counter.
+    std::string name;
+
+    /// what was recorded.
+    span_kind kind;
+
+    /// thread the event was recorded on (numbered by the tracer, from 1).
+    std::uint64_t thread;
+
+    /// when the span began, or the counter was recorded (nanoseconds, monotonic clock).
+    std::int64_t begin;
+
+    /// how long the span took (nanoseconds), or the value of the counter.
+    std::int64_t value;
+};
+
+/**
+ * The log_tracer class records spans and counters for instrumenting hot paths. Each thread records in to a buffer of
+ * its own, which is passed to the log writer tracing was started with as a single entry (namespace TRACE_NAMESPACE)
+ * once full, or when the thread flushes it or ends. The entry holds the events as a binary attachment, so nothing is
+ * formatted until the writer encodes it. Traces are read back from log files by decode(), write_chrome_trace() and
+ * write_summary() (see the ign_logging_trace tool).
+ */
+class log_tracer
+{
+
+    public:
+
+        /// there is no default constructor for this class (all members are static).
+        log_tracer() = delete;
+
+        /// namespace of the entries holding traces.
+        static const char* const TRACE_NAMESPACE;
+
+        /// typed extended data key holding the thread the events were recorded on.
+        static const char* const THREAD_KEY;
+
+        /// extended data key (followed by an id) holding the name of a span or counter.
+        static const char* const SITE_KEY;
+
+        /// name of the attachment holding the events.
+        static const char* const EVENTS_ATTACHMENT;
+
+        // starts tracing, passing the events recorded to a log writer.
+        static void start(const std::shared_ptr<log_writer>& writer, const category& entry_type = category::information);
+
+        // stops tracing.
+        static void stop();
+
+        /// indicates if tracing has been started (the only load a span makes while it hasn't).
+        static bool enabled() { return m_enabled.load(std::memory_order_relaxed); }
+
+        // passes the events recorded on this thread to the log writer.
+        static void flush();
+
+        // gets the time from the monotonic clock spans (and the rest of the library) are timed with (nanoseconds).
+        static std::int64_t now();
+
+        // records an event on this thread.
+        static void record(log_span_site& site, const span_kind& kind, const std::int64_t& begin, const std::int64_t& value);
+
+        // reads the events held by an entry.
+        static bool decode(log_entry& entry, std::vector<log_span_event>& events);
+
+        // converts the traces in a log file to Chrome's trace event format (JSON, viewable in Perfetto).
+        static std::size_t write_chrome_trace(log_file_reader& reader, std::ostream& output);
+
+        // summarizes the traces in a log file, with a histogram of the time taken by each span.
+        static std::size_t write_summary(log_file_reader& reader, std::ostream& output);
+
+    private:
+
+        /// set while tracing.
+        static std::atomic<bool> m_enabled;
+};
+
+/**
+ * The log_span class times its scope as a span while tracing (see IGN_SPAN).
+ */
+class log_span
+{
+
+    public:
+
+        /// there is no copy constructor for this class.
+        log_span(const log_span&) = delete;
+
+        /// begins the span (if tracing).
+        explicit log_span(log_span_site& site) : m_site(nullptr), m_begin(0)
+        {
+            if(log_tracer::enabled())
+            {
+                m_site = &site;
+                m_begin = log_tracer::now();
+            }
+        }
+
+        /// ends the span, recording it (if it began while tracing; the scope may outlast tracing, so this can't
+        /// test enabled() again).
+        ~log_span()
+        {
+            if(m_site != nullptr)
+            {
+                log_tracer::record(*m_site, span_complete, m_begin, log_tracer::now() - m_begin);
+            }
+        }
+
+    private:
+
+        /// where the span is recorded from (nullptr if not tracing).
+        log_span_site* m_site;
+
+        /// when the span began.
+        std::int64_t m_begin;
+};
+
+} // namespace inglenook::logging
+
+} // namespace inglenook
@@ -0,0 +1,151 @@
+#pragma once
+/*
+* log_span_tests.h: Test routines for the log_tracer and log_span classes (log_span.cpp/h)
+* Copyright (C) 2012, Project Inglenook (http://www.project-inglenook.co.uk)
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE LOG_TEST_NAME
+
+// standard includes
+#include <sstream>
+#include <vector>
+
+// boost (http://boost.org) includes
+#include <boost/test/unit_test.hpp>
+#include <boost/thread.hpp>
+
+// inglenook includes
+#include "log_span.h"
+#include "log_file_reader.h"
+
+namespace inglenook
+{
+
+namespace logging
+{
+
+//
+// log_span_tests__stopped
+// checks nothing is recorded while tracing is stopped.
+BOOST_AUTO_TEST_CASE ( log_span_tests__stopped )
+{
+    BOOST_CHECK(!log_tracer::enabled());
+    for(int i = 0; i < 10; i++)
+    {
+        IGN_SPAN("test.stopped");
+        IGN_COUNTER("test.stopped.counter", i);
+    }
+
+    auto xml = std::shared_ptr<std::stringstream>(new std::stringstream());
+    {
+        auto writer = log_writer::create_from_stream(xml, false, false);
+        writer->console_threshold(category::no_log);
+        log_tracer::start(writer);
+        BOOST_CHECK(log_tracer::enabled());
+        log_tracer::stop();
+        BOOST_CHECK(!log_tracer::enabled());
+    }
+    BOOST_CHECK(xml->str().find(log_tracer::TRACE_NAMESPACE) == std::string::npos);
+}
+
+//
+// log_span_tests__traces
+// checks spans and counters recorded on each thread are written out by the writer (a few
+// at a time, as the attachment limit allows), read back from the log file, converted to
+// Chrome's trace event format and summarized.
+BOOST_AUTO_TEST_CASE ( log_span_tests__traces )
+{
+    auto xml = std::shared_ptr<std::stringstream>(new std::stringstream());
+    {
+        auto writer = log_writer::create_from_stream(xml, false, false);
+        writer->console_threshold(category::no_log);
+        writer->attachment_limit(48);
+        log_tracer::start(writer);
+
+        for(int i = 0; i < 10; i++)
+        {
+            IGN_SPAN("test.span");
+            IGN_COUNTER("test.counter", i);
+        }
+        boost::thread worker([]()
+        {
+            for(int i = 0; i < 3; i++)
+            {
+                IGN_SPAN("test.worker");
+            }
+        });
+        worker.join();
+
+        log_tracer::stop();
+        IGN_SPAN("test.after");
+    }
+
+    // each thread's events are read back, in the order they were recorded.
+    std::vector<log_span_event> events;
+    std::size_t entries = 0;
+    log_file_reader reader(xml);
+    for(auto entry = reader.next_entry(); entry != nullptr; entry = reader.next_entry())
+    {
+        entries += log_tracer::decode(*entry, events) ? 1 : 0;
+    }
+    BOOST_CHECK(entries >= 12);
+    BOOST_REQUIRE(events.size() == 23);
+
+    std::size_t spans = 0, counters = 0, worker_spans = 0;
+    std::int64_t last_counter = -1;
+    for(auto event = events.begin(); event != events.end(); event++)
+    {
+        if(event->name == "test.span")
+        {
+            spans++;
+            BOOST_CHECK(event->kind == span_complete && event->value >= 0);
+        }
+        else if(event->name == "test.counter")
+        {
+            BOOST_CHECK(event->kind == span_counter && event->value == last_counter + 1);
+            last_counter = event->value;
+            counters++;
+        }
+        else if(event->name == "test.worker")
+        {
+            BOOST_CHECK(event->thread != events.front().thread);
+            worker_spans++;
+        }
+    }
+    BOOST_CHECK(spans == 10 && counters == 10 && worker_spans == 3);
+
+    // the traces can be converted ...
+    std::ostringstream chrome;
+    log_file_reader chrome_reader(std::shared_ptr<std::stringstream>(new std::stringstream(xml->str())));
+    BOOST_CHECK(log_tracer::write_chrome_trace(chrome_reader, chrome) == 23);
+    BOOST_CHECK(chrome.str().find("{\"traceEvents\":[") == 0);
+    BOOST_CHECK(chrome.str().find("{\"name\":\"test.span\",\"ph\":\"X\",\"ts\":") != std::string::npos);
+    BOOST_CHECK(chrome.str().find("\"ph\":\"C\"") != std::string::npos);
+    BOOST_CHECK(chrome.str().find("\"args\":{\"value\":9}") != std::string::npos);
+
+    // ... and summarized.
+    std::ostringstream summary;
+    log_file_reader summary_reader(std::shared_ptr<std::stringstream>(new std::stringstream(xml->str())));
+    BOOST_CHECK(log_tracer::write_summary(summary_reader, summary) == 23);
+    BOOST_CHECK(summary.str().find("span test.span: 10 recorded") != std::string::npos);
+    BOOST_CHECK(summary.str().find("span test.worker: 3 recorded") != std::string::npos);
+    BOOST_CHECK(summary.str().find("counter test.counter: 10 recorded, min 0, max 9, last 9") != std::string::npos);
+}
+
+} // namespace inglenook::logging
+
+} // namespace inglenook
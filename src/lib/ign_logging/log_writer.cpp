@@ -19,20 +19,28 @@
 // inglenook includes
 #include "log_writer.h"
 #include "log_exceptions.h"
+#include "log_file_stream.h"
+#include "log_mapped_file_stream.h"
+#include "log_record.h"
+#include "log_span.h"
 #include <ign_directories/directories.h>
 
 // standard library includes
 #include <fstream>
 #include <sstream>
+#include <algorithm>
+#include <cstdlib>
+#include <new>
 
 // boost (http://boost.org) includes
 #include <boost/locale.hpp>
-#include <boost/format.hpp>
 #include <boost/exception/all.hpp>
 #include <boost/date_time/posix_time/posix_time.hpp>
 #include <boost/date_time/posix_time/posix_time_io.hpp>
 #include <boost/thread/locks.hpp>
-#include <boost/algorithm/string/replace.hpp>
+
+// platform includes
+#include <unistd.h>
 
 namespace inglenook {
 
@@ -41,6 +49,184 @@ namespace logging {
 /// defines the value that expresses no PID
 const pid_type log_writer::NO_PID = 0;
 
+/// size of the spill ring's record area (see log_writer.h).
+const std::size_t log_writer::SPILL_CAPACITY;
+const std::size_t log_writer::ATTACHMENT_LIMIT;
+
+/// namespace the writer logs its own statistics under (reserved).
+const char* const log_writer::STATISTICS_NAMESPACE = "inglenook.logging.statistics";
+
+/// extended data keys describing a coalesced entry (see coalesce_window()).
+const char* const log_writer::REPEATED_KEY = "inglenook.logging.repeated";
+const char* const log_writer::REPEATED_FIRST_KEY = "inglenook.logging.repeated.first";
+const char* const log_writer::REPEATED_LAST_KEY = "inglenook.logging.repeated.last";
+
+/// extended data key holding the id of the group an entry was logged in (see add_entries()).
+const char* const log_writer::GROUP_KEY = "inglenook.logging.group";
+
+/**
+ * Live counters behind log_writer_statistics. Every counter is updated and read without locks (relaxed), so a
+ * snapshot is not an exact cut across counters; each counter is individually accurate.
+ */
+struct log_writer_counters
+{
+    std::atomic<std::uint64_t> enqueued[LOG_STATISTICS_CATEGORIES];
+    std::atomic<std::uint64_t> written[LOG_STATISTICS_CATEGORIES];
+    std::atomic<std::uint64_t> dropped[LOG_STATISTICS_CATEGORIES];
+    std::atomic<std::uint64_t> coalesced[LOG_STATISTICS_CATEGORIES];
+    std::atomic<std::uint64_t> queue_depth;
+    std::atomic<std::uint64_t> queue_high_water;
+    std::atomic<std::uint64_t> enqueue_wait[LOG_STATISTICS_WAIT_BUCKETS];
+    std::atomic<std::uint64_t> serialization_time;
+    std::atomic<std::uint64_t> bytes_written;
+    std::atomic<std::uint64_t> flushes;
+    std::atomic<std::uint64_t> flush_time;
+    std::atomic<std::uint64_t> flush_time_max;
+    std::atomic<std::uint64_t> syncs;
+    std::atomic<std::uint64_t> sync_time;
+    std::atomic<std::uint64_t> sync_time_max;
+
+    log_writer_counters() : queue_depth(0), queue_high_water(0), serialization_time(0), bytes_written(0),
+        flushes(0), flush_time(0), flush_time_max(0), syncs(0), sync_time(0), sync_time_max(0)
+    {
+        for(std::size_t i = 0; i < LOG_STATISTICS_CATEGORIES; i++)
+        {
+            enqueued[i] = 0;
+            written[i] = 0;
+            dropped[i] = 0;
+            coalesced[i] = 0;
+        }
+        for(std::size_t i = 0; i < LOG_STATISTICS_WAIT_BUCKETS; i++)
+        {
+            enqueue_wait[i] = 0;
+        }
+    }
+};
+
+/**
+ * Base of the structures holding cache line aligned members. Before C++17 new ignores alignment beyond the
+ * fundamental one, so they're allocated on a cache line boundary here instead.
+ */
+struct log_cache_aligned
+{
+    static void* operator new(std::size_t size)
+    {
+        void* memory = nullptr;
+        if(posix_memalign(&memory, 64, size) != 0)
+        {
+            throw std::bad_alloc();
+        }
+        return memory;
+    }
+
+    static void operator delete(void* memory)
+    {
+        free(memory);
+    }
+};
+
+/**
+ * Live counters behind log_namespace_statistics. Namespaces are found in an open addressed table of
+ * LOG_NAMESPACE_COUNTERS slots without taking locks; the lock is only taken to fill a slot, the first time an entry
+ * is logged under a namespace (once every slot is taken, further namespaces share the overflow counters). Each
+ * namespace's counters are split over SHARDS cache lines, and each thread counts in one of them, so threads logging
+ * under the same namespace don't fight over a line; snapshots add the shards up.
+ */
+struct log_namespace_counters : log_cache_aligned
+{
+    /// number of shards each namespace's counters are split over.
+    static const std::size_t SHARDS = 4;
+
+    /// a thread's share of the counters, on a cache line of its own.
+    struct alignas(64) shard
+    {
+        std::atomic<std::uint64_t> logged[LOG_STATISTICS_CATEGORIES];
+    };
+    static_assert(sizeof(shard) % 64 == 0, "namespace counter shards must fill whole cache lines");
+
+    /// counters of a single namespace.
+    struct counters : log_cache_aligned
+    {
+        const std::string log_namespace;
+        const std::size_t hash;
+        shard shards[SHARDS];
+
+        counters(const std::string& name, const std::size_t& name_hash) : log_namespace(name), hash(name_hash)
+        {
+            for(std::size_t i = 0; i < SHARDS; i++)
+            {
+                for(std::size_t j = 0; j < LOG_STATISTICS_CATEGORIES; j++)
+                {
+                    shards[i].logged[j] = 0;
+                }
+            }
+        }
+
+        std::uint64_t logged(const std::size_t& slot) const
+        {
+            std::uint64_t total = 0;
+            for(std::size_t i = 0; i < SHARDS; i++)
+            {
+                total += shards[i].logged[slot].load(std::memory_order_relaxed);
+            }
+            return total;
+        }
+    };
+
+    std::atomic<counters*> slots[LOG_NAMESPACE_COUNTERS];
+    counters overflow;
+    boost::mutex fill_mutex;
+
+    log_namespace_counters() : overflow("", 0)
+    {
+        for(std::size_t i = 0; i < LOG_NAMESPACE_COUNTERS; i++)
+        {
+            slots[i] = nullptr;
+        }
+    }
+
+    ~log_namespace_counters()
+    {
+        for(std::size_t i = 0; i < LOG_NAMESPACE_COUNTERS; i++)
+        {
+            delete slots[i].load();
+        }
+    }
+
+    /// finds the counters of a namespace, filling a slot for it if create is set (nullptr if not found).
+    counters* find(const std::string& log_namespace, const bool& create)
+    {
+        std::size_t hash = std::hash<std::string>()(log_namespace);
+        for(std::size_t probe = 0; probe < LOG_NAMESPACE_COUNTERS; probe++)
+        {
+            auto& slot = slots[(hash + probe) % LOG_NAMESPACE_COUNTERS];
+            counters* found = slot.load(std::memory_order_acquire);
+            if(found == nullptr)
+            {
+                if(!create)
+                {
+                    return nullptr;
+                }
+
+                // slots are only ever filled under the lock, so look again once we hold it.
+                boost::mutex::scoped_lock lock(fill_mutex);
+                found = slot.load(std::memory_order_acquire);
+                if(found == nullptr)
+                {
+                    found = new counters(log_namespace, hash);
+                    slot.store(found, std::memory_order_release);
+                    return found;
+                }
+            }
+            if(found->hash == hash && found->log_namespace == log_namespace)
+            {
+                return found;
+            }
+        }
+        return create ? &overflow : nullptr;
+    }
+};
+
 /**
  * Creates a POSIX time item out of a milisecond duration..
  * @param ms milliseconds until event.
@@ -51,6 +237,82 @@ const boost::posix_time::ptime timeout_ms(int ms) {
     return boost::get_system_time() + boost::posix_time::milliseconds(ms);
 }
 
+//--------------------------------------------------------//
+// Hide the implementation in the anonymous namespace.
+namespace
+{
+
+    /**
+     * Gets the current time from the monotonic clock (used to time writes to the output stream).
+     * @returns milliseconds since an arbitrary point (never 0).
+     */
+    std::int64_t monotonic_ms()
+    {
+        return log_tracer::now() / 1000000 + 1;
+    }
+
+    /**
+     * Gets the current time from the monotonic clock (used for statistics).
+     * @returns microseconds since an arbitrary point.
+     */
+    std::int64_t monotonic_us()
+    {
+        return log_tracer::now() / 1000;
+    }
+
+    /**
+     * Gets the per category statistics slot for a category.
+     * @param entry_type category to look up.
+     * @returns slot index (unspecified for anything out of range).
+     */
+    std::size_t statistics_slot(const category& entry_type)
+    {
+        return entry_type < LOG_STATISTICS_CATEGORIES ? static_cast<std::size_t>(entry_type) : 0;
+    }
+
+    /**
+     * Raises an atomic counter to at least the specified value.
+     * @param counter counter to raise.
+     * @param value value to raise it to.
+     */
+    void raise_to(std::atomic<std::uint64_t>& counter, const std::uint64_t& value)
+    {
+        std::uint64_t current = counter.load(std::memory_order_relaxed);
+        while(current < value && !counter.compare_exchange_weak(current, value, std::memory_order_relaxed)) { }
+    }
+
+    /**
+     * Gets a future that has already completed.
+     * @param value value of the future.
+     * @returns completed future.
+     */
+    std::future<bool> completed_future(const bool& value)
+    {
+        std::promise<bool> completed;
+        completed.set_value(value);
+        return completed.get_future();
+    }
+
+    /**
+     * Gets the shard of the namespace counters this thread counts in (threads are dealt out across the shards).
+     * @returns shard index.
+     */
+    std::size_t namespace_counter_shard()
+    {
+        static std::atomic<std::size_t> next_shard(0);
+
+        // (0 until the thread first counts, then its shard plus one.)
+        thread_local std::size_t shard = 0;
+        if(shard == 0)
+        {
+            shard = next_shard.fetch_add(1, std::memory_order_relaxed) % log_namespace_counters::SHARDS + 1;
+        }
+        return shard - 1;
+    }
+
+}
+//--------------------------------------------------------//
+
 /**
  * Creates a new log_writer instance which will emit output to the specified std::ostream.
  * @param output_stream std::ostream to write XML to.
@@ -78,17 +340,46 @@ log_writer::log_writer(const std::shared_ptr<std::ostream>& output_stream, const
     m_log_serialization_thread(nullptr),
     m_log_serialization_shutdown_mutex(new boost::timed_mutex()),
     m_log_serialization_queue_mutex(new boost::mutex()),
-    m_log_serialization_element_queuing_mutex(new boost::mutex()),
     m_process_id(specific_pid),
     m_process_name(specific_application_name),
     m_output_stream(output_stream),
+    m_output_started(false),
+    m_crash_protected(false),
     m_xml_serialization_threshold(category::information),
     m_console_serialization_threshold(category::information),
     m_default_entry_type(category::information),
     m_default_namespace("inglenook.anonymous"),
     m_write_header(write_header),
-    m_write_footer(write_footer)
+    m_write_footer(write_footer),
+    m_service_lost(false),
+    m_sink_write_started(0),
+    m_spilling(false),
+    m_spill_unavailable(false),
+    m_replay_started(0),
+    m_stalls(0),
+    m_stall_time(0),
+    m_spilled_entries(0),
+    m_spilled_bytes(0),
+    m_replay_time(0),
+    m_counters(new log_writer_counters()),
+    m_statistics_interval(0),
+    m_statistics_logged(0),
+    m_namespace_counters(new log_namespace_counters()),
+    m_metrics_interval(0),
+    m_metrics_dumped(0),
+    m_coalesce_window(0),
+    m_attachment_limit(ATTACHMENT_LIMIT),
+    m_coalesce_hash(0),
+    m_coalesce_repeats(0),
+    m_coalesce_started(0),
+    m_next_group_id(1),
+    m_scheduled(0),
+    m_processed(0),
+    m_serializer_stopped(false)
 {
+    // entries are written as XML unless the writer is given another formatter (see formatter()).
+    formatter(std::make_shared<log_xml_formatter>());
+
     // check the output streams health
     if (m_output_stream != nullptr && m_output_stream->fail())
     {
@@ -106,6 +397,64 @@ log_writer::log_writer(const std::shared_ptr<std::ostream>& output_stream, const
             new boost::thread(&log_writer::_log_serialization_worker, this));
 }
 
+/**
+ * Creates a new log_writer instance which will pass log entries to the logging service daemon through a ring.
+ * No serialization thread is started and no output stream is held; entries are pushed in to the ring by the calling
+ * thread and written by the daemon. Should the daemon go away, a local writer is created on demand (see add_entry()).
+ * @param ring ring to push entries in to.
+ * @param specific_pid specify the PID to create log for.
+ * @param specific_application_name specify the application name to create log for.
+ * @see ~log_writer()
+ */
+log_writer::log_writer(const std::shared_ptr<log_ring>& ring, const pid_type& specific_pid, const std::string& specific_application_name) :
+    m_log_serialization_thread(nullptr),
+    m_log_serialization_shutdown_mutex(new boost::timed_mutex()),
+    m_log_serialization_queue_mutex(new boost::mutex()),
+    m_process_id(specific_pid),
+    m_process_name(specific_application_name),
+    m_output_stream(nullptr),
+    m_output_started(false),
+    m_crash_protected(false),
+    m_xml_serialization_threshold(category::information),
+    m_console_serialization_threshold(category::information),
+    m_default_entry_type(category::information),
+    m_default_namespace("inglenook.anonymous"),
+    m_write_header(false),
+    m_write_footer(false),
+    m_ring(ring),
+    m_service_lost(false),
+    m_sink_write_started(0),
+    m_spilling(false),
+    m_spill_unavailable(false),
+    m_replay_started(0),
+    m_stalls(0),
+    m_stall_time(0),
+    m_spilled_entries(0),
+    m_spilled_bytes(0),
+    m_replay_time(0),
+    m_counters(new log_writer_counters()),
+    m_statistics_interval(0),
+    m_statistics_logged(0),
+    m_namespace_counters(new log_namespace_counters()),
+    m_metrics_interval(0),
+    m_metrics_dumped(0),
+    m_coalesce_window(0),
+    m_attachment_limit(ATTACHMENT_LIMIT),
+    m_coalesce_hash(0),
+    m_coalesce_repeats(0),
+    m_coalesce_started(0),
+    m_next_group_id(1),
+    m_scheduled(0),
+    m_processed(0),
+    m_serializer_stopped(false)
+{
+    // entries are written as XML unless the writer is given another formatter (see formatter()).
+    formatter(std::make_shared<log_xml_formatter>());
+
+    // the queue is never used, but keep it valid for anything inspecting it (e.g. log_crash_handler).
+    m_log_serialization_queue = std::shared_ptr<log_message_queue>(new log_message_queue(1));
+}
+
 /**
  * Creates a new log_writer instance based on inglenooks logging directory structure. This can be impacted by a variety of factors
  * including but not limited to; global configuration, application configuration and environment.
@@ -149,6 +498,44 @@ std::shared_ptr<log_writer> log_writer::create(const bool& write_header, const b
             write_header, write_footer, specific_pid, specific_application_name);
 }
 
+/**
+ * Creates a new log_writer instance which will pass log entries to the logging service daemon (ign_logd).
+ * If the daemon is not running (or a ring cannot be created) this is equivalent to log_writer::create().
+ * @returns shared pointer to newly instanced log_writer.
+ */
+std::shared_ptr<log_writer> log_writer::create_from_service()
+{
+    return log_writer::create_from_service(
+            inglenook::core::application::pid(),
+            inglenook::core::application::name());
+}
+
+/**
+ * Creates a new log_writer instance which will pass log entries to the logging service daemon (ign_logd).
+ * If the daemon is not running (or a ring cannot be created) this is equivalent to log_writer::create().
+ * @param specific_pid specify the PID to create log for.
+ * @param specific_application_name specify the application name to create log for.
+ * @returns shared pointer to newly instanced log_writer.
+ */
+std::shared_ptr<log_writer> log_writer::create_from_service(const pid_type& specific_pid, const std::string& specific_application_name)
+{
+    // only bother with a ring if there is somebody to collect it.
+    if(log_ring::collector_running(log_ring::default_ring_directory()))
+    {
+        try
+        {
+            auto ring = log_ring::create(log_ring::default_ring_file(specific_pid), specific_pid, specific_application_name);
+            return std::shared_ptr<log_writer>(new log_writer(ring, specific_pid, specific_application_name));
+        }
+        catch(log_ring_exception&)
+        {
+            /* we can't use the service - carry on and write the log ourselves */
+        }
+    }
+
+    return log_writer::create(true, true, specific_pid, specific_application_name);
+}
+
 /**
  * Determines the default log path, note that the file path is time dependant and will
  * change with every call made to it.
@@ -248,6 +635,107 @@ std::shared_ptr<log_writer> log_writer::create_from_file_path(
         const boost::filesystem::path& output_file, const bool& create,
         const bool& write_header, const bool& write_footer,
         const pid_type& specific_pid, const std::string& specific_application_name)
+{
+    return log_writer::_create_from_file_path(output_file, create, write_header, write_footer,
+            specific_pid, specific_application_name, append_sink);
+}
+
+/**
+ * Creates a new log_writer instance which will emit output to the specified file, through a memory mapping of a
+ * preallocated file (see log_mapped_file_stream). This suits storage where many small appends are slow or leave the
+ * file badly fragmented (such as SD cards); only one process may append to the file at a time.
+ * @param output_file Path identifying file to write XML to.
+ * @param create If output_file doesn't exist, indicates whether to create it on the fly. Defaults to true.
+ * @param write_header indicates if the XML preamble should be written on startup
+ * @param write_footer indicates if the XML closure tags should be written on shutdown.
+ * @returns shared pointer to newly instanced log_writer.
+ */
+std::shared_ptr<log_writer> log_writer::create_from_mapped_file_path(
+        const boost::filesystem::path& output_file, const bool& create,
+        const bool& write_header, const bool& write_footer)
+{
+    return log_writer::create_from_mapped_file_path(output_file,
+            create, write_header, write_footer,
+            inglenook::core::application::pid(),
+            inglenook::core::application::name());
+}
+
+/**
+ * Creates a new log_writer instance which will emit output to the specified file, through a memory mapping of a
+ * preallocated file (see log_mapped_file_stream).
+ * @param output_file Path identifying file to write XML to.
+ * @param create If output_file doesn't exist, indicates whether to create it on the fly. Defaults to true.
+ * @param write_header indicates if the XML preamble should be written on startup
+ * @param write_footer indicates if the XML closure tags should be written on shutdown.
+ * @param specific_pid specify the PID to create log for
+ * @param specific_application_name specify the application name to create log for
+ * @returns shared pointer to newly instanced log_writer.
+ */
+std::shared_ptr<log_writer> log_writer::create_from_mapped_file_path(
+        const boost::filesystem::path& output_file, const bool& create,
+        const bool& write_header, const bool& write_footer,
+        const pid_type& specific_pid, const std::string& specific_application_name)
+{
+    return log_writer::_create_from_file_path(output_file, create, write_header, write_footer,
+            specific_pid, specific_application_name, mapped_sink);
+}
+
+/**
+ * Creates a new log_writer instance which will emit output to the specified file, handing its writes to the kernel
+ * through io_uring (see log_file_buffer) so the serializer doesn't wait on them. Where io_uring isn't available the
+ * file is appended to as create_from_file_path() would; only one process should append to the file at a time.
+ * @param output_file Path identifying file to write XML to.
+ * @param create If output_file doesn't exist, indicates whether to create it on the fly. Defaults to true.
+ * @param write_header indicates if the XML preamble should be written on startup
+ * @param write_footer indicates if the XML closure tags should be written on shutdown.
+ * @returns shared pointer to newly instanced log_writer.
+ */
+std::shared_ptr<log_writer> log_writer::create_from_async_file_path(
+        const boost::filesystem::path& output_file, const bool& create,
+        const bool& write_header, const bool& write_footer)
+{
+    return log_writer::create_from_async_file_path(output_file,
+            create, write_header, write_footer,
+            inglenook::core::application::pid(),
+            inglenook::core::application::name());
+}
+
+/**
+ * Creates a new log_writer instance which will emit output to the specified file, handing its writes to the kernel
+ * through io_uring (see log_file_buffer).
+ * @param output_file Path identifying file to write XML to.
+ * @param create If output_file doesn't exist, indicates whether to create it on the fly. Defaults to true.
+ * @param write_header indicates if the XML preamble should be written on startup
+ * @param write_footer indicates if the XML closure tags should be written on shutdown.
+ * @param specific_pid specify the PID to create log for
+ * @param specific_application_name specify the application name to create log for
+ * @returns shared pointer to newly instanced log_writer.
+ */
+std::shared_ptr<log_writer> log_writer::create_from_async_file_path(
+        const boost::filesystem::path& output_file, const bool& create,
+        const bool& write_header, const bool& write_footer,
+        const pid_type& specific_pid, const std::string& specific_application_name)
+{
+    return log_writer::_create_from_file_path(output_file, create, write_header, write_footer,
+            specific_pid, specific_application_name, async_sink);
+}
+
+/**
+ * Creates a new log_writer instance which will emit output to the specified file.
+ * @param output_file Path identifying file to write XML to.
+ * @param create If output_file doesn't exist, indicates whether to create it on the fly.
+ * @param write_header indicates if the XML preamble should be written on startup
+ * @param write_footer indicates if the XML closure tags should be written on shutdown.
+ * @param specific_pid specify the PID to create log for
+ * @param specific_application_name specify the application name to create log for
+ * @param sink how the file is written: appended to (log_file_stream), through a memory mapping
+ *        (log_mapped_file_stream) or appended to through io_uring (log_file_stream, asynchronously).
+ * @returns shared pointer to newly instanced log_writer.
+ */
+std::shared_ptr<log_writer> log_writer::_create_from_file_path(
+        const boost::filesystem::path& output_file, const bool& create,
+        const bool& write_header, const bool& write_footer,
+        const pid_type& specific_pid, const std::string& specific_application_name, const file_sink& sink)
 {
     try
     {
@@ -292,10 +780,22 @@ std::shared_ptr<log_writer> log_writer::create_from_file_path(
 
         // at this point either the log exists, or we are good to create it
         // so attempt to open the specified file path for appending data.
-        return std::shared_ptr<log_writer>(new log_writer(std::shared_ptr<std::ofstream>(
-                                new std::ofstream(output_file.native(), std::ios::app)),
+        std::shared_ptr<std::ostream> output_stream;
+        if(sink == mapped_sink)
+        {
+            output_stream = std::make_shared<log_mapped_file_stream>(output_file.native());
+        }
+        else
+        {
+            output_stream = std::make_shared<log_file_stream>(output_file.native(), sink == async_sink);
+        }
+        auto writer = std::shared_ptr<log_writer>(new log_writer(output_stream,
                                 write_header, write_footer, specific_pid,
                                 specific_application_name));
+
+        // remember where we are writing to (used by log_crash_handler).
+        writer->m_output_file = absolute(output_file);
+        return writer;
     }
     catch(boost::exception& ex)
     {
@@ -388,58 +888,213 @@ log_writer::~log_writer()
  */
 bool log_writer::add_entry(std::shared_ptr<log_entry>& entry)
 {
+    // (the entry isn't ours to look at once it is queued.)
+    std::int64_t started = monotonic_us();
+    category entry_type = entry->entry_type();
+    _count_namespace(entry->log_namespace().length() > 0 ? entry->log_namespace() : default_namespace(), entry_type);
+
+    // the logging service daemon is doing the writing for us.
+    if(m_ring != nullptr)
+    {
+        bool entry_passed = _service_add_entry(entry);
+        _count_entry(entry_type, entry_passed, started);
+        return entry_passed;
+    }
+
     bool entry_scheduled = false;
-    bool attempt_to_wake_serializer = false;
 
     // make sure there is a message
     if(entry->message().length() > 0)
     {
-        int schedule_attempts = 0;
-        const int MAX_SCHEDULE_ATTEMPTS = 10;
-
         // correct empty name spaces.
         if(entry->log_namespace().length() == 0)
         {
             entry->log_namespace(default_namespace());
         }
 
-        // attempt to acquire the lock on the queue mutex
-        boost::mutex::scoped_lock lock_queue(
-                (*m_log_serialization_queue_mutex.get()));
-
-        // check we asserted lock ownership
-        if(lock_queue.owns_lock())
+        // note who logged the entry (so only entries from the same thread are coalesced).
+        if(entry->thread() == std::thread::id())
         {
-            // attempt to schedule this entry...
-            while(schedule_attempts++ < MAX_SCHEDULE_ATTEMPTS)
-            {
-                bool boolean_queue = true;
-
-                // if the queue is empty, flag that we want to poke the serializer.
-                if(m_log_serialization_queue->empty())
-                {
-                    attempt_to_wake_serializer = true;
-                }
-                // else we can only attempt to serialize if the queue is empty
-                else
-                {
-                    boolean_queue = !m_log_serialization_queue->full();
-                }
+            entry->thread(std::this_thread::get_id());
+        }
 
-                // make sure the queue isn't full
-                if(boolean_queue)
-                {
-                    // push the item on to the queue
-                    m_log_serialization_queue->push_back(entry);
-                    entry_scheduled = true;
-                    break;
-                }
+        entry_scheduled = _schedule_entry(entry);
+    }
 
-                //
-                // the queue is full. wait on a notification from the serializer to proceed (or retry in RESCHEDULE_MAX_RETRY_DELAY milliseconds).
-                m_log_serialization_element_serialized.timed_wait(lock_queue, timeout_ms(RESCHEDULE_MAX_RETRY_DELAY));
-            }
-        }
+    // return result
+    _count_entry(entry_type, entry_scheduled, started);
+    return entry_scheduled;
+}
+
+/**
+ * Adds a log entry to the serialization queue, as add_entry() does, for entries the caller needs to know have been
+ * written (for example, a record of a critical event made before acting on it). The future completes once the entry,
+ * and every entry scheduled before it returned, has been written (see flush()).
+ * As with add_entry(), DO NOT USE [entry] AFTER A SUCCESSFUL CALL TO THIS METHOD.
+ * @param entry log entry to enqueue and serialize.
+ * @param written [output] future holding true once the entry has been written (false if it was not enqueued).
+ * @param sync if set, the output file is synced before the future completes (see flush()).
+ * @returns true if the item is enqueued.
+ */
+bool log_writer::add_entry(std::shared_ptr<log_entry>& entry, std::future<bool>& written, const bool& sync)
+{
+    bool entry_scheduled = add_entry(entry);
+    written = entry_scheduled ? flush(sync) : completed_future(false);
+    return entry_scheduled;
+}
+
+/**
+ * Adds a group of log entries to the serialization queue.
+ * The group takes a single place in the queue (its first entry carries the rest, see log_entry::group()), so it
+ * costs one acquisition of the queue lock and at most one wake up of the serializer however many entries it holds,
+ * and is written without entries from other threads coming between its members. Each entry is given the group's id
+ * (see GROUP_KEY). Entries without a message are dropped, as add_entry() would drop them. When passing entries to the
+ * logging service daemon the group is pushed in to the ring as one, and is kept together in the same way.
+ * As with add_entry(), DO NOT USE THE ENTRIES AFTER A SUCCESSFUL CALL TO THIS METHOD (entries is emptied).
+ * @param entries log entries to enqueue and serialize, in order.
+ * @returns true if the entries are enqueued.
+ */
+bool log_writer::add_entries(std::vector<std::shared_ptr<log_entry>>& entries)
+{
+    std::int64_t started = monotonic_us();
+    std::uint64_t group_id = m_next_group_id.fetch_add(1, std::memory_order_relaxed);
+
+    // fill out the entries as add_entry() would, noting their types (they aren't ours to look at once queued).
+    std::vector<std::shared_ptr<log_entry>> group;
+    std::vector<category> entry_types;
+    group.reserve(entries.size());
+    entry_types.reserve(entries.size());
+    for(auto entry = entries.begin(); entry != entries.end(); entry++)
+    {
+        _count_namespace((*entry)->log_namespace().length() > 0 ? (*entry)->log_namespace() : default_namespace(),
+                (*entry)->entry_type());
+        if((*entry)->message().length() == 0)
+        {
+            _count_entry((*entry)->entry_type(), false, started);
+            continue;
+        }
+        if((*entry)->log_namespace().length() == 0)
+        {
+            (*entry)->log_namespace(default_namespace());
+        }
+        if((*entry)->thread() == std::thread::id())
+        {
+            (*entry)->thread(std::this_thread::get_id());
+        }
+        (*entry)->field(GROUP_KEY, group_id);
+        group.push_back(*entry);
+        entry_types.push_back((*entry)->entry_type());
+    }
+    entries.clear();
+
+    bool group_scheduled = false;
+
+    // the logging service daemon is doing the writing for us...
+    if(!group.empty() && m_ring != nullptr)
+    {
+        group_scheduled = _service_add_entries(group);
+    }
+
+    // ... or the serializer is.
+    else if(!group.empty())
+    {
+        auto leader = group.front();
+        leader->group().assign(group.begin() + 1, group.end());
+        group_scheduled = _schedule_entry(leader);
+    }
+
+    for(auto entry_type = entry_types.begin(); entry_type != entry_types.end(); entry_type++)
+    {
+        _count_entry(*entry_type, group_scheduled, started);
+    }
+    return group_scheduled;
+}
+
+/**
+ * Queues an entry (and any entries grouped with it, see log_entry::group()) for the serializer, waking it if the queue
+ * was empty. If the queue is full this waits for space, spilling the entry instead if the output stream has stalled,
+ * and gives up after a while.
+ * @param entry filled out log entry to queue.
+ * @returns true if the entry was queued (or spilled).
+ */
+bool log_writer::_schedule_entry(std::shared_ptr<log_entry>& entry)
+{
+    bool entry_scheduled = false;
+    bool attempt_to_wake_serializer = false;
+
+    // (scoped so that the queue lock is released before the serializer is poked.)
+    {
+        const int MAX_SCHEDULE_ATTEMPTS = 10;
+
+        // give up once we have waited MAX_SCHEDULE_ATTEMPTS retry delays. this is measured in time rather than
+        // wake ups, as with several threads waiting on a full queue most wake ups find it full again.
+        auto schedule_deadline = timeout_ms(MAX_SCHEDULE_ATTEMPTS * RESCHEDULE_MAX_RETRY_DELAY);
+
+        // attempt to acquire the lock on the queue mutex
+        boost::mutex::scoped_lock lock_queue(
+                (*m_log_serialization_queue_mutex.get()));
+
+        // check we asserted lock ownership
+        if(lock_queue.owns_lock())
+        {
+            // attempt to schedule this entry...
+            while(true)
+            {
+                // while there are spilled entries waiting to be replayed, new entries join them (to stay in order).
+                // the serializer will find them once it has emptied the queue, so there is no need to poke it.
+                if(m_spilling)
+                {
+                    if(_spill_entry(entry))
+                    {
+                        entry_scheduled = true;
+                        break;
+                    }
+                }
+                else
+                {
+                    bool boolean_queue = true;
+
+                    // if the queue is empty, flag that we want to poke the serializer.
+                    if(m_log_serialization_queue->empty())
+                    {
+                        attempt_to_wake_serializer = true;
+                    }
+                    // else we can only attempt to serialize if the queue is empty
+                    else
+                    {
+                        boolean_queue = !m_log_serialization_queue->full();
+                    }
+
+                    // make sure the queue isn't full
+                    if(boolean_queue)
+                    {
+                        // push the item on to the queue
+                        m_log_serialization_queue->push_back(entry);
+                        m_scheduled++;
+                        m_counters->queue_depth.store(m_log_serialization_queue->size(), std::memory_order_relaxed);
+                        raise_to(m_counters->queue_high_water, m_log_serialization_queue->size());
+                        entry_scheduled = true;
+                        break;
+                    }
+
+                    // the queue is full; if that's because the output stream has stalled, spill rather than wait.
+                    if(_sink_stalled() && _spill_entry(entry))
+                    {
+                        entry_scheduled = true;
+                        break;
+                    }
+                }
+
+                //
+                // the queue is full. wait on a notification from the serializer to proceed (or retry in RESCHEDULE_MAX_RETRY_DELAY milliseconds).
+                if(boost::get_system_time() >= schedule_deadline)
+                {
+                    break;
+                }
+                m_log_serialization_element_serialized.timed_wait(lock_queue,
+                        std::min(schedule_deadline, timeout_ms(RESCHEDULE_MAX_RETRY_DELAY)));
+            }
+        }
 
         // check if we failed to schedule to entry.
         if(!entry_scheduled)
@@ -454,15 +1109,185 @@ bool log_writer::add_entry(std::shared_ptr<log_entry>& entry)
     // (entry_scheduled should always true if attempt_to_wake_serializer is, but just in case).
     if(entry_scheduled && attempt_to_wake_serializer)
     {
-        // acquire the queue notification mutex
-        boost::mutex::scoped_lock lock_notify((*m_log_serialization_element_queuing_mutex.get()));
-        m_log_serialization_element_queuing.notify_all();
+        _wake_serializer();
     }
 
-    // return result
     return entry_scheduled;
 }
 
+/**
+ * Wakes the serializer, if it is sleeping. This never waits on the serializer (which may be part way through a write
+ * that has stalled); the serializer checks for work and goes to sleep under the queue mutex, so anything queued (or a
+ * flush requested) under that mutex before this is called is either seen by the check or wakes the sleep.
+ */
+void log_writer::_wake_serializer()
+{
+    m_log_serialization_element_queuing.notify_all();
+}
+
+/**
+ * Gets a future that completes once every entry scheduled (by any thread) before the call has been written to the
+ * output stream and the stream flushed, or synced to disk as well if requested. Entries below the xml threshold count
+ * as written once the serializer has passed them. An entry held back for coalescing is written straight away rather
+ * than at the end of its window. This gives callers (tests, shutdown code, or anyone about to do something that
+ * depends on an entry being in the log) a point to wait for in place of sleeping.
+ * Writers passing entries to the logging service daemon complete once the entries are in the ring (the daemon writes
+ * them in its own time), unless the daemon has gone away, in which case this waits on the fallback writer.
+ * @param sync if set, the output file is synced (fsync) before completing. This only applies where the writer opened
+ *        the file itself (see create_from_file_path(), create_from_mapped_file_path() and
+ *        create_from_async_file_path()); other output streams are flushed only.
+ * @returns future holding true once the entries have been written, or false if the serializer stopped first.
+ */
+std::future<bool> log_writer::flush(const bool& sync)
+{
+    if(m_ring != nullptr)
+    {
+        return m_service_lost.load(std::memory_order_acquire) ? _service_fallback()->flush(sync) : completed_future(true);
+    }
+
+    std::future<bool> written;
+    {
+        boost::mutex::scoped_lock lock_queue((*m_log_serialization_queue_mutex.get()));
+        if(m_serializer_stopped)
+        {
+            return completed_future(false);
+        }
+
+        pending_flush waiting;
+        waiting.target = m_scheduled;
+        waiting.sync = sync;
+        written = waiting.written.get_future();
+        m_pending_flushes.push_back(std::move(waiting));
+    }
+
+    _wake_serializer();
+    return written;
+}
+
+/**
+ * Indicates if a call to flush() is waiting on the serializer.
+ * @returns true if a flush is waiting.
+ */
+bool log_writer::_flush_requested() const
+{
+    boost::mutex::scoped_lock lock_queue((*m_log_serialization_queue_mutex.get()));
+    return !m_pending_flushes.empty();
+}
+
+/**
+ * Completes the calls to flush() waiting on places in the queue that have now been processed, syncing the output
+ * file first if any asked for it. This is called once the output stream has been flushed, and leaves the calls
+ * waiting while an entry is held back for coalescing, or the first statistics entry is still to be written (the
+ * serializer writes either on its next pass). Once the
+ * serializer has stopped, any calls still waiting are completed (false if their entries were never reached). This
+ * should only ever be called by the serialization worker thread.
+ */
+void log_writer::_log_serialization_worker_complete_flushes()
+{
+    std::vector<pending_flush> completed;
+    bool stopped;
+    {
+        boost::mutex::scoped_lock lock_queue((*m_log_serialization_queue_mutex.get()));
+        stopped = m_serializer_stopped;
+
+        // (statistics asked for since the pass began, see statistics_interval(), are written on the next one first.)
+        bool statistics_unlogged = m_output_stream && m_statistics_logged == 0 &&
+                m_statistics_interval.load(std::memory_order_relaxed) > 0;
+        if(m_pending_flushes.empty() || ((m_coalesce_held != nullptr || statistics_unlogged) && !stopped))
+        {
+            return;
+        }
+
+        auto reached = std::stable_partition(m_pending_flushes.begin(), m_pending_flushes.end(),
+                [this](const pending_flush& waiting) { return waiting.target <= m_processed; });
+        if(stopped)
+        {
+            reached = m_pending_flushes.end();
+        }
+        completed.assign(std::make_move_iterator(m_pending_flushes.begin()), std::make_move_iterator(reached));
+        m_pending_flushes.erase(m_pending_flushes.begin(), reached);
+    }
+
+    // sync the file once for everyone that asked.
+    bool sync = false;
+    for(auto waiting = completed.begin(); waiting != completed.end(); waiting++)
+    {
+        sync = sync || waiting->sync;
+    }
+    auto file_stream = dynamic_cast<log_file_stream*>(m_output_stream.get());
+    auto mapped_file_stream = dynamic_cast<log_mapped_file_stream*>(m_output_stream.get());
+    std::int64_t sync_started = monotonic_us();
+    bool synced = false;
+    if(file_stream != nullptr && file_stream->file_buffer().is_open()
+            && (sync || file_stream->file_buffer().asynchronous()))
+    {
+        // (writes handed to io_uring have to have finished before anyone is told they are written.)
+        _sink_write_begin();
+        if(sync)
+        {
+            file_stream->file_buffer().synchronize();
+            synced = true;
+        }
+        else
+        {
+            file_stream->file_buffer().complete_writes();
+        }
+        _sink_write_end();
+    }
+    else if(sync && mapped_file_stream != nullptr && mapped_file_stream->file_buffer().is_open())
+    {
+        _sink_write_begin();
+        mapped_file_stream->file_buffer().synchronize();
+        _sink_write_end();
+        synced = true;
+    }
+    if(synced)
+    {
+        std::uint64_t sync_time = monotonic_us() - sync_started;
+        m_counters->syncs.fetch_add(1, std::memory_order_relaxed);
+        m_counters->sync_time.fetch_add(sync_time, std::memory_order_relaxed);
+        raise_to(m_counters->sync_time_max, sync_time);
+    }
+
+    for(auto waiting = completed.begin(); waiting != completed.end(); waiting++)
+    {
+        waiting->written.set_value(waiting->target <= m_processed);
+    }
+}
+
+/**
+ * Counts an entry accepted or rejected by add_entry, and the time add_entry took.
+ * @param entry_type category of the entry.
+ * @param enqueued true if the entry was accepted.
+ * @param started time add_entry was called (monotonic microseconds).
+ */
+void log_writer::_count_entry(const category& entry_type, const bool& enqueued, const std::int64_t& started)
+{
+    auto& counter = enqueued ? m_counters->enqueued[statistics_slot(entry_type)] : m_counters->dropped[statistics_slot(entry_type)];
+    counter.fetch_add(1, std::memory_order_relaxed);
+
+    // find the (power of two) bucket for the time taken.
+    std::uint64_t waited = monotonic_us() - started;
+    std::size_t bucket = 0;
+    while(bucket < LOG_STATISTICS_WAIT_BUCKETS - 1 && waited >= (static_cast<std::uint64_t>(1) << bucket))
+    {
+        bucket++;
+    }
+    m_counters->enqueue_wait[bucket].fetch_add(1, std::memory_order_relaxed);
+}
+
+/**
+ * Counts an entry passed to add_entry (or add_entries) under its namespace. Every entry is counted, including those
+ * below the thresholds (which are never written) and those dropped.
+ * @param log_namespace namespace the entry was logged under.
+ * @param entry_type category of the entry.
+ */
+void log_writer::_count_namespace(const std::string& log_namespace, const category& entry_type)
+{
+    auto counters = m_namespace_counters->find(log_namespace, true);
+    counters->shards[namespace_counter_shard()].logged[statistics_slot(entry_type)].fetch_add(1, std::memory_order_relaxed);
+}
+
 /**
  * Gets the process id
  * This is the PID of the process we are logging on behalf of. This can be modified, but only during instantiation
@@ -491,40 +1316,33 @@ const std::string log_writer::process_name() const
 
 
 /**
- * This method writes out the XML header.
- * This includes the XML declaration, root node (tied in the XSD) and the binary information element.
+ * Starts the output, writing the formatter's header first if the writer should (see formatter()). Nothing is written
+ * until the first entry, the writer's own statistics or the footer, so the formatter can be chosen after the writer
+ * has been created; once the output has started it is fixed. This should only ever be called by the serialization
+ * worker thread.
  */
-void log_writer::write_xml_header()
+void log_writer::_log_serialization_worker_begin_output()
 {
-    // acquire the binaries version information
-    std::string version_string = inglenook::core::application::version();
-
-    // locate the logging xsd
-    std::stringstream xsd_location;
-    xsd_location << "http://schemas.project-inglenook.co.uk/" // domain for schema's
-        << "0.00-DEVELOPMENT/" // software version
-        << "schemas/" // keep top level tidy for html.
-        << "file-formats/" // types of schema
-        << "inglenook-log-file.xsd"; // specific file.
-
-    // just because the binary name can be tampered with..
-    std::string safe_process_name = process_name();
-    boost::replace_all(safe_process_name, "<", "&lt;");
-    boost::replace_all(safe_process_name, ">", "&gt;");
-
-    // write out the xml data type declaration
-    (*m_output_stream.get()) << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>";
+    if(m_output_started)
+    {
+        return;
+    }
 
-    // write out the root node and type in the xsd
-    (*m_output_stream.get()) << "<inglenook-log-file xmlns=\"" << xsd_location.str() << "\">";
+    std::string header;
+    {
+        boost::mutex::scoped_lock lock_queue((*m_log_serialization_queue_mutex.get()));
+        m_output_started = true;
+        header = m_header;
+    }
 
-    // write out binary information block.
-    (*m_output_stream.get()) << "<process-id pid=\"" << pid() << "\">";
-    (*m_output_stream.get()) << "<binary-name><![CDATA[" << safe_process_name << "]]></binary-name>";
-    (*m_output_stream.get()) << "<binary-version><![CDATA[" << version_string << "]]></binary-version>";
-    (*m_output_stream.get()) << "<log-writer-version><![CDATA[" << "v1.0.0000" << "]]></log-writer-version>";
-    (*m_output_stream.get()) << "</process-id>";
-    (*m_output_stream.get()) << "<log-entries>";
+    // the header is written as one block (see _log_serialization_worker_serialize).
+    if(m_write_header && m_output_stream && !header.empty())
+    {
+        _sink_write_begin();
+        m_output_stream->write(header.data(), header.length());
+        _sink_write_end();
+        m_counters->bytes_written.fetch_add(header.length(), std::memory_order_relaxed);
+    }
 }
 
 /**
@@ -536,22 +1354,12 @@ void log_writer::_log_serialization_worker()
 {
     try
     {
-        // attempt to acquire the lock on the shutdown mutex
-        boost::mutex::scoped_lock lock_item_waiting(
-                (*m_log_serialization_element_queuing_mutex.get()));
-
-        // make sure this thread owns the notification lock.
-        if(!lock_item_waiting.owns_lock())
-        {
-            using namespace inglenook::core::exceptions;
-            BOOST_THROW_EXCEPTION( log_serialization_exception()
-                    << inglenook_error_number(unable_to_aquire_queue_notification_lock) );
-        }
-        // start the log file if required.
-        if(m_write_header && m_output_stream)
+        // there is work to do while entries are queued or spilled, or someone is waiting on a flush.
+        // (only ever called with the queue mutex held.)
+        auto work_waiting = [this]() -> bool
         {
-            write_xml_header();
-        }
+            return !m_log_serialization_queue->empty() || m_spilling || !m_pending_flushes.empty();
+        };
 
         while(true)
         {
@@ -561,26 +1369,82 @@ void log_writer::_log_serialization_worker()
             //
 
             std::shared_ptr<log_entry> entry;
+            bool entries_serialized = false;
+            bool entries_echoed = false;
             while((entry = _log_serialization_worker_next_entry()) != nullptr)
             {
-                // make sure the entry is filled out.
-                if(entry->entry_type() != category::unspecified &&
-                   entry->entry_type() != category::no_log &&
-                   entry->log_namespace().length() > 0 &&
-                   entry->message().length() > 0)
+                _log_serialization_worker_process(entry, entries_serialized, entries_echoed);
+
+                // the rest of a group follows its first entry (see add_entries()).
+                if(!entry->group().empty())
                 {
-                    if(entry->entry_type() >= xml_threshold() && m_output_stream)
+                    std::vector<std::shared_ptr<log_entry>> group;
+                    group.swap(entry->group());
+                    for(auto member = group.begin(); member != group.end(); member++)
                     {
-                        _log_serialization_worker_serialize(entry);
+                        _log_serialization_worker_process(*member, entries_serialized, entries_echoed);
                     }
+                }
+                m_processed++;
+            }
 
-                    if(entry->entry_type() >= console_threshold())
-                    {
-                        _log_serialization_worker_screen(entry);
-                    }
+            // an entry held back for coalescing is written once its window has passed (or someone is waiting on it).
+            if(m_coalesce_held != nullptr &&
+               (monotonic_ms() - m_coalesce_started > m_coalesce_window.load(std::memory_order_relaxed) ||
+                _flush_requested()))
+            {
+                _log_serialization_worker_coalesce_release(entries_serialized, entries_echoed);
+            }
+
+            // log our own statistics if it is time to (straight away once they have been asked for).
+            int statistics_interval = m_statistics_interval.load(std::memory_order_relaxed);
+            if(statistics_interval <= 0)
+            {
+                m_statistics_logged = 0;
+            }
+            else if(m_output_stream)
+            {
+                std::int64_t now = monotonic_ms();
+                if(m_statistics_logged == 0 || now - m_statistics_logged >= statistics_interval)
+                {
+                    m_statistics_logged = now;
+                    _log_serialization_worker_statistics();
+                    entries_serialized = true;
+                }
+            }
+
+            // dump the namespace counters if it is time to.
+            int metrics_interval = m_metrics_interval.load(std::memory_order_relaxed);
+            if(metrics_interval > 0)
+            {
+                std::int64_t now = monotonic_ms();
+                if(m_metrics_dumped == 0 || now - m_metrics_dumped >= metrics_interval)
+                {
+                    m_metrics_dumped = now;
+                    _log_serialization_worker_metrics();
                 }
             }
 
+            // the queue has been drained, hand what we have written over to the operating system.
+            if(entries_serialized)
+            {
+                std::int64_t flush_started = monotonic_us();
+                _sink_write_begin();
+                m_output_stream->flush();
+                _sink_write_end();
+
+                std::uint64_t flush_time = monotonic_us() - flush_started;
+                m_counters->flushes.fetch_add(1, std::memory_order_relaxed);
+                m_counters->flush_time.fetch_add(flush_time, std::memory_order_relaxed);
+                raise_to(m_counters->flush_time_max, flush_time);
+            }
+            _log_serialization_worker_complete_flushes();
+            if(entries_echoed)
+            {
+                std::cout.flush();
+                std::cerr.flush();
+            }
+
             //
             // the queue is empty, use this breathing time to check to see if the
             // shutdown flag is set, if so we'll want to initialize a thread shutdown,
@@ -606,14 +1470,38 @@ void log_writer::_log_serialization_worker()
             // deconstruction of lock_shutdown will release mutex.
             if(m_log_serialization_worker_shutdown)
             {
+                // don't leave an entry held back for coalescing behind.
+                if(m_coalesce_held != nullptr)
+                {
+                    _log_serialization_worker_coalesce_release(entries_serialized, entries_echoed);
+                    if(entries_serialized)
+                    {
+                        _sink_write_begin();
+                        m_output_stream->flush();
+                        _sink_write_end();
+                    }
+                }
+
+                // leave the final counts behind in the metrics file.
+                if(m_metrics_interval.load(std::memory_order_relaxed) > 0)
+                {
+                    _log_serialization_worker_metrics();
+                }
+                _log_serialization_worker_complete_flushes();
                 break;
             }
 
             // release the lock
             lock_shutdown.unlock();
 
+            // entries queued while we were writing don't wake us (see add_entry()), so check before sleeping; the check
+            // and the sleep are made under the queue mutex, so a wake up can't slip in between them.
             // we are idle, nothing to do so sleep for a bit. siesta!
-            m_log_serialization_element_queuing.timed_wait(lock_item_waiting, timeout_ms(SERIALIZER_IDLE_TIMEOUT));
+            {
+                boost::mutex::scoped_lock lock_queue((*m_log_serialization_queue_mutex.get()));
+                m_log_serialization_element_queuing.timed_wait(lock_queue, timeout_ms(SERIALIZER_IDLE_TIMEOUT),
+                        work_waiting);
+            }
         }
     }
     catch(boost::exception&)
@@ -628,106 +1516,328 @@ void log_writer::_log_serialization_worker()
     //
     try
     {
-        // if the header is set to be written.
+        // a file is started even if nothing was written to it (the header may be all that is wanted).
+        if(m_output_stream)
+        {
+            _log_serialization_worker_begin_output();
+        }
+
+        // close off the output if required.
         if(m_write_footer && m_output_stream)
         {
-            (*m_output_stream.get()) << "</log-entries>";
-            (*m_output_stream.get()) << "</inglenook-log-file>";
+            std::string footer;
+            m_formatter->format_footer(footer);
+            _sink_write_begin();
+            m_output_stream->write(footer.data(), footer.length());
+            _sink_write_end();
+            m_counters->bytes_written.fetch_add(footer.length(), std::memory_order_relaxed);
         }
     }
     catch(...) { /* if we crashed because of a bad stream, don't make the problem worse */}
 
+    // no one is left to complete calls to flush(), so don't leave anyone waiting.
+    {
+        boost::mutex::scoped_lock lock_queue((*m_log_serialization_queue_mutex.get()));
+        m_serializer_stopped = true;
+    }
+    _log_serialization_worker_complete_flushes();
 }
 
 /**
- * Serializes an entry to the output stream as XML.
- * Given a pointer to a log entry, serializes the item to the output stream as XML. This should only
+ * Serializes an entry to the output stream, as the formatter formats it (XML unless set otherwise, see formatter()).
+ * Given a pointer to a log entry, serializes the item to the output stream. This should only
  * ever be called by the serialization worker thread.
  * @param entry entry to serialize.
  */
 void log_writer::_log_serialization_worker_serialize(std::shared_ptr<log_entry> entry)
 {
-    // should only need to initialize this stuff once for performance
-    auto output_stream = m_output_stream.get();
-    auto timestamp_formatter = std::locale(output_stream->getloc(),
-            new boost::posix_time::time_facet("%Y-%m-%dT%H:%M:%sZ"));
+    std::int64_t started = monotonic_us();
+    _log_serialization_worker_begin_output();
+
+    // the entry is formatted in full before being written out, so the output stream is only ever
+    // handed complete entries. log_crash_handler relies on this to recover buffered output, and
+    // log files rely on it to keep entries whole when several processes append at once (each block
+    // reaches the file in a single write, see log_file_buffer). the formatting buffer is kept
+    // between entries, so it only allocates while growing.
+    m_formatted_entry.clear();
+    m_formatter->format_entry(m_formatted_entry, *entry, m_attachment_limit.load(std::memory_order_relaxed));
+
+    // write the complete entry to the output stream.
+    _sink_write_begin();
+    m_output_stream->write(m_formatted_entry.data(), m_formatted_entry.length());
+    _sink_write_end();
+
+    m_counters->written[statistics_slot(entry->entry_type())].fetch_add(1, std::memory_order_relaxed);
+    m_counters->bytes_written.fetch_add(m_formatted_entry.length(), std::memory_order_relaxed);
+    m_counters->serialization_time.fetch_add(monotonic_us() - started, std::memory_order_relaxed);
+}
 
-    /*
-     * This is what we are aiming for:
+/**
+ * Writes an entry to the output stream and/or the console, depending on the xml and console thresholds. This should
+ * only ever be called by the serialization worker thread.
+ * @param entry entry to write.
+ * @param serialized [output] set if the entry was written to the output stream.
+ * @param echoed [output] set if the entry was written to the console.
+ */
+void log_writer::_log_serialization_worker_write(std::shared_ptr<log_entry> entry, bool& serialized, bool& echoed)
+{
+    if(entry->entry_type() >= xml_threshold() && m_output_stream)
+    {
+        _log_serialization_worker_serialize(entry);
+        serialized = true;
+    }
+
+    if(entry->entry_type() >= console_threshold())
+    {
+        _log_serialization_worker_screen(entry);
+        echoed = true;
+    }
+}
 
-     <log-entry timestamp="2012-12-21T00:00:00.00Z" severity="4" ns="inglenook.sample.process">
-        <message><![CDATA[Yikes! Something incredibly Mayan happened to the process - cannot continue.]]></message>
-        <extended-data>
-            <item key="sample.specific"><![CDATA[Kittens]]></item>
-            <item key="sample.host"><![CDATA[127.0.0.1]]></item>
-        <extended-data>
-     </log-entry>
-    */
+/**
+ * Coalesces repeated entries. While coalescing is enabled (see coalesce_window()), each entry is held back for the
+ * window; further entries from the same thread, with the same namespace, category, message, call site and extended
+ * data (text and typed), are counted against it rather than written. A cheap hash of the message is compared before
+ * the rest. Entries with attachments are never held back (comparing the data isn't worth it). Any other entry (or
+ * the window passing) writes out the held entry, with the number of repeats and the times of the first and last.
+ * This should only ever be called by the serialization worker thread.
+ * @param entry entry to coalesce.
+ * @param serialized [output] set if the held entry was written to the output stream.
+ * @param echoed [output] set if the held entry was written to the console.
+ * @returns true if the entry has been taken care of (folded in to the held entry, or held itself), false if the
+ *          entry should be written as usual.
+ */
+bool log_writer::_log_serialization_worker_coalesce(std::shared_ptr<log_entry>& entry, bool& serialized, bool& echoed)
+{
+    int window = m_coalesce_window.load(std::memory_order_relaxed);
+    if(window <= 0 && m_coalesce_held == nullptr)
+    {
+        return false;
+    }
 
-    // sanitize message this can contain user input
-    std::string message = entry->message();
-    boost::replace_all(message, "<", "&lt;");
-    boost::replace_all(message, ">", "&gt;");
+    // entries logged in a group, or with attachments, are written as they are (the held entry goes first).
+    if(entry->fields().count(GROUP_KEY) != 0 || !entry->attachments().empty())
+    {
+        _log_serialization_worker_coalesce_release(serialized, echoed);
+        return false;
+    }
 
-    // get the extended data (pre-doing this to keep xml writing as clean as possible).
-    auto extended_data = entry->extended_data();
+    std::int64_t now = monotonic_ms();
+    std::size_t hash = std::hash<std::string>()(entry->message());
 
-    // open the <log-entry> dom element
-    *output_stream << "<log-entry timestamp=\"";
-    output_stream->imbue(timestamp_formatter);
-    *output_stream << boost::posix_time::second_clock::universal_time();
-    *output_stream << "\" severity=\"" << entry->entry_type() << "\" ns=\"" << entry->log_namespace() << "\">";
+    // a repeat of the held entry.
+    if(m_coalesce_held != nullptr)
+    {
+        if(now - m_coalesce_started <= window &&
+           hash == m_coalesce_hash &&
+           entry->entry_type() == m_coalesce_held->entry_type() &&
+           entry->thread() == m_coalesce_held->thread() &&
+           entry->log_namespace() == m_coalesce_held->log_namespace() &&
+           entry->context() == m_coalesce_held->context() &&
+           entry->source() == m_coalesce_held->source() &&
+           entry->message() == m_coalesce_held->message() &&
+           entry->fields() == m_coalesce_held->fields() &&
+           entry->extended_data() == m_coalesce_held->extended_data())
+        {
+            m_coalesce_repeats++;
+            m_coalesce_last = entry->timestamp().is_not_a_date_time() ?
+                    boost::posix_time::microsec_clock::universal_time() : entry->timestamp();
+            m_counters->coalesced[statistics_slot(entry->entry_type())].fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
 
-    // output the message body
-    *output_stream << "<message><![CDATA[" << message << "]]></message>";
+        _log_serialization_worker_coalesce_release(serialized, echoed);
+    }
 
-    // check for extended data
-    if(extended_data.size() > 0)
+    if(window <= 0)
     {
-        // start the <extended-data> dom item
-        *output_stream << "<extended-data>";
+        return false;
+    }
 
-        // iterate through all the data in the map
-        for(auto data = extended_data.begin(); data != extended_data.end(); data++)
-        {
-            // sanitize the data provided (not only value is sanitized).
-            std::string value = data->second;
-            boost::replace_all(value, "<", "&lt;");
-            boost::replace_all(value, ">", "&gt;");
+    // hold the entry back to see if it repeats (timestamping it now, so it isn't written with the time it is released).
+    if(entry->timestamp().is_not_a_date_time())
+    {
+        entry->timestamp(boost::posix_time::microsec_clock::universal_time());
+    }
+    m_coalesce_held = entry;
+    m_coalesce_hash = hash;
+    m_coalesce_repeats = 1;
+    m_coalesce_last = entry->timestamp();
+    m_coalesce_started = now;
+    return true;
+}
 
-            // and write it out.
-            *output_stream << "<item key=\"" << data->first << "\"><![CDATA[" << value << "]]></item>";
+/**
+ * Processes an entry taken from the queue. Entries that aren't filled out are dropped, the rest are coalesced (see
+ * _log_serialization_worker_coalesce()) or written. This should only ever be called by the serialization worker thread.
+ * @param entry entry to process.
+ * @param serialized [output] set if anything was written to the output stream.
+ * @param echoed [output] set if anything was written to the console.
+ */
+void log_writer::_log_serialization_worker_process(std::shared_ptr<log_entry>& entry, bool& serialized, bool& echoed)
+{
+    // make sure the entry is filled out.
+    if(entry->entry_type() != category::unspecified &&
+       entry->entry_type() != category::no_log &&
+       entry->log_namespace().length() > 0 &&
+       entry->message().length() > 0)
+    {
+        // repeats of the same entry in quick succession are folded in to the first.
+        if(!_log_serialization_worker_coalesce(entry, serialized, echoed))
+        {
+            _log_serialization_worker_write(entry, serialized, echoed);
         }
+    }
+    else
+    {
+        m_counters->dropped[statistics_slot(entry->entry_type())].fetch_add(1, std::memory_order_relaxed);
+    }
+}
 
-        // end the <extended-data> dom item
-        *output_stream << "</extended-data>";
+/**
+ * Writes out the entry held for coalescing. If it was repeated, the number of times it was logged (REPEATED_KEY) and
+ * the times it was first and last logged (REPEATED_FIRST_KEY, REPEATED_LAST_KEY) are added as extended data. This
+ * should only ever be called by the serialization worker thread.
+ * @param serialized [output] set if the entry was written to the output stream.
+ * @param echoed [output] set if the entry was written to the console.
+ */
+void log_writer::_log_serialization_worker_coalesce_release(bool& serialized, bool& echoed)
+{
+    auto entry = m_coalesce_held;
+    m_coalesce_held = nullptr;
+    if(entry == nullptr)
+    {
+        return;
     }
 
-    // close the <log-entry>
-    *output_stream << "</log-entry>";
+    if(m_coalesce_repeats > 1)
+    {
+        entry->extended_data(REPEATED_KEY, std::to_string(m_coalesce_repeats));
+        entry->extended_data(REPEATED_FIRST_KEY, boost::posix_time::to_iso_extended_string(entry->timestamp()) + "Z");
+        entry->extended_data(REPEATED_LAST_KEY, boost::posix_time::to_iso_extended_string(m_coalesce_last) + "Z");
+    }
+    _log_serialization_worker_write(entry, serialized, echoed);
 }
 
 /**
- * Serializes an entry to the console.
- * Given a pointer to a log entry, serializes the item to the console. This should only
- * ever be called by the serialization worker thread.
- * @param entry entry to serialize.
+ * Writes the writer's own statistics to the output stream, as an information entry under STATISTICS_NAMESPACE
+ * with the figures held as extended data. The entry is not echoed to the console. This should only ever be
+ * called by the serialization worker thread.
  */
-void log_writer::_log_serialization_worker_screen(std::shared_ptr<log_entry> entry)
+void log_writer::_log_serialization_worker_statistics()
 {
-    /*
-     // both cout and ceer should have the same locale...
-     auto timestamp_formatter = std::locale(std::cout.getloc(),
-     new boost::posix_time::time_facet("%d-%M-%Y-%H:%M:%S"));
+    auto snapshot = statistics();
+    std::uint64_t enqueued = 0, written = 0, dropped = 0, coalesced = 0;
+    for(std::size_t i = 0; i < LOG_STATISTICS_CATEGORIES; i++)
+    {
+        enqueued += snapshot.enqueued[i];
+        written += snapshot.written[i];
+        dropped += snapshot.dropped[i];
+        coalesced += snapshot.coalesced[i];
+    }
 
-     // short names for all the entry types localized for user.
-     std::string categories[] =
-     {
-        boost::locale::translate("     "),
-        boost::locale::translate("debug"),
-        boost::locale::translate("trace"),
-        boost::locale::translate(" info"),
-        boost::locale::translate(" warn"),
+    auto entry = std::shared_ptr<log_entry>(new log_entry());
+    entry->entry_type(category::information);
+    entry->log_namespace(STATISTICS_NAMESPACE);
+    entry->message("Log writer statistics.");
+    entry->extended_data("enqueued", std::to_string(enqueued));
+    entry->extended_data("written", std::to_string(written));
+    entry->extended_data("dropped", std::to_string(dropped));
+    entry->extended_data("coalesced", std::to_string(coalesced));
+    entry->extended_data("queue-depth", std::to_string(snapshot.queue_depth));
+    entry->extended_data("queue-high-water", std::to_string(snapshot.queue_high_water));
+    entry->extended_data("serialization-time-us", std::to_string(snapshot.serialization_time));
+    entry->extended_data("bytes-written", std::to_string(snapshot.bytes_written));
+    entry->extended_data("flushes", std::to_string(snapshot.flushes));
+    entry->extended_data("flush-time-us", std::to_string(snapshot.flush_time));
+    entry->extended_data("flush-time-max-us", std::to_string(snapshot.flush_time_max));
+    entry->extended_data("syncs", std::to_string(snapshot.syncs));
+    entry->extended_data("sync-time-us", std::to_string(snapshot.sync_time));
+    entry->extended_data("sync-time-max-us", std::to_string(snapshot.sync_time_max));
+    entry->extended_data("stalls", std::to_string(snapshot.stalls.stalls));
+    entry->extended_data("spilled-entries", std::to_string(snapshot.stalls.spilled_entries));
+    _log_serialization_worker_serialize(entry);
+}
+
+/**
+ * Dumps the namespace counters to the metrics file (see metrics_file()) as JSON, for monitoring to pick up without
+ * reading the log. The file is written beside the old one and renamed over it, so it is never seen half written.
+ * Failures are ignored (the next dump tries again). This should only ever be called by the serialization worker
+ * thread.
+ */
+void log_writer::_log_serialization_worker_metrics()
+{
+    boost::filesystem::path file;
+    try
+    {
+        file = metrics_file();
+    }
+    catch(boost::exception&)
+    {
+        return;
+    }
+
+    // (built with the escaping and number helpers the formatters use, see log_formatter.)
+    std::string metrics = "{\"process\":";
+    log_formatter::append_json_string(metrics, m_process_name);
+    metrics += ",\"pid\":";
+    log_formatter::append_number(metrics, static_cast<std::int64_t>(m_process_id));
+    metrics += ",\"timestamp\":\"";
+    metrics += boost::posix_time::to_iso_extended_string(boost::posix_time::microsec_clock::universal_time());
+    metrics += "Z\",\"namespaces\":{";
+    auto snapshot = namespace_statistics();
+    for(auto counters = snapshot.begin(); counters != snapshot.end(); counters++)
+    {
+        metrics += counters == snapshot.begin() ? "" : ",";
+        log_formatter::append_json_string(metrics, counters->log_namespace);
+        metrics += ":{";
+        for(std::size_t i = 0; i < LOG_STATISTICS_CATEGORIES; i++)
+        {
+            metrics += i == 0 ? "\"" : ",\"";
+            metrics += log_formatter::category_name(static_cast<category>(i));
+            metrics += "\":";
+            log_formatter::append_number(metrics, counters->logged[i]);
+        }
+        metrics += "}";
+    }
+    metrics += "}}\n";
+
+    boost::system::error_code filesystem_error;
+    boost::filesystem::create_directories(file.parent_path(), filesystem_error);
+    auto written = file;
+    written += ".tmp";
+    {
+        std::ofstream output(written.native().c_str(), std::ios::out | std::ios::trunc);
+        output << metrics;
+        if(!output.good())
+        {
+            return;
+        }
+    }
+    boost::filesystem::rename(written, file, filesystem_error);
+}
+
+/**
+ * Serializes an entry to the console.
+ * Given a pointer to a log entry, serializes the item to the console. This should only
+ * ever be called by the serialization worker thread.
+ * @param entry entry to serialize.
+ */
+void log_writer::_log_serialization_worker_screen(std::shared_ptr<log_entry> entry)
+{
+    /*
+     // both cout and ceer should have the same locale...
+     auto timestamp_formatter = std::locale(std::cout.getloc(),
+     new boost::posix_time::time_facet("%d-%M-%Y-%H:%M:%S"));
+
+     // short names for all the entry types localized for user.
+     std::string categories[] =
+     {
+        boost::locale::translate("     "),
+        boost::locale::translate("debug"),
+        boost::locale::translate("trace"),
+        boost::locale::translate(" info"),
+        boost::locale::translate(" warn"),
         boost::locale::translate("error"),
         boost::locale::translate("fatal")
      };
@@ -753,7 +1863,198 @@ void log_writer::_log_serialization_worker_screen(std::shared_ptr<log_entry> ent
      *output_stream << boost::posix_time::second_clock::local_time();
      *output_stream << " " << category << "] ";
      */
-    *output_stream << entry->message() << std::endl;
+    // (flushed once the queue has drained, rather than line by line)
+    *output_stream << entry->message() << '\n';
+}
+
+/**
+ * Passes a log entry to the logging service daemon.
+ * The entry is filtered and echoed to the console as the serialization worker would, then pushed in to the ring. If the
+ * ring stays full for RESCHEDULE_MAX_RETRY_DELAY, or the daemon stops collecting it, the daemon is considered lost and
+ * this and all later entries are passed to a local fallback writer (created on demand at the default log path).
+ * @param entry log entry to pass on.
+ * @returns true if the entry was accepted.
+ */
+bool log_writer::_service_add_entry(std::shared_ptr<log_entry>& entry)
+{
+    // make sure there is a message
+    if(entry->message().length() == 0)
+    {
+        return false;
+    }
+
+    // nothing more to do if the entry won't be written.
+    if(!_service_filter_entry(entry))
+    {
+        return true;
+    }
+
+    if(!m_service_lost.load(std::memory_order_acquire))
+    {
+        // entries have to fit in the ring, trim the message of any that won't.
+        log_record::truncate(*entry, m_ring->max_entry_size());
+
+        // push the entry, giving the daemon a little time to catch up if the ring is full.
+        const boost::posix_time::ptime give_up = timeout_ms(RESCHEDULE_MAX_RETRY_DELAY);
+        for(bool retrying = false; _service_ring_ready(give_up, retrying); retrying = true)
+        {
+            if(m_ring->push(*entry))
+            {
+                return true;
+            }
+        }
+    }
+
+    return _service_fallback()->add_entry(entry);
+}
+
+/**
+ * Passes a group of log entries to the logging service daemon (see add_entries()).
+ * Each entry is filtered and echoed as _service_add_entry() would, and what is left of the group is pushed in to the
+ * ring as one, so that entries from other threads can't come between its members. A group too large for the ring to
+ * take at once (see log_ring::push()) is pushed an entry at a time. If the daemon is lost, whatever wasn't pushed is
+ * passed to the fallback writer, which keeps it together.
+ * @param group log entries to pass on (each has a message).
+ * @returns true if the entries were accepted.
+ */
+bool log_writer::_service_add_entries(std::vector<std::shared_ptr<log_entry>>& group)
+{
+    // filter the group as the serialization worker would, noting how large what is left will be in the ring.
+    std::vector<std::shared_ptr<log_entry>> passed;
+    std::size_t passed_size = 0;
+    for(auto entry = group.begin(); entry != group.end(); entry++)
+    {
+        if(_service_filter_entry(*entry))
+        {
+            log_record::truncate(**entry, m_ring->max_entry_size());
+            passed_size += log_record::encoded_size(**entry);
+            passed.push_back(*entry);
+        }
+    }
+    if(passed.empty())
+    {
+        return true;
+    }
+
+    if(!m_service_lost.load(std::memory_order_acquire))
+    {
+        // push the group (or, if it is too large to go as one, each entry in turn), giving the daemon a little time
+        // to catch up if the ring is full.
+        const bool whole = passed_size <= m_ring->max_entry_size();
+        const boost::posix_time::ptime give_up = timeout_ms(RESCHEDULE_MAX_RETRY_DELAY);
+        std::size_t pushed = 0;
+        for(bool retrying = false; _service_ring_ready(give_up, retrying); retrying = true)
+        {
+            if(whole && m_ring->push(passed))
+            {
+                return true;
+            }
+            while(!whole && pushed < passed.size() && m_ring->push(*passed[pushed]))
+            {
+                pushed++;
+            }
+            if(pushed == passed.size())
+            {
+                return true;
+            }
+        }
+        passed.erase(passed.begin(), passed.begin() + pushed);
+    }
+
+    return _service_fallback()->add_entries(passed);
+}
+
+/**
+ * Prepares an entry for the logging service daemon as the serialization worker would: empty name spaces are corrected
+ * and the entry is echoed to the console (the daemon can't reach it), then filtered.
+ * @param entry log entry to prepare (with a message).
+ * @returns true if the entry should be passed to the daemon.
+ */
+bool log_writer::_service_filter_entry(std::shared_ptr<log_entry>& entry)
+{
+    // correct empty name spaces.
+    if(entry->log_namespace().length() == 0)
+    {
+        entry->log_namespace(default_namespace());
+    }
+
+    // incomplete entries are discarded, as the serialization worker would.
+    if(entry->entry_type() == category::unspecified || entry->entry_type() == category::no_log)
+    {
+        return false;
+    }
+
+    // the daemon can't reach our console, so that stays local.
+    if(entry->entry_type() >= console_threshold())
+    {
+        _log_serialization_worker_screen(entry);
+        std::cout.flush();
+    }
+
+    return entry->entry_type() >= xml_threshold();
+}
+
+/**
+ * Decides whether to (keep) trying to push in to the ring, waiting a moment before each retry. Once the daemon has
+ * stopped collecting the ring, or the ring has stayed full until the specified time, the daemon is considered lost.
+ * @param give_up time after which a full ring is given up on.
+ * @param retrying set if a push has already been refused.
+ * @returns true if a push should be tried, false if the daemon has been lost.
+ */
+bool log_writer::_service_ring_ready(const boost::posix_time::ptime& give_up, const bool& retrying)
+{
+    if(m_ring->collector_alive() && !(retrying && boost::get_system_time() > give_up))
+    {
+        if(retrying)
+        {
+            boost::this_thread::sleep(boost::posix_time::milliseconds(1));
+        }
+        return true;
+    }
+
+    // the daemon has gone away (or can't keep up), we're on our own from here.
+    m_service_lost.store(true, std::memory_order_release);
+    return false;
+}
+
+/**
+ * Gets the writer used once the logging service daemon has gone away, creating it on first use.
+ * The fallback writer takes the settings of this writer, but never echos to the console (see _service_add_entry()).
+ * If the default log file can't be created, the fallback discards entries rather than fail the caller.
+ * @returns fallback writer.
+ */
+std::shared_ptr<log_writer> log_writer::_service_fallback()
+{
+    boost::mutex::scoped_lock lock_queue((*m_log_serialization_queue_mutex.get()));
+
+    if(m_service_fallback == nullptr)
+    {
+        try
+        {
+            m_service_fallback = log_writer::create(true, true, m_process_id, m_process_name);
+        }
+        catch(boost::exception&)
+        {
+            std::cerr << boost::locale::translate("WARNING: the logging service has gone away and a local log could not be created.") << std::endl;
+            m_service_fallback = log_writer::create_from_stream(nullptr, false, false, m_process_id, m_process_name);
+        }
+
+        m_service_fallback->default_namespace(default_namespace());
+        m_service_fallback->default_entry_type(default_entry_type());
+        m_service_fallback->xml_threshold(xml_threshold());
+        m_service_fallback->console_threshold(category::no_log);
+    }
+
+    return m_service_fallback;
+}
+
+/**
+ * Indicates if log entries are currently being passed to the logging service daemon.
+ * @returns true if entries are passed to the daemon, false if this writer (or its fallback) is writing them.
+ */
+bool log_writer::using_service() const
+{
+    return m_ring != nullptr && !m_service_lost.load(std::memory_order_acquire);
 }
 
 /**
@@ -782,16 +2083,427 @@ std::shared_ptr<log_entry> log_writer::_log_serialization_worker_next_entry()
             // pop an item off the front of the queue...
             result = m_log_serialization_queue->front();
             m_log_serialization_queue->pop_front();
+            m_counters->queue_depth.store(m_log_serialization_queue->size(), std::memory_order_relaxed);
 
             // notify someone queing (if anyone is) that space has become available.
             m_log_serialization_element_serialized.notify_one();
         }
+        // once the queue is empty, replay anything spilled while the output stream was stalled.
+        else if(m_spilling)
+        {
+            result = m_spill->pop();
+            if(result == nullptr)
+            {
+                // the spill has been replayed, new entries can be queued again.
+                m_spilling = false;
+                m_replay_time += monotonic_ms() - m_replay_started;
+                m_replay_started = 0;
+            }
+            else if(m_replay_started == 0)
+            {
+                m_replay_started = monotonic_ms();
+            }
+
+            // someone may be waiting for space in the spill.
+            m_log_serialization_element_serialized.notify_one();
+        }
     }
 
     // return the result.
     return result;
 }
 
+/**
+ * Spills an entry while the output stream is stalled.
+ * Entries are spilled in to a ring (see log_ring) which is created, on first use, under directories::tmp(). The
+ * ring file is removed as soon as it is mapped; the mapping is all we need and nothing is left behind. Entries too
+ * large for the ring are trimmed. Must be called with m_log_serialization_queue_mutex held.
+ * @param entry entry to spill.
+ * @returns true if the entry was spilled, false if the spill is full or could not be created.
+ */
+bool log_writer::_spill_entry(std::shared_ptr<log_entry>& entry)
+{
+    // create the spill on first use (only trying the once).
+    if(m_spill == nullptr)
+    {
+        if(m_spill_unavailable)
+        {
+            return false;
+        }
+
+        try
+        {
+            auto spill_file = inglenook::directories::tmp() / "log-spill" / (std::to_string(inglenook::core::application::pid()) +
+                    "-" + boost::filesystem::unique_path("%%%%-%%%%-%%%%").native() + log_ring::RING_FILE_EXTENSION);
+            m_spill = log_ring::create(spill_file, pid(), process_name(), SPILL_CAPACITY);
+
+            boost::system::error_code filesystem_error;
+            boost::filesystem::remove(spill_file, filesystem_error);
+        }
+        catch(boost::exception&)
+        {
+            m_spill_unavailable = true;
+            return false;
+        }
+    }
+
+    log_record::truncate(*entry.get(), m_spill->max_entry_size());
+    std::size_t size = log_record::encoded_size(*entry.get());
+    if(!m_spill->push(*entry.get()))
+    {
+        return false;
+    }
+
+    m_spilling = true;
+    m_scheduled++;
+    m_spilled_entries++;
+    m_spilled_bytes += size;
+
+    // the rest of a group follows its first entry (nothing else can come between them, as the queue mutex is held).
+    // once the group has started it can't be retried, so members the spill has no room for are dropped.
+    for(auto member = entry->group().begin(); member != entry->group().end(); member++)
+    {
+        log_record::truncate(*member->get(), m_spill->max_entry_size());
+        size = log_record::encoded_size(*member->get());
+        if(m_spill->push(*member->get()))
+        {
+            m_scheduled++;
+            m_spilled_entries++;
+            m_spilled_bytes += size;
+        }
+        else
+        {
+            m_counters->dropped[statistics_slot((*member)->entry_type())].fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+    entry->group().clear();
+    return true;
+}
+
+/**
+ * Indicates if the output stream is stalled.
+ * The output stream is stalled if the serialization thread has been in a single write to it for longer than
+ * SINK_STALL_TIMEOUT (for example because the disk is full, or a network file system is not responding).
+ * @returns true if the output stream is stalled.
+ */
+bool log_writer::_sink_stalled() const
+{
+    std::int64_t started = m_sink_write_started.load(std::memory_order_acquire);
+    return started != 0 && monotonic_ms() - started > SINK_STALL_TIMEOUT;
+}
+
+/**
+ * Marks the start of a write to the output stream, so stalls can be detected (see _sink_stalled()).
+ */
+void log_writer::_sink_write_begin()
+{
+    m_sink_write_started.store(monotonic_ms(), std::memory_order_release);
+}
+
+/**
+ * Marks the end of a write to the output stream. If the write stalled it is counted in the stall counters.
+ */
+void log_writer::_sink_write_end()
+{
+    std::int64_t duration = monotonic_ms() - m_sink_write_started.exchange(0, std::memory_order_acq_rel);
+    if(duration > SINK_STALL_TIMEOUT)
+    {
+        m_stalls++;
+        m_stall_time += duration;
+    }
+}
+
+/**
+ * Gets the number of entries the serialization queue can hold.
+ * @returns capacity of the queue.
+ */
+std::size_t log_writer::queue_capacity() const
+{
+    boost::mutex::scoped_lock lock_queue((*m_log_serialization_queue_mutex.get()));
+    return m_log_serialization_queue->capacity();
+}
+
+/**
+ * Sets the number of entries the serialization queue can hold (LOG_WRITER_QUEUE_SIZE by default). Larger queues
+ * absorb longer bursts before callers of add_entry() have to wait for the serializer, at the cost of memory.
+ * The queue can't be shrunk below the number of entries waiting in it, nor be set for writers passing entries to
+ * the logging service daemon (which don't queue).
+ * @param value new capacity of the queue (at least 1).
+ * @returns true if the capacity was changed.
+ */
+bool log_writer::queue_capacity(const std::size_t& value)
+{
+    boost::mutex::scoped_lock lock_queue((*m_log_serialization_queue_mutex.get()));
+    if(m_ring != nullptr || value == 0 || value < m_log_serialization_queue->size())
+    {
+        return false;
+    }
+
+    m_log_serialization_queue->set_capacity(value);
+
+    // anyone waiting for space may now have some.
+    m_log_serialization_element_serialized.notify_all();
+    return true;
+}
+
+/**
+ * Gets the counters describing how the writer has coped with a stalled output stream.
+ * Writes that run for longer than SINK_STALL_TIMEOUT are counted as stalls; while the output stream is stalled,
+ * entries that can't be queued are spilled and are replayed, in order, once it recovers.
+ * @returns snapshot of the counters.
+ */
+log_writer_stall_counters log_writer::stall_counters() const
+{
+    log_writer_stall_counters counters;
+    counters.stalls = m_stalls.load();
+    counters.stall_time = m_stall_time.load();
+    counters.spilled_entries = m_spilled_entries.load();
+    counters.spilled_bytes = m_spilled_bytes.load();
+    counters.replay_time = m_replay_time.load();
+    return counters;
+}
+
+/**
+ * Gets a snapshot of the writer's statistics.
+ * The counters are read without taking any locks, so this is cheap enough to call while the writer is busy; the
+ * figures are not an exact cut across counters (entries may move from enqueued to written as they are read).
+ * Writers passing entries to the logging service daemon only count entries enqueued and dropped.
+ * @returns snapshot of the statistics.
+ */
+log_writer_statistics log_writer::statistics() const
+{
+    log_writer_statistics snapshot;
+    for(std::size_t i = 0; i < LOG_STATISTICS_CATEGORIES; i++)
+    {
+        snapshot.enqueued[i] = m_counters->enqueued[i].load(std::memory_order_relaxed);
+        snapshot.written[i] = m_counters->written[i].load(std::memory_order_relaxed);
+        snapshot.dropped[i] = m_counters->dropped[i].load(std::memory_order_relaxed);
+        snapshot.coalesced[i] = m_counters->coalesced[i].load(std::memory_order_relaxed);
+    }
+    for(std::size_t i = 0; i < LOG_STATISTICS_WAIT_BUCKETS; i++)
+    {
+        snapshot.enqueue_wait[i] = m_counters->enqueue_wait[i].load(std::memory_order_relaxed);
+    }
+    snapshot.queue_depth = m_counters->queue_depth.load(std::memory_order_relaxed);
+    snapshot.queue_high_water = m_counters->queue_high_water.load(std::memory_order_relaxed);
+    snapshot.serialization_time = m_counters->serialization_time.load(std::memory_order_relaxed);
+    snapshot.bytes_written = m_counters->bytes_written.load(std::memory_order_relaxed);
+    snapshot.flushes = m_counters->flushes.load(std::memory_order_relaxed);
+    snapshot.flush_time = m_counters->flush_time.load(std::memory_order_relaxed);
+    snapshot.flush_time_max = m_counters->flush_time_max.load(std::memory_order_relaxed);
+    snapshot.syncs = m_counters->syncs.load(std::memory_order_relaxed);
+    snapshot.sync_time = m_counters->sync_time.load(std::memory_order_relaxed);
+    snapshot.sync_time_max = m_counters->sync_time_max.load(std::memory_order_relaxed);
+    snapshot.stalls = stall_counters();
+    return snapshot;
+}
+
+/**
+ * Gets the interval the writer logs its own statistics at.
+ * @returns interval in milliseconds, 0 if the writer doesn't log its statistics.
+ */
+int log_writer::statistics_interval() const
+{
+    return m_statistics_interval.load(std::memory_order_relaxed);
+}
+
+/**
+ * Sets the interval the writer logs its own statistics at. The statistics are written as an entry under
+ * STATISTICS_NAMESPACE (see _log_serialization_worker_statistics()), no more often than the serialization thread
+ * wakes (SERIALIZER_IDLE_TIMEOUT) when the writer is idle. The first entry is written on the serialization thread's
+ * next pass, so it is in the output once a call to flush() made after this has completed.
+ * @param value interval in milliseconds, 0 (the default) to stop.
+ */
+void log_writer::statistics_interval(const int& value)
+{
+    m_statistics_interval.store(value < 0 ? 0 : value, std::memory_order_relaxed);
+}
+
+/**
+ * Gets a snapshot of the number of entries logged under each namespace.
+ * The counters are read without taking any locks. Entries are counted as they are passed to add_entry (or
+ * add_entries), so this includes entries below the thresholds that were never written, and entries that were
+ * dropped. Once LOG_NAMESPACE_COUNTERS namespaces have been logged under, entries of any others are counted together
+ * under an empty namespace (only present if there were any).
+ * @returns counters of each namespace logged under, in no particular order.
+ */
+std::vector<log_namespace_statistics> log_writer::namespace_statistics() const
+{
+    std::vector<log_namespace_statistics> snapshot;
+    auto add = [&snapshot](const log_namespace_counters::counters& counters)
+    {
+        log_namespace_statistics statistics;
+        statistics.log_namespace = counters.log_namespace;
+        std::uint64_t total = 0;
+        for(std::size_t i = 0; i < LOG_STATISTICS_CATEGORIES; i++)
+        {
+            statistics.logged[i] = counters.logged(i);
+            total += statistics.logged[i];
+        }
+        if(total > 0 || !statistics.log_namespace.empty())
+        {
+            snapshot.push_back(statistics);
+        }
+    };
+
+    for(std::size_t i = 0; i < LOG_NAMESPACE_COUNTERS; i++)
+    {
+        auto counters = m_namespace_counters->slots[i].load(std::memory_order_acquire);
+        if(counters != nullptr)
+        {
+            add(*counters);
+        }
+    }
+    add(m_namespace_counters->overflow);
+    return snapshot;
+}
+
+/**
+ * Gets the number of entries of a category logged under a namespace (see namespace_statistics()). This is a single
+ * lookup, without locks or I/O, so it is cheap enough to poll (for example, to raise an alarm on a rate of errors).
+ * @param log_namespace namespace to look up (entries are counted under exactly the namespace they were logged under).
+ * @param entry_type category to count.
+ * @returns number of entries logged, 0 if none have been.
+ */
+std::uint64_t log_writer::namespace_count(const std::string& log_namespace, const category& entry_type) const
+{
+    auto counters = m_namespace_counters->find(log_namespace, false);
+    return counters != nullptr ? counters->logged(statistics_slot(entry_type)) : 0;
+}
+
+/**
+ * Gets the interval the writer dumps its namespace counters to the metrics file at.
+ * @returns interval in milliseconds, 0 if the writer doesn't dump them.
+ */
+int log_writer::metrics_interval() const
+{
+    return m_metrics_interval.load(std::memory_order_relaxed);
+}
+
+/**
+ * Sets the interval the writer dumps its namespace counters (see namespace_statistics()) to the metrics file at
+ * (see metrics_file()). The first dump is made as soon as the serialization thread next wakes, then no more often
+ * than it wakes (SERIALIZER_IDLE_TIMEOUT) when the writer is idle. This has no effect on writers passing entries to
+ * the logging service daemon (the daemon's writer counts their entries).
+ * @param value interval in milliseconds, 0 (the default) to stop.
+ */
+void log_writer::metrics_interval(const int& value)
+{
+    m_metrics_interval.store(value < 0 ? 0 : value, std::memory_order_relaxed);
+}
+
+/**
+ * Gets the file the namespace counters are dumped to. Unless set, this is a file named after the process (and its
+ * id) in the log-metrics directory under directories::data().
+ * @returns path of the metrics file.
+ */
+boost::filesystem::path log_writer::metrics_file() const
+{
+    {
+        boost::mutex::scoped_lock lock(*m_log_serialization_queue_mutex);
+        if(!m_metrics_file.empty())
+        {
+            return m_metrics_file;
+        }
+    }
+    return inglenook::directories::data() / "log-metrics" / (m_process_name + "." + std::to_string(m_process_id) + ".json");
+}
+
+/**
+ * Sets the file the namespace counters are dumped to (see metrics_interval()).
+ * @param value path of the metrics file, empty for the default.
+ */
+void log_writer::metrics_file(const boost::filesystem::path& value)
+{
+    boost::mutex::scoped_lock lock(*m_log_serialization_queue_mutex);
+    m_metrics_file = value;
+}
+
+/**
+ * Gets the window identical entries are coalesced within.
+ * @returns window in milliseconds, 0 if entries aren't coalesced.
+ */
+int log_writer::coalesce_window() const
+{
+    return m_coalesce_window.load(std::memory_order_relaxed);
+}
+
+/**
+ * Sets the window identical entries are coalesced within. Polling loops often log the same entry over and over;
+ * with a window set, an entry logged again (by the same thread, with the same namespace, category and message)
+ * within the window of the first is counted rather than written. The first is written once the window has passed
+ * or a different entry arrives, carrying the repeat count and the times of the first and last repeat as extended
+ * data (see REPEATED_KEY). Entries are held back by up to the window (plus SERIALIZER_IDLE_TIMEOUT when idle).
+ * This has no effect on writers passing entries to the logging service daemon.
+ * @param value window in milliseconds, 0 (the default) to stop coalescing.
+ */
+void log_writer::coalesce_window(const int& value)
+{
+    m_coalesce_window.store(value < 0 ? 0 : value, std::memory_order_relaxed);
+}
+
+/**
+ * Gets the formatter entries are written out with.
+ * @returns the formatter (a log_xml_formatter unless set otherwise).
+ */
+std::shared_ptr<log_formatter> log_writer::formatter() const
+{
+    boost::mutex::scoped_lock lock_queue((*m_log_serialization_queue_mutex.get()));
+    return m_formatter;
+}
+
+/**
+ * Sets the formatter entries are written out with, for example to write JSON Lines for a log shipper (see
+ * log_json_formatter). The output starts with the formatter's header and ends with its footer (if the writer writes
+ * them), so the formatter can only be changed until the output has started: nothing is written until the first
+ * entry, so set the formatter straight after creating the writer. Nor can it be changed while log_crash_handler is
+ * installed for the writer (the handler writes entries in the writer's format, worked out during installation). This
+ * has no effect on writers passing entries to the logging service daemon (the daemon formats them).
+ * @param value formatter to use.
+ * @returns true if the formatter was set, false if the output has already started, the crash handler is installed for
+ * the writer (or value is null).
+ */
+bool log_writer::formatter(const std::shared_ptr<log_formatter>& value)
+{
+    if(value == nullptr)
+    {
+        return false;
+    }
+
+    std::string header;
+    value->format_header(header, m_process_id, m_process_name);
+
+    boost::mutex::scoped_lock lock_queue((*m_log_serialization_queue_mutex.get()));
+    if(m_output_started || m_crash_protected)
+    {
+        return false;
+    }
+    m_formatter = value;
+    m_header.swap(header);
+    return true;
+}
+
+/**
+ * Gets the largest number of bytes of each attachment written out.
+ * @returns limit in bytes.
+ */
+std::size_t log_writer::attachment_limit() const
+{
+    return m_attachment_limit.load(std::memory_order_relaxed);
+}
+
+/**
+ * Sets the largest number of bytes of each attachment written out (ATTACHMENT_LIMIT by default). Attachments are
+ * encoded on the serialization thread, as they are written; bytes beyond the limit are left out, and the attachment
+ * marked as truncated (its size attribute still gives the number of bytes attached). Writers passing entries to the
+ * logging service daemon leave this to the daemon.
+ * @param value limit in bytes.
+ */
+void log_writer::attachment_limit(const std::size_t& value)
+{
+    m_attachment_limit.store(value, std::memory_order_relaxed);
+}
+
 /**
  * Gets the value for the default name space
  * This property makes no guarantees of thread safety.
@@ -19,6 +19,12 @@
 
 // standard library includes
 #include <ostream>
+#include <sstream>
+#include <atomic>
+#include <cstdint>
+#include <future>
+#include <string>
+#include <vector>
 
 // boost (http://boost.org) includes
 #include <boost/filesystem.hpp>
@@ -29,6 +35,8 @@
 // inglenook includes
 #include <ign_core/application.h>
 #include "log_entry.h"
+#include "log_formatter.h"
+#include "log_ring.h"
 
 namespace inglenook
 {
@@ -39,6 +47,102 @@ namespace logging
 /// log message queue used to schedule message serialization.
 typedef boost::circular_buffer<std::shared_ptr<log_entry>> log_message_queue;
 
+/// counters describing how a log_writer has coped with a stalled output stream (see log_writer::stall_counters()).
+struct log_writer_stall_counters
+{
+    /// number of writes to the output stream that stalled.
+    std::uint64_t stalls;
+
+    /// total time spent in writes that stalled (milliseconds).
+    std::uint64_t stall_time;
+
+    /// number of entries spilled while the output stream was stalled.
+    std::uint64_t spilled_entries;
+
+    /// number of bytes spilled while the output stream was stalled (as encoded by log_record).
+    std::uint64_t spilled_bytes;
+
+    /// total time spent replaying spilled entries once the output stream recovered (milliseconds).
+    std::uint64_t replay_time;
+};
+
+/// number of per category slots in log_writer_statistics (indexed by category, anything else counts as unspecified).
+const std::size_t LOG_STATISTICS_CATEGORIES = 7;
+
+/// number of buckets in the log_writer_statistics enqueue wait histogram.
+const std::size_t LOG_STATISTICS_WAIT_BUCKETS = 16;
+
+/// snapshot of what a log_writer has been doing (see log_writer::statistics()).
+struct log_writer_statistics
+{
+    /// entries accepted by add_entry (or add_entries), per category.
+    std::uint64_t enqueued[LOG_STATISTICS_CATEGORIES];
+
+    /// entries written to the output stream, per category.
+    std::uint64_t written[LOG_STATISTICS_CATEGORIES];
+
+    /// entries rejected by add_entry or add_entries (or found incomplete by the serializer), per category.
+    std::uint64_t dropped[LOG_STATISTICS_CATEGORIES];
+
+    /// entries folded in to an earlier identical entry rather than written (see log_writer::coalesce_window()), per category.
+    std::uint64_t coalesced[LOG_STATISTICS_CATEGORIES];
+
+    /// number of entries currently waiting in the queue.
+    std::uint64_t queue_depth;
+
+    /// largest number of entries that have been waiting in the queue.
+    std::uint64_t queue_high_water;
+
+    /// time spent in add_entry; bucket i counts calls that took less than 2^i microseconds (the last counts the rest).
+    std::uint64_t enqueue_wait[LOG_STATISTICS_WAIT_BUCKETS];
+
+    /// total time spent formatting and writing entries (microseconds).
+    std::uint64_t serialization_time;
+
+    /// number of bytes written to the output stream.
+    std::uint64_t bytes_written;
+
+    /// number of times the output stream was flushed.
+    std::uint64_t flushes;
+
+    /// total time spent flushing the output stream (microseconds).
+    std::uint64_t flush_time;
+
+    /// longest time spent flushing the output stream (microseconds).
+    std::uint64_t flush_time_max;
+
+    /// number of times the output file was synced to disk (see log_writer::flush()).
+    std::uint64_t syncs;
+
+    /// total time spent syncing the output file (microseconds).
+    std::uint64_t sync_time;
+
+    /// longest time spent syncing the output file (microseconds).
+    std::uint64_t sync_time_max;
+
+    /// how the writer has coped with a stalled output stream.
+    log_writer_stall_counters stalls;
+};
+
+/// live counters behind log_writer_statistics (see log_writer.cpp).
+struct log_writer_counters;
+
+/// number of namespaces a log_writer counts entries for separately (see log_writer::namespace_statistics()).
+const std::size_t LOG_NAMESPACE_COUNTERS = 256;
+
+/// number of entries logged under a namespace (see log_writer::namespace_statistics()).
+struct log_namespace_statistics
+{
+    /// namespace the entries were logged under (empty for namespaces logged under once LOG_NAMESPACE_COUNTERS were).
+    std::string log_namespace;
+
+    /// entries passed to add_entry (or add_entries), per category, whether or not they were written.
+    std::uint64_t logged[LOG_STATISTICS_CATEGORIES];
+};
+
+/// live counters behind log_namespace_statistics (see log_writer.cpp).
+struct log_namespace_counters;
+
 /**
  * The log_writer class provides log writing functionality for client applications.
  * The log_writer class will write log entries as well formed XML to a specified output stream (std::ostream). XML emitted by this class
@@ -48,6 +152,9 @@ typedef boost::circular_buffer<std::shared_ptr<log_entry>> log_message_queue;
 class log_writer
 {
 
+    /// the crash handler writes outstanding entries on our behalf when the process is terminated.
+    friend class log_crash_handler;
+
     protected:
 
         // (there is no default constructor for the LogWriter)
@@ -60,6 +167,9 @@ class log_writer
         log_writer(const std::shared_ptr<std::ostream>& output_stream, const bool& write_header, const bool& write_footer,
                    const pid_type& pid, const std::string& application_name);
 
+        // Creates a new LogWriter instance which will pass logs to the logging service daemon through a ring.
+        log_writer(const std::shared_ptr<log_ring>& ring, const pid_type& pid, const std::string& application_name);
+
     public:
 
         /// there is no default constructor for the LogWriter (deleted).
@@ -80,6 +190,24 @@ class log_writer
         static std::shared_ptr<log_writer> create_from_file_path(const boost::filesystem::path& output_file, const bool& create,
                 const bool& write_header, const bool& write_footer, const pid_type& pid, const std::string& application_name);
 
+        // Creates a new log_writer instance which will emit logs to the specified file, through a memory mapping.
+        static std::shared_ptr<log_writer> create_from_mapped_file_path(const boost::filesystem::path& output_file,
+                const bool& create = true, const bool& write_header = true, const bool& write_footer = true);
+
+        // Creates a new log_writer instance which will emit logs to the specified file, through a memory mapping.
+        static std::shared_ptr<log_writer> create_from_mapped_file_path(const boost::filesystem::path& output_file,
+                const bool& create, const bool& write_header, const bool& write_footer, const pid_type& pid,
+                const std::string& application_name);
+
+        // Creates a new log_writer instance which will emit logs to the specified file, through io_uring.
+        static std::shared_ptr<log_writer> create_from_async_file_path(const boost::filesystem::path& output_file,
+                const bool& create = true, const bool& write_header = true, const bool& write_footer = true);
+
+        // Creates a new log_writer instance which will emit logs to the specified file, through io_uring.
+        static std::shared_ptr<log_writer> create_from_async_file_path(const boost::filesystem::path& output_file,
+                const bool& create, const bool& write_header, const bool& write_footer, const pid_type& pid,
+                const std::string& application_name);
+
         // Creates a new log_writer instance which will emit logs to a specified stream
         static std::shared_ptr<log_writer> create_from_stream(const std::shared_ptr<std::ostream>& output_stream,
                 const bool& write_header = true, const bool& write_footer = true);
@@ -88,6 +216,12 @@ class log_writer
         static std::shared_ptr<log_writer> create_from_stream(const std::shared_ptr<std::ostream>& output_stream,
                 const bool& write_header, const bool& write_footer, const pid_type& pid, const std::string& application_name);
 
+        // Creates a new log_writer instance which will pass logs to the logging service daemon (if running).
+        static std::shared_ptr<log_writer> create_from_service();
+
+        // Creates a new log_writer instance which will pass logs to the logging service daemon (if running).
+        static std::shared_ptr<log_writer> create_from_service(const pid_type& pid, const std::string& application_name);
+
         // gets the default log path for this run of the software.
         static boost::filesystem::path default_log_path();
 
@@ -102,6 +236,15 @@ class log_writer
         ///            you probably shouldn't be calling it directly anyhow.
         bool add_entry(std::shared_ptr<log_entry>& entry);
 
+        // schedules an entry for addition to the log, with a future completing once it has been written.
+        bool add_entry(std::shared_ptr<log_entry>& entry, std::future<bool>& written, const bool& sync = false);
+
+        // schedules a group of entries for addition to the log, to be written together (see add_entry()).
+        bool add_entries(std::vector<std::shared_ptr<log_entry>>& entries);
+
+        // gets a future completing once every entry scheduled before the call has been written.
+        std::future<bool> flush(const bool& sync = false);
+
         /// gets the current process id  (or id of process we are logging on behalf of).
         const pid_type pid() const;
 
@@ -132,13 +275,93 @@ class log_writer
         /// sets the console threshold
         void console_threshold(const category& value);
 
+        /// gets the number of entries the serialization queue can hold.
+        std::size_t queue_capacity() const;
+
+        // sets the number of entries the serialization queue can hold.
+        bool queue_capacity(const std::size_t& value);
+
+        /// indicates if entries are currently being passed to the logging service daemon.
+        bool using_service() const;
+
+        // gets the stalled output stream counters.
+        log_writer_stall_counters stall_counters() const;
+
+        // gets a snapshot of the writer's statistics.
+        log_writer_statistics statistics() const;
+
+        /// gets the interval the writer logs its own statistics at (milliseconds, 0 if it doesn't).
+        int statistics_interval() const;
+
+        // sets the interval the writer logs its own statistics at (milliseconds, 0 to stop).
+        void statistics_interval(const int& value);
+
+        // gets a snapshot of the number of entries logged under each namespace.
+        std::vector<log_namespace_statistics> namespace_statistics() const;
+
+        // gets the number of entries of a category logged under a namespace.
+        std::uint64_t namespace_count(const std::string& log_namespace, const category& entry_type) const;
+
+        /// gets the interval the writer dumps its namespace counters to the metrics file at (milliseconds, 0 if it doesn't).
+        int metrics_interval() const;
+
+        // sets the interval the writer dumps its namespace counters to the metrics file at (milliseconds, 0 to stop).
+        void metrics_interval(const int& value);
+
+        // gets the file the namespace counters are dumped to.
+        boost::filesystem::path metrics_file() const;
+
+        // sets the file the namespace counters are dumped to.
+        void metrics_file(const boost::filesystem::path& value);
+
+        /// gets the window identical entries are coalesced within (milliseconds, 0 if they aren't).
+        int coalesce_window() const;
+
+        // sets the window identical entries are coalesced within (milliseconds, 0 to stop).
+        void coalesce_window(const int& value);
+
+        // gets the formatter entries are written out with.
+        std::shared_ptr<log_formatter> formatter() const;
+
+        // sets the formatter entries are written out with (before anything has been written).
+        bool formatter(const std::shared_ptr<log_formatter>& value);
+
+        /// gets the largest number of bytes of each attachment written out (see log_attachment).
+        std::size_t attachment_limit() const;
+
+        // sets the largest number of bytes of each attachment written out.
+        void attachment_limit(const std::size_t& value);
+
         /// defines the value that expresses no PID
         static const pid_type NO_PID;
 
+        /// namespace the writer logs its own statistics under (reserved).
+        static const char* const STATISTICS_NAMESPACE;
+
+        /// extended data key holding the number of times a coalesced entry was logged.
+        static const char* const REPEATED_KEY;
+
+        /// extended data key holding the time a coalesced entry was first logged.
+        static const char* const REPEATED_FIRST_KEY;
+
+        /// extended data key holding the time a coalesced entry was last logged.
+        static const char* const REPEATED_LAST_KEY;
+
+        /// extended data key holding the id of the group an entry was logged in (see add_entries()).
+        static const char* const GROUP_KEY;
+
     private:
 
-        /// Writes the xml header out to the stream.
-        void write_xml_header();
+        /// ways a writer can write to a file (see _create_from_file_path()).
+        enum file_sink { append_sink, mapped_sink, async_sink };
+
+        /// creates a writer emitting logs to a file, written to as the sink says.
+        static std::shared_ptr<log_writer> _create_from_file_path(const boost::filesystem::path& output_file,
+                const bool& create, const bool& write_header, const bool& write_footer, const pid_type& pid,
+                const std::string& application_name, const file_sink& sink);
+
+        /// starts the output, writing the header if there should be one (serialization thread only).
+        void _log_serialization_worker_begin_output();
 
         /// amount of time a worker should wait for a space availability notification from the serializer
         /// before it just tries to reschedule the message anyway.
@@ -158,11 +381,20 @@ class log_writer
         /// threads will ignore the condition and accept that they will need to wait.
         const int LOCK_ITEM_QUEUED_TIMEOUT = 250; // ms (0.25seconds)
 
-        /// The number of elements to store in the log writer queue. Changing this
-        /// number will impact the memory footprint of all applications. We may want
-        /// to make this an option in future versions of the writer.
+        /// The number of elements to store in the log writer queue by default. Changing this
+        /// number will impact the memory footprint of all applications (see queue_capacity()).
         const int LOG_WRITER_QUEUE_SIZE = 50; // log_entries
 
+        /// a write to the output stream that has been running for longer than this is considered stalled, entries
+        /// that would otherwise wait for space in the queue are spilled until the output stream recovers.
+        const int SINK_STALL_TIMEOUT = 500; // ms (0.5 seconds)
+
+        /// largest number of bytes of each attachment written out by default (see attachment_limit()).
+        static const std::size_t ATTACHMENT_LIMIT = 4096; // bytes
+
+        /// size of the spill ring's record area (bytes, must be a power of two).
+        static const std::size_t SPILL_CAPACITY = 16777216; // 16MiB
+
         /// identifies the boundary at an element is no longer printed to cout on a
         /// call to _log_serialization_worker_screen, but cerr instead.
         const category LOG_CATEGORY_CERR_BOUNTRY = category::warning;
@@ -180,6 +412,69 @@ class log_writer
         /// serializes a log entry to standard outputs (cout/cerr)
         void _log_serialization_worker_screen(std::shared_ptr<log_entry> entry);
 
+        /// writes a log entry to the output stream and/or console, as the thresholds dictate.
+        void _log_serialization_worker_write(std::shared_ptr<log_entry> entry, bool& serialized, bool& echoed);
+
+        /// folds an entry in to the entry held for coalescing, or holds it (serialization thread only).
+        bool _log_serialization_worker_coalesce(std::shared_ptr<log_entry>& entry, bool& serialized, bool& echoed);
+
+        /// checks an entry is filled out, then coalesces or writes it (serialization thread only).
+        void _log_serialization_worker_process(std::shared_ptr<log_entry>& entry, bool& serialized, bool& echoed);
+
+        /// writes out the entry held for coalescing (serialization thread only).
+        void _log_serialization_worker_coalesce_release(bool& serialized, bool& echoed);
+
+        /// spills an entry while the output stream is stalled (queue mutex must be held).
+        bool _spill_entry(std::shared_ptr<log_entry>& entry);
+
+        /// indicates if the output stream is stalled (a write has been running for longer than SINK_STALL_TIMEOUT).
+        bool _sink_stalled() const;
+
+        /// marks the start of a write to the output stream (serialization thread only).
+        void _sink_write_begin();
+
+        /// marks the end of a write to the output stream, counting it if it stalled (serialization thread only).
+        void _sink_write_end();
+
+        /// queues an entry (and any entries grouped with it), waiting for space if need be.
+        bool _schedule_entry(std::shared_ptr<log_entry>& entry);
+
+        /// wakes the serializer (if it is sleeping).
+        void _wake_serializer();
+
+        /// indicates if a call to flush() is waiting on the serializer.
+        bool _flush_requested() const;
+
+        /// completes the calls to flush() waiting on entries that have now been written (serialization thread only).
+        void _log_serialization_worker_complete_flushes();
+
+        /// counts an entry accepted or rejected by add_entry.
+        void _count_entry(const category& entry_type, const bool& enqueued, const std::int64_t& started);
+
+        /// writes the writer's own statistics to the output stream (serialization thread only).
+        void _log_serialization_worker_statistics();
+
+        /// counts an entry passed to add_entry (or add_entries) under its namespace.
+        void _count_namespace(const std::string& log_namespace, const category& entry_type);
+
+        /// dumps the namespace counters to the metrics file (serialization thread only).
+        void _log_serialization_worker_metrics();
+
+        /// passes an entry to the logging service daemon, or the fallback writer if it has gone away.
+        bool _service_add_entry(std::shared_ptr<log_entry>& entry);
+
+        /// passes a group of entries to the logging service daemon (together), or the fallback writer if it has gone away.
+        bool _service_add_entries(std::vector<std::shared_ptr<log_entry>>& group);
+
+        /// prepares an entry for the logging service daemon (echoing it), indicating if it should be passed on.
+        bool _service_filter_entry(std::shared_ptr<log_entry>& entry);
+
+        /// indicates if a push in to the ring should be tried (again), marking the daemon lost if not.
+        bool _service_ring_ready(const boost::posix_time::ptime& give_up, const bool& retrying);
+
+        /// gets the writer used once the logging service daemon has gone away (creating it if needed).
+        std::shared_ptr<log_writer> _service_fallback();
+
         /// log serialization thread (see declaration for details).
         std::shared_ptr<boost::thread> m_log_serialization_thread;
 
@@ -197,10 +492,8 @@ class log_writer
         /// mutex that must be acquired to work with the shutdown variable.
         std::shared_ptr<boost::mutex> m_log_serialization_queue_mutex;
 
-        /// mutex that must be acquired to work with the element queued notification system.
-        std::shared_ptr<boost::mutex> m_log_serialization_element_queuing_mutex;
-
         /// used to notify the serialization thread that it needs to process some information.
+        /// the serializer waits on this with m_log_serialization_queue_mutex held.
         boost::condition_variable m_log_serialization_element_queuing;
 
         /// used to notify the queuing entries that space in the queue has become available.
@@ -215,6 +508,28 @@ class log_writer
         /// output stream to write log messages to
         std::shared_ptr<std::ostream> m_output_stream;
 
+        /// file the output stream writes to (empty if not writing to a file).
+        boost::filesystem::path m_output_file;
+
+        /// entries are formatted in to this before being written (serialization thread only, kept between entries).
+        std::string m_formatted_entry;
+
+        /// formats the entries written to the output stream (fixed once the output has started).
+        /// always acquire ownership of m_log_serialization_queue_mutex before use (see formatter()).
+        std::shared_ptr<log_formatter> m_formatter;
+
+        /// header the formatter starts the output with (formatted when the formatter is set).
+        /// always acquire ownership of m_log_serialization_queue_mutex before use.
+        std::string m_header;
+
+        /// set once the serializer has started the output (the formatter can no longer be changed).
+        /// always acquire ownership of m_log_serialization_queue_mutex before use (the serializer only sets it).
+        bool m_output_started;
+
+        /// set while log_crash_handler protects the writer (the formatter can't be changed, see formatter()).
+        /// always acquire ownership of m_log_serialization_queue_mutex before use.
+        bool m_crash_protected;
+
         /// lowest type of information that will be written to xml
         category m_xml_serialization_threshold;
 
@@ -232,6 +547,123 @@ class log_writer
 
         /// inidicates if a footer should be written on shutdown.
         bool m_write_footer;
+
+        /// ring entries are passed to the logging service daemon through (null if not using the service).
+        std::shared_ptr<log_ring> m_ring;
+
+        /// writer used once the logging service daemon has gone away.
+        /// always acquire ownership of m_log_serialization_queue_mutex before use.
+        std::shared_ptr<log_writer> m_service_fallback;
+
+        /// set once the logging service daemon has gone away (entries are then written by m_service_fallback).
+        std::atomic<bool> m_service_lost;
+
+        /// time the current write to the output stream started (monotonic milliseconds, 0 if not writing).
+        std::atomic<std::int64_t> m_sink_write_started;
+
+        /// ring entries are spilled in to while the output stream is stalled (created on first use).
+        /// always acquire ownership of m_log_serialization_queue_mutex before use.
+        std::shared_ptr<log_ring> m_spill;
+
+        /// set while entries are being spilled, new entries join the spill until it is empty (to keep them in order).
+        /// always acquire ownership of m_log_serialization_queue_mutex before use.
+        bool m_spilling;
+
+        /// set if the spill ring could not be created (entries then wait for the output stream as before).
+        /// always acquire ownership of m_log_serialization_queue_mutex before use.
+        bool m_spill_unavailable;
+
+        /// time replay of the spill started (monotonic milliseconds, 0 if not replaying; serialization thread only).
+        std::int64_t m_replay_started;
+
+        /// number of writes to the output stream that stalled.
+        std::atomic<std::uint64_t> m_stalls;
+
+        /// total time spent in writes that stalled (milliseconds).
+        std::atomic<std::uint64_t> m_stall_time;
+
+        /// number of entries spilled.
+        std::atomic<std::uint64_t> m_spilled_entries;
+
+        /// number of bytes spilled.
+        std::atomic<std::uint64_t> m_spilled_bytes;
+
+        /// total time spent replaying spilled entries (milliseconds).
+        std::atomic<std::uint64_t> m_replay_time;
+
+        /// live statistics counters (see statistics()).
+        std::shared_ptr<log_writer_counters> m_counters;
+
+        /// interval the writer logs its own statistics at (milliseconds, 0 if it doesn't).
+        std::atomic<int> m_statistics_interval;
+
+        /// time the writer last logged its own statistics (monotonic milliseconds; serialization thread only).
+        std::int64_t m_statistics_logged;
+
+        /// live per namespace counters (see namespace_statistics()).
+        std::shared_ptr<log_namespace_counters> m_namespace_counters;
+
+        /// interval the writer dumps its namespace counters at (milliseconds, 0 if it doesn't).
+        std::atomic<int> m_metrics_interval;
+
+        /// time the writer last dumped its namespace counters (monotonic milliseconds; serialization thread only).
+        std::int64_t m_metrics_dumped;
+
+        /// file the namespace counters are dumped to (empty for the default, see metrics_file()).
+        /// always acquire ownership of m_log_serialization_queue_mutex before use.
+        boost::filesystem::path m_metrics_file;
+
+        /// window identical entries are coalesced within (milliseconds, 0 if they aren't).
+        std::atomic<int> m_coalesce_window;
+
+        /// largest number of bytes of each attachment written out.
+        std::atomic<std::size_t> m_attachment_limit;
+
+        /// entry held back while identical entries are folded in to it (serialization thread only).
+        std::shared_ptr<log_entry> m_coalesce_held;
+
+        /// hash of the held entry's message (serialization thread only).
+        std::size_t m_coalesce_hash;
+
+        /// number of times the held entry has been logged (serialization thread only).
+        std::uint64_t m_coalesce_repeats;
+
+        /// time the held entry was last logged (serialization thread only).
+        boost::posix_time::ptime m_coalesce_last;
+
+        /// time the entry was held (monotonic milliseconds; serialization thread only).
+        std::int64_t m_coalesce_started;
+
+        /// id given to the next group of entries (see add_entries()).
+        std::atomic<std::uint64_t> m_next_group_id;
+
+        /// a call to flush() waiting on the serializer.
+        struct pending_flush
+        {
+            /// number of queue places (see m_scheduled) that must have been written.
+            std::uint64_t target;
+
+            /// set if the output file should be synced before completing.
+            bool sync;
+
+            /// completed once written.
+            std::promise<bool> written;
+        };
+
+        /// number of places taken in the queue (or spill) so far; a group takes one place in the queue.
+        /// always acquire ownership of m_log_serialization_queue_mutex before use.
+        std::uint64_t m_scheduled;
+
+        /// number of places taken from the queue (or spill) and processed (serialization thread only).
+        std::uint64_t m_processed;
+
+        /// calls to flush() waiting on the serializer.
+        /// always acquire ownership of m_log_serialization_queue_mutex before use.
+        std::vector<pending_flush> m_pending_flushes;
+
+        /// set once the serializer has stopped (calls to flush() then complete straight away).
+        /// always acquire ownership of m_log_serialization_queue_mutex before use.
+        bool m_serializer_stopped;
 };
 
 } // namespace inglenook::logging
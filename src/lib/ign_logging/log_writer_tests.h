@@ -22,16 +22,30 @@
 
 // standard includes
 // #include <regex> // gcc regex is non-functional, using boost instead.
+#include <cstring>
 #include <ctime>
+#include <fstream>
+#include <sstream>
+#include <vector>
+
+// platform includes
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <linux/io_uring.h>
 
 // boost (http://boost.org) includes
 #include <boost/lexical_cast.hpp>
 #include <boost/test/unit_test.hpp>
 #include <boost/scope_exit.hpp>
 #include <boost/regex.hpp>
+#include <boost/filesystem.hpp>
 
 // inglenook includes
 #include "log_writer.h"
+#include "log_file_reader.h"
+#include "log_file_stream.h"
+#include "log_mapped_file_stream.h"
 
 namespace inglenook
 {
@@ -163,6 +177,38 @@ void filter_scenario(const category& entry_category, const category& xml_filter,
             xml_out, console_cout_out, console_cerr_out);
 }
 
+/**
+ * Test scenario for log_writer.
+ * Forks a child process which appends entries to an existing log file (as ign_log_write does), entries are
+ * named after the writer and their sequence so they can be checked once every writer has finished. Roughly half
+ * of the entries are larger than PIPE_BUF.
+ * @param log_file file for the child process to append to.
+ * @param writer_number number identifying this writer in its messages.
+ * @param entry_count number of entries to write.
+ * @returns the id of the child process.
+ */
+pid_t run_appending_child(const boost::filesystem::path& log_file, const int& writer_number, const int& entry_count)
+{
+    pid_t child = fork();
+    if(child == 0)
+    {
+        int result = 0;
+        {
+            auto writer = log_writer::create_from_file_path(log_file, false, false, false);
+            writer->console_threshold(category::no_log);
+            for(int i = 0; i < entry_count; i++)
+            {
+                auto entry = create_log_entry(category::information, "writer " + std::to_string(writer_number) +
+                        " entry " + std::to_string(i) + " " + std::string((i * 97) % 8192, 'x'), "inglenook.logging.test");
+                result |= writer->add_entry(entry) ? 0 : 1;
+            }
+        }
+        _exit(result);
+    }
+
+    return child;
+}
+
 //
 // log_writer_tests__ctor_dtor
 // checks all the default values for correctness. This should ensure that
@@ -340,7 +386,7 @@ BOOST_AUTO_TEST_CASE ( log_writer_tests__assignments )
     _log_writer->console_threshold(category::fatal);         BOOST_CHECK(_log_writer->console_threshold() == category::fatal);
 
     // nothing should have been written to the stream during this test
-    boost::this_thread::yield(); boost::this_thread::sleep(boost::posix_time::milliseconds(10));
+    BOOST_CHECK(_log_writer->flush().get());
     BOOST_CHECK(test_stream->str() == "");
 }
 
@@ -686,6 +732,511 @@ BOOST_AUTO_TEST_CASE ( log_writer_tests__ouput )
     }
 }
 
+//
+// log_writer_tests__concurrent_append
+// several processes append to the same log file at once, each entry must reach the file whole. the result
+// is checked against the structure the XSD describes: one header, then complete entries only, then the footer.
+BOOST_AUTO_TEST_CASE ( log_writer_tests__concurrent_append )
+{
+    const int WRITER_COUNT = 8;
+    const int ENTRY_COUNT = 250;
+    auto log_file = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("ign-append-%%%%-%%%%.xml");
+    BOOST_SCOPE_EXIT( (&log_file) )
+    {
+        boost::filesystem::remove(log_file);
+    } BOOST_SCOPE_EXIT_END
+
+    // start the file as ign_log_write would...
+    log_writer::create_from_file_path(log_file, true, true, false).reset();
+
+    // ... then have every writer append to it at once ...
+    std::vector<pid_t> children;
+    for(int i = 0; i < WRITER_COUNT; i++)
+    {
+        children.push_back(run_appending_child(log_file, i, ENTRY_COUNT));
+    }
+    for(auto child = children.begin(); child != children.end(); child++)
+    {
+        int status = -1;
+        waitpid(*child, &status, 0);
+        BOOST_CHECK(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    }
+
+    // ... and close it.
+    log_writer::create_from_file_path(log_file, false, false, true).reset();
+
+    std::ifstream input(log_file.native());
+    std::stringstream content;
+    content << input.rdbuf();
+    std::string xml = content.str();
+
+    // the header,
+    const boost::regex header("<\\?xml version=\"1\\.0\" encoding=\"UTF-8\"\\?><inglenook-log-file xmlns=\"[^\"]+\">"
+            "<process-id pid=\"[0-9]+\"><binary-name><!\\[CDATA\\[[^\\]]*\\]\\]></binary-name>"
+            "<binary-version><!\\[CDATA\\[[^\\]]*\\]\\]></binary-version>"
+            "<log-writer-version><!\\[CDATA\\[[^\\]]*\\]\\]></log-writer-version></process-id><log-entries>");
+    const boost::regex entry("<log-entry timestamp=\"[0-9]{4}-[0-9]{2}-[0-9]{2}T[0-9]{2}:[0-9]{2}:[0-9]{2}(\\.[0-9]+)?Z\" "
+            "severity=\"3\" ns=\"inglenook\\.logging\\.test\"><message><!\\[CDATA\\[writer ([0-9]+) entry ([0-9]+) (x*)\\]\\]>"
+            "</message></log-entry>");
+    const std::string footer = "</log-entries></inglenook-log-file>";
+
+    std::string::const_iterator position = xml.begin();
+    boost::match_results<std::string::const_iterator> items;
+    BOOST_REQUIRE(boost::regex_search(position, xml.cend(), items, header, boost::match_continuous));
+    position = items[0].second;
+
+    // every entry, in the order each writer wrote them,
+    std::vector<int> next_entry(WRITER_COUNT, 0);
+    int entries_read = 0;
+    while(boost::regex_search(position, xml.cend(), items, entry, boost::match_continuous))
+    {
+        int writer_number = boost::lexical_cast<int>(items[2]);
+        int entry_number = boost::lexical_cast<int>(items[3]);
+        BOOST_REQUIRE(writer_number >= 0 && writer_number < WRITER_COUNT);
+        BOOST_CHECK(entry_number == next_entry[writer_number]++);
+        BOOST_CHECK(static_cast<int>(items[4].length()) == (entry_number * 97) % 8192);
+        position = items[0].second;
+        entries_read++;
+    }
+    BOOST_CHECK(entries_read == WRITER_COUNT * ENTRY_COUNT);
+
+    // and the footer (with nothing left over).
+    BOOST_CHECK(std::string(position, xml.cend()) == footer);
+}
+
+//
+// log_writer_tests__mapped_file
+// checks a writer through a memory mapped file preallocates it in extents while writing, passes entries larger than
+// its window, and leaves only the data behind when closed; and that a file left at its preallocated length (as a
+// killed process would leave it) is carried on from the end of its data.
+BOOST_AUTO_TEST_CASE ( log_writer_tests__mapped_file )
+{
+    auto log_file = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("ign-mapped-%%%%-%%%%.xml");
+    BOOST_SCOPE_EXIT( (&log_file) )
+    {
+        boost::filesystem::remove(log_file);
+    } BOOST_SCOPE_EXIT_END
+
+    // start the file, with an entry too large for the window amongst the others.
+    std::string large(log_mapped_file_buffer::WINDOW_SIZE + 1000, 'x');
+    {
+        auto writer = log_writer::create_from_mapped_file_path(log_file, true, true, false);
+        writer->console_threshold(category::no_log);
+        for(int i = 0; i < 100; i++)
+        {
+            auto entry = create_log_entry(category::information, "entry " + std::to_string(i) + (i == 50 ? large : ""),
+                    "inglenook.logging.test");
+            writer->add_entry(entry);
+        }
+        BOOST_CHECK(writer->flush(true).get());
+        BOOST_CHECK(writer->statistics().syncs == 1);
+        auto allocated = boost::filesystem::file_size(log_file);
+        BOOST_CHECK(allocated >= static_cast<std::uintmax_t>(log_mapped_file_buffer::EXTENT_SIZE));
+        BOOST_CHECK(allocated % log_mapped_file_buffer::EXTENT_SIZE == 0);
+    }
+    auto written = boost::filesystem::file_size(log_file);
+    BOOST_CHECK(written < static_cast<std::uintmax_t>(log_mapped_file_buffer::EXTENT_SIZE));
+
+    // leave the file as a killed writer would have, then carry on from the end of it and close it.
+    boost::filesystem::resize_file(log_file, log_mapped_file_buffer::EXTENT_SIZE);
+    {
+        auto writer = log_writer::create_from_mapped_file_path(log_file, false, false, true);
+        writer->console_threshold(category::no_log);
+        auto entry = create_log_entry(category::information, "entry 100", "inglenook.logging.test");
+        writer->add_entry(entry);
+    }
+
+    std::ifstream input(log_file.native());
+    std::stringstream content;
+    content << input.rdbuf();
+    std::string xml = content.str();
+    BOOST_CHECK(xml.find('\0') == std::string::npos);
+    BOOST_CHECK(xml.find("<?xml") == 0 && xml.find("<?xml", 1) == std::string::npos);
+    BOOST_CHECK(xml.find(large) != std::string::npos);
+    BOOST_CHECK(boost::regex_search(xml, boost::regex(
+            "<message><!\\[CDATA\\[entry 99\\]\\]></message></log-entry><log-entry [^>]+><message><!\\[CDATA\\[entry 100\\]\\]>"
+            "</message></log-entry></log-entries></inglenook-log-file>$")));
+}
+
+//
+// log_writer_tests__async_file
+// checks a file stream goes through io_uring where the kernel has it, and that a writer through io_uring (or, where
+// there is none, appending as usual) passes a flush only once what came before it is in the file, across many
+// batches, and keeps the entries in order.
+BOOST_AUTO_TEST_CASE ( log_writer_tests__async_file )
+{
+    auto log_file = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("ign-async-%%%%-%%%%.xml");
+    BOOST_SCOPE_EXIT( (&log_file) )
+    {
+        boost::filesystem::remove(log_file);
+    } BOOST_SCOPE_EXIT_END
+
+    // the stream writes through io_uring wherever the kernel can append with it.
+    io_uring_params parameters;
+    std::memset(&parameters, 0, sizeof(parameters));
+    int ring = static_cast<int>(syscall(__NR_io_uring_setup, 1, &parameters));
+    bool uring_available = ring >= 0 && (parameters.features & IORING_FEAT_RW_CUR_POS);
+    if(ring >= 0)
+    {
+        ::close(ring);
+    }
+    {
+        log_file_stream stream(log_file.native(), true);
+        BOOST_CHECK(stream.file_buffer().asynchronous() == uring_available);
+        stream << "through the ring";
+        BOOST_CHECK(stream.file_buffer().synchronize());
+        std::ifstream input(log_file.native());
+        std::stringstream content;
+        content << input.rdbuf();
+        BOOST_CHECK(content.str() == "through the ring");
+    }
+    boost::filesystem::remove(log_file);
+
+    const int ENTRY_COUNT = 2000;
+    std::string padding(200, 'x');
+    {
+        auto writer = log_writer::create_from_async_file_path(log_file, true, true, true);
+        writer->console_threshold(category::no_log);
+        for(int i = 0; i < ENTRY_COUNT; i++)
+        {
+            auto entry = create_log_entry(category::information, "entry " + std::to_string(i) + " " + padding,
+                    "inglenook.logging.test");
+            writer->add_entry(entry);
+        }
+
+        // everything before the flush is in the file once it has passed (the footer is still to come).
+        BOOST_CHECK(writer->flush().get());
+        std::ifstream input(log_file.native());
+        std::stringstream content;
+        content << input.rdbuf();
+        BOOST_CHECK(content.str().size() > ENTRY_COUNT * padding.size());
+        BOOST_CHECK(content.str().find("entry " + std::to_string(ENTRY_COUNT - 1) + " ") != std::string::npos);
+        BOOST_CHECK(content.str().find("</inglenook-log-file>") == std::string::npos);
+        BOOST_CHECK(writer->flush(true).get());
+    }
+
+    std::ifstream input(log_file.native());
+    std::stringstream content;
+    content << input.rdbuf();
+    std::string xml = content.str();
+    std::string::size_type position = 0;
+    for(int i = 0; i < ENTRY_COUNT && position != std::string::npos; i++)
+    {
+        position = xml.find("<![CDATA[entry " + std::to_string(i) + " ", position);
+    }
+    BOOST_CHECK(position != std::string::npos);
+    BOOST_CHECK(xml.find("<?xml") == 0);
+    BOOST_CHECK(boost::regex_search(xml, boost::regex(
+            "<!\\[CDATA\\[entry 1999 x+\\]\\]></message></log-entry></log-entries></inglenook-log-file>$")));
+}
+
+//
+// log_writer_tests__statistics
+// checks the writer counts what it is doing, and can log its own statistics.
+BOOST_AUTO_TEST_CASE ( log_writer_tests__statistics )
+{
+    auto xml_stream = std::shared_ptr<std::stringstream>(new std::stringstream());
+    auto writer = log_writer::create_from_stream(xml_stream, false, false);
+    writer->console_threshold(category::no_log);
+    writer->xml_threshold(category::information);
+
+    // three entries to write, two to filter out and one to drop (it has no message).
+    for(int i = 0; i < 3; i++)
+    {
+        auto entry = create_log_entry(category::information, "statistics", "inglenook.logging.test");
+        BOOST_CHECK(writer->add_entry(entry));
+    }
+    for(int i = 0; i < 2; i++)
+    {
+        auto entry = create_log_entry(category::debugging, "statistics", "inglenook.logging.test");
+        BOOST_CHECK(writer->add_entry(entry));
+    }
+    auto empty_entry = create_log_entry(category::warning, "", "inglenook.logging.test");
+    BOOST_CHECK(!writer->add_entry(empty_entry));
+
+    // wait for the writer to catch up.
+    BOOST_CHECK(writer->flush().get());
+    auto statistics = writer->statistics();
+
+    BOOST_CHECK(statistics.enqueued[category::information] == 3);
+    BOOST_CHECK(statistics.written[category::information] == 3);
+    BOOST_CHECK(statistics.enqueued[category::debugging] == 2);
+    BOOST_CHECK(statistics.written[category::debugging] == 0);
+    BOOST_CHECK(statistics.dropped[category::warning] == 1);
+    BOOST_CHECK(statistics.queue_depth == 0);
+    BOOST_CHECK(statistics.queue_high_water >= 1);
+    BOOST_CHECK(statistics.bytes_written == xml_stream->str().length());
+    BOOST_CHECK(statistics.flushes >= 1);
+    BOOST_CHECK(statistics.syncs == 0);
+
+    std::uint64_t calls = 0;
+    for(std::size_t i = 0; i < LOG_STATISTICS_WAIT_BUCKETS; i++)
+    {
+        calls += statistics.enqueue_wait[i];
+    }
+    BOOST_CHECK(calls == 6);
+
+    // and have the writer log them (the first time on its next pass, which the flush waits for).
+    writer->statistics_interval(10);
+    BOOST_CHECK(writer->statistics_interval() == 10);
+    BOOST_CHECK(writer->flush().get());
+    writer.reset();
+    BOOST_CHECK(xml_stream->str().find(std::string("ns=\"") + log_writer::STATISTICS_NAMESPACE + "\"") != std::string::npos);
+    BOOST_CHECK(xml_stream->str().find("<item key=\"enqueued\"><![CDATA[5]]></item>") != std::string::npos);
+    BOOST_CHECK(xml_stream->str().find("<item key=\"syncs\"><![CDATA[0]]></item>") != std::string::npos);
+}
+
+//
+// log_writer_tests__namespace_statistics
+// checks the writer counts the entries logged under each namespace (including those below
+// the threshold, from several threads), and dumps the counts to the metrics file.
+BOOST_AUTO_TEST_CASE ( log_writer_tests__namespace_statistics )
+{
+    auto metrics_file = boost::filesystem::temp_directory_path() /
+            boost::filesystem::unique_path("ign-metrics-%%%%-%%%%") / "metrics.json";
+    BOOST_SCOPE_EXIT(&metrics_file)
+    {
+        boost::filesystem::remove_all(metrics_file.parent_path());
+    }
+    BOOST_SCOPE_EXIT_END
+
+    auto writer = log_writer::create_from_stream(std::shared_ptr<std::stringstream>(new std::stringstream()), false, false);
+    writer->console_threshold(category::no_log);
+    writer->xml_threshold(category::warning);
+    writer->default_namespace("inglenook.logging.default");
+
+    std::vector<boost::thread> threads;
+    for(int t = 0; t < 4; t++)
+    {
+        threads.push_back(boost::thread([&writer]()
+        {
+            for(int i = 0; i < 50; i++)
+            {
+                auto error = create_log_entry(category::error, "failed", "inglenook.zwave");
+                writer->add_entry(error);
+                auto debug = create_log_entry(category::debugging, "polled", "inglenook.zwave");
+                writer->add_entry(debug);
+            }
+        }));
+    }
+    for(auto thread = threads.begin(); thread != threads.end(); thread++)
+    {
+        thread->join();
+    }
+    std::vector<std::shared_ptr<log_entry>> group;
+    group.push_back(create_log_entry(category::warning, "grouped", ""));
+    group.push_back(create_log_entry(category::warning, "grouped", "inglenook.logging.test"));
+    BOOST_CHECK(writer->add_entries(group));
+
+    BOOST_CHECK(writer->namespace_count("inglenook.zwave", category::error) == 200);
+    BOOST_CHECK(writer->namespace_count("inglenook.zwave", category::debugging) == 200);
+    BOOST_CHECK(writer->namespace_count("inglenook.zwave", category::warning) == 0);
+    BOOST_CHECK(writer->namespace_count("inglenook.logging.default", category::warning) == 1);
+    BOOST_CHECK(writer->namespace_count("inglenook.logging.test", category::warning) == 1);
+    BOOST_CHECK(writer->namespace_count("inglenook.missing", category::error) == 0);
+
+    auto snapshot = writer->namespace_statistics();
+    BOOST_CHECK(snapshot.size() == 3);
+    for(auto counters = snapshot.begin(); counters != snapshot.end(); counters++)
+    {
+        if(counters->log_namespace == "inglenook.zwave")
+        {
+            BOOST_CHECK(counters->logged[category::error] == 200 && counters->logged[category::information] == 0);
+        }
+    }
+
+    // and dump them to the metrics file.
+    BOOST_CHECK(writer->metrics_file().filename() == writer->process_name() + "." + std::to_string(writer->pid()) + ".json");
+    writer->metrics_file(metrics_file);
+    BOOST_CHECK(writer->metrics_file() == metrics_file);
+    writer->metrics_interval(10);
+    BOOST_CHECK(writer->metrics_interval() == 10);
+    writer.reset();
+
+    std::ifstream metrics(metrics_file.native().c_str());
+    std::string dumped((std::istreambuf_iterator<char>(metrics)), std::istreambuf_iterator<char>());
+    BOOST_CHECK(dumped.find("\"namespaces\":{") != std::string::npos);
+    BOOST_CHECK(dumped.find("\"inglenook.zwave\":{\"unspecified\":0,\"debugging\":200,\"verbose\":0,\"information\":0,"
+            "\"warning\":0,\"error\":200,\"fatal\":0}") != std::string::npos);
+    BOOST_CHECK(!boost::filesystem::exists(metrics_file.native() + ".tmp"));
+}
+
+//
+// log_writer_tests__flush
+// checks flush() completes once the entries scheduled before it have been written (synced
+// to the log file if asked), including an entry held back for coalescing, and that entries
+// can be added with a future of their own.
+BOOST_AUTO_TEST_CASE ( log_writer_tests__flush )
+{
+    auto log_file = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("ign-flush-%%%%-%%%%.xml");
+    BOOST_SCOPE_EXIT( (&log_file) )
+    {
+        boost::filesystem::remove(log_file);
+    } BOOST_SCOPE_EXIT_END
+
+    auto read_log = [&log_file]()
+    {
+        std::ifstream input(log_file.native());
+        std::stringstream content;
+        content << input.rdbuf();
+        return content.str();
+    };
+
+    auto writer = log_writer::create_from_file_path(log_file, true, true, true);
+    writer->console_threshold(category::no_log);
+    for(int i = 0; i < 50; i++)
+    {
+        auto entry = create_log_entry(category::information, "flushed " + std::to_string(i), "inglenook.logging.test");
+        BOOST_CHECK(writer->add_entry(entry));
+    }
+    BOOST_CHECK(writer->flush(true).get());
+    BOOST_CHECK(read_log().find("flushed 49") != std::string::npos);
+
+    // an entry held back for coalescing is written straight away.
+    writer->coalesce_window(60000);
+    auto held_entry = create_log_entry(category::information, "held", "inglenook.logging.test");
+    BOOST_CHECK(writer->add_entry(held_entry));
+    BOOST_CHECK(writer->flush().get());
+    BOOST_CHECK(read_log().find("held") != std::string::npos);
+    writer->coalesce_window(0);
+
+    // entries can carry a future of their own.
+    std::future<bool> written;
+    auto critical_entry = create_log_entry(category::error, "critical", "inglenook.logging.test");
+    BOOST_CHECK(writer->add_entry(critical_entry, written, true));
+    BOOST_CHECK(written.get());
+    BOOST_CHECK(read_log().find("critical") != std::string::npos);
+
+    auto empty_entry = create_log_entry(category::error, "", "inglenook.logging.test");
+    BOOST_CHECK(!writer->add_entry(empty_entry, written));
+    BOOST_CHECK(!written.get());
+
+    // with nothing scheduled, a flush completes on the serializer's next pass.
+    BOOST_CHECK(writer->flush().wait_for(std::chrono::seconds(5)) == std::future_status::ready);
+}
+
+//
+// log_writer_tests__coalesce
+// checks identical entries logged by the same thread within the coalescing window are written
+// once, carrying the number of times they were logged and when the first and last were.
+BOOST_AUTO_TEST_CASE ( log_writer_tests__coalesce )
+{
+    auto xml_stream = std::shared_ptr<std::stringstream>(new std::stringstream());
+    {
+        auto writer = log_writer::create_from_stream(xml_stream, false, false);
+        writer->console_threshold(category::no_log);
+        BOOST_CHECK(writer->coalesce_window() == 0);
+        writer->coalesce_window(60000);
+        BOOST_CHECK(writer->coalesce_window() == 60000);
+
+        // repeats from this thread, then the same entry from another thread (which isn't a repeat).
+        for(int i = 0; i < 5; i++)
+        {
+            auto entry = create_log_entry(category::information, "polling", "inglenook.logging.test");
+            BOOST_CHECK(writer->add_entry(entry));
+        }
+        boost::thread other_thread([&writer]()
+        {
+            auto entry = create_log_entry(category::information, "polling", "inglenook.logging.test");
+            writer->add_entry(entry);
+        });
+        other_thread.join();
+
+        // a different message, then a different category, then repeats left to be written on shutdown.
+        auto done_entry = create_log_entry(category::information, "done", "inglenook.logging.test");
+        BOOST_CHECK(writer->add_entry(done_entry));
+        auto warning_entry = create_log_entry(category::warning, "done", "inglenook.logging.test");
+        BOOST_CHECK(writer->add_entry(warning_entry));
+        for(int i = 0; i < 3; i++)
+        {
+            auto entry = create_log_entry(category::information, "again", "inglenook.logging.test");
+            BOOST_CHECK(writer->add_entry(entry));
+        }
+
+        // entries outside the window aren't repeats.
+        writer->coalesce_window(20);
+        for(int i = 0; i < 2; i++)
+        {
+            auto entry = create_log_entry(category::information, "tick", "inglenook.logging.test");
+            BOOST_CHECK(writer->add_entry(entry));
+            boost::this_thread::sleep(boost::posix_time::milliseconds(100));
+        }
+
+        auto statistics = writer->statistics();
+        BOOST_CHECK(statistics.coalesced[category::information] == 6);
+        BOOST_CHECK(statistics.coalesced[category::warning] == 0);
+    }
+
+    log_file_reader reader(xml_stream);
+    std::vector<std::string> messages, repeats;
+    for(auto entry = reader.next_entry(); entry != nullptr; entry = reader.next_entry())
+    {
+        messages.push_back(entry->message());
+        auto repeated = entry->extended_data().find(log_writer::REPEATED_KEY);
+        repeats.push_back(repeated == entry->extended_data().end() ? "" : repeated->second);
+        if(repeated != entry->extended_data().end())
+        {
+            auto first = entry->extended_data().find(log_writer::REPEATED_FIRST_KEY);
+            auto last = entry->extended_data().find(log_writer::REPEATED_LAST_KEY);
+            BOOST_REQUIRE(first != entry->extended_data().end() && last != entry->extended_data().end());
+            BOOST_CHECK(first->second <= last->second);
+        }
+    }
+
+    const std::vector<std::string> expected_messages = { "polling", "polling", "done", "done", "again", "tick", "tick" };
+    const std::vector<std::string> expected_repeats = { "5", "", "", "", "3", "", "" };
+    BOOST_CHECK(messages == expected_messages);
+    BOOST_CHECK(repeats == expected_repeats);
+}
+
+//
+// log_writer_tests__coalesce_payload
+// checks entries with the same message are only repeats if what they carry matches too: typed
+// data (as kv() adds), text data and the call site; entries with attachments are never held.
+BOOST_AUTO_TEST_CASE ( log_writer_tests__coalesce_payload )
+{
+    const unsigned char frame[] = { 0x01, 0x02 };
+    const log_source_location* site = log_source_location::intern("zwave/driver.cpp", 42, "poll");
+    auto xml_stream = std::shared_ptr<std::stringstream>(new std::stringstream());
+    {
+        auto writer = log_writer::create_from_stream(xml_stream, false, false);
+        writer->console_threshold(category::no_log);
+        writer->coalesce_window(60000);
+
+        std::vector<std::shared_ptr<log_entry>> entries;
+        for(int i = 0; i < 9; i++)
+        {
+            entries.push_back(create_log_entry(category::warning, "reading", "inglenook.logging.test"));
+        }
+        entries[0]->field("value", 12);
+        entries[1]->field("value", 12);
+        entries[2]->field("value", 13);
+        entries[3]->extended_data("unit", "C");
+        entries[4]->extended_data("unit", "F");
+        entries[5]->source(site);
+        entries[6]->source(site);
+        entries[7]->attachment(log_attachment("frame", frame, sizeof(frame)));
+        entries[8]->attachment(log_attachment("frame", frame, sizeof(frame)));
+        for(auto entry = entries.begin(); entry != entries.end(); entry++)
+        {
+            BOOST_CHECK(writer->add_entry(*entry));
+        }
+        BOOST_CHECK(writer->flush().get());
+        BOOST_CHECK(writer->statistics().coalesced[category::warning] == 2);
+    }
+
+    log_file_reader reader(xml_stream);
+    std::vector<std::string> repeats;
+    for(auto entry = reader.next_entry(); entry != nullptr; entry = reader.next_entry())
+    {
+        auto repeated = entry->extended_data().find(log_writer::REPEATED_KEY);
+        repeats.push_back(repeated == entry->extended_data().end() ? "" : repeated->second);
+    }
+
+    const std::vector<std::string> expected_repeats = { "2", "", "", "", "2", "", "" };
+    BOOST_CHECK(repeats == expected_repeats);
+}
+
 } // namespace inglenook::logging
 
 } // namespace inglenook
@@ -21,6 +21,7 @@
 
 // inglenook includes
 #include "logging.h"
+#include "log_crash_handler.h"
 
 namespace inglenook
 {
@@ -31,24 +32,40 @@ namespace logging
 /**
  * Initializes the logging system using default parameters
  * This is the easiest way to get logging initialized; it will create a writer that will output
- * to both console, and a new log file - the path of which is determined by log_writer::default_log_path()
+ * to both console, and a new log file - the path of which is determined by log_writer::default_log_path().
+ * If the logging service daemon (ign_logd) is running, the log file is written by the daemon instead.
  */
 void initialize_logging()
 {
+    // the crash handler must not outlive the writer it was installed for.
+    log_crash_handler::uninstall();
+
     // initialize logging functionality
-    initialize_logging(log_writer::default_log_path());
+    log_output = log_writer::create_from_service();
+    ilog = std::shared_ptr<log_client>(new log_client(log_output));
 }
 
 /**
  * Initializes the logging system using a specific file path
- * Initializes logging, emmiting log entries to the specified log file.
+ * Initializes logging, emmiting log entries to the specified log file. When requested, the crash handler is
+ * installed so entries that are still queued when the process is fatally terminated are not lost (see log_crash_handler).
  * @param log_file path to the file in which to store logs. Will be created if does not exist.
+ * @param crash_handler indicates if the crash handler should be installed. Defaults to false.
  */
-void initialize_logging(const boost::filesystem::path& log_file)
+void initialize_logging(const boost::filesystem::path& log_file, const bool& crash_handler)
 {
+    // the crash handler must not outlive the writer it was installed for.
+    log_crash_handler::uninstall();
+
     // create global variables and output appropriately.
     log_output = log_writer::create_from_file_path( log_file );
     ilog = std::shared_ptr<log_client>(new log_client(log_output));
+
+    // protect the new writer if asked to.
+    if(crash_handler)
+    {
+        log_crash_handler::install(log_output);
+    }
 }
 
 /**
@@ -57,6 +74,9 @@ void initialize_logging(const boost::filesystem::path& log_file)
  */
 void initialize_logging_off_record()
 {
+    // the crash handler must not outlive the writer it was installed for.
+    log_crash_handler::uninstall();
+
     // create global variables and output appropriately.
     log_output = log_writer::create_from_stream( nullptr );
     ilog = std::shared_ptr<log_client>(new log_client(log_output));
@@ -24,6 +24,8 @@
 #include "log_writer.h"
 #include "log_client.h"
 #include "log_entry_modifiers.h"
+#include "log_source.h"
+#include "log_span.h"
 
 // the following precompiler is designed such that the SHARED definition
 // declarations the appropriate export or import keywords relative the
@@ -46,6 +48,15 @@
     #endif
 #endif
 
+// the following start an entry of each category, recording the call site it is logged from (see LOG_HERE):
+//     LOG_WARNING << ns("zwave") << "checksum mismatch" << lf::end;
+#define LOG_DEBUG   (::inglenook::logging::log_debug() << LOG_HERE)
+#define LOG_TRACE   (::inglenook::logging::log_trace() << LOG_HERE)
+#define LOG_INFO    (::inglenook::logging::log_info() << LOG_HERE)
+#define LOG_WARNING (::inglenook::logging::log_warning() << LOG_HERE)
+#define LOG_ERROR   (::inglenook::logging::log_error() << LOG_HERE)
+#define LOG_FATAL   (::inglenook::logging::log_fatal() << LOG_HERE)
+
 namespace inglenook
 {
 
@@ -55,8 +66,8 @@ namespace inglenook
         // initializes the logging system
         void initialize_logging();
 
-        // initializes the logging system with a define file path
-        void initialize_logging(const boost::filesystem::path& log_file);
+        // initializes the logging system with a define file path (optionally installing the crash handler).
+        void initialize_logging(const boost::filesystem::path& log_file, const bool& crash_handler = false);
 
         /// creates an "off-the-record" logger (console only).
         void initialize_logging_off_record();
@@ -85,6 +96,55 @@ namespace inglenook
         /// Continues an existing log entry, switching context to fatal.
         log_client& log_fatal();
 
+        /// Continues an existing log entry, with a message formatted from a format string (see FMT()).
+        template <typename format_type, typename... argument_types>
+        log_client& log(const format_type& format_string, const argument_types&... arguments)
+        {
+            return log().format(format_string, arguments...);
+        }
+
+        /// Continues an existing log entry, switching context to debug, with a message formatted from a format string (see FMT()).
+        template <typename format_type, typename... argument_types>
+        log_client& log_debug(const format_type& format_string, const argument_types&... arguments)
+        {
+            return log_debug().format(format_string, arguments...);
+        }
+
+        /// Continues an existing log entry, switching context to trace, with a message formatted from a format string (see FMT()).
+        template <typename format_type, typename... argument_types>
+        log_client& log_trace(const format_type& format_string, const argument_types&... arguments)
+        {
+            return log_trace().format(format_string, arguments...);
+        }
+
+        /// Continues an existing log entry, switching context to info, with a message formatted from a format string (see FMT()).
+        template <typename format_type, typename... argument_types>
+        log_client& log_info(const format_type& format_string, const argument_types&... arguments)
+        {
+            return log_info().format(format_string, arguments...);
+        }
+
+        /// Continues an existing log entry, switching context to warning, with a message formatted from a format string (see FMT()).
+        template <typename format_type, typename... argument_types>
+        log_client& log_warning(const format_type& format_string, const argument_types&... arguments)
+        {
+            return log_warning().format(format_string, arguments...);
+        }
+
+        /// Continues an existing log entry, switching context to error, with a message formatted from a format string (see FMT()).
+        template <typename format_type, typename... argument_types>
+        log_client& log_error(const format_type& format_string, const argument_types&... arguments)
+        {
+            return log_error().format(format_string, arguments...);
+        }
+
+        /// Continues an existing log entry, switching context to fatal, with a message formatted from a format string (see FMT()).
+        template <typename format_type, typename... argument_types>
+        log_client& log_fatal(const format_type& format_string, const argument_types&... arguments)
+        {
+            return log_fatal().format(format_string, arguments...);
+        }
+
         /// log output interface - default serialization object.
         SHARED std::shared_ptr<log_writer> log_output;
 
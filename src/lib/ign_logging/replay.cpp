@@ -0,0 +1,560 @@
+/*
+ * replay.cpp: Replays log files, and generates synthetic workloads, through a log_writer for capacity planning.
+ * Copyright (C) 2012, Project Inglenook (http://www.project-inglenook.co.uk)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * usage: ign_logging_replay replay <log file> [options]
+ *        ign_logging_replay generate <profile> [options]
+ *        ign_logging_replay profile <log file>
+ *
+ * replay    reads the entries of a log file and passes them to a log_writer, at the times they were originally
+ *           logged (--speed scales this up, --flat-out ignores it). Entries are stamped with the time they are
+ *           replayed. Files only record whole seconds unless entries were stamped by their client, in which case
+ *           the entries logged within a second are replayed back to back.
+ * generate  passes synthetic entries to a log_writer, as described by a workload profile, from one or more
+ *           threads at the profile's rate (--rate overrides it, 0 is flat out).
+ * profile   describes the workload in a log file as a profile (written to standard out), ready to generate more
+ *           of the same, or to edit in to the workload expected.
+ *
+ * A profile is an XML file; every section is optional, and weights are relative:
+ *   <workload-profile>
+ *     <rate>250</rate>                                   entries per second (0 for as fast as possible)
+ *     <message-sizes>                                    message length, uniform in (bytes / 2, bytes]
+ *       <size><bytes>128</bytes><weight>9</weight></size>
+ *       <size><bytes>4096</bytes><weight>1</weight></size>
+ *     </message-sizes>
+ *     <namespaces>
+ *       <namespace><name>inglenook.example</name><weight>1</weight></namespace>
+ *     </namespaces>
+ *     <categories>                                       severity as written in log files (1 - 6)
+ *       <category><severity>3</severity><weight>1</weight></category>
+ *     </categories>
+ *     <extended-data>
+ *       <value-bytes>16</value-bytes>                    length of each value
+ *       <items><count>0</count><weight>1</weight></items>
+ *     </extended-data>
+ *   </workload-profile>
+ *
+ * Once every entry has been written, how the writer coped is printed to standard out as JSON (the queue capacity
+ * and output can be varied to see the effect; see --queue, --output and --null).
+ */
+
+// inglenook includes
+#include "logging.h"
+#include "log_file_reader.h"
+#include "log_exceptions.h"
+
+// standard library includes
+#include <iostream>
+#include <sstream>
+#include <cstdlib>
+#include <cstdint>
+#include <vector>
+#include <string>
+#include <map>
+#include <random>
+#include <algorithm>
+
+// boost (http://boost.org) includes
+#include <boost/filesystem.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/program_options.hpp>
+#include <boost/property_tree/ptree.hpp>
+#include <boost/property_tree/xml_parser.hpp>
+
+//--------------------------------------------------------//
+// Hide the implementation in the anonymous namespace.
+namespace
+{
+
+    /// namespace used by generated entries when the profile doesn't list any.
+    const std::string DEFAULT_NAMESPACE = "inglenook.logging.replay";
+
+    /**
+     * Stream buffer that discards everything written to it (see --null).
+     */
+    class null_buffer : public std::streambuf
+    {
+        protected:
+
+            virtual std::streamsize xsputn(const char_type*, std::streamsize count) { return count; }
+
+            virtual int_type overflow(int_type character) { return traits_type::not_eof(character); }
+    };
+
+    /// a weighted choice of values.
+    template <typename T> struct weighted
+    {
+        std::vector<T> values;
+        std::vector<double> weights;
+        std::discrete_distribution<std::size_t> choice;
+
+        /// adds a value to choose from.
+        void add(const T& value, const double& weight)
+        {
+            values.push_back(value);
+            weights.push_back(weight);
+            choice = std::discrete_distribution<std::size_t>(weights.begin(), weights.end());
+        }
+
+        /// picks a value (or default_value if there is nothing to pick from).
+        T pick(std::mt19937& random, const T& default_value)
+        {
+            return values.empty() ? default_value : values[choice(random)];
+        }
+    };
+
+    /// description of a workload (see the usage above).
+    struct workload_profile
+    {
+        double rate;
+        weighted<std::size_t> message_sizes;
+        weighted<std::string> namespaces;
+        weighted<unsigned int> categories;
+        weighted<std::size_t> extended_items;
+        std::size_t value_bytes;
+    };
+
+    /**
+     * Waits until a point in time.
+     * @param until monotonic time to wait until (nanoseconds).
+     * @returns how late we already were (nanoseconds, 0 if we had to wait).
+     */
+    std::int64_t wait_until(const std::int64_t& until)
+    {
+        std::int64_t now = inglenook::logging::log_tracer::now();
+        if(now >= until)
+        {
+            return now - until;
+        }
+        boost::this_thread::sleep(boost::posix_time::microseconds((until - now) / 1000));
+        return 0;
+    }
+
+    /**
+     * Totals a per category statistic.
+     * @param counters per category counters.
+     * @returns total across every category.
+     */
+    std::uint64_t total(const std::uint64_t (&counters)[inglenook::logging::LOG_STATISTICS_CATEGORIES])
+    {
+        std::uint64_t result = 0;
+        for(std::size_t i = 0; i < inglenook::logging::LOG_STATISTICS_CATEGORIES; i++)
+        {
+            result += counters[i];
+        }
+        return result;
+    }
+
+    /**
+     * Reads a weighted list from a profile.
+     * @param profile profile to read.
+     * @param list path of the list.
+     * @param item name of each item of the list.
+     * @param value path of the value in each item of the list.
+     * @param result [output] list read.
+     */
+    template <typename T> void read_weighted(const boost::property_tree::ptree& profile, const std::string& list,
+            const std::string& item_name, const std::string& value, weighted<T>& result)
+    {
+        auto items = profile.get_child_optional(list);
+        if(!items)
+        {
+            return;
+        }
+        for(auto item = items->begin(); item != items->end(); item++)
+        {
+            double weight = item->second.get<double>("weight", 1.0);
+            if(item->first == item_name && weight > 0)
+            {
+                result.add(item->second.get<T>(value), weight);
+            }
+        }
+    }
+
+    /**
+     * Reads a workload profile.
+     * @param profile_file profile to read.
+     * @returns the profile.
+     */
+    workload_profile read_profile(const boost::filesystem::path& profile_file)
+    {
+        boost::property_tree::ptree tree;
+        boost::property_tree::read_xml(profile_file.string(), tree, boost::property_tree::xml_parser::trim_whitespace);
+        auto& profile = tree.get_child("workload-profile");
+
+        workload_profile result;
+        result.rate = profile.get<double>("rate", 0);
+        result.value_bytes = profile.get<std::size_t>("extended-data.value-bytes", 16);
+        read_weighted(profile, "message-sizes", "size", "bytes", result.message_sizes);
+        read_weighted(profile, "namespaces", "namespace", "name", result.namespaces);
+        read_weighted(profile, "categories", "category", "severity", result.categories);
+        read_weighted(profile, "extended-data", "items", "count", result.extended_items);
+        return result;
+    }
+
+    /**
+     * Writes a weighted list to a profile.
+     * @param profile profile to write to.
+     * @param list path of the list.
+     * @param item name of each item of the list.
+     * @param value name of the value in each item.
+     * @param counts number of times each value was seen.
+     */
+    template <typename T> void write_weighted(boost::property_tree::ptree& profile, const std::string& list,
+            const std::string& item, const std::string& value, const std::map<T, std::uint64_t>& counts)
+    {
+        auto& items = profile.put_child(list, boost::property_tree::ptree());
+        for(auto count = counts.begin(); count != counts.end(); count++)
+        {
+            auto& added = items.add(item, "");
+            added.put(value, count->first);
+            added.put("weight", count->second);
+        }
+    }
+
+    /**
+     * Describes the workload in a log file as a profile.
+     * @param log_file log file to describe.
+     * @param output stream to write the profile to.
+     * @returns EXIT_SUCCESS, or EXIT_FAILURE if the file holds no entries.
+     */
+    int profile(const boost::filesystem::path& log_file, std::ostream& output)
+    {
+        auto reader = inglenook::logging::log_file_reader::create_from_file_path(log_file);
+
+        std::map<std::size_t, std::uint64_t> message_sizes, extended_items;
+        std::map<std::string, std::uint64_t> namespaces;
+        std::map<unsigned int, std::uint64_t> categories;
+        std::uint64_t entries = 0, value_bytes = 0, values = 0;
+        boost::posix_time::ptime first, last;
+
+        for(auto entry = reader->next_entry(); entry != nullptr; entry = reader->next_entry())
+        {
+            // message sizes are bucketed by the next power of two.
+            std::size_t bucket = 16;
+            while(bucket < entry->message().length())
+            {
+                bucket *= 2;
+            }
+            message_sizes[bucket]++;
+            namespaces[entry->log_namespace()]++;
+            categories[entry->entry_type()]++;
+
+            auto& extended_data = entry->extended_data();
+            extended_items[extended_data.size()]++;
+            for(auto data = extended_data.begin(); data != extended_data.end(); data++)
+            {
+                value_bytes += data->second.length();
+                values++;
+            }
+
+            first = entries == 0 ? entry->timestamp() : std::min(first, entry->timestamp());
+            last = entries == 0 ? entry->timestamp() : std::max(last, entry->timestamp());
+            entries++;
+        }
+        if(entries == 0)
+        {
+            std::cerr << "no entries found in " << log_file << std::endl;
+            return EXIT_FAILURE;
+        }
+
+        boost::property_tree::ptree tree;
+        auto& profile = tree.put_child("workload-profile", boost::property_tree::ptree());
+        double seconds = (last - first).total_microseconds() / 1000000.0;
+        profile.put("rate", seconds > 0 ? static_cast<std::uint64_t>(entries / seconds) : 0);
+        write_weighted(profile, "message-sizes", "size", "bytes", message_sizes);
+        write_weighted(profile, "namespaces", "namespace", "name", namespaces);
+        write_weighted(profile, "categories", "category", "severity", categories);
+        write_weighted(profile, "extended-data", "items", "count", extended_items);
+        profile.put("extended-data.value-bytes", values > 0 ? value_bytes / values : 16);
+
+        boost::property_tree::write_xml(output, tree, boost::property_tree::xml_writer_make_settings<std::string>(' ', 2));
+        return EXIT_SUCCESS;
+    }
+
+    /// how a run went.
+    struct run_result
+    {
+        std::uint64_t entries;
+        std::uint64_t refused;
+        std::int64_t started;
+        std::int64_t finished;
+        std::int64_t lag_max;   // nanoseconds
+    };
+
+    /**
+     * Replays the entries in a log file.
+     * @param writer writer to replay the entries through.
+     * @param log_file log file to replay.
+     * @param speed how many times faster than real time to replay the entries (0 for as fast as possible).
+     * @param result [output] how the run went.
+     */
+    void replay(std::shared_ptr<inglenook::logging::log_writer> writer, const boost::filesystem::path& log_file,
+            const double& speed, run_result& result)
+    {
+        auto reader = inglenook::logging::log_file_reader::create_from_file_path(log_file);
+        boost::posix_time::ptime first;
+
+        result.started = inglenook::logging::log_tracer::now();
+        for(auto entry = reader->next_entry(); entry != nullptr; entry = reader->next_entry())
+        {
+            if(first.is_not_a_date_time())
+            {
+                first = entry->timestamp();
+            }
+            if(speed > 0)
+            {
+                // (entries out of order across processes are sent straight away.)
+                auto offset = std::max<std::int64_t>(0, (entry->timestamp() - first).total_microseconds());
+                result.lag_max = std::max(result.lag_max, wait_until(result.started + static_cast<std::int64_t>(offset * 1000 / speed)));
+            }
+
+            entry->timestamp(boost::posix_time::microsec_clock::universal_time());
+            if(!writer->add_entry(entry))
+            {
+                result.refused++;
+            }
+            result.entries++;
+        }
+
+        if(reader->malformed_entries() > 0)
+        {
+            std::cerr << reader->malformed_entries() << " entries in " << log_file << " could not be read" << std::endl;
+        }
+    }
+
+    /**
+     * Generates entries as described by a profile.
+     * @param writer writer to pass the entries to.
+     * @param profile workload to generate.
+     * @param entries number of entries to generate.
+     * @param rate entries per second (0 for as fast as possible).
+     * @param started when the run started (monotonic nanoseconds).
+     * @param seed seed for the random choices.
+     * @param result [output] how the thread got on (entries, refused and lag_max).
+     */
+    void generate(std::shared_ptr<inglenook::logging::log_writer> writer, const workload_profile* profile,
+            const std::uint64_t entries, const double rate, const std::int64_t started, const unsigned int seed,
+            run_result* result)
+    {
+        using namespace inglenook::logging;
+
+        // (each thread has its own copy, as picking changes the distributions.)
+        workload_profile workload = *profile;
+        std::mt19937 random(seed);
+        for(std::uint64_t i = 0; i < entries; i++)
+        {
+            if(rate > 0)
+            {
+                result->lag_max = std::max(result->lag_max, wait_until(started + static_cast<std::int64_t>(i * 1000000000.0 / rate)));
+            }
+
+            std::size_t size = workload.message_sizes.pick(random, 128);
+            size = std::uniform_int_distribution<std::size_t>(size / 2 + 1, std::max<std::size_t>(size, 1))(random);
+
+            auto entry = std::shared_ptr<log_entry>(new log_entry());
+            entry->entry_type(static_cast<category>(std::min<unsigned int>(workload.categories.pick(random, category::information), category::fatal)));
+            entry->log_namespace(workload.namespaces.pick(random, DEFAULT_NAMESPACE));
+            entry->message(std::string(size, 'x'));
+            std::size_t items = workload.extended_items.pick(random, 0);
+            for(std::size_t item = 0; item < items; item++)
+            {
+                entry->extended_data("replay.item." + std::to_string(item), std::string(workload.value_bytes, 'y'));
+            }
+            entry->timestamp(boost::posix_time::microsec_clock::universal_time());
+
+            if(!writer->add_entry(entry))
+            {
+                result->refused++;
+            }
+            result->entries++;
+        }
+    }
+
+}
+//--------------------------------------------------------//
+
+/**
+ * This is the main entry point of the ign_logging replay tool.
+ * @param argc number of command line arguments
+ * @param argv list of command line arguments
+ * @returns EXIT_SUCCESS on success, EXIT_FAILURE if the arguments were bad or any entries were dropped.
+ */
+int main(int argc, const char* argv[])
+{
+    using namespace inglenook::logging;
+    namespace po = boost::program_options;
+
+    po::options_description options("options");
+    options.add_options()
+        ("help,h", "show this help")
+        ("speed,s", po::value<double>()->default_value(1), "replay: times faster than real time to replay the entries")
+        ("flat-out,F", "replay: pass the entries to the writer as fast as possible")
+        ("entries,e", po::value<std::uint64_t>()->default_value(100000), "generate: number of entries to generate")
+        ("rate,r", po::value<double>(), "generate: entries per second, overriding the profile (0 for as fast as possible)")
+        ("threads,t", po::value<int>()->default_value(1), "generate: number of threads to generate entries from")
+        ("seed", po::value<unsigned int>()->default_value(1), "generate: seed for the random choices")
+        ("queue,q", po::value<std::size_t>(), "capacity of the writer's queue")
+        ("output,o", po::value<std::string>(), "log file to write (a temporary file by default)")
+        ("null,0", "discard the output instead of writing a log file");
+
+    po::options_description positional_options;
+    positional_options.add_options()
+        ("action", po::value<std::string>())
+        ("input", po::value<std::string>());
+    po::positional_options_description positions;
+    positions.add("action", 1).add("input", 1);
+
+    po::variables_map arguments;
+    try
+    {
+        po::options_description all_options;
+        all_options.add(options).add(positional_options);
+        po::store(po::command_line_parser(argc, argv).options(all_options).positional(positions).run(), arguments);
+        po::notify(arguments);
+    }
+    catch(po::error& ex)
+    {
+        std::cerr << ex.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::string action = arguments.count("action") ? arguments["action"].as<std::string>() : "";
+    if(arguments.count("help") || !arguments.count("input") ||
+       (action != "replay" && action != "generate" && action != "profile"))
+    {
+        std::cerr << "usage: ign_logging_replay replay <log file> [options]" << std::endl
+                  << "       ign_logging_replay generate <profile> [options]" << std::endl
+                  << "       ign_logging_replay profile <log file>" << std::endl << options;
+        return arguments.count("help") ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    boost::filesystem::path input = arguments["input"].as<std::string>();
+
+    try
+    {
+        if(action == "profile")
+        {
+            return profile(input, std::cout);
+        }
+
+        workload_profile generate_profile;
+        if(action == "generate")
+        {
+            generate_profile = read_profile(input);
+        }
+
+        // where the entries go.
+        boost::filesystem::path scratch;
+        null_buffer null_sink;
+        std::shared_ptr<log_writer> writer;
+        if(arguments.count("null"))
+        {
+            writer = log_writer::create_from_stream(std::shared_ptr<std::ostream>(new std::ostream(&null_sink)), false, false);
+        }
+        else if(arguments.count("output"))
+        {
+            writer = log_writer::create_from_file_path(arguments["output"].as<std::string>());
+        }
+        else
+        {
+            scratch = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("ign-logging-replay-%%%%-%%%%.xml");
+            writer = log_writer::create_from_file_path(scratch);
+        }
+        writer->console_threshold(category::no_log);
+        writer->xml_threshold(category::debugging);
+        if(arguments.count("queue") && !writer->queue_capacity(arguments["queue"].as<std::size_t>()))
+        {
+            std::cerr << "invalid queue capacity" << std::endl;
+            return EXIT_FAILURE;
+        }
+
+        run_result result = { 0, 0, 0, 0, 0 };
+        if(action == "replay")
+        {
+            replay(writer, input, arguments.count("flat-out") ? 0 : arguments["speed"].as<double>(), result);
+        }
+        else
+        {
+            const int threads = std::max(1, arguments["threads"].as<int>());
+            const std::uint64_t entries = arguments["entries"].as<std::uint64_t>();
+            const double rate = arguments.count("rate") ? arguments["rate"].as<double>() : generate_profile.rate;
+
+            std::vector<run_result> thread_results(threads, result);
+            std::vector<std::shared_ptr<boost::thread>> generating_threads;
+            result.started = inglenook::logging::log_tracer::now();
+            for(int i = 0; i < threads; i++)
+            {
+                generating_threads.push_back(std::shared_ptr<boost::thread>(new boost::thread(generate, writer,
+                        &generate_profile, entries / threads + (static_cast<std::uint64_t>(i) < entries % threads ? 1 : 0),
+                        rate / threads, result.started, arguments["seed"].as<unsigned int>() + i, &thread_results[i])));
+            }
+            for(int i = 0; i < threads; i++)
+            {
+                generating_threads[i]->join();
+                result.entries += thread_results[i].entries;
+                result.refused += thread_results[i].refused;
+                result.lag_max = std::max(result.lag_max, thread_results[i].lag_max);
+            }
+        }
+
+        // wait for the writer to finish (the last of the entries are flushed when it is destroyed).
+        auto statistics = writer->statistics();
+        while(total(statistics.written) + total(statistics.dropped) < result.entries)
+        {
+            boost::this_thread::sleep(boost::posix_time::milliseconds(1));
+            statistics = writer->statistics();
+        }
+        writer.reset();
+        result.finished = inglenook::logging::log_tracer::now();
+        if(!scratch.empty())
+        {
+            boost::filesystem::remove(scratch);
+        }
+
+        double seconds = std::max(1e-9, (result.finished - result.started) / 1000000000.0);
+        std::cout << "{\"action\": \"" << action << "\", \"entries\": " << result.entries
+                  << ", \"seconds\": " << seconds
+                  << ", \"entries_per_second\": " << static_cast<std::uint64_t>(result.entries / seconds)
+                  << ", \"bytes_per_second\": " << static_cast<std::uint64_t>(statistics.bytes_written / seconds)
+                  << ", \"dropped\": " << result.refused
+                  << ", \"schedule_lag_max_ms\": " << result.lag_max / 1000000
+                  << ", \"queue_high_water\": " << statistics.queue_high_water
+                  << ", \"flushes\": " << statistics.flushes
+                  << ", \"flush_time_max_us\": " << statistics.flush_time_max
+                  << ", \"spilled\": " << statistics.stalls.spilled_entries
+                  << ", \"enqueue_wait_us\": [";
+        for(std::size_t i = 0; i < LOG_STATISTICS_WAIT_BUCKETS; i++)
+        {
+            std::cout << (i > 0 ? ", " : "") << statistics.enqueue_wait[i];
+        }
+        std::cout << "]}" << std::endl;
+
+        return result.refused == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    catch(log_exception& ex)
+    {
+        auto file = boost::get_error_info<log_file_name>(ex);
+        std::cerr << "ign_logging_replay: failed to open " << (file != nullptr ? *file : input) << std::endl;
+        return EXIT_FAILURE;
+    }
+    catch(std::exception& ex)
+    {
+        std::cerr << "ign_logging_replay: " << ex.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+}
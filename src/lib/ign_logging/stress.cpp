@@ -0,0 +1,453 @@
+/*
+ * stress.cpp: Verifies log_writer is lossless and keeps each thread's entries in order under backpressure.
+ * Copyright (C) 2012, Project Inglenook (http://www.project-inglenook.co.uk)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * usage: ign_logging_stress [soak seconds]
+ * Producer threads tag every entry with their number and a sequence number ("stress <thread> <sequence>") and
+ * pass them straight to log_writer::add_entry(), remembering which entries were accepted. The writer is given a
+ * tiny queue and a slow output stream (which can also be stalled outright), then the XML it produced is parsed
+ * and checked against what the producers were told:
+ *  backpressure    the queue is always full; add_entry() has to wait, but nothing may be lost.
+ *  spill           the output stream stalls for longer than SINK_STALL_TIMEOUT; entries spill and are replayed,
+ *                  nothing may be lost.
+ *  drop            the output stream stalls for longer than add_entry() is prepared to wait and there is nowhere
+ *                  to spill; entries are dropped, but only those add_entry() refused.
+ * In every case each thread's accepted entries must be written exactly once and in the order they were added,
+ * the file must be well formed (header, entries, footer) and the writer's statistics must agree.
+ * With no arguments each scenario is run once (this is what the test suite does). Given a number of seconds, the
+ * scenarios are run repeatedly with randomised thread counts, queue sizes and delays until the time is up.
+ */
+
+// inglenook includes
+#include <ign_core/environment.h>
+#include <ign_core/environment_variables.h>
+#include "logging.h"
+
+// standard library includes
+#include <iostream>
+#include <sstream>
+#include <fstream>
+#include <cstdlib>
+#include <cstdint>
+#include <vector>
+#include <string>
+#include <random>
+
+// boost (http://boost.org) includes
+#include <boost/filesystem.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/regex.hpp>
+#include <boost/lexical_cast.hpp>
+
+//--------------------------------------------------------//
+// Hide the implementation in the anonymous namespace.
+namespace
+{
+
+    /// namespace stress entries are logged under.
+    const std::string STRESS_NAMESPACE = "inglenook.logging.stress";
+
+    /**
+     * Output stream buffer which takes a while over every write, and can be stalled outright (the slow sink).
+     */
+    class slow_buffer : public std::stringbuf
+    {
+        public:
+
+            /// @param write_delay time taken by each write (microseconds).
+            explicit slow_buffer(const int& write_delay) : m_write_delay(write_delay), m_stalled(false) {}
+
+            /// blocks writes until release() is called.
+            void stall()
+            {
+                boost::mutex::scoped_lock lock(m_mutex);
+                m_stalled = true;
+            }
+
+            /// lets blocked (and future) writes complete.
+            void release()
+            {
+                boost::mutex::scoped_lock lock(m_mutex);
+                m_stalled = false;
+                m_released.notify_all();
+            }
+
+            /// gets everything written so far.
+            std::string contents()
+            {
+                boost::mutex::scoped_lock lock(m_mutex);
+                return str();
+            }
+
+        protected:
+
+            virtual std::streamsize xsputn(const char_type* data, std::streamsize count)
+            {
+                boost::mutex::scoped_lock lock(m_mutex);
+                while(m_stalled)
+                {
+                    m_released.wait(lock);
+                }
+                if(m_write_delay > 0)
+                {
+                    boost::this_thread::sleep(boost::posix_time::microseconds(m_write_delay));
+                }
+                return std::stringbuf::xsputn(data, count);
+            }
+
+        private:
+
+            int m_write_delay;
+            bool m_stalled;
+            boost::mutex m_mutex;
+            boost::condition_variable m_released;
+    };
+
+    /// what to do to the writer during a run.
+    enum class scenario { backpressure, spill, drop };
+
+    /// settings for a single run.
+    struct run_settings
+    {
+        scenario kind;
+        int producers;
+        int entries;
+        std::size_t queue_capacity;
+        int write_delay;    // microseconds
+        int stall;          // milliseconds
+    };
+
+    /// what a producer was told by add_entry().
+    struct producer_result
+    {
+        std::vector<int> accepted;
+        int refused;
+    };
+
+    /**
+     * Gets the name of a scenario.
+     * @param kind scenario to name.
+     * @returns name of the scenario.
+     */
+    std::string scenario_name(const scenario& kind)
+    {
+        switch(kind)
+        {
+            case scenario::backpressure: return "backpressure";
+            case scenario::spill: return "spill";
+            default: return "drop";
+        }
+    }
+
+    /**
+     * Totals a per category statistic.
+     * @param counters per category counters.
+     * @returns total across every category.
+     */
+    std::uint64_t total(const std::uint64_t (&counters)[inglenook::logging::LOG_STATISTICS_CATEGORIES])
+    {
+        std::uint64_t result = 0;
+        for(std::size_t i = 0; i < inglenook::logging::LOG_STATISTICS_CATEGORIES; i++)
+        {
+            result += counters[i];
+        }
+        return result;
+    }
+
+    /**
+     * Adds numbered entries to a writer, recording which were accepted.
+     * @param writer writer to add the entries to.
+     * @param id number of this producer.
+     * @param entries number of entries to add.
+     * @param result [output] what add_entry() said about each entry.
+     */
+    void producer(std::shared_ptr<inglenook::logging::log_writer> writer, const int& id, const int& entries,
+            producer_result* result)
+    {
+        using namespace inglenook::logging;
+
+        result->refused = 0;
+        result->accepted.reserve(entries);
+        for(int sequence = 0; sequence < entries; sequence++)
+        {
+            auto entry = std::shared_ptr<log_entry>(new log_entry());
+            entry->entry_type(category::information);
+            entry->log_namespace(STRESS_NAMESPACE);
+            entry->message("stress " + std::to_string(id) + " " + std::to_string(sequence));
+            if(writer->add_entry(entry))
+            {
+                result->accepted.push_back(sequence);
+            }
+            else
+            {
+                result->refused++;
+            }
+        }
+    }
+
+    /**
+     * Checks the XML written during a run against what the producers were told.
+     * @param xml everything the writer wrote.
+     * @param results what each producer was told by add_entry().
+     * @param problems [output] description of anything wrong.
+     * @returns number of entries read.
+     */
+    std::size_t check_output(const std::string& xml, const std::vector<producer_result>& results, std::ostream& problems)
+    {
+        const boost::regex header("<\\?xml version=\"1\\.0\" encoding=\"UTF-8\"\\?><inglenook-log-file xmlns=\"[^\"]+\">"
+                "<process-id pid=\"[0-9]+\"><binary-name><!\\[CDATA\\[[^\\]]*\\]\\]></binary-name>"
+                "<binary-version><!\\[CDATA\\[[^\\]]*\\]\\]></binary-version>"
+                "<log-writer-version><!\\[CDATA\\[[^\\]]*\\]\\]></log-writer-version></process-id><log-entries>");
+        const boost::regex entry("<log-entry timestamp=\"[^\"]+\" severity=\"3\" ns=\"inglenook\\.logging\\.stress\">"
+                "<message><!\\[CDATA\\[stress ([0-9]+) ([0-9]+)\\]\\]></message></log-entry>");
+        const std::string footer = "</log-entries></inglenook-log-file>";
+
+        std::string::const_iterator position = xml.begin();
+        boost::match_results<std::string::const_iterator> items;
+        if(!boost::regex_search(position, xml.cend(), items, header, boost::match_continuous))
+        {
+            problems << "malformed header; ";
+            return 0;
+        }
+        position = items[0].second;
+
+        // each producer's entries must turn up in exactly the order they were accepted (so none lost or repeated).
+        std::vector<std::size_t> next(results.size(), 0);
+        std::size_t entries_read = 0;
+        while(boost::regex_search(position, xml.cend(), items, entry, boost::match_continuous))
+        {
+            std::size_t id = boost::lexical_cast<std::size_t>(items[1]);
+            int sequence = boost::lexical_cast<int>(items[2]);
+            if(id >= results.size())
+            {
+                problems << "unknown producer " << id << "; ";
+                return entries_read;
+            }
+            const auto& accepted = results[id].accepted;
+            if(next[id] >= accepted.size() || accepted[next[id]] != sequence)
+            {
+                problems << "producer " << id << " entry " << sequence << " out of place (expected "
+                         << (next[id] < accepted.size() ? std::to_string(accepted[next[id]]) : "nothing") << "); ";
+                return entries_read;
+            }
+            next[id]++;
+            entries_read++;
+            position = items[0].second;
+        }
+
+        for(std::size_t id = 0; id < results.size(); id++)
+        {
+            if(next[id] != results[id].accepted.size())
+            {
+                problems << "producer " << id << " lost " << results[id].accepted.size() - next[id] << " entries; ";
+            }
+        }
+
+        if(std::string(position, xml.cend()) != footer)
+        {
+            problems << "malformed footer or trailing output; ";
+        }
+        return entries_read;
+    }
+
+    /**
+     * Runs a single scenario and checks the outcome.
+     * @param settings what to run.
+     * @param scratch scratch directory for the run.
+     * @returns true if the writer behaved.
+     */
+    bool run(const run_settings& settings, const boost::filesystem::path& scratch)
+    {
+        using namespace inglenook::logging;
+        using namespace inglenook::core;
+
+        // entries spill beneath the temporary directory; make it impossible to create anything there when we
+        // want entries dropped.
+        boost::filesystem::remove_all(scratch);
+        boost::filesystem::create_directories(scratch);
+        if(settings.kind == scenario::drop)
+        {
+            std::ofstream((scratch / "not-a-directory").native()) << "";
+            environment::set(environment::variables::DIR_TMP, (scratch / "not-a-directory" / "tmp").native());
+        }
+        else
+        {
+            environment::set(environment::variables::DIR_TMP, (scratch / "tmp").native());
+        }
+
+        slow_buffer buffer(settings.write_delay);
+        auto writer = log_writer::create_from_stream(std::shared_ptr<std::ostream>(new std::ostream(&buffer)), true, true);
+        writer->console_threshold(category::no_log);
+        writer->queue_capacity(settings.queue_capacity);
+
+        if(settings.stall > 0)
+        {
+            buffer.stall();
+        }
+
+        std::vector<producer_result> results(settings.producers);
+        std::vector<std::shared_ptr<boost::thread>> producers;
+        for(int i = 0; i < settings.producers; i++)
+        {
+            producers.push_back(std::shared_ptr<boost::thread>(
+                    new boost::thread(producer, writer, i, settings.entries, &results[i])));
+        }
+
+        if(settings.stall > 0)
+        {
+            boost::this_thread::sleep(boost::posix_time::milliseconds(settings.stall));
+            buffer.release();
+        }
+        for(auto thread = producers.begin(); thread != producers.end(); thread++)
+        {
+            (*thread)->join();
+        }
+
+        std::uint64_t accepted = 0, refused = 0;
+        for(auto result = results.begin(); result != results.end(); result++)
+        {
+            accepted += result->accepted.size();
+            refused += result->refused;
+        }
+
+        // let the writer catch up before taking its statistics (the footer is written on destruction).
+        for(int i = 0; i < 6000 && total(writer->statistics().written) < accepted; i++)
+        {
+            boost::this_thread::sleep(boost::posix_time::milliseconds(10));
+        }
+        auto statistics = writer->statistics();
+        writer.reset();
+
+        std::ostringstream problems;
+        std::size_t written = check_output(buffer.contents(), results, problems);
+
+        if(total(statistics.enqueued) != accepted || total(statistics.written) != accepted)
+        {
+            problems << "statistics disagree (enqueued " << total(statistics.enqueued) << ", written "
+                     << total(statistics.written) << ", accepted " << accepted << "); ";
+        }
+        if(total(statistics.dropped) != refused)
+        {
+            problems << "statistics disagree (dropped " << total(statistics.dropped) << ", refused " << refused << "); ";
+        }
+
+        // what each scenario promises.
+        switch(settings.kind)
+        {
+            case scenario::backpressure:
+                if(refused > 0)
+                {
+                    problems << refused << " entries refused; ";
+                }
+                break;
+            case scenario::spill:
+                if(refused > 0)
+                {
+                    problems << refused << " entries refused; ";
+                }
+                if(statistics.stalls.spilled_entries == 0)
+                {
+                    problems << "nothing spilled; ";
+                }
+                break;
+            case scenario::drop:
+                if(refused == 0)
+                {
+                    problems << "nothing dropped; ";
+                }
+                if(statistics.stalls.spilled_entries > 0)
+                {
+                    problems << "entries spilled; ";
+                }
+                break;
+        }
+
+        std::string problem_text = problems.str();
+        std::cout << scenario_name(settings.kind) << ": " << settings.producers << " producers x " << settings.entries
+                  << " entries, queue " << settings.queue_capacity << ", write delay " << settings.write_delay
+                  << "us, stall " << settings.stall << "ms: " << written << " written, " << refused << " dropped, "
+                  << statistics.stalls.spilled_entries << " spilled, " << statistics.stalls.stalls << " stalls, high water " << statistics.queue_high_water
+                  << (problem_text.empty() ? " - ok" : " - FAILED: " + problem_text) << std::endl;
+        return problem_text.empty();
+    }
+
+}
+//--------------------------------------------------------//
+
+/**
+ * This is the main entry point of the ign_logging stress test.
+ * @param argc number of command line arguments
+ * @param argv list of command line arguments
+ * @returns EXIT_SUCCESS if the writer behaved in every run, EXIT_FAILURE otherwise.
+ */
+int main(int argc, const char* argv[])
+{
+    using namespace inglenook::core;
+
+    const int soak_seconds = argc > 1 ? std::atoi(argv[1]) : 0;
+    if(soak_seconds < 0)
+    {
+        std::cerr << "usage: ign_logging_stress [soak seconds]" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    auto scratch = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("ign-logging-stress-%%%%-%%%%");
+    auto previous_tmp = environment::get(environment::variables::DIR_TMP);
+    bool passed = true;
+
+    // each scenario once (this keeps the test suite quick, the drop scenario has to outlast add_entry()'s patience)...
+    const run_settings quick[] = {
+        { scenario::backpressure, 4, 500, 1, 50, 0 },
+        { scenario::backpressure, 8, 250, 4, 0, 0 },
+        { scenario::spill, 4, 500, 4, 0, 1500 },
+        { scenario::drop, 4, 50, 2, 0, 3500 }
+    };
+    for(auto settings = std::begin(quick); settings != std::end(quick); settings++)
+    {
+        passed = run(*settings, scratch) && passed;
+    }
+
+    // ... then, if asked to soak, mix things up until the time is up.
+    std::mt19937 random(std::random_device{}());
+    auto soak_end = boost::posix_time::microsec_clock::universal_time() + boost::posix_time::seconds(soak_seconds);
+    while(boost::posix_time::microsec_clock::universal_time() < soak_end)
+    {
+        run_settings settings;
+        settings.kind = static_cast<scenario>(std::uniform_int_distribution<int>(0, 2)(random));
+        settings.producers = std::uniform_int_distribution<int>(1, 16)(random);
+        settings.entries = std::uniform_int_distribution<int>(1, settings.kind == scenario::drop ? 100 : 2000)(random);
+        settings.queue_capacity = std::uniform_int_distribution<std::size_t>(1, 64)(random);
+        settings.write_delay = std::uniform_int_distribution<int>(0, 100)(random);
+        settings.stall = settings.kind == scenario::backpressure ? 0 :
+                settings.kind == scenario::spill ? std::uniform_int_distribution<int>(1000, 3000)(random) :
+                std::uniform_int_distribution<int>(3000, 5000)(random);
+
+        // the writer has to run out of room for there to be anything to spill or drop.
+        if(settings.kind != scenario::backpressure)
+        {
+            settings.entries = std::max<int>(settings.entries, settings.queue_capacity + 1);
+        }
+        passed = run(settings, scratch) && passed;
+    }
+
+    environment::set(environment::variables::DIR_TMP, previous_tmp);
+    boost::filesystem::remove_all(scratch);
+    return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,125 @@
+/*
+ * trace.cpp: Converts and summarizes the traces (spans and counters) recorded in log files.
+ * Copyright (C) 2012, Project Inglenook (http://www.project-inglenook.co.uk)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * usage: ign_logging_trace chrome <log file> [options]
+ *        ign_logging_trace summary <log file>
+ *
+ * chrome   converts the traces in a log file (recorded with IGN_SPAN and IGN_COUNTER, see log_span.h) to Chrome's
+ *          trace event format, ready to load in to Perfetto (ui.perfetto.dev) or chrome://tracing. The JSON is
+ *          written to standard out, or the file given with --output.
+ * summary  prints the number of times each span was recorded, its percentiles and a histogram of the time it took,
+ *          along with the range of each counter.
+ */
+
+// inglenook includes
+#include "log_span.h"
+#include "log_file_reader.h"
+#include "log_exceptions.h"
+
+// standard library includes
+#include <iostream>
+#include <fstream>
+#include <cstdlib>
+#include <string>
+
+// boost (http://boost.org) includes
+#include <boost/filesystem.hpp>
+#include <boost/program_options.hpp>
+
+int main(int argc, const char* argv[])
+{
+    using namespace inglenook::logging;
+    namespace po = boost::program_options;
+
+    po::options_description options("options");
+    options.add_options()
+        ("help,h", "show this help")
+        ("output,o", po::value<std::string>(), "chrome: file to write the JSON to (standard out by default)");
+
+    po::options_description positional_options;
+    positional_options.add_options()
+        ("action", po::value<std::string>())
+        ("input", po::value<std::string>());
+    po::positional_options_description positions;
+    positions.add("action", 1).add("input", 1);
+
+    po::variables_map arguments;
+    try
+    {
+        po::options_description all_options;
+        all_options.add(options).add(positional_options);
+        po::store(po::command_line_parser(argc, argv).options(all_options).positional(positions).run(), arguments);
+        po::notify(arguments);
+    }
+    catch(po::error& ex)
+    {
+        std::cerr << ex.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::string action = arguments.count("action") ? arguments["action"].as<std::string>() : "";
+    if(arguments.count("help") || !arguments.count("input") || (action != "chrome" && action != "summary"))
+    {
+        std::cerr << "usage: ign_logging_trace chrome <log file> [options]" << std::endl
+                  << "       ign_logging_trace summary <log file>" << std::endl << options;
+        return arguments.count("help") ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    boost::filesystem::path input = arguments["input"].as<std::string>();
+
+    try
+    {
+        auto reader = log_file_reader::create_from_file_path(input);
+        std::size_t events;
+        if(action == "summary")
+        {
+            events = log_tracer::write_summary(*reader, std::cout);
+        }
+        else if(arguments.count("output"))
+        {
+            std::ofstream output(arguments["output"].as<std::string>().c_str());
+            if(!output)
+            {
+                std::cerr << "ign_logging_trace: failed to create " << arguments["output"].as<std::string>() << std::endl;
+                return EXIT_FAILURE;
+            }
+            events = log_tracer::write_chrome_trace(*reader, output);
+        }
+        else
+        {
+            events = log_tracer::write_chrome_trace(*reader, std::cout);
+        }
+
+        if(events == 0)
+        {
+            std::cerr << "ign_logging_trace: no traces found in " << input.string() << std::endl;
+        }
+        return EXIT_SUCCESS;
+    }
+    catch(log_exception& ex)
+    {
+        auto file = boost::get_error_info<log_file_name>(ex);
+        std::cerr << "ign_logging_trace: failed to open " << (file != nullptr ? *file : input) << std::endl;
+        return EXIT_FAILURE;
+    }
+    catch(std::exception& ex)
+    {
+        std::cerr << "ign_logging_trace: " << ex.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+}
@@ -0,0 +1,150 @@
+/*
+ * bench.cpp: Measures ign_logd collection throughput with many concurrent socket clients.
+ * Copyright (C) 2012, Project Inglenook (http://www.project-inglenook.co.uk)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * usage: ign_logd_bench [clients] [entries per client]
+ * Forks the requested number of client processes (100 by default), each of which connects to an in-process
+ * collector over the socket and sends its entries as fast as the collector lets it. Logs are written to a
+ * scratch directory which is removed afterwards.
+ */
+
+// inglenook includes
+#include "log_collector.h"
+#include <ign_core/environment.h>
+#include <ign_core/environment_variables.h>
+
+// standard library includes
+#include <iostream>
+#include <cstdlib>
+#include <vector>
+
+// boost (http://boost.org) includes
+#include <boost/filesystem.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+
+// platform includes
+#include <unistd.h>
+#include <sys/wait.h>
+
+/**
+ * Sends entries to the collector as a client process would.
+ * @param entries number of entries to send.
+ * @returns number of times the collector told us to hold off (capped to fit an exit status).
+ */
+int run_client(const int& entries)
+{
+    using namespace inglenook::logging;
+
+    auto connection = log_socket::connect(getpid(), "ign_logd_bench");
+    int held_off = 0;
+    for(int i = 0; i < entries; i++)
+    {
+        log_entry entry;
+        entry.entry_type(category::information);
+        entry.log_namespace("inglenook.logd.bench");
+        entry.message("benchmark entry " + std::to_string(i));
+        while(!connection->send(entry))
+        {
+            held_off++;
+        }
+    }
+    connection->close_log();
+    return std::min(held_off, 255);
+}
+
+/**
+ * This is the main entry point of the ign_logd benchmark.
+ * @param argc number of command line arguments
+ * @param argv list of command line arguments
+ * @returns EXIT_SUCCESS on success, EXIT_FAILURE on failure.
+ */
+int main(int argc, const char* argv[])
+{
+    using namespace inglenook;
+
+    const int clients = argc > 1 ? std::atoi(argv[1]) : 100;
+    const int entries = argc > 2 ? std::atoi(argv[2]) : 1000;
+
+    // keep the benchmark's logs and rings out of the way.
+    auto scratch = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("ign-logd-bench-%%%%-%%%%");
+    boost::filesystem::create_directories(scratch / "log");
+    core::environment::set(core::environment::variables::DIR_TMP, (scratch / "tmp").native());
+    core::environment::set(core::environment::variables::DIR_LOG, (scratch / "log").native());
+
+    std::size_t collected = 0;
+    int held_off = 0;
+    int failed = 0;
+    auto started = boost::posix_time::microsec_clock::universal_time();
+    {
+        logging::log_collector collector;
+
+        // start the clients...
+        std::vector<pid_t> children;
+        for(int i = 0; i < clients; i++)
+        {
+            pid_t child = fork();
+            if(child == 0)
+            {
+                _exit(run_client(entries));
+            }
+            children.push_back(child);
+        }
+
+        // ... and collect until they have all finished and their logs are closed.
+        std::size_t running = children.size();
+        while(running > 0 || collector.connection_count() > 0 || collector.socket_log_count() > 0)
+        {
+            std::size_t collected_now = collector.collect();
+            collected += collected_now;
+
+            int status = 0;
+            pid_t finished;
+            while(running > 0 && (finished = waitpid(-1, &status, WNOHANG)) > 0)
+            {
+                running--;
+                if(WIFEXITED(status))
+                {
+                    held_off += WEXITSTATUS(status);
+                }
+                else
+                {
+                    failed++;
+                }
+            }
+
+            if(collected_now == 0)
+            {
+                boost::this_thread::sleep(boost::posix_time::milliseconds(1));
+            }
+        }
+    }
+    auto elapsed = boost::posix_time::microsec_clock::universal_time() - started;
+    boost::filesystem::remove_all(scratch);
+
+    double seconds = elapsed.total_microseconds() / 1000000.0;
+    std::cout << "clients:          " << clients << std::endl;
+    std::cout << "entries/client:   " << entries << std::endl;
+    std::cout << "entries written:  " << collected << std::endl;
+    std::cout << "clients failed:   " << failed << std::endl;
+    std::cout << "times held off:   " << held_off << std::endl;
+    std::cout << "elapsed (s):      " << seconds << std::endl;
+    std::cout << "entries/s:        " << static_cast<long>(collected / seconds) << std::endl;
+
+    return (failed == 0 && collected == static_cast<std::size_t>(clients) * entries) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,459 @@
+/*
+ * log_collector.cpp: Collects log entries from client rings and writes them to log files.
+ * Copyright (C) 2012, Project Inglenook (http://www.project-inglenook.co.uk)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// inglenook includes
+#include "log_collector.h"
+#include <ign_logging/log_exceptions.h>
+#include <ign_logging/log_record.h>
+
+// standard library includes
+#include <iostream>
+#include <cstring>
+
+// boost (http://boost.org) includes
+#include <boost/locale.hpp>
+
+// platform includes
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+namespace inglenook
+{
+
+namespace logging
+{
+
+/**
+ * Creates a new collector for the specified ring directory and marks the daemon as running, so clients
+ * started from now on will pass their entries to us.
+ * @param ring_directory directory to collect rings from.
+ */
+log_collector::log_collector(const boost::filesystem::path& ring_directory) :
+    m_ring_directory(ring_directory),
+    m_last_scan(boost::posix_time::not_a_date_time),
+    m_listener(-1),
+    m_frame(log_socket::MAX_FRAME_SIZE)
+{
+    scan();
+    _listen();
+}
+
+/**
+ * Drains every ring being collected and closes their log files.
+ * The heartbeat file is removed so new clients write their own logs; clients already using the daemon fall
+ * back to writing their own logs once they notice their ring is no longer collected.
+ */
+log_collector::~log_collector()
+{
+    boost::system::error_code filesystem_error;
+    boost::filesystem::remove(m_ring_directory / log_ring::COLLECTOR_HEARTBEAT_FILE, filesystem_error);
+
+    for(auto collected = m_rings.begin(); collected != m_rings.end(); collected++)
+    {
+        while(_drain(collected->second) > 0)
+        {
+            /* keep going until there is nothing left */
+        }
+    }
+
+    // stop accepting connections, then read whatever the connected clients have already sent.
+    if(m_listener >= 0)
+    {
+        ::close(m_listener);
+        boost::filesystem::remove(m_ring_directory / log_socket::SOCKET_FILE, filesystem_error);
+    }
+    for(auto client = m_socket_clients.begin(); client != m_socket_clients.end(); client++)
+    {
+        while(client->descriptor >= 0 && _receive(*client) > 0)
+        {
+            /* keep going until there is nothing left */
+        }
+        if(client->descriptor >= 0)
+        {
+            ::close(client->descriptor);
+        }
+    }
+}
+
+/**
+ * Collects waiting entries from every ring. The ring directory is scanned first if SCAN_INTERVAL has passed.
+ * Rings that have been closed by their client (or whose client has died) are removed once drained.
+ * @returns number of entries collected.
+ */
+std::size_t log_collector::collect()
+{
+    auto now = boost::posix_time::microsec_clock::universal_time();
+    if(m_last_scan.is_not_a_date_time() || now - m_last_scan >= boost::posix_time::milliseconds(SCAN_INTERVAL))
+    {
+        scan();
+    }
+
+    std::size_t collected_entries = 0;
+    for(auto collected = m_rings.begin(); collected != m_rings.end(); )
+    {
+        // the client has finished with the ring if it closed it or is no longer running (check before draining,
+        // so nothing pushed in between is missed).
+        auto& ring = collected->second.ring;
+        bool finished = ring->closed() || !ring->owner_alive();
+
+        collected_entries += _drain(collected->second);
+
+        if(finished && ring->empty())
+        {
+            // close the log file, then get rid of the ring.
+            collected->second.writer.reset();
+            boost::system::error_code filesystem_error;
+            boost::filesystem::remove(ring->file(), filesystem_error);
+            collected = m_rings.erase(collected);
+        }
+        else
+        {
+            collected++;
+        }
+    }
+
+    // collect from the socket connections, forgetting those that have gone.
+    _accept();
+    for(auto client = m_socket_clients.begin(); client != m_socket_clients.end(); )
+    {
+        collected_entries += _receive(*client);
+        if(client->descriptor < 0)
+        {
+            client = m_socket_clients.erase(client);
+        }
+        else
+        {
+            client++;
+        }
+    }
+
+    return collected_entries;
+}
+
+/**
+ * Marks the daemon as running and looks for rings that are not yet being collected.
+ * Rings that can't be opened (for example because their client is still creating them) are tried again
+ * on the next scan.
+ */
+void log_collector::scan()
+{
+    m_last_scan = boost::posix_time::microsec_clock::universal_time();
+    log_ring::collector_heartbeat(m_ring_directory);
+
+    boost::system::error_code filesystem_error;
+    boost::filesystem::directory_iterator end;
+    for(boost::filesystem::directory_iterator file(m_ring_directory, filesystem_error); !filesystem_error && file != end; file.increment(filesystem_error))
+    {
+        auto ring_file = file->path();
+        if(ring_file.extension() != log_ring::RING_FILE_EXTENSION || m_rings.count(ring_file) > 0)
+        {
+            continue;
+        }
+
+        try
+        {
+            collected_ring collected;
+            collected.ring = log_ring::open(ring_file);
+            collected.ring->heartbeat();
+            collected.writer = _create_writer(collected.ring->pid(), collected.ring->process_name());
+            m_rings[ring_file] = collected;
+        }
+        catch(log_ring_exception&)
+        {
+            /* not ready yet (or not a ring at all) - try again next time */
+        }
+        catch(log_exception&)
+        {
+            std::cerr << boost::locale::translate("WARNING: unable to create a log file for ring ") << ring_file << std::endl;
+        }
+    }
+
+    // close the log files of processes that have gone without saying so (and have no connections left).
+    for(auto socket_log = m_socket_logs.begin(); socket_log != m_socket_logs.end(); )
+    {
+        if(socket_log->second.use_count() == 1 && kill(static_cast<pid_t>(socket_log->first), 0) != 0 && errno != EPERM)
+        {
+            socket_log = m_socket_logs.erase(socket_log);
+        }
+        else
+        {
+            socket_log++;
+        }
+    }
+}
+
+/**
+ * Pops waiting entries from a ring (up to COLLECT_BATCH_SIZE) and writes them, then stamps the ring.
+ * @param collected ring to drain.
+ * @returns number of entries collected.
+ */
+std::size_t log_collector::_drain(collected_ring& collected)
+{
+    std::size_t collected_entries = 0;
+    while(collected_entries < COLLECT_BATCH_SIZE)
+    {
+        auto entry = collected.ring->pop();
+        if(entry == nullptr)
+        {
+            break;
+        }
+
+        collected.writer->add_entry(entry);
+        collected_entries++;
+    }
+
+    collected.ring->heartbeat();
+    return collected_entries;
+}
+
+/**
+ * Creates a writer for entries collected on behalf of a process, at the log path the process would have used.
+ * @param pid process id of the process.
+ * @param process_name name of the process.
+ * @returns new writer.
+ */
+std::shared_ptr<log_writer> log_collector::_create_writer(const pid_type& pid, const std::string& process_name)
+{
+    auto writer = log_writer::create(true, true, pid, process_name);
+
+    // clients only pass entries they want written, and the console isn't ours to write to.
+    writer->xml_threshold(category::debugging);
+    writer->console_threshold(category::no_log);
+
+    return writer;
+}
+
+/**
+ * Starts listening for socket connections in the ring directory. Any stale socket left by a previous run is
+ * replaced. If the socket can't be created, rings are still collected.
+ */
+void log_collector::_listen()
+{
+    auto socket_file = m_ring_directory / log_socket::SOCKET_FILE;
+
+    struct sockaddr_un address;
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if(socket_file.native().length() >= sizeof(address.sun_path))
+    {
+        std::cerr << boost::locale::translate("WARNING: socket path is too long, not listening on ") << socket_file << std::endl;
+        return;
+    }
+    std::strncpy(address.sun_path, socket_file.c_str(), sizeof(address.sun_path) - 1);
+
+    boost::system::error_code filesystem_error;
+    boost::filesystem::remove(socket_file, filesystem_error);
+
+    m_listener = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if(m_listener < 0 ||
+       bind(m_listener, reinterpret_cast<struct sockaddr*>(&address), sizeof(address)) != 0 ||
+       listen(m_listener, SOMAXCONN) != 0)
+    {
+        std::cerr << boost::locale::translate("WARNING: unable to listen on ") << socket_file << ": " << std::strerror(errno) << std::endl;
+        if(m_listener >= 0)
+        {
+            ::close(m_listener);
+            m_listener = -1;
+        }
+    }
+}
+
+/**
+ * Accepts any waiting socket connections. Clients are not logged for until they have said who they are.
+ */
+void log_collector::_accept()
+{
+    while(m_listener >= 0)
+    {
+        int descriptor = accept4(m_listener, nullptr, nullptr, SOCK_CLOEXEC);
+        if(descriptor < 0)
+        {
+            break;
+        }
+
+        socket_client client;
+        client.descriptor = descriptor;
+        client.pid = log_writer::NO_PID;
+        client.busy = false;
+        m_socket_clients.push_back(client);
+    }
+}
+
+/**
+ * Reads up to COLLECT_BATCH_SIZE entries from a socket connection, then writes them as a batch. Clients with more
+ * than BUSY_HIGH_WATER still waiting to be read are told to hold off, and told to carry on once below
+ * BUSY_LOW_WATER. The connection is closed (and its descriptor set to -1) once the client has gone.
+ * @param client connection to read from.
+ * @returns number of entries collected.
+ */
+std::size_t log_collector::_receive(socket_client& client)
+{
+    bool finished = false;
+    while(client.batch.size() < COLLECT_BATCH_SIZE)
+    {
+        ssize_t received = recv(client.descriptor, m_frame.data(), m_frame.size(), MSG_DONTWAIT);
+        if(received < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if(received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        {
+            break;
+        }
+        if(received <= 0)
+        {
+            finished = true;
+            break;
+        }
+
+        switch(static_cast<log_socket_frame>(m_frame[0]))
+        {
+            // the client is saying who it is logging for (processes share a log file between connections).
+            case log_socket_frame::hello:
+            {
+                std::int64_t pid = 0;
+                if(client.writer != nullptr || static_cast<std::size_t>(received) < 1 + sizeof(pid))
+                {
+                    break;
+                }
+                std::memcpy(&pid, m_frame.data() + 1, sizeof(pid));
+                client.pid = static_cast<pid_type>(pid);
+
+                auto& writer = m_socket_logs[client.pid];
+                if(writer == nullptr)
+                {
+                    try
+                    {
+                        writer = _create_writer(client.pid, std::string(m_frame.data() + 1 + sizeof(pid), received - 1 - sizeof(pid)));
+                    }
+                    catch(log_exception&)
+                    {
+                        std::cerr << boost::locale::translate("WARNING: unable to create a log file for process ") << client.pid << std::endl;
+                        m_socket_logs.erase(client.pid);
+                        finished = true;
+                        break;
+                    }
+                }
+                client.writer = writer;
+                break;
+            }
+            // an entry to write (entries from clients that haven't said who they are are dropped).
+            case log_socket_frame::entry:
+            {
+                auto entry = log_record::decode(m_frame.data() + 1, received - 1);
+                if(client.writer != nullptr && entry != nullptr)
+                {
+                    client.batch.push_back(entry);
+                }
+                break;
+            }
+            // the process has finished, its log file is closed once the last connection for it has gone.
+            case log_socket_frame::close_log:
+            {
+                auto socket_log = m_socket_logs.find(client.pid);
+                if(client.writer != nullptr && socket_log != m_socket_logs.end() && socket_log->second == client.writer)
+                {
+                    m_socket_logs.erase(socket_log);
+                }
+                break;
+            }
+            default:
+            {
+                /* not something a client should send - ignore it */
+                break;
+            }
+        }
+
+        if(finished)
+        {
+            break;
+        }
+    }
+
+    // write the batch out.
+    std::size_t collected_entries = client.batch.size();
+    for(auto entry = client.batch.begin(); entry != client.batch.end(); entry++)
+    {
+        client.writer->add_entry(*entry);
+    }
+    client.batch.clear();
+
+    if(finished)
+    {
+        ::close(client.descriptor);
+        client.descriptor = -1;
+        client.writer.reset();
+        return collected_entries;
+    }
+
+    // let the client know if it is getting ahead of us.
+    int waiting = 0;
+    ioctl(client.descriptor, FIONREAD, &waiting);
+    if(client.busy != (waiting > (client.busy ? BUSY_LOW_WATER : BUSY_HIGH_WATER)))
+    {
+        client.busy = !client.busy;
+        char status = static_cast<char>(client.busy ? log_socket_frame::busy : log_socket_frame::ready);
+        send(client.descriptor, &status, 1, MSG_DONTWAIT | MSG_NOSIGNAL);
+    }
+
+    return collected_entries;
+}
+
+/**
+ * Gets the number of rings currently being collected.
+ * @returns number of rings.
+ */
+std::size_t log_collector::ring_count() const
+{
+    return m_rings.size();
+}
+
+/**
+ * Gets the directory rings are collected from.
+ * @returns ring directory.
+ */
+const boost::filesystem::path& log_collector::ring_directory() const
+{
+    return m_ring_directory;
+}
+
+/**
+ * Gets the number of clients connected over the socket.
+ * @returns number of connections.
+ */
+std::size_t log_collector::connection_count() const
+{
+    return m_socket_clients.size();
+}
+
+/**
+ * Gets the number of log files open for clients connecting over the socket.
+ * @returns number of log files.
+ */
+std::size_t log_collector::socket_log_count() const
+{
+    return m_socket_logs.size();
+}
+
+} // namespace inglenook::logging
+
+} // namespace inglenook
@@ -0,0 +1,166 @@
+#pragma once
+/*
+ * log_collector.h: Collects log entries from client rings and writes them to log files.
+ * Copyright (C) 2012, Project Inglenook (http://www.project-inglenook.co.uk)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// standard library includes
+#include <map>
+#include <list>
+#include <vector>
+#include <memory>
+
+// boost (http://boost.org) includes
+#include <boost/filesystem.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+
+// inglenook includes
+#include <ign_logging/log_ring.h>
+#include <ign_logging/log_writer.h>
+#include <ign_logging/log_socket.h>
+
+namespace inglenook
+{
+
+namespace logging
+{
+
+/**
+ * The log_collector class is the heart of the logging service daemon (ign_logd).
+ * It watches the ring directory for rings created by client processes (see log_writer::create_from_service()), pops
+ * entries from each ring and writes them to a log file on behalf of the client, exactly as the client would have
+ * written it. Rings are stamped each time they are collected so clients know the daemon is alive; once a client has
+ * closed its ring (or died) and the ring has been drained, the log file is closed and the ring removed.
+ * The collector also listens on a unix domain socket in the ring directory (see log_socket). Entries are read from
+ * each connection in batches and written to the log file of the process the connection announced; connections
+ * that send faster than the entries can be written are told to hold off until the collector catches up.
+ */
+class log_collector
+{
+
+    public:
+
+        // creates a new collector for the specified ring directory.
+        log_collector(const boost::filesystem::path& ring_directory = log_ring::default_ring_directory());
+
+        /// there is no copy constructor for the log_collector (deleted).
+        log_collector(const log_collector&) = delete;
+
+        // drains and closes every ring being collected.
+        virtual ~log_collector();
+
+        // collects waiting entries from every ring (looking for new rings when due).
+        std::size_t collect();
+
+        // looks for new rings and marks the daemon as running.
+        void scan();
+
+        /// gets the number of rings currently being collected.
+        std::size_t ring_count() const;
+
+        /// gets the directory rings are collected from.
+        const boost::filesystem::path& ring_directory() const;
+
+        /// gets the number of clients connected over the socket.
+        std::size_t connection_count() const;
+
+        /// gets the number of log files open for clients connecting over the socket.
+        std::size_t socket_log_count() const;
+
+        /// amount of time between scans of the ring directory.
+        const int SCAN_INTERVAL = 250; // ms (0.25 seconds)
+
+        /// maximum number of entries popped from one ring before moving to the next.
+        const std::size_t COLLECT_BATCH_SIZE = 256;
+
+        /// socket connections are told to hold off when more than this is waiting to be read from them.
+        const int BUSY_HIGH_WATER = 65536; // bytes (64KiB)
+
+        /// socket connections that were told to hold off are told to carry on when less than this is waiting.
+        const int BUSY_LOW_WATER = 16384; // bytes (16KiB)
+
+    private:
+
+        /// a ring being collected, and the writer its entries are written with.
+        struct collected_ring
+        {
+            /// ring the entries are popped from.
+            std::shared_ptr<log_ring> ring;
+
+            /// writer the entries are written with.
+            std::shared_ptr<log_writer> writer;
+        };
+
+        /// a client connected over the socket.
+        struct socket_client
+        {
+            /// connected socket (closed once the client has gone).
+            int descriptor;
+
+            /// process id the client is logging for.
+            pid_type pid;
+
+            /// set while the client has been told to hold off.
+            bool busy;
+
+            /// writer the entries are written with (null until the client has said who it is).
+            std::shared_ptr<log_writer> writer;
+
+            /// entries read from the client, waiting to be written.
+            std::vector<std::shared_ptr<log_entry>> batch;
+        };
+
+        /// pops waiting entries from a ring and writes them.
+        std::size_t _drain(collected_ring& collected);
+
+        /// creates a writer for entries collected on behalf of a process.
+        std::shared_ptr<log_writer> _create_writer(const pid_type& pid, const std::string& process_name);
+
+        /// starts listening for socket connections.
+        void _listen();
+
+        /// accepts waiting socket connections.
+        void _accept();
+
+        /// reads a batch of frames from a socket connection and writes its entries.
+        std::size_t _receive(socket_client& client);
+
+        /// directory rings are collected from.
+        boost::filesystem::path m_ring_directory;
+
+        /// rings currently being collected, keyed by ring file.
+        std::map<boost::filesystem::path, collected_ring> m_rings;
+
+        /// time the ring directory was last scanned.
+        boost::posix_time::ptime m_last_scan;
+
+        /// listening socket (-1 if not listening).
+        int m_listener;
+
+        /// clients connected over the socket.
+        std::list<socket_client> m_socket_clients;
+
+        /// log files open for clients connecting over the socket, keyed by process id.
+        std::map<pid_type, std::shared_ptr<log_writer>> m_socket_logs;
+
+        /// buffer frames are read in to.
+        std::vector<char> m_frame;
+
+};
+
+} // namespace inglenook::logging
+
+} // namespace inglenook
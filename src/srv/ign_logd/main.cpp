@@ -0,0 +1,142 @@
+/*
+ * main.cpp: Logging service daemon, writes log files on behalf of client processes.
+ * Copyright (C) 2012, Project Inglenook (http://www.project-inglenook.co.uk)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// inglenook includes
+#include "version.h"
+#include "program_options.h"
+#include "log_collector.h"
+#include <ign_core/application.h>
+#include <ign_core/application_exceptions.h>
+
+// standard library includes
+#include <iostream>
+#include <csignal>
+
+// boost (http://boost.org) includes
+#include <boost/format.hpp>
+#include <boost/locale.hpp>
+#include <boost/program_options.hpp>
+#include <boost/thread/thread.hpp>
+
+//--------------------------------------------------------//
+// Hide the implementation in the anonymous namespace.
+namespace
+{
+
+    /// set by the signal handler when the daemon is asked to stop.
+    volatile std::sig_atomic_t shutdown_requested = 0;
+
+    /**
+     * Asks the daemon to stop (SIGTERM, SIGINT).
+     * @param signal_number signal received.
+     */
+    void request_shutdown(int signal_number)
+    {
+        shutdown_requested = 1;
+    }
+
+}
+//--------------------------------------------------------//
+
+/**
+ * This is the main entry point of the ign_logd daemon.
+ * @param argc number of command line arguments
+ * @param argv list of command line arguments
+ * @returns EXIT_SUCCESS on success, EXIT_FAILURE on generic failure.
+ */
+int main(int argc, const char* argv[])
+{
+    // Keep track of our success.
+    int success(EXIT_FAILURE);
+
+    // Program description.
+    std::string description(boost::locale::translate("logging service daemon, writes log files on behalf of inglenook processes"));
+
+    // Create the application store.
+    inglenook::core::application app(description, VERSION,  __DATE__, __TIME__);
+
+    // Program specific options.
+    boost::program_options::options_description options("Program options");
+    options.add_options()
+        (boost::str(boost::format("%1%,%2%") % PO_RING_DIRECTORY_FULL % PO_RING_DIRECTORY_SHORT).c_str(),
+            boost::program_options::value<std::string>()->default_value(inglenook::logging::log_ring::default_ring_directory().string()),
+            boost::locale::translate("Directory to collect client rings from.").str().c_str())
+        (boost::str(boost::format("%1%,%2%") % PO_POLL_INTERVAL_FULL % PO_POLL_INTERVAL_SHORT).c_str(),
+            boost::program_options::value<int>()->default_value(10),
+            boost::locale::translate("Time to wait (in milliseconds) before collecting again when there was nothing to collect.").str().c_str())
+    ;
+
+    // Try and parse the command line arguments.
+    bool parser_exit(false);
+    bool parser_failure(false);
+    boost::program_options::variables_map vm;
+    try
+    {
+        parser_exit = inglenook::core::application::arguments_parser(vm, argc, argv, options);
+    }
+    catch(inglenook::core::exceptions::application_arguments_parser_exception &ex)
+    {
+        parser_failure = true;
+    }
+
+    // Has the options parser indicated we should exit.
+    if(parser_exit)
+    {
+        // Set as a success execution before we finish.
+        success = EXIT_SUCCESS;
+    }
+    // Did the parser fail (It would have already printed out the issue .
+    else if(parser_failure)
+    {
+        // Set as a failure execution before we finish.
+        success = EXIT_FAILURE;
+    }
+    else
+    {
+        try
+        {
+            // ign_logd does not use logging conventionally - it would be logging to itself.
+            auto poll_interval = boost::posix_time::milliseconds(std::max(1, vm[PO_POLL_INTERVAL_FULL].as<int>()));
+
+            // stop cleanly when asked to.
+            std::signal(SIGTERM, request_shutdown);
+            std::signal(SIGINT, request_shutdown);
+
+            // collect until we are asked to stop (the collector drains everything as it goes).
+            inglenook::logging::log_collector collector(vm[PO_RING_DIRECTORY_FULL].as<std::string>());
+            while(!shutdown_requested)
+            {
+                if(collector.collect() == 0)
+                {
+                    boost::this_thread::sleep(poll_interval);
+                }
+            }
+
+            // Sucess!
+            success = EXIT_SUCCESS;
+        }
+        catch(...) // this is the "its gone seriously wrong" error handler.
+        {
+            std::cerr << boost::locale::translate("Unhandled exception in ign_logd:") << std::endl <<
+                boost::current_exception_diagnostic_information();
+        }
+    }
+
+    // Return whether we was successful.
+    return success;
+}
@@ -0,0 +1,28 @@
+/*
+ * program_options.h: Defines program options.
+ * Copyright (C) 2012, Project Inglenook (http://www.project-inglenook.co.uk)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// standard library includes
+#include <string>
+
+// Program options: ring directory
+const std::string PO_RING_DIRECTORY_FULL = "ring-directory";
+const std::string PO_RING_DIRECTORY_SHORT = "r";
+
+// Program options: poll interval
+const std::string PO_POLL_INTERVAL_FULL = "poll-interval";
+const std::string PO_POLL_INTERVAL_SHORT = "i";
@@ -0,0 +1,222 @@
+/*
+* tests.cpp: Test routines for the ign_logd assembly (src/srv/ign_logd)
+* Copyright (C) 2012, Project Inglenook (http://www.project-inglenook.co.uk)
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE ign_logd_tests
+
+/*
+ * The following tests help ensure that ign_logd is operating correctly.
+ * The ring itself is tested by ign_logging, these tests cover collecting from
+ * rings. The follow elements are not currently tested:
+ *  main.cpp                          - little functional code tests could be written for (by design).
+ */
+
+// standard includes
+#include <fstream>
+#include <sstream>
+
+// platform includes
+#include <unistd.h>
+#include <sys/wait.h>
+
+// boost (http://boost.org) includes
+#include <boost/test/unit_test.hpp>
+#include <boost/filesystem.hpp>
+
+// inglenook includes
+#include <ign_core/environment.h>
+#include <ign_core/environment_variables.h>
+#include <ign_logging/log_exceptions.h>
+#include "log_collector.h"
+
+namespace inglenook
+{
+
+namespace logging
+{
+
+/**
+ * Points the temporary and log directories at a scratch directory for the duration of a test.
+ */
+struct logd_test_directories
+{
+    /// scratch directory used by the test.
+    boost::filesystem::path root;
+
+    logd_test_directories() :
+        root(boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("ign-logd-%%%%-%%%%"))
+    {
+        boost::filesystem::create_directories(root / "log");
+        core::environment::set(core::environment::variables::DIR_TMP, (root / "tmp").native());
+        core::environment::set(core::environment::variables::DIR_LOG, (root / "log").native());
+    }
+
+    ~logd_test_directories()
+    {
+        boost::filesystem::remove_all(root);
+    }
+
+    /**
+     * Reads every log file written in to the log directory.
+     * @returns content of all log files.
+     */
+    std::string logs() const
+    {
+        std::stringstream content;
+        for(boost::filesystem::recursive_directory_iterator file(root / "log"), end; file != end; file++)
+        {
+            if(boost::filesystem::is_regular_file(file->path()))
+            {
+                std::ifstream input(file->path().native());
+                content << input.rdbuf();
+            }
+        }
+        return content.str();
+    }
+};
+
+/**
+ * Creates a test entry.
+ * @param message message of the entry.
+ * @returns new entry.
+ */
+std::shared_ptr<log_entry> make_logd_entry(const std::string& message)
+{
+    auto entry = std::shared_ptr<log_entry>(new log_entry());
+    entry->entry_type(category::information);
+    entry->log_namespace("inglenook.logd.test");
+    entry->message(message);
+    return entry;
+}
+
+//
+// logd_tests__collect
+// checks that entries passed to the daemon by a client are written to the clients
+// log file, and that the ring is cleaned up once the client has finished with it.
+BOOST_AUTO_TEST_CASE ( logd_tests__collect )
+{
+    logd_test_directories directories;
+    log_collector collector;
+    BOOST_CHECK(log_ring::collector_running(collector.ring_directory()));
+
+    auto writer = log_writer::create_from_service(getpid(), "logd-test");
+    writer->console_threshold(category::no_log);
+    BOOST_REQUIRE(writer->using_service());
+
+    auto entry = make_logd_entry("collected entry");
+    entry->extended_data("test.key", "test value");
+    writer->add_entry(entry);
+    collector.scan();
+    BOOST_CHECK(collector.collect() == 1);
+    BOOST_CHECK(collector.ring_count() == 1);
+
+    // once the client is finished, the log is closed and the ring removed.
+    writer.reset();
+    BOOST_CHECK(collector.collect() == 0);
+    BOOST_CHECK(collector.ring_count() == 0);
+    BOOST_CHECK(!boost::filesystem::exists(log_ring::default_ring_file(getpid())));
+
+    std::string logs = directories.logs();
+    BOOST_CHECK(logs.find("<![CDATA[collected entry]]>") != std::string::npos);
+    BOOST_CHECK(logs.find("<item key=\"test.key\"><![CDATA[test value]]></item>") != std::string::npos);
+    BOOST_CHECK(logs.find("logd-test") != std::string::npos);
+    BOOST_CHECK(logs.find("</inglenook-log-file>") != std::string::npos);
+}
+
+//
+// logd_tests__dead_client
+// checks that entries left behind by a client that has died are still written,
+// and its ring is removed.
+BOOST_AUTO_TEST_CASE ( logd_tests__dead_client )
+{
+    logd_test_directories directories;
+    log_collector collector;
+
+    // the child leaves its ring behind without closing it.
+    pid_t child = fork();
+    if(child == 0)
+    {
+        auto ring = log_ring::create(log_ring::default_ring_file(getpid()), getpid(), "logd-child");
+        ring->push(*make_logd_entry("left behind"));
+        _exit(0);
+    }
+    int status = 0;
+    waitpid(child, &status, 0);
+
+    collector.scan();
+    BOOST_CHECK(collector.collect() == 1);
+    BOOST_CHECK(collector.ring_count() == 0);
+    BOOST_CHECK(!boost::filesystem::exists(log_ring::default_ring_file(child)));
+    BOOST_CHECK(directories.logs().find("<![CDATA[left behind]]>") != std::string::npos);
+}
+
+//
+// logd_tests__socket
+// checks that entries sent over the socket by several connections for the same
+// process are written to one log file, which is closed once the process asks.
+BOOST_AUTO_TEST_CASE ( logd_tests__socket )
+{
+    logd_test_directories directories;
+    log_collector collector;
+
+    auto first = log_socket::connect(getpid(), "logd-socket");
+    auto second = log_socket::connect(getpid(), "logd-socket");
+    BOOST_CHECK(first->send(*make_logd_entry("first connection")));
+    BOOST_CHECK(second->send(*make_logd_entry("second connection")));
+    BOOST_CHECK(collector.collect() == 2);
+    BOOST_CHECK(collector.connection_count() == 2);
+    BOOST_CHECK(collector.socket_log_count() == 1);
+
+    // the log stays open until the process is finished with it...
+    first.reset();
+    collector.collect();
+    BOOST_CHECK(collector.connection_count() == 1);
+    BOOST_CHECK(collector.socket_log_count() == 1);
+    BOOST_CHECK(directories.logs().find("</inglenook-log-file>") == std::string::npos);
+
+    // ... and is closed once the last connection goes after it has said so.
+    BOOST_CHECK(second->close_log());
+    second.reset();
+    collector.collect();
+    BOOST_CHECK(collector.connection_count() == 0);
+    BOOST_CHECK(collector.socket_log_count() == 0);
+
+    std::string logs = directories.logs();
+    BOOST_CHECK(logs.find("<![CDATA[first connection]]>") != std::string::npos);
+    BOOST_CHECK(logs.find("<![CDATA[second connection]]>") != std::string::npos);
+    BOOST_CHECK(logs.find("logd-socket") != std::string::npos);
+    BOOST_CHECK(logs.find("</inglenook-log-file>") != std::string::npos);
+}
+
+//
+// logd_tests__shutdown
+// checks that stopping the daemon tells new clients to write their own logs.
+BOOST_AUTO_TEST_CASE ( logd_tests__shutdown )
+{
+    logd_test_directories directories;
+    {
+        log_collector collector;
+        BOOST_CHECK(log_ring::collector_running(collector.ring_directory()));
+    }
+    BOOST_CHECK(!log_ring::collector_running(log_ring::default_ring_directory()));
+    BOOST_CHECK(!log_writer::create_from_service(getpid(), "logd-test")->using_service());
+    BOOST_CHECK_THROW(log_socket::connect(getpid(), "logd-test"), log_socket_exception);
+}
+
+} // namespace inglenook::logging
+
+} // namespace inglenook